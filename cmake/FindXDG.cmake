@@ -24,6 +24,12 @@ string (REGEX REPLACE "/xdg$" "" XDG_INCLUDE ${XDG_INCLUDE})
 
 find_library(XDG_LIBRARY NAMES xdg)
 
+# The library loads the MIME database with several threads
+find_package (Threads)
+if (XDG_LIBRARY AND CMAKE_THREAD_LIBS_INIT)
+    set (XDG_LIBRARY ${XDG_LIBRARY} ${CMAKE_THREAD_LIBS_INIT})
+endif ()
+
 
 # handle the QUIETLY and REQUIRED arguments and set XDG_FOUND to TRUE if all listed variables are TRUE
 include(FindPackageHandleStandardArgs)
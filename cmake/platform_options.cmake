@@ -7,3 +7,4 @@ BUILD_DESKTOP_SPEC               "Build library with \"Desktop Entry Specificati
 BUILD_THEMES_SPEC                "Build library with \"Icon Theme Specification\""    1
 BUILD_MENU_SPEC                  "Build library with \"Desktop Menu Specification\""  1
 BUILD_UPDATE_APPLICATIONS_CACHE  "Build executable for rebuilding the cache"          1
+BUILD_MIME_BENCHMARKS            "Build \"Shared MIME-info Database\" benchmarks"     0
@@ -263,3 +263,27 @@ char *_xdg_search_in_each_theme_dir(XdgIconSearchFunc func, void *user_data)
 
 	return 0;
 }
+
+char *_xdg_cache_home_file(const char *file_name)
+{
+	const char *xdg_cache_home;
+	char *res;
+
+	if ((xdg_cache_home = getenv("XDG_CACHE_HOME")) && *xdg_cache_home)
+	{
+		res = malloc(strlen(xdg_cache_home) + strlen(file_name) + 2);
+		strcpy(res, xdg_cache_home); strcat(res, "/"); strcat(res, file_name);
+	}
+	else
+	{
+		const char *home = getenv("HOME");
+
+		if (home == NULL)
+			return NULL;
+
+		res = malloc(strlen(home) + strlen("/.cache/") + strlen(file_name) + 1);
+		strcpy(res, home); strcat(res, "/.cache/"); strcat(res, file_name);
+	}
+
+	return res;
+}
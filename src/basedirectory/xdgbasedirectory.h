@@ -61,4 +61,11 @@ void _xdg_for_each_theme_dir(XdgDirectoryFunc func, void *user_data);
  */
 char *_xdg_search_in_each_theme_dir(XdgIconSearchFunc func, void *user_data);
 
+
+/**
+ * Returns "file_name" inside the "XDG_CACHE_HOME" directory, or NULL
+ * if neither it nor "HOME" is set. The result must be freed.
+ */
+char *_xdg_cache_home_file(const char *file_name);
+
 #endif /* XDGBASEDIRECTORY_H_ */
@@ -0,0 +1,419 @@
+#include "corpus.h"
+#include "../mime/xdgmime.h"
+#include "../mime/xdgmime_p.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+
+#define DEFAULT_GLOBS 1000
+#define DEFAULT_MAGIC 200
+#define DEFAULT_FILES 2000
+#define DEFAULT_ITERATIONS 5
+#define DEFAULT_SEED 1
+#define MAX_RESULTS 10
+
+typedef void (*LookupFunc)(const BenchFile *files, int n_files);
+
+struct Lookup
+{
+	const char *name;
+	LookupFunc func;
+	int thread_safe;
+};
+typedef struct Lookup Lookup;
+
+struct Options
+{
+	int globs;
+	int magic;
+	int files;
+	int threads;
+	int iterations;
+	unsigned int seed;
+	int csv;
+	int keep;
+};
+typedef struct Options Options;
+
+struct Worker
+{
+	pthread_t thread;
+	pthread_barrier_t *barrier;
+	const Lookup *lookup;
+	const BenchCorpus *corpus;
+	int iterations;
+	double start;
+	double end;
+};
+typedef struct Worker Worker;
+
+static Options options =
+{
+	DEFAULT_GLOBS, DEFAULT_MAGIC, DEFAULT_FILES, 0, DEFAULT_ITERATIONS, DEFAULT_SEED, 0, 0
+};
+
+
+static void lookup_from_file_name(const BenchFile *files, int n_files)
+{
+	int i;
+
+	for (i = 0; i < n_files; ++i)
+		xdg_mime_get_mime_type_from_file_name(files[i].name);
+}
+
+static void lookup_types_from_file_name(const BenchFile *files, int n_files)
+{
+	const char *mime_types[MAX_RESULTS];
+	int i;
+
+	for (i = 0; i < n_files; ++i)
+		xdg_mime_get_mime_types_from_file_name(files[i].name, mime_types, MAX_RESULTS);
+}
+
+static void lookup_for_data(const BenchFile *files, int n_files)
+{
+	int i, prio;
+
+	for (i = 0; i < n_files; ++i)
+		xdg_mime_get_mime_type_for_data(files[i].data, files[i].size, &prio);
+}
+
+static void lookup_for_file(const BenchFile *files, int n_files)
+{
+	int i;
+
+	for (i = 0; i < n_files; ++i)
+		xdg_mime_get_mime_type_for_file(files[i].path, NULL);
+}
+
+static void lookup_for_files(const BenchFile *files, int n_files)
+{
+	const char **file_names = malloc(sizeof(const char *) * n_files * 2);
+	const char **mime_types = file_names + n_files;
+	int i;
+
+	for (i = 0; i < n_files; ++i)
+		file_names[i] = files[i].path;
+
+	xdg_mime_get_mime_types_for_files(file_names, mime_types, n_files);
+	free(file_names);
+}
+
+static void lookup_unalias(const BenchFile *files, int n_files)
+{
+	int i;
+
+	for (i = 0; i < n_files; ++i)
+		xdg_mime_unalias_mime_type(files[i].mime_type);
+}
+
+static void lookup_subclass(const BenchFile *files, int n_files)
+{
+	int i;
+
+	for (i = 0; i < n_files; ++i)
+		xdg_mime_mime_type_subclass(files[i].mime_type, "text/plain");
+}
+
+static void lookup_parents(const BenchFile *files, int n_files)
+{
+	const char *parents[MAX_RESULTS];
+	int i;
+
+	for (i = 0; i < n_files; ++i)
+		xdg_mime_get_parents_into(files[i].mime_type, parents, MAX_RESULTS);
+}
+
+static void lookup_icon(const BenchFile *files, int n_files)
+{
+	int i;
+
+	for (i = 0; i < n_files; ++i)
+		if (xdg_mime_get_icon(files[i].mime_type) == NULL)
+			xdg_mime_get_generic_icon(files[i].mime_type);
+}
+
+static void lookup_globs_for_type(const BenchFile *files, int n_files)
+{
+	const char *globs[MAX_RESULTS];
+	int i;
+
+	for (i = 0; i < n_files; ++i)
+		xdg_mime_get_globs_for_type(files[i].mime_type, globs, MAX_RESULTS);
+}
+
+/* The batch lookup temporarily changes the magic flags, so it is only
+ * measured from one thread */
+static const Lookup lookups[] =
+{
+	{ "from_file_name",       lookup_from_file_name,       1 },
+	{ "types_from_file_name", lookup_types_from_file_name, 1 },
+	{ "for_data",             lookup_for_data,             1 },
+	{ "for_file",             lookup_for_file,             1 },
+	{ "for_files",            lookup_for_files,            0 },
+	{ "unalias",              lookup_unalias,              1 },
+	{ "subclass",             lookup_subclass,             1 },
+	{ "parents",              lookup_parents,              1 },
+	{ "icon",                 lookup_icon,                 1 },
+	{ "globs_for_type",       lookup_globs_for_type,       1 }
+};
+
+
+static void usage()
+{
+	fprintf(stdout,
+			"Usage: bench-mime [-g GLOBS] [-m MAGIC] [-n FILES] [-t THREADS] [-i ITERATIONS] [-s SEED] [-c] [-k]"
+			"\n\n  Generates a synthetic \"Shared MIME-info Database\" with GLOBS globs (default %d)"
+			"\nand MAGIC magic rules (default %d) and a corpus of FILES files (default %d), then"
+			"\nmeasures every public lookup over the corpus:"
+			"\n\n  cold   first pass right after loading the database, with the database and"
+			"\n         the corpus evicted from the page cache"
+			"\n  warm   median of ITERATIONS passes (default %d) from one thread"
+			"\n  warm   ITERATIONS passes from each of THREADS threads at once (default is"
+			"\n         the number of processors, at least 2)"
+			"\n\n  -s SEED  seed of the generators (default %d), equal seeds give equal data"
+			"\n  -c       print comma separated values"
+			"\n  -k       keep the generated files"
+			"\n",
+			DEFAULT_GLOBS, DEFAULT_MAGIC, DEFAULT_FILES, DEFAULT_ITERATIONS, DEFAULT_SEED);
+}
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+
+	return (da > db) - (da < db);
+}
+
+static void evict(const char *file_name)
+{
+	int fd = open(file_name, O_RDONLY);
+
+	if (fd >= 0)
+	{
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+}
+
+static void report(const Lookup *lookup, const char *state, int threads, long calls, double elapsed, double wall)
+{
+	if (options.csv)
+		fprintf(stdout, "%s,%s,%d,%d,%d,%d,%ld,%.1f,%.0f\n",
+				lookup->name, state, threads, options.globs, options.magic, options.files,
+				calls, elapsed / calls, calls * 1e9 / wall);
+	else
+		fprintf(stdout, "%-22s %-5s %7d %10ld %12.1f %14.0f\n",
+				lookup->name, state, threads,
+				calls, elapsed / calls, calls * 1e9 / wall);
+}
+
+static void measure_cold(const Lookup *lookup, const BenchCorpus *corpus, const char *cache_file)
+{
+	double start, elapsed;
+	int i;
+
+	_xdg_mime_shutdown();
+
+	evict(cache_file);
+	for (i = 0; i < corpus->n_files; ++i)
+		evict(corpus->files[i].path);
+
+	_xdg_mime_init();
+
+	start = now();
+	lookup->func(corpus->files, corpus->n_files);
+	elapsed = now() - start;
+
+	report(lookup, "cold", 1, corpus->n_files, elapsed, elapsed);
+}
+
+static void measure_warm(const Lookup *lookup, const BenchCorpus *corpus)
+{
+	double *samples = malloc(sizeof(double) * options.iterations);
+	double start;
+	int i;
+
+	for (i = 0; i < options.iterations; ++i)
+	{
+		start = now();
+		lookup->func(corpus->files, corpus->n_files);
+		samples[i] = now() - start;
+	}
+
+	qsort(samples, options.iterations, sizeof(double), compare_doubles);
+	report(lookup, "warm", 1, corpus->n_files, samples[options.iterations / 2], samples[options.iterations / 2]);
+
+	free(samples);
+}
+
+static void *worker_main(void *data)
+{
+	Worker *worker = data;
+	int i;
+
+	pthread_barrier_wait(worker->barrier);
+
+	worker->start = now();
+	for (i = 0; i < worker->iterations; ++i)
+		worker->lookup->func(worker->corpus->files, worker->corpus->n_files);
+	worker->end = now();
+
+	return NULL;
+}
+
+static void measure_threads(const Lookup *lookup, const BenchCorpus *corpus)
+{
+	Worker *workers = calloc(options.threads, sizeof(Worker));
+	pthread_barrier_t barrier;
+	double start, end, elapsed = 0;
+	int i;
+
+	pthread_barrier_init(&barrier, NULL, options.threads + 1);
+
+	for (i = 0; i < options.threads; ++i)
+	{
+		workers[i].barrier = &barrier;
+		workers[i].lookup = lookup;
+		workers[i].corpus = corpus;
+		workers[i].iterations = options.iterations;
+		pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+	}
+
+	pthread_barrier_wait(&barrier);
+
+	for (i = 0; i < options.threads; ++i)
+		pthread_join(workers[i].thread, NULL);
+
+	start = workers[0].start;
+	end = workers[0].end;
+
+	for (i = 0; i < options.threads; ++i)
+	{
+		elapsed += workers[i].end - workers[i].start;
+		start = workers[i].start < start ? workers[i].start : start;
+		end = workers[i].end > end ? workers[i].end : end;
+	}
+
+	/* Latency is averaged over the threads, throughput is of all of them */
+	report(lookup, "warm", options.threads,
+		   (long)corpus->n_files * options.iterations * options.threads,
+		   elapsed, end - start);
+
+	pthread_barrier_destroy(&barrier);
+	free(workers);
+}
+
+static int parse_options(int argc, char *argv[])
+{
+	int option;
+
+	while ((option = getopt(argc, argv, "g:m:n:t:i:s:ck")) != -1)
+		switch (option)
+		{
+			case 'g': options.globs = atoi(optarg); break;
+			case 'm': options.magic = atoi(optarg); break;
+			case 'n': options.files = atoi(optarg); break;
+			case 't': options.threads = atoi(optarg); break;
+			case 'i': options.iterations = atoi(optarg); break;
+			case 's': options.seed = strtoul(optarg, NULL, 10); break;
+			case 'c': options.csv = 1; break;
+			case 'k': options.keep = 1; break;
+			default: return 0;
+		}
+
+	if (options.threads == 0 && (options.threads = sysconf(_SC_NPROCESSORS_ONLN)) < 2)
+		options.threads = 2;
+
+	return optind == argc && options.globs >= 0 && options.magic >= 0 &&
+		   options.files > 0 && options.threads > 0 && options.iterations > 0;
+}
+
+int main(int argc, char *argv[])
+{
+	char directory[] = "/tmp/bench-mime-XXXXXX";
+	char path[sizeof(directory) + 32];
+	char cache_file[sizeof(directory) + 32];
+	BenchCorpus *corpus;
+	int i;
+
+	if (!parse_options(argc, argv))
+	{
+		usage();
+		return 1;
+	}
+
+	if (mkdtemp(directory) == NULL)
+	{
+		perror("bench-mime");
+		return 1;
+	}
+
+	sprintf(path, "%s/mime", directory);
+	mkdir(path, 0755);
+	sprintf(cache_file, "%s/mime/mime.cache", directory);
+	sprintf(path, "%s/corpus", directory);
+	mkdir(path, 0755);
+
+	if (!bench_write_cache(cache_file, options.globs, options.magic, options.seed) ||
+		(corpus = bench_corpus_new(path, options.files, options.globs, options.magic, options.seed)) == NULL)
+	{
+		fprintf(stderr, "bench-mime: failed to generate files in %s\n", directory);
+		return 1;
+	}
+
+	/* Only the generated database is loaded */
+	sprintf(path, "%s/home", directory);
+	setenv("XDG_DATA_HOME", path, 1);
+	setenv("XDG_DATA_DIRS", directory, 1);
+
+	if (options.csv)
+		fprintf(stdout, "lookup,state,threads,globs,magic,files,calls,ns_per_call,calls_per_sec\n");
+	else
+		fprintf(stdout, "%d globs, %d magic rules, %d files, seed %u\n\n%-22s %-5s %7s %10s %12s %14s\n",
+				options.globs, options.magic, options.files, options.seed,
+				"lookup", "state", "threads", "calls", "ns/call", "calls/sec");
+
+	for (i = 0; i < sizeof(lookups) / sizeof(lookups[0]); ++i)
+	{
+		measure_cold(&lookups[i], corpus, cache_file);
+		measure_warm(&lookups[i], corpus);
+
+		if (lookups[i].thread_safe)
+			measure_threads(&lookups[i], corpus);
+	}
+
+	_xdg_mime_shutdown();
+
+	if (options.keep)
+	{
+		fprintf(stderr, "bench-mime: generated files are kept in %s\n", directory);
+		bench_corpus_free(corpus, 0);
+	}
+	else
+	{
+		bench_corpus_free(corpus, 1);
+		unlink(cache_file);
+		sprintf(path, "%s/corpus", directory);
+		rmdir(path);
+		sprintf(path, "%s/mime", directory);
+		rmdir(path);
+		rmdir(directory);
+	}
+
+	return 0;
+}
@@ -0,0 +1,390 @@
+#include "corpus.h"
+#include "../mime/xdgmimecachewriter.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#define SYNTHETIC_GLOB_WEIGHT 50
+#define MAX_MAGIC_VALUE 8
+
+struct Format
+{
+	const char *mime_type;
+	const char *extension;
+	int frequency;
+	int text;
+	int priority;
+	int offset;
+	const char *magic;
+	int magic_length;
+	const char *alias;
+	const char *parent;
+	const char *generic_icon;
+};
+typedef struct Format Format;
+
+struct MagicRule
+{
+	char mime_type[64];
+	int priority;
+	int offset;
+	int range_length;
+	int value_length;
+	unsigned char value[MAX_MAGIC_VALUE];
+	unsigned char mask[MAX_MAGIC_VALUE];
+	int has_mask;
+	int has_child;
+	int child_offset;
+	unsigned char child_value[2];
+};
+typedef struct MagicRule MagicRule;
+
+/* Frequencies roughly follow what is found in home directories */
+static const Format formats[] =
+{
+	{ "image/jpeg",               "jpg",  18, 0, 50, 0, "\xff\xd8\xff", 3, "image/pjpeg", NULL, "image-x-generic" },
+	{ "image/png",                "png",  12, 0, 50, 0, "\x89PNG\r\n\x1a\n", 8, "image/x-png", NULL, "image-x-generic" },
+	{ "image/gif",                "gif",   3, 0, 50, 0, "GIF89a", 6, NULL, NULL, "image-x-generic" },
+	{ "application/pdf",          "pdf",   5, 0, 50, 0, "%PDF-", 5, "application/x-pdf", NULL, NULL },
+	{ "application/zip",          "zip",   2, 0, 40, 0, "PK\003\004", 4, "application/x-zip-compressed", NULL, "package-x-generic" },
+	{ "application/gzip",         "gz",    3, 0, 45, 0, "\037\213", 2, "application/x-gzip", NULL, "package-x-generic" },
+	{ "audio/mpeg",               "mp3",   3, 0, 50, 0, "ID3", 3, "audio/x-mp3", NULL, "audio-x-generic" },
+	{ "video/mp4",                "mp4",   2, 0, 50, 4, "ftyp", 4, "video/x-m4v", NULL, "video-x-generic" },
+	{ "application/x-executable", NULL,    1, 0, 40, 0, "\177ELF", 4, NULL, NULL, "application-x-executable" },
+	{ "application/xml",          "xml",   3, 1, 40, 0, "<?xml", 5, "text/xml", "text/plain", "text-x-generic" },
+	{ "text/html",                "html",  6, 1, 40, 0, "<!DOCTYPE html", 14, NULL, "text/plain", "text-x-generic" },
+	{ "text/plain",               "txt",  10, 1,  0, 0, NULL, 0, NULL, NULL, "text-x-generic" },
+	{ "text/x-csrc",              "c",     5, 1,  0, 0, NULL, 0, "text/x-c", "text/plain", "text-x-generic" },
+	{ "text/x-chdr",              "h",     4, 1,  0, 0, NULL, 0, NULL, "text/x-csrc", "text-x-generic" },
+	{ "application/javascript",   "js",    6, 1,  0, 0, NULL, 0, "application/x-javascript", "text/plain", "text-x-generic" },
+	{ "application/json",         "json",  4, 1,  0, 0, NULL, 0, NULL, "application/javascript", "text-x-generic" }
+};
+
+static const char *const words[] =
+{
+	"the", "mime", "type", "of", "a", "file", "is", "found", "by", "looking", "at",
+	"its", "name", "and", "contents", "int", "main", "return", "{", "}", ";"
+};
+
+
+void bench_random_init(BenchRandom *random, unsigned int seed)
+{
+	random->state = seed * 0x9E3779B97F4A7C15ULL + 1;
+}
+
+/* xorshift64*, returns a value below limit */
+uint32_t bench_random(BenchRandom *random, uint32_t limit)
+{
+	random->state ^= random->state >> 12;
+	random->state ^= random->state << 25;
+	random->state ^= random->state >> 27;
+
+	return (uint32_t)((random->state * 0x2545F4914F6CDD1DULL) >> 32) % limit;
+}
+
+static const Format *random_format(BenchRandom *random)
+{
+	int total = 0, pick, i;
+
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i)
+		total += formats[i].frequency;
+
+	pick = bench_random(random, total);
+
+	for (i = 0; pick >= formats[i].frequency; ++i)
+		pick -= formats[i].frequency;
+
+	return &formats[i];
+}
+
+/* Synthetic globs are mostly suffixes, with some literal file names
+ * and a few patterns that can only be matched with fnmatch() */
+static void synthetic_glob(int index, char *glob, char *file_name, int *case_sensitive)
+{
+	*case_sensitive = index % 10 == 3;
+
+	if (index % 20 == 0)
+	{
+		sprintf(glob, "BENCHLIT%d", index);
+		sprintf(file_name, "BENCHLIT%d", index);
+	}
+	else if (index % 40 == 1)
+	{
+		sprintf(glob, "[Bb]ench%d.*", index);
+		sprintf(file_name, "bench%d.dat", index);
+	}
+	else
+	{
+		sprintf(glob, "*.x%d", index);
+		sprintf(file_name, "file.x%d", index);
+	}
+}
+
+/* Rules are derived from the seed and their index only, so the corpus
+ * can produce data matching a rule without reading the cache back */
+static void synthetic_magic(int index, unsigned int seed, MagicRule *rule)
+{
+	BenchRandom random;
+	int i;
+
+	bench_random_init(&random, seed * 7919 + index);
+
+	sprintf(rule->mime_type, "application/x-bench-magic-%d", index);
+	rule->priority = 20 + bench_random(&random, 60);
+	rule->offset = bench_random(&random, 32);
+	rule->range_length = index % 5 == 0 ? 16 : 1;
+	rule->value_length = 4 + bench_random(&random, MAX_MAGIC_VALUE - 3);
+	rule->has_mask = index % 7 == 0;
+	rule->has_child = index % 4 == 0;
+	rule->child_offset = rule->offset + rule->value_length + bench_random(&random, 8);
+
+	for (i = 0; i < rule->value_length; ++i)
+	{
+		rule->value[i] = 1 + bench_random(&random, 255);
+		rule->mask[i] = i == 1 ? 0xf0 : 0xff;
+	}
+
+	rule->child_value[0] = 1 + bench_random(&random, 255);
+	rule->child_value[1] = 1 + bench_random(&random, 255);
+}
+
+int bench_write_cache(const char *file_name, int n_globs, int n_magic, unsigned int seed)
+{
+	XdgMimeCacheWriter *writer = _xdg_mime_cache_writer_new();
+	char glob[64], name[64], mime_type[64];
+	int case_sensitive, magic, matchlet, res, i;
+	MagicRule rule;
+
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i)
+	{
+		const Format *format = &formats[i];
+
+		if (format->extension)
+		{
+			sprintf(glob, "*.%s", format->extension);
+			_xdg_mime_cache_writer_add_glob(writer, glob, format->mime_type, 50, 0);
+		}
+
+		if (format->magic)
+		{
+			magic = _xdg_mime_cache_writer_add_magic(writer, format->priority, format->mime_type);
+			_xdg_mime_cache_writer_add_matchlet(writer, magic, -1, format->offset, 1, 1,
+												format->magic, NULL, format->magic_length);
+		}
+
+		if (format->alias)
+			_xdg_mime_cache_writer_add_alias(writer, format->alias, format->mime_type);
+
+		if (format->parent)
+			_xdg_mime_cache_writer_add_parent(writer, format->mime_type, format->parent);
+
+		if (format->generic_icon)
+			_xdg_mime_cache_writer_add_generic_icon(writer, format->mime_type, format->generic_icon);
+	}
+
+	_xdg_mime_cache_writer_add_namespace(writer, "http://www.w3.org/1999/xhtml", "html", "application/xhtml+xml");
+	_xdg_mime_cache_writer_add_namespace(writer, "http://www.w3.org/2000/svg", "svg", "image/svg+xml");
+
+	for (i = 0; i < n_globs; ++i)
+	{
+		synthetic_glob(i, glob, name, &case_sensitive);
+		sprintf(mime_type, "application/x-bench-%d", i);
+
+		_xdg_mime_cache_writer_add_glob(writer, glob, mime_type, SYNTHETIC_GLOB_WEIGHT, case_sensitive);
+		_xdg_mime_cache_writer_add_parent(writer, mime_type, "application/octet-stream");
+
+		if (i % 10 == 0)
+		{
+			sprintf(name, "application/x-bench-alias-%d", i);
+			_xdg_mime_cache_writer_add_alias(writer, name, mime_type);
+		}
+
+		if (i % 3 == 0)
+		{
+			sprintf(name, "bench-%d", i);
+			_xdg_mime_cache_writer_add_icon(writer, mime_type, name);
+		}
+	}
+
+	for (i = 0; i < n_magic; ++i)
+	{
+		synthetic_magic(i, seed, &rule);
+
+		magic = _xdg_mime_cache_writer_add_magic(writer, rule.priority, rule.mime_type);
+		matchlet = _xdg_mime_cache_writer_add_matchlet(writer, magic, -1, rule.offset, rule.range_length, 1,
+													   rule.value, rule.has_mask ? rule.mask : NULL,
+													   rule.value_length);
+
+		if (rule.has_child)
+			_xdg_mime_cache_writer_add_matchlet(writer, magic, matchlet, rule.child_offset, 1, 1,
+												rule.child_value, NULL, 2);
+	}
+
+	res = _xdg_mime_cache_writer_write(writer, file_name);
+	_xdg_mime_cache_writer_free(writer);
+
+	return res;
+}
+
+static void fill_text(BenchRandom *random, unsigned char *data, size_t size)
+{
+	size_t from = 0, len;
+	const char *word;
+
+	while (from < size)
+	{
+		word = words[bench_random(random, sizeof(words) / sizeof(words[0]))];
+		len = strlen(word);
+
+		if (from + len + 1 > size)
+			len = size - from - 1;
+
+		memcpy(data + from, word, len);
+		from += len;
+		data[from++] = bench_random(random, 8) == 0 ? '\n' : ' ';
+	}
+}
+
+static void fill_binary(BenchRandom *random, unsigned char *data, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; ++i)
+		data[i] = bench_random(random, 256);
+}
+
+static void generate_file(BenchCorpus *corpus, BenchFile *file, BenchRandom *random,
+						  int index, int n_globs, int n_magic, unsigned int seed)
+{
+	char name[128], base[64], glob[64];
+	int kind, case_sensitive, i;
+	const Format *format;
+	MagicRule rule;
+
+	file->size = 64 + bench_random(random, 960);
+	file->data = malloc(file->size);
+
+	kind = bench_random(random, 100);
+
+	if (kind < 55 || (kind < 70 && n_globs == 0))
+	{
+		format = random_format(random);
+		strcpy(file->mime_type, format->mime_type);
+
+		if (format->text)
+			fill_text(random, file->data, file->size);
+		else
+			fill_binary(random, file->data, file->size);
+
+		if (format->magic)
+			memcpy(file->data + format->offset, format->magic, format->magic_length);
+
+		if (format->extension == NULL)
+			sprintf(name, "program%05d", index);
+		else
+		{
+			sprintf(name, "file%05d.%s", index, format->extension);
+
+			/* Some names only match case insensitively */
+			if (bench_random(random, 10) == 0)
+				for (i = strlen(name) - strlen(format->extension); name[i]; ++i)
+					name[i] = toupper(name[i]);
+		}
+	}
+	else if (kind < 70)
+	{
+		i = bench_random(random, n_globs);
+		synthetic_glob(i, glob, base, &case_sensitive);
+		sprintf(file->mime_type, "application/x-bench-%d", i);
+		fill_binary(random, file->data, file->size);
+
+		/* Literal and fnmatch names are used as they are, the same
+		 * literal name may thus be generated more than once */
+		if (strncmp(glob, "*.", 2) == 0)
+			sprintf(name, "%05d-%s", index, base);
+		else
+			strcpy(name, base);
+	}
+	else if (kind < 80 && n_magic > 0)
+	{
+		synthetic_magic(bench_random(random, n_magic), seed, &rule);
+		sprintf(name, "blob%05d", index);
+		strcpy(file->mime_type, rule.mime_type);
+		fill_binary(random, file->data, file->size);
+
+		memcpy(file->data + rule.offset, rule.value, rule.value_length);
+		if (rule.has_child)
+			memcpy(file->data + rule.child_offset, rule.child_value, 2);
+	}
+	else if (kind < 90)
+	{
+		sprintf(name, bench_random(random, 2) ? "data%05d.q%u" : "data%05d", index, bench_random(random, 1000));
+		strcpy(file->mime_type, "application/octet-stream");
+		fill_binary(random, file->data, file->size);
+	}
+	else
+	{
+		sprintf(name, "README%05d", index);
+		strcpy(file->mime_type, "text/plain");
+		fill_text(random, file->data, file->size);
+	}
+
+	file->name = strdup(name);
+	file->path = malloc(strlen(corpus->directory) + strlen(name) + 2);
+	sprintf(file->path, "%s/%s", corpus->directory, name);
+}
+
+BenchCorpus *bench_corpus_new(const char *directory, int n_files, int n_globs, int n_magic, unsigned int seed)
+{
+	BenchCorpus *corpus = malloc(sizeof(BenchCorpus));
+	BenchRandom random;
+	FILE *stream;
+	int i;
+
+	corpus->directory = strdup(directory);
+	corpus->files = calloc(n_files, sizeof(BenchFile));
+	corpus->n_files = n_files;
+
+	bench_random_init(&random, seed);
+
+	for (i = 0; i < n_files; ++i)
+	{
+		generate_file(corpus, &corpus->files[i], &random, i, n_globs, n_magic, seed);
+
+		if ((stream = fopen(corpus->files[i].path, "wb")) == NULL)
+		{
+			bench_corpus_free(corpus, 1);
+			return NULL;
+		}
+
+		fwrite(corpus->files[i].data, 1, corpus->files[i].size, stream);
+		fclose(stream);
+	}
+
+	return corpus;
+}
+
+void bench_corpus_free(BenchCorpus *corpus, int remove_files)
+{
+	int i;
+
+	for (i = 0; i < corpus->n_files; ++i)
+	{
+		if (corpus->files[i].path == NULL)
+			continue;
+
+		if (remove_files)
+			unlink(corpus->files[i].path);
+
+		free(corpus->files[i].name);
+		free(corpus->files[i].path);
+		free(corpus->files[i].data);
+	}
+
+	free(corpus->files);
+	free(corpus->directory);
+	free(corpus);
+}
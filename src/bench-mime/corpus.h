@@ -0,0 +1,45 @@
+#ifndef BENCH_MIME_CORPUS_H_
+#define BENCH_MIME_CORPUS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* Deterministic generator, so a seed always produces the same corpus */
+struct BenchRandom
+{
+	uint64_t state;
+};
+typedef struct BenchRandom BenchRandom;
+
+struct BenchFile
+{
+	char *name;
+	char *path;
+	char mime_type[64];
+	unsigned char *data;
+	size_t size;
+};
+typedef struct BenchFile BenchFile;
+
+struct BenchCorpus
+{
+	BenchFile *files;
+	int n_files;
+	char *directory;
+};
+typedef struct BenchCorpus BenchCorpus;
+
+void bench_random_init(BenchRandom *random, unsigned int seed);
+uint32_t bench_random(BenchRandom *random, uint32_t limit);
+
+/* Writes a mime.cache with the types of the known formats plus n_globs
+ * synthetic globs and n_magic synthetic magic rules */
+int bench_write_cache(const char *file_name, int n_globs, int n_magic, unsigned int seed);
+
+/* Generates n_files files into directory: known formats, files matching
+ * the synthetic globs and magic rules, unknown binaries and text */
+BenchCorpus *bench_corpus_new(const char *directory, int n_files, int n_globs, int n_magic, unsigned int seed);
+void bench_corpus_free(BenchCorpus *corpus, int remove_files);
+
+#endif /* BENCH_MIME_CORPUS_H_ */
@@ -0,0 +1,175 @@
+#include "../mime/xdgmime.h"
+#include "../mime/xdgmime_p.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+
+#define DEFAULT_ITERATIONS 50
+
+struct Option
+{
+	const char *name;
+	int flags;
+};
+typedef struct Option Option;
+
+struct Sample
+{
+	double load;
+	double first_glob;
+	double first_magic;
+	double total;
+	long minor_faults;
+};
+typedef struct Sample Sample;
+
+static const Option options[] =
+{
+	{ "default",           XDG_MIME_CACHE_LOAD_DEFAULT },
+	{ "populate",          XDG_MIME_CACHE_LOAD_POPULATE },
+	{ "willneed",          XDG_MIME_CACHE_LOAD_WILLNEED },
+	{ "mlock",             XDG_MIME_CACHE_LOAD_MLOCK },
+	{ "hugepage",          XDG_MIME_CACHE_LOAD_HUGEPAGE },
+	{ "populate+mlock",    XDG_MIME_CACHE_LOAD_POPULATE | XDG_MIME_CACHE_LOAD_MLOCK },
+	{ "willneed+hugepage", XDG_MIME_CACHE_LOAD_WILLNEED | XDG_MIME_CACHE_LOAD_HUGEPAGE }
+};
+
+/* PNG signature followed by the start of an IHDR chunk */
+static const unsigned char png_data[] =
+{
+	0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n',
+	0x00, 0x00, 0x00, 0x0d, 'I', 'H', 'D', 'R'
+};
+
+static void usage()
+{
+	fprintf(stdout,
+			"Usage: bench-mime-startup [ITERATIONS]"
+			"\n\n  Measures how long it takes to load the \"Shared MIME-info Database\""
+			"\nand to answer the first glob and magic lookups with every supported"
+			"\ncache load option. Each option is measured ITERATIONS times (default %d)."
+			"\n",
+			DEFAULT_ITERATIONS);
+}
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static long minor_faults()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_minflt;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+
+	return (da > db) - (da < db);
+}
+
+static double percentile(double *values, int count, int percent)
+{
+	int index = (count * percent + 99) / 100 - 1;
+
+	qsort(values, count, sizeof(double), compare_doubles);
+
+	if (index < 0)
+		index = 0;
+
+	return values[index];
+}
+
+static void measure(int flags, Sample *sample)
+{
+	const char *mime_type;
+	long faults;
+	double start, t;
+	int prio;
+
+	xdg_mime_set_cache_load_flags(flags);
+
+	faults = minor_faults();
+	start = now();
+
+	_xdg_mime_init();
+	t = now();
+	sample->load = t - start;
+
+	mime_type = xdg_mime_get_mime_type_from_file_name("screenshot.png");
+	sample->first_glob = now() - t;
+	t = now();
+
+	mime_type = xdg_mime_get_mime_type_for_data(png_data, sizeof(png_data), &prio);
+	sample->first_magic = now() - t;
+
+	sample->total = now() - start;
+	sample->minor_faults = minor_faults() - faults;
+
+	_xdg_mime_shutdown();
+	(void)mime_type;
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = DEFAULT_ITERATIONS;
+	double *load, *glob, *magic, *total;
+	Sample sample;
+	long faults;
+	size_t i;
+	int j;
+
+	if (argc > 2 || (argc == 2 && (iterations = atoi(argv[1])) <= 0))
+	{
+		usage();
+		return 1;
+	}
+
+	load = malloc(sizeof(double) * iterations * 4);
+	glob = load + iterations;
+	magic = glob + iterations;
+	total = magic + iterations;
+
+	/* Warm up the page cache so only mapping costs are measured */
+	measure(XDG_MIME_CACHE_LOAD_DEFAULT, &sample);
+
+	fprintf(stdout, "%-18s %10s %10s %10s %10s %10s %10s %8s\n",
+			"option", "load p50", "glob p50", "magic p50", "total p50", "total p99", "total max", "faults");
+
+	for (i = 0; i < sizeof(options) / sizeof(options[0]); ++i)
+	{
+		faults = 0;
+
+		for (j = 0; j < iterations; ++j)
+		{
+			measure(options[i].flags, &sample);
+			load[j] = sample.load;
+			glob[j] = sample.first_glob;
+			magic[j] = sample.first_magic;
+			total[j] = sample.total;
+			faults += sample.minor_faults;
+		}
+
+		fprintf(stdout, "%-18s %8.1fus %8.1fus %8.1fus %8.1fus %8.1fus %8.1fus %8ld\n",
+				options[i].name,
+				percentile(load, iterations, 50),
+				percentile(glob, iterations, 50),
+				percentile(magic, iterations, 50),
+				percentile(total, iterations, 50),
+				percentile(total, iterations, 99),
+				percentile(total, iterations, 100),
+				faults / iterations);
+	}
+
+	free(load);
+	return 0;
+}
@@ -48,11 +48,21 @@
 #define FALSE 0
 
 
-static AvlNode *create_avl_node(const KEY_TYPE key, AvlNode *parent, DuplicateKey duplicateKey)
+static AvlNode *create_avl_node(AvlTree *tree, const KEY_TYPE key, AvlNode *parent)
 {
-	AvlNode *res = malloc(sizeof(AvlNode));
+	AvlNode *res;
+
+	if (tree->arena)
+	{
+		res = _xdg_arena_alloc(tree->arena, sizeof(AvlNode), sizeof(void *));
+		res->key = tree->duplicateKey ? tree->duplicateKey(key) : _xdg_arena_strdup(tree->arena, key);
+	}
+	else
+	{
+		res = malloc(sizeof(AvlNode));
+		res->key = tree->duplicateKey(key);
+	}
 
-	res->key = duplicateKey(key);
 	res->value = 0;
 	res->balance = BALANCED;
 	res->links.left = 0;
@@ -63,17 +73,21 @@ static AvlNode *create_avl_node(const KEY_TYPE key, AvlNode *parent, DuplicateKe
 	return res;
 }
 
-static void free_avl_node(AvlNode *node, DestroyKey destroyKey)
+static void free_avl_node(AvlTree *tree, AvlNode *node)
 {
-	destroyKey(node->key);
-	free(node);
+	if (tree->arena == NULL)
+	{
+		if (tree->destroyKey)
+			tree->destroyKey(node->key);
+
+		free(node);
+	}
 }
 
-static void free_avl_node_and_value(AvlNode *node, DestroyKey destroyKey, DestroyValue destroyValue)
+static void free_avl_node_and_value(AvlTree *tree, AvlNode *node, DestroyValue destroyValue)
 {
-	destroyKey(node->key);
 	destroyValue(node->value);
-	free(node);
+	free_avl_node(tree, node);
 }
 
 static void left_left_rotation(AvlNode *parent, AvlNode *child, AvlNode **root)
@@ -385,7 +399,7 @@ static void destroy_subtree(AvlTree *tree, AvlNode **subtree_root)
 				AvlNode *node_to_delete = this_node;
 				this_node = this_node->links.parent;
 
-				free_avl_node(node_to_delete, tree->destroyKey);
+				free_avl_node(tree, node_to_delete);
 
 				if (node_to_delete == (*subtree_root) || this_node == 0)
 					break;
@@ -417,7 +431,7 @@ static void destroy_subtree_and_values(AvlTree *tree, AvlNode **subtree_root, De
 				AvlNode *node_to_delete = this_node;
 				this_node = this_node->links.parent;
 
-				free_avl_node_and_value(node_to_delete, tree->destroyKey, destroyValue);
+				free_avl_node_and_value(tree, node_to_delete, destroyValue);
 
 				if (node_to_delete == (*subtree_root) || this_node == 0)
 					break;
@@ -483,6 +497,16 @@ void init_avl_tree(AvlTree *tree, DuplicateKey duplicateKey, DestroyKey destroyK
 	tree->duplicateKey = duplicateKey;
 	tree->destroyKey = destroyKey;
 	tree->compareKeys = compareKeys;
+	tree->arena = NULL;
+}
+
+void init_avl_tree_in_arena(AvlTree *tree, XdgArena *arena, DuplicateKey duplicateKey, CompareKeys compareKeys)
+{
+	tree->tree_root = NULL;
+	tree->duplicateKey = duplicateKey;
+	tree->destroyKey = NULL;
+	tree->compareKeys = compareKeys;
+	tree->arena = arena;
 }
 
 void clear_avl_tree(AvlTree *tree)
@@ -551,7 +575,7 @@ VALUE_TYPE *search_or_create_node(AvlTree *tree, const KEY_TYPE key)
 		return &(*this_node)->value;
 	else
 	{
-		if (((*this_node) = parent_node = create_avl_node(key, parent_node, tree->duplicateKey)))
+		if (((*this_node) = parent_node = create_avl_node(tree, key, parent_node)))
 			rebalance_grew(parent_node, &tree->tree_root);
 
 		return &parent_node->value;
@@ -579,7 +603,7 @@ VALUE_TYPE delete_node(AvlTree *tree, const KEY_TYPE key)
 		VALUE_TYPE res = this_node->value;
 
 		rebalance_shrunk(this_node, &tree->tree_root);
-		free_avl_node(this_node, tree->destroyKey);
+		free_avl_node(tree, this_node);
 
 		return res;
 	}
@@ -29,6 +29,7 @@
 #define AVLTREE_P_H_
 
 #include "avltree.h"
+#include "xdgarena_p.h"
 
 
 enum Balanced
@@ -71,10 +72,17 @@ struct AvlTree
 	DuplicateKey duplicateKey;
 	DestroyKey destroyKey;
 	CompareKeys compareKeys;
+	/**
+	 * If not \c NULL nodes are allocated from the arena and released
+	 * together with it, so are keys unless \a duplicateKey is given.
+	 * @n \a destroyKey may be \c NULL if keys are not owned by the tree.
+	 */
+	XdgArena *arena;
 };
 
 
 void init_avl_tree(AvlTree *tree, DuplicateKey duplicateKey, DestroyKey destroyKey, CompareKeys compareKeys);
+void init_avl_tree_in_arena(AvlTree *tree, XdgArena *arena, DuplicateKey duplicateKey, CompareKeys compareKeys);
 void clear_avl_tree(AvlTree *tree);
 void clear_avl_tree_and_values(AvlTree *tree, DestroyValue destroyValue);
 
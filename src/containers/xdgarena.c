@@ -0,0 +1,152 @@
+/** @internal @file xdgarena.c
+ *  @brief Private file.
+ *
+ * Region allocator for data which is freed all at once.
+ *
+ * @copyright
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ * @n@n
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ * @n@n
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ * @n@n
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ * @n@n
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "xdgarena_p.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+struct XdgArenaBlock
+{
+	XdgArenaBlock *next;
+	/**
+	 * Makes the memory of the block aligned for any type.
+	 */
+	union
+	{
+		long double ld;
+		void *ptr;
+		long long ll;
+	} memory[1];
+};
+
+
+void _xdg_arena_init(XdgArena *arena)
+{
+	arena->blocks = NULL;
+	arena->current = arena->end = NULL;
+	arena->bytes = 0;
+	arena->allocations = 0;
+}
+
+void *_xdg_arena_alloc(XdgArena *arena, size_t size, size_t align)
+{
+	XdgArenaBlock *block;
+	char *res = (char *)(((uintptr_t)arena->current + align - 1) & ~(uintptr_t)(align - 1));
+
+	arena->bytes += size;
+	++arena->allocations;
+
+	if (arena->current && size <= (size_t)(arena->end - res))
+	{
+		arena->current = res + size;
+		return res;
+	}
+
+	if (size > XDG_ARENA_BLOCK_SIZE / 4)
+	{
+		/* Large allocations do not waste the rest of the current block */
+		if ((block = malloc(offsetof(XdgArenaBlock, memory) + size)) == NULL)
+			return NULL;
+
+		if (arena->blocks)
+		{
+			block->next = arena->blocks->next;
+			arena->blocks->next = block;
+		}
+		else
+		{
+			block->next = NULL;
+			arena->blocks = block;
+		}
+
+		return block->memory;
+	}
+
+	if ((block = malloc(offsetof(XdgArenaBlock, memory) + XDG_ARENA_BLOCK_SIZE)) == NULL)
+		return NULL;
+
+	block->next = arena->blocks;
+	arena->blocks = block;
+	arena->current = (char *)block->memory + size;
+	arena->end = (char *)block->memory + XDG_ARENA_BLOCK_SIZE;
+
+	return block->memory;
+}
+
+char *_xdg_arena_strdup(XdgArena *arena, const char *string)
+{
+	size_t size = strlen(string) + 1;
+	char *res = _xdg_arena_alloc(arena, size, 1);
+
+	memcpy(res, string, size);
+
+	return res;
+}
+
+void _xdg_arena_move(XdgArena *to, XdgArena *from)
+{
+	XdgArenaBlock *last;
+
+	to->bytes += from->bytes;
+	to->allocations += from->allocations;
+
+	if (from->blocks)
+	{
+		for (last = from->blocks; last->next; last = last->next);
+
+		/* Blocks of "to" keep being the first ones,
+		 * so its current block stays in use. */
+		if (to->blocks)
+		{
+			last->next = to->blocks->next;
+			to->blocks->next = from->blocks;
+		}
+		else
+		{
+			to->blocks = from->blocks;
+			to->current = from->current;
+			to->end = from->end;
+		}
+	}
+
+	_xdg_arena_init(from);
+}
+
+void _xdg_arena_free(XdgArena *arena)
+{
+	XdgArenaBlock *block;
+
+	while (block = arena->blocks)
+	{
+		arena->blocks = block->next;
+		free(block);
+	}
+
+	_xdg_arena_init(arena);
+}
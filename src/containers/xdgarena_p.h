@@ -0,0 +1,72 @@
+/** @internal @file xdgarena_p.h
+ *  @brief Private file.
+ *
+ * Region allocator for data which is freed all at once.
+ *
+ * @copyright
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ * @n@n
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ * @n@n
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ * @n@n
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ * @n@n
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XDGARENA_P_H_
+#define XDGARENA_P_H_
+
+#include <stddef.h>
+
+
+/**
+ * Default size of memory blocks of the arena, larger
+ * allocations get a block of their own.
+ */
+#define XDG_ARENA_BLOCK_SIZE 65536
+
+
+typedef struct XdgArenaBlock XdgArenaBlock;
+
+/**
+ * Allocates memory from large blocks, nothing is freed
+ * until the whole arena is.
+ */
+struct XdgArena
+{
+	XdgArenaBlock *blocks;
+	char *current;
+	char *end;
+	/**
+	 * Number of bytes and allocations requested so far.
+	 */
+	size_t bytes;
+	size_t allocations;
+};
+typedef struct XdgArena XdgArena;
+
+
+void _xdg_arena_init(XdgArena *arena);
+void *_xdg_arena_alloc(XdgArena *arena, size_t size, size_t align);
+char *_xdg_arena_strdup(XdgArena *arena, const char *string);
+
+/**
+ * Moves all blocks of \a from into \a to, \a from is empty afterwards
+ * and its statistics are added to the ones of \a to.
+ */
+void _xdg_arena_move(XdgArena *to, XdgArena *from);
+void _xdg_arena_free(XdgArena *arena);
+
+#endif /* XDGARENA_P_H_ */
@@ -0,0 +1,171 @@
+/** @internal @file xdgintern.c
+ *  @brief Private file.
+ *
+ * Process-wide table of interned strings.
+ *
+ * @copyright
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ * @n@n
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ * @n@n
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ * @n@n
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ * @n@n
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <xdg/config.h>
+#include "xdgintern_p.h"
+#include "xdgarena_p.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD
+#	include <pthread.h>
+#endif
+
+
+struct XdgInternItem
+{
+	const char *string;
+	size_t hash;
+};
+typedef struct XdgInternItem XdgInternItem;
+
+/**
+ * Open addressing hash table, strings themselves live in \a arena.
+ */
+struct XdgInternTable
+{
+	XdgInternItem *items;
+	size_t size;
+	size_t count;
+	XdgArena arena;
+};
+typedef struct XdgInternTable XdgInternTable;
+
+
+static XdgInternTable table;
+
+#ifdef HAVE_PTHREAD
+/* Most of the strings are interned already, so lookups
+ * should not wait for each other. */
+static pthread_rwlock_t table_lock = PTHREAD_RWLOCK_INITIALIZER;
+#endif
+
+
+static size_t hash_string(const char *string, size_t length)
+{
+	size_t res = 2166136261u;
+
+	while (length--)
+		res = (res ^ (unsigned char)*string++) * 16777619u;
+
+	return res;
+}
+
+static const char *search_string(const char *string, size_t length, size_t hash)
+{
+	size_t i;
+
+	if (table.size)
+		for (i = hash & (table.size - 1); table.items[i].string; i = (i + 1) & (table.size - 1))
+			if (table.items[i].hash == hash &&
+				strncmp(table.items[i].string, string, length) == 0 &&
+				table.items[i].string[length] == 0)
+			{
+				return table.items[i].string;
+			}
+
+	return NULL;
+}
+
+static void insert_item(XdgInternItem *items, size_t size, const XdgInternItem *item)
+{
+	size_t i;
+
+	for (i = item->hash & (size - 1); items[i].string; i = (i + 1) & (size - 1));
+
+	items[i] = *item;
+}
+
+static const char *add_string(const char *string, size_t length, size_t hash)
+{
+	size_t i;
+	XdgInternItem item;
+
+	if ((table.count + 1) * 2 > table.size)
+	{
+		size_t size = table.size ? table.size * 2 : 1024;
+		XdgInternItem *items = calloc(size, sizeof(XdgInternItem));
+
+		for (i = 0; i < table.size; ++i)
+			if (table.items[i].string)
+				insert_item(items, size, &table.items[i]);
+
+		free(table.items);
+		table.items = items;
+		table.size = size;
+	}
+
+	item.string = _xdg_arena_alloc(&table.arena, length + 1, 1);
+	item.hash = hash;
+	memcpy((char *)item.string, string, length);
+	((char *)item.string)[length] = 0;
+
+	insert_item(table.items, table.size, &item);
+	++table.count;
+
+	return item.string;
+}
+
+const char *_xdg_intern(const char *string)
+{
+	return _xdg_intern_n(string, strlen(string));
+}
+
+const char *_xdg_intern_n(const char *string, size_t length)
+{
+	const char *res;
+	size_t hash = hash_string(string, length);
+
+#ifdef HAVE_PTHREAD
+	pthread_rwlock_rdlock(&table_lock);
+	res = search_string(string, length, hash);
+	pthread_rwlock_unlock(&table_lock);
+
+	if (res == NULL)
+	{
+		pthread_rwlock_wrlock(&table_lock);
+
+		if ((res = search_string(string, length, hash)) == NULL)
+			res = add_string(string, length, hash);
+
+		pthread_rwlock_unlock(&table_lock);
+	}
+#else
+	if ((res = search_string(string, length, hash)) == NULL)
+		res = add_string(string, length, hash);
+#endif
+
+	return res;
+}
+
+int _xdg_intern_compare(const char *string1, const char *string2)
+{
+	if (string1 == string2)
+		return 0;
+	else
+		return strcmp(string1, string2);
+}
@@ -0,0 +1,49 @@
+/** @internal @file xdgintern_p.h
+ *  @brief Private file.
+ *
+ * Process-wide table of interned strings.
+ *
+ * @copyright
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ * @n@n
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ * @n@n
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ * @n@n
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ * @n@n
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef XDGINTERN_P_H_
+#define XDGINTERN_P_H_
+
+#include <stddef.h>
+
+
+/**
+ * Returns the only copy of the string kept by the process,
+ * it is never freed. Equal interned strings are equal pointers.
+ *
+ * @note These functions are thread safe.
+ */
+const char *_xdg_intern(const char *string);
+const char *_xdg_intern_n(const char *string, size_t length);
+
+/**
+ * Compares strings like \c strcmp does, equal interned
+ * strings are recognized by the pointer alone.
+ */
+int _xdg_intern_compare(const char *string1, const char *string2);
+
+#endif /* XDGINTERN_P_H_ */
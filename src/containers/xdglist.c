@@ -27,6 +27,7 @@
 
 #include "xdglist_p.h"
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <assert.h>
 
@@ -199,9 +200,17 @@ void _xdg_joint_list_apped(XdgJointList *list, XdgJointListItem *value)
 	}
 }
 
+static const XdgListItem *_xdg_list_item_next(const XdgListItem *item)
+{
+	if (item->list || item->next == NULL)
+		return item->next;
+	else
+		return (const XdgListItem *)((const char *)item + (intptr_t)item->next);
+}
+
 const XdgListItem *xdg_list_next(const XdgListItem *list)
 {
-	return list->next;
+	return _xdg_list_item_next(list);
 }
 
 const XdgJointListItem *xdg_joint_list_next(const XdgJointListItem *item)
@@ -211,7 +220,7 @@ const XdgJointListItem *xdg_joint_list_next(const XdgJointListItem *item)
 	 * 	most of the cases list will be contain more than 1 element.
 	 */
 	if (__builtin_expect(item->item.next != NULL, 1))
-		return (const XdgJointListItem *)item->item.next;
+		return (const XdgJointListItem *)_xdg_list_item_next(&item->item);
 	else
 		if (item->next)
 			return (const XdgJointListItem *)item->next->item.list->head;
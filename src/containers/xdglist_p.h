@@ -41,6 +41,12 @@ struct XdgList
     XdgListItem *tail;
 };
 
+/**
+ * Items of relocatable lists (stored in read-only cache files)
+ * do not belong to any XdgList, their \a list field is \c NULL
+ * and \a next keeps an offset of the next item relative to the
+ * item itself.
+ */
 struct XdgListItem
 {
     XdgList *list;
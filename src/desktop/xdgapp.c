@@ -31,40 +31,55 @@
 #include "xdgappcache_p.h"
 #include "xdgmimedefs.h"
 #include "../basedirectory/xdgbasedirectory.h"
+#include "../containers/xdgarena_p.h"
+#include "../containers/xdgintern_p.h"
 
 #ifdef THEMES_SPEC
 #	include "../themes/xdgtheme.h"
 #endif
 
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <dirent.h>
 #include <stdio.h>
 #include <string.h>
 #include <fnmatch.h>
 #include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifdef HAVE_PTHREAD
+#	include <pthread.h>
+#endif
 
 
 static const char cache_file_name[] = "applications.cache";
 
 
 /**
- * Holds cache data
+ * Holds cache data, either mapped from \a "applications.cache"
+ * or built in memory from contents of the folder.
  */
 struct XdgAppCache
 {
 	XdgAppCahceFile file;
-	const XdgList *files;
-	const AvlTree *asoc_map;
-	const AvlTree *app_files_map;
-	const AvlTree *lst_files_map;
+	const XdgAppCacheHeader *header;
+	/**
+	 * Memory held by contents of files of the folder
+	 * the cache was built from, 0 if it was loaded from the file.
+	 */
+	size_t bytes;
+	size_t allocations;
 };
 typedef struct XdgAppCache XdgAppCache;
 
 
 /**
- * Holds dynamically indexed data
+ * Holds dynamically indexed data, it is turned into XdgAppCache
+ * right after the folder was read.
  */
 struct XdgAppData
 {
@@ -72,22 +87,89 @@ struct XdgAppData
 	AvlTree app_files_map;
 	AvlTree lst_files_map;
 	XdgList files;
+	/**
+	 * Nodes and keys of \a app_files_map and applications which are
+	 * only mentioned in \a ".list" files, released at once.
+	 */
+	XdgArena arena;
 };
 typedef struct XdgAppData XdgAppData;
 
 
+/**
+ * A \a ".desktop" or \a ".list" file of a folder.
+ */
+struct XdgAppFile
+{
+	char *file_name;
+	/**
+	 * Interned id of the application, \c NULL for \a ".list" files.
+	 */
+	const char *name;
+	/**
+	 * Contents of \a ".desktop" files with this id, read by one of
+	 * _xdg_app_read_desktop_files() threads, \c NULL for duplicates.
+	 */
+	XdgApp *app;
+	/**
+	 * Contents of \a ".list" file.
+	 */
+	char *contents;
+	size_t length;
+	/**
+	 * Memory taken by contents in the arena of the folder.
+	 */
+	size_t bytes;
+	/**
+	 * Index of the next file with the same id (files of sub folders
+	 * may end up with the same id), 0 if there is none.
+	 */
+	int next;
+	BOOL duplicate;
+	/**
+	 * Identity of the file when it was found.
+	 */
+	time_t mtime;
+	off_t size;
+	ino_t ino;
+};
+typedef struct XdgAppFile XdgAppFile;
+
+
+/**
+ * Files of a folder in the order they were found.
+ */
+struct XdgAppFiles
+{
+	XdgAppFile *files;
+	int count;
+	int allocated;
+	/**
+	 * Index of the next file to read, shared between threads.
+	 */
+	int next;
+};
+typedef struct XdgAppFiles XdgAppFiles;
+
+
 /**
  * Stores indexed data of \a ".desktop" and \a ".list" files
  * of a given folder.
  */
 struct XdgAppFolder
 {
-	XdgAppData data;
 	XdgAppCache cache;
-
-	const AvlTree *asoc_map;
-	const AvlTree *app_files_map;
-	const AvlTree *lst_files_map;
+	/**
+	 * Files the cache was built from, their contents are kept
+	 * in \a arena, so only added or modified files are read
+	 * again by xdg_app_refresh().
+	 */
+	XdgAppFiles files;
+	XdgArena arena;
+	/**
+	 * Bytes of contents in \a arena which are not used anymore.
+	 */
+	size_t garbage;
 };
 typedef struct XdgAppFolder XdgAppFolder;
 
@@ -104,6 +186,63 @@ struct XdgAppFolderItem
 typedef struct XdgAppFolderItem XdgAppFolderItem;
 
 
+/**
+ * An application id of the merged index of folders.
+ */
+struct XdgAppIndexItem
+{
+	const char *name;
+	/**
+	 * Entry of the first folder which has the id.
+	 */
+	const XdgAppCacheApp *first;
+	/**
+	 * Entry of the first folder which has a \a ".desktop" file
+	 * with the id, the ones of the following folders are shadowed.
+	 */
+	const XdgAppCacheApp *app;
+};
+typedef struct XdgAppIndexItem XdgAppIndexItem;
+
+
+/**
+ * Ids of applications of all folders sorted by strcmp,
+ * everything resolved across folders goes through it.
+ */
+struct XdgAppIndex
+{
+	XdgAppIndexItem *items;
+	int count;
+};
+typedef struct XdgAppIndex XdgAppIndex;
+
+
+/**
+ * Position in the map of applications of a folder,
+ * used by _xdg_app_index_build().
+ */
+struct XdgAppIndexCursor
+{
+	const XdgAppCacheItem *item;
+	const XdgAppCacheItem *end;
+};
+typedef struct XdgAppIndexCursor XdgAppIndexCursor;
+
+
+/**
+ * State of a thread which reads \a ".desktop" files, its \a arena
+ * is moved into \a target (the one of XdgAppFolder) when the thread
+ * is done.
+ */
+struct XdgAppReader
+{
+	XdgAppFiles *files;
+	XdgArena arena;
+	XdgArena *target;
+};
+typedef struct XdgAppReader XdgAppReader;
+
+
 /**
  * Just for passing arguments into _init_from_directory().
  */
@@ -158,6 +297,18 @@ struct UserDefinedAppsArgs
 typedef struct UserDefinedAppsArgs UserDefinedAppsArgs;
 
 
+/**
+ * Just for passing arguments into _xdg_app_group_add_mime_types().
+ */
+struct AddMimeTypesArgs
+{
+	AvlTree *asoc_map;
+	const char *name;
+	XdgApp *app;
+};
+typedef struct AddMimeTypesArgs AddMimeTypesArgs;
+
+
 /**
  * Just for passing arguments into _rebuild_directory_cache().
  */
@@ -178,27 +329,43 @@ typedef void (*GroupHandler)(XdgListItem **item, const char *name, XdgApp *app);
 
 static XdgList folders_list = { NULL, NULL };
 
+/**
+ * Lists of applications of a mime type found in several folders
+ * joined by xdg_known_apps_lookup() and xdg_apps_lookup(), lists
+ * of the cache itself can not be linked together.
+ */
+static AvlTree joined_asoc_map;
+static AvlTree joined_lst_files_map;
+
+/**
+ * Built by _xdg_app_index_build() whenever folders change.
+ */
+static XdgAppIndex apps_index = { NULL, 0 };
+
+/**
+ * Locale set by xdg_app_set_cache_locale().
+ */
+static XdgAppLocale *cache_locale = NULL;
+
 
 /**
  * Memory allocation functions
  */
-static void _xdg_list_value_item_add(XdgList *list, const char *line)
+static void _xdg_list_value_item_add(XdgArena *arena, XdgList *list, const char *string)
 {
-	XdgValue *value = malloc(sizeof(XdgValue) + strlen(line));
+	XdgValue *value = _xdg_arena_alloc(arena, sizeof(XdgValue), sizeof(void *));
 
 	_xdg_list_apped(list, (XdgListItem *)value);
-	strcpy(value->value, line);
+	value->value = string;
 }
 
-static void _xdg_list_value_item_free(XdgList *list)
-{
-	_xdg_list_clear(list, free);
-}
-
-static void _xdg_list_value_item_and_list_free(XdgList *list)
+/**
+ * Directories grow when the cache itself is saved into them, their
+ * modification time is enough, so the size is watched for files only.
+ */
+static off_t _xdg_file_watcher_size(const struct stat *st)
 {
-    _xdg_list_value_item_free(list);
-    free(list);
+	return S_ISDIR(st->st_mode) ? 0 : st->st_size;
 }
 
 static void _xdg_file_watcher_list_add(XdgList *list, const char *path, struct stat *st)
@@ -208,9 +375,18 @@ static void _xdg_file_watcher_list_add(XdgList *list, const char *path, struct s
 	_xdg_list_apped(list, (XdgListItem *)res);
 
 	if (stat(path, st) == 0)
+	{
 		res->mtime = st->st_mtime;
+		res->size = _xdg_file_watcher_size(st);
+		res->ino = st->st_ino;
+	}
 	else
+	{
+		memset(st, 0, sizeof(struct stat));
 		res->mtime = 0;
+		res->size = 0;
+		res->ino = 0;
+	}
 
 	strcpy(res->path, path);
 }
@@ -222,44 +398,48 @@ static void _xdg_file_watcher_list_free(XdgList *list)
 
 void _xdg_list_app_item_append(XdgList *list, const char *name, XdgApp *app)
 {
-	XdgMimeSubTypeValue *value = malloc(sizeof(XdgMimeSubTypeValue) + strlen(name));
+	XdgMimeSubTypeValue *value = malloc(sizeof(XdgMimeSubTypeValue));
 
 	_xdg_list_apped(list, (XdgListItem *)value);
 
 	value->app = app;
-	strcpy(value->name, name);
+	value->name = name;
 }
 
+/**
+ * Names of cache items point into the cache, copies
+ * may outlive it, so names are interned again.
+ */
 static XdgMimeSubTypeValue *_xdg_list_app_item_append_copy(XdgList *list, XdgMimeSubTypeValue *value)
 {
-    XdgMimeSubTypeValue *res = malloc(sizeof(XdgMimeSubTypeValue) + strlen(value->name));
+    XdgMimeSubTypeValue *res = malloc(sizeof(XdgMimeSubTypeValue));
 
     _xdg_list_apped(list, (XdgListItem *)res);
 
-    res->app = value->app;
-    strcpy(res->name, value->name);
+    res->app = (XdgApp *)_xdg_app_cache_value_app(value);
+    res->name = _xdg_intern(_xdg_app_cache_value_name(value));
 
     return res;
 }
 
 void _xdg_list_app_item_prepend(XdgList *list, const char *name, XdgApp *app)
 {
-    XdgMimeSubTypeValue *value = malloc(sizeof(XdgMimeSubTypeValue) + strlen(name));
+    XdgMimeSubTypeValue *value = malloc(sizeof(XdgMimeSubTypeValue));
 
     _xdg_list_prepend(list, (XdgListItem *)value);
 
     value->app = app;
-    strcpy(value->name, name);
+    value->name = name;
 }
 
 static XdgMimeSubTypeValue *_xdg_list_app_item_prepend_copy(XdgList *list, XdgMimeSubTypeValue *value)
 {
-    XdgMimeSubTypeValue *res = malloc(sizeof(XdgMimeSubTypeValue) + strlen(value->name));
+    XdgMimeSubTypeValue *res = malloc(sizeof(XdgMimeSubTypeValue));
 
     _xdg_list_prepend(list, (XdgListItem *)res);
 
-    res->app = value->app;
-    strcpy(res->name, value->name);
+    res->app = (XdgApp *)_xdg_app_cache_value_app(value);
+    res->name = _xdg_intern(_xdg_app_cache_value_name(value));
 
     return res;
 }
@@ -276,142 +456,144 @@ static void _xdg_mime_type_map_item_free(XdgMimeType *type)
 	free(type);
 }
 
+/**
+ * Objects of the application graph are allocated from
+ * the arena of the tree they are added to.
+ */
 static XdgAppGroupEntry *_xdg_app_group_entry_map_item_add(AvlTree *map, const char *name)
 {
 	XdgAppGroupEntry **res = (XdgAppGroupEntry **)search_or_create_node(map, name);
 
 	if ((*res) == NULL)
 	{
-		(*res) = malloc(sizeof(XdgAppGroupEntry));
-		memset(&(*res)->values, 0, sizeof(XdgListItem));
-		init_avl_tree(&(*res)->localized, strdup, (DestroyKey)free, strcmp);
+		(*res) = _xdg_arena_alloc(map->arena, sizeof(XdgAppGroupEntry), sizeof(void *));
+		(*res)->values.head = (*res)->values.tail = NULL;
+		init_avl_tree_in_arena(&(*res)->localized, map->arena, (DuplicateKey)_xdg_intern, _xdg_intern_compare);
 	}
 
 	return (*res);
 }
 
-static void _xdg_app_group_entry_map_item_free(XdgAppGroupEntry *item)
-{
-	_xdg_list_value_item_free(&item->values);
-	clear_avl_tree_and_values(&item->localized, (DestroyValue)_xdg_list_value_item_and_list_free);
-	free(item);
-}
-
 static XdgAppGroup *_xdg_app_group_map_item_add(AvlTree *map, const char *name)
 {
 	XdgAppGroup **res = (XdgAppGroup **)search_or_create_node(map, name);
 
 	if ((*res) == NULL)
 	{
-		(*res) = malloc(sizeof(XdgAppGroup));
-		init_avl_tree(&(*res)->entries, strdup, (DestroyKey)free, strcmp);
+		(*res) = _xdg_arena_alloc(map->arena, sizeof(XdgAppGroup), sizeof(void *));
+		init_avl_tree_in_arena(&(*res)->entries, map->arena, (DuplicateKey)_xdg_intern, _xdg_intern_compare);
 	}
 
 	return (*res);
 }
 
-static void _xdg_app_group_map_item_free(XdgAppGroup *item)
-{
-	clear_avl_tree_and_values(&item->entries, (DestroyValue)_xdg_app_group_entry_map_item_free);
-	free(item);
-}
-
 static XdgApp *_xdg_app_map_item_find(AvlTree *map, const char *name)
 {
 	XdgApp **res = (XdgApp **)search_or_create_node(map, name);
 
 	if ((*res) == NULL)
-		(*res) = calloc(1, sizeof(XdgApp));
+	{
+		(*res) = _xdg_arena_alloc(map->arena, sizeof(XdgApp), sizeof(void *));
+		memset(*res, 0, sizeof(XdgApp));
+	}
 
 	return (*res);
 }
 
-static XdgApp *_xdg_app_map_item_find_const(const AvlTree *map, const char *name)
-{
-    XdgApp **res = (XdgApp **)search_node(map, name);
-
-    if (res == NULL)
-        return NULL;
-    else
-        return (*res);
-}
-
-static XdgApp *_xdg_app_map_item_add(AvlTree *map, const char *name)
+static XdgApp *_xdg_app_new(XdgArena *arena)
 {
-	XdgApp *res = _xdg_app_map_item_find(map, name);
+	XdgApp *res = _xdg_arena_alloc(arena, sizeof(XdgApp), sizeof(void *));
 
-	if (res->groups == NULL)
-	{
-		res->groups = malloc(sizeof(XdgAppGroups));
-		res->groups->owner = res;
-		init_avl_tree(&res->groups->tree, strdup, (DestroyKey)free, strcmp);
-	}
+	res->groups = _xdg_arena_alloc(arena, sizeof(XdgAppGroups), sizeof(void *));
+	res->groups->owner = res;
+	init_avl_tree_in_arena(&res->groups->tree, arena, (DuplicateKey)_xdg_intern, _xdg_intern_compare);
 
 	return res;
 }
 
-static void _xdg_app_map_item_free(XdgApp *item)
+static void _xdg_app_cache_init(XdgAppCache *cache)
 {
-	if (item->groups && item->groups->owner == item)
-	{
-		clear_avl_tree_and_values(&item->groups->tree, (DestroyValue)_xdg_app_group_map_item_free);
-		free(item->groups);
-	}
-
-	free(item);
+	cache->file.error = 0;
+	cache->file.fd = -1;
+	cache->file.memory = MAP_FAILED;
+	cache->file.size = 0;
+	cache->header = NULL;
+	cache->bytes = 0;
+	cache->allocations = 0;
 }
 
-static void _xdg_app_cache_init(XdgAppCache *cache)
+static void _xdg_app_cache_free(XdgAppCache *cache)
 {
-	memset(cache, 0, sizeof(XdgAppCache));
+	_xdg_app_cache_close(&cache->file);
+	_xdg_app_cache_init(cache);
 }
 
-static int _xdg_app_cache_read(XdgAppCache *cache)
+static void _xdg_app_data_init(XdgAppData *data)
 {
-	void *memory = cache->file.memory;
+	init_avl_tree(&data->asoc_map, (DuplicateKey)_xdg_intern, NULL, _xdg_intern_compare);
+	init_avl_tree_in_arena(&data->app_files_map, &data->arena, (DuplicateKey)_xdg_intern, _xdg_intern_compare);
+	init_avl_tree(&data->lst_files_map, (DuplicateKey)_xdg_intern, NULL, _xdg_intern_compare);
+	data->files.head = data->files.tail = NULL;
+	_xdg_arena_init(&data->arena);
+}
 
-	if (read_version(&memory) == 1)
-	{
-		cache->files = read_file_watcher_list(&memory);
-		cache->app_files_map = map_from_memory(&memory, (ReadKey)read_app_key, (ReadValue)read_app, strcmp, NULL);
-		cache->asoc_map = map_from_memory(&memory, (ReadKey)read_app_key, (ReadValue)read_mime_group_type, strcmp, (void *)cache->app_files_map);
-		cache->lst_files_map = map_from_memory(&memory, (ReadKey)read_app_key, (ReadValue)read_mime_group_type, strcmp, (void *)cache->app_files_map);
+static void _xdg_app_data_free(XdgAppData *data)
+{
+	clear_avl_tree_and_values(&data->asoc_map, (DestroyValue)_xdg_mime_type_map_item_free);
+	clear_avl_tree_and_values(&data->lst_files_map, (DestroyValue)_xdg_mime_type_map_item_free);
+	_xdg_file_watcher_list_free(&data->files);
+	_xdg_arena_free(&data->arena);
+}
 
-		return TRUE;
-	}
+static void _xdg_app_reader_init(XdgAppReader *reader, XdgAppFiles *files, XdgArena *target)
+{
+	reader->files = files;
+	reader->target = target;
+	_xdg_arena_init(&reader->arena);
+}
 
-	return FALSE;
+static void _xdg_app_reader_free(XdgAppReader *reader)
+{
+	_xdg_arena_move(reader->target, &reader->arena);
 }
 
-static void _xdg_app_cache_write(XdgAppCahceFile *file, XdgAppData *data)
+static void _xdg_app_files_free(XdgAppFiles *files)
 {
-	write_version(file->fd, 1);
-	write_file_watcher_list(file->fd, &data->files);
-	write_to_file(file->fd, &data->app_files_map, write_app_key, (WriteValue)write_app, NULL);
-	write_to_file(file->fd, &data->asoc_map, write_app_key, (WriteValue)write_mime_group_type, NULL);
-	write_to_file(file->fd, &data->lst_files_map, write_app_key, (WriteValue)write_mime_group_type, NULL);
+	int i;
+
+	for (i = 0; i < files->count; ++i)
+		free(files->files[i].file_name);
+
+	free(files->files);
+	files->files = NULL;
+	files->count = files->allocated = files->next = 0;
 }
 
-static void _xdg_app_cache_free(XdgAppCache *cache)
+static void _xdg_app_folder_init(XdgAppFolder *folder)
 {
-	_xdg_app_cache_close(&cache->file);
-	memset(cache, 0, sizeof(XdgAppCache));
+	_xdg_app_cache_init(&folder->cache);
+	folder->files.files = NULL;
+	folder->files.count = folder->files.allocated = folder->files.next = 0;
+	_xdg_arena_init(&folder->arena);
+	folder->garbage = 0;
 }
 
-static void _xdg_app_data_init(XdgAppData *data)
+/**
+ * Releases contents of files, the cache is kept.
+ */
+static void _xdg_app_folder_clear_files(XdgAppFolder *folder)
 {
-	init_avl_tree(&data->asoc_map, strdup, (DestroyKey)free, strcmp);
-	init_avl_tree(&data->app_files_map, strdup, (DestroyKey)free, strcmp);
-	init_avl_tree(&data->lst_files_map, strdup, (DestroyKey)free, strcmp);
-	data->files.head = data->files.tail = NULL;
+	_xdg_app_files_free(&folder->files);
+	_xdg_arena_free(&folder->arena);
+	_xdg_arena_init(&folder->arena);
+	folder->garbage = 0;
 }
 
-static void _xdg_app_data_free(XdgAppData *data)
+static void _xdg_app_folder_free(XdgAppFolder *folder)
 {
-	clear_avl_tree_and_values(&data->asoc_map, (DestroyValue)_xdg_mime_type_map_item_free);
-	clear_avl_tree_and_values(&data->app_files_map, (DestroyValue)_xdg_app_map_item_free);
-	clear_avl_tree_and_values(&data->lst_files_map, (DestroyValue)_xdg_mime_type_map_item_free);
-	_xdg_file_watcher_list_free(&data->files);
+	_xdg_app_cache_free(&folder->cache);
+	_xdg_app_files_free(&folder->files);
+	_xdg_arena_free(&folder->arena);
 }
 
 static XdgAppFolderItem *_xdg_app_folder_item_new(XdgList *list, const char *directory)
@@ -419,8 +601,7 @@ static XdgAppFolderItem *_xdg_app_folder_item_new(XdgList *list, const char *dir
     XdgAppFolderItem *res = malloc(sizeof(XdgAppFolderItem) + strlen(directory));
 
 	_xdg_list_apped(list, (XdgListItem *)res);
-	_xdg_app_data_init(&res->app.data);
-	_xdg_app_cache_init(&res->app.cache);
+	_xdg_app_folder_init(&res->app);
 	strcpy(res->directory, directory);
 
 	return res;
@@ -428,8 +609,7 @@ static XdgAppFolderItem *_xdg_app_folder_item_new(XdgList *list, const char *dir
 
 static void _xdg_app_folder_item_free(XdgAppFolderItem *folder)
 {
-	_xdg_app_data_free(&folder->app.data);
-	_xdg_app_cache_free(&folder->app.cache);
+	_xdg_app_folder_free(&folder->app);
 	free(folder);
 }
 
@@ -445,7 +625,7 @@ static XdgMimeType *_xdg_mime_type_map_item_add(AvlTree *map, const char *name)
 	if ((*res) == NULL)
 	{
 		(*res) = malloc(sizeof(XdgMimeType));
-		init_avl_tree(&(*res)->sub_types, strdup, (DestroyKey)free, strcmp);
+		init_avl_tree(&(*res)->sub_types, (DuplicateKey)_xdg_intern, NULL, _xdg_intern_compare);
 	}
 
 	return (*res);
@@ -500,110 +680,93 @@ static XdgMimeSubType *_xdg_mime_sub_type_item_search_or_create(AvlTree *map, co
     return _xdg_mime_sub_type_map_item_add(&mime_type->sub_types, sub_type);
 }
 
-static void _xdg_app_group_read_entry_value(XdgList *list, char *line)
+/**
+ * Splits the value by unescaped ';' unescaping it on the fly, all
+ * values of the line share one allocation from the arena.
+ */
+static void _xdg_app_group_read_entry_value(XdgAppReader *reader, XdgList *list, const char *line, const char *end)
 {
-	char *sep;
+	char *value;
+	char *dest;
+
+	if (line == end)
+		return;
 
-	for (sep = line; *sep && *sep != '\n'; ++sep)
-		if (*sep == ';')
+	value = dest = _xdg_arena_alloc(&reader->arena, end - line + 1, 1);
+
+	for (; line < end; ++line)
+		if (*line == ';')
 		{
-			*sep = 0;
-			_xdg_list_value_item_add(list, line);
-			line = sep + 1;
+			*dest++ = 0;
+			_xdg_list_value_item_add(&reader->arena, list, value);
+			value = dest;
 		}
+		else
+			if (*line == '\\' && line + 1 < end)
+				switch (*++line)
+				{
+					case 's':  *dest++ = ' ';  break;
+					case 'n':  *dest++ = '\n'; break;
+					case 't':  *dest++ = '\t'; break;
+					case 'r':  *dest++ = '\r'; break;
+					case '\\': *dest++ = '\\'; break;
+					case ';':  *dest++ = ';';  break;
+					default:
+						*dest++ = '\\';
+						*dest++ = *line;
+						break;
+				}
+			else
+				*dest++ = *line;
 
-	if (*line != 0 && *line != '\n')
+	if (dest != value)
 	{
-		*sep = 0;
-		_xdg_list_value_item_add(list, line);
+		*dest = 0;
+		_xdg_list_value_item_add(&reader->arena, list, value);
 	}
 }
 
-static void __xdg_app_group_read_entry_value(XdgList **list, char *line)
+static void __xdg_app_group_read_entry_value(XdgAppReader *reader, XdgList **list, const char *line, const char *end)
 {
     if ((*list) == NULL)
-        (*list) = calloc(1, sizeof(XdgList));
+    {
+        (*list) = _xdg_arena_alloc(&reader->arena, sizeof(XdgList), sizeof(void *));
+        (*list)->head = (*list)->tail = NULL;
+    }
 
-    _xdg_app_group_read_entry_value(*list, line);
+    _xdg_app_group_read_entry_value(reader, *list, line, end);
 }
 
-static void _xdg_app_group_read_mime_type_entry_value(XdgList *list, XdgApp *app, const char *app_name, AvlTree *asoc_map, char *line)
+static void _xdg_app_group_read_entry(XdgAppReader *reader, XdgAppGroup *group, const char *line, const char *end)
 {
-	char *sep;
-	XdgMimeSubType *sub_type;
-
-	for (sep = line; *sep && *sep != '\n'; ++sep)
-		if (*sep == ';')
-		{
-			*sep = 0;
-			_xdg_list_value_item_add(list, line);
-
-			if (sub_type = _xdg_mime_sub_type_add(asoc_map, line))
-				_xdg_list_app_item_append((XdgList *)&sub_type->apps, app_name, app);
-
-			line = sep + 1;
-		}
+	const char *sep;
 
-	if (*line != 0 && *line != '\n')
+	if ((sep = memchr(line, '=', end - line)) != NULL)
 	{
-		*sep = 0;
-		_xdg_list_value_item_add(list, line);
-
-		if (sub_type = _xdg_mime_sub_type_add(asoc_map, line))
-			_xdg_list_app_item_append((XdgList *)&sub_type->apps, app_name, app);
-	}
-}
+		XdgAppGroupEntry *entry;
+		const char *locale;
+		const char *key_end = sep;
+		const char *start = sep + 1;
 
-static void _xdg_app_group_read_entry(XdgAppGroup *group, XdgApp *app, const char *app_name, AvlTree *asoc_map, const char *line)
-{
-	char *sep;
+		while (key_end - 1 > line && key_end[-1] == ' ')
+			--key_end;
 
-	if ((sep = strchr(line, '=')) != NULL)
-	{
-		XdgListItem *values;
-		char *start = sep + 1;
-		REMOVE_WHITE_SPACES_LEFT(line, sep)
-		REMOVE_WHITE_SPACES_RIGHT(start)
+		while (start < end && *start == ' ')
+			++start;
 
-		if ((sep = strchr(line, '[')) != NULL)
+		if ((locale = memchr(line, '[', key_end - line)) != NULL)
 		{
-			*sep = 0;
-			char *locale = sep + 1;
-			XdgAppGroupEntry *entry = _xdg_app_group_entry_map_item_add(&group->entries, line);
-
-			if ((sep = strchr(locale, ']')) != NULL)
-			{
-				*sep = 0;
-				char *modifier = NULL;
-				char buffer[LOCALE_NAME_BUFFER_SIZE];
-
-				if ((sep = strchr(locale, '@')) != NULL)
-				{
-					*sep = 0;
-					modifier = sep + 1;
-				}
-
-				strcpy(buffer, locale);
+			entry = _xdg_app_group_entry_map_item_add(&group->entries, _xdg_intern_n(line, locale++ - line));
 
-				if (modifier)
-				{
-					strcat(buffer, "@");
-					strcat(buffer, modifier);
-				}
-
-				__xdg_app_group_read_entry_value((XdgList **)search_or_create_node(&entry->localized, buffer), start);
-			}
+			if ((sep = memchr(locale, ']', key_end - locale)) != NULL)
+				__xdg_app_group_read_entry_value(reader, (XdgList **)search_or_create_node(&entry->localized, _xdg_intern_n(locale, sep - locale)), start, end);
 			else
-				_xdg_app_group_read_entry_value((XdgList *)&entry->values, start);
+				_xdg_app_group_read_entry_value(reader, (XdgList *)&entry->values, start, end);
 		}
 		else
 		{
-			XdgAppGroupEntry *entry = _xdg_app_group_entry_map_item_add(&group->entries, line);
-
-			if (strcmp(line, "MimeType") == 0)
-				_xdg_app_group_read_mime_type_entry_value((XdgList *)&entry->values, app, app_name, asoc_map, start);
-			else
-				_xdg_app_group_read_entry_value((XdgList *)&entry->values, start);
+			entry = _xdg_app_group_entry_map_item_add(&group->entries, _xdg_intern_n(line, key_end - line));
+			_xdg_app_group_read_entry_value(reader, (XdgList *)&entry->values, start, end);
 		}
 	}
 }
@@ -613,7 +776,7 @@ static void _xdg_lst_group_handle_default(XdgList *list, const char *name, XdgAp
     XdgMimeSubTypeValue *item = (XdgMimeSubTypeValue *)list->head;
 
     while (item)
-        if (strcmp(item->name, name) == 0)
+        if (item->name == name)
             return;
         else
             item = (XdgMimeSubTypeValue *)item->item.item.next;
@@ -623,7 +786,7 @@ static void _xdg_lst_group_handle_default(XdgList *list, const char *name, XdgAp
 
 static int _xdg_lst_remove_sub_type_value(XdgMimeSubTypeValue *item, const char *name)
 {
-	return strcmp(item->name, name) == 0;
+	return item->name == name;
 }
 
 static void _xdg_lst_group_handle_added(XdgList *list, const char *name, XdgApp *app)
@@ -654,34 +817,119 @@ static void _xdg_lst_group_read_entry(const char *line, GroupHandler handler, Xd
 				if (*sep == ';')
 				{
 					*sep = 0;
-					handler((XdgListItem **)&sub_type->apps, start, _xdg_app_map_item_find(&data->app_files_map, start));
+					handler((XdgListItem **)&sub_type->apps, _xdg_intern(start), _xdg_app_map_item_find(&data->app_files_map, start));
 					start = sep + 1;
 				}
 
 			if (*start != 0 && *start != '\n')
 			{
 				*sep = 0;
-				handler((XdgListItem **)&sub_type->apps, start, _xdg_app_map_item_find(&data->app_files_map, start));
+				handler((XdgListItem **)&sub_type->apps, _xdg_intern(start), _xdg_app_map_item_find(&data->app_files_map, start));
 			}
 		}
 	}
 }
 
-static XdgApp *_xdg_folders_list_find_app(const char *name)
+/**
+ * Merges sorted maps of applications of all folders into one
+ * array, every id is compared with the head of each folder, so
+ * the cost is the number of applications times the number of
+ * folders, there are only a few of them.
+ */
+static void _xdg_app_index_build()
 {
-    XdgApp *res = NULL;
-    XdgAppFolderItem *item = (XdgAppFolderItem *)folders_list.head;
+	int i;
+	int count = 0;
+	int total = 0;
+	const char *name;
+	const XdgAppCacheApp *app;
+	const XdgAppCacheMap *map;
+	XdgAppIndexItem *item;
+	XdgAppIndexCursor *cursors;
+	XdgAppFolderItem *folder;
 
-    do
-    {
-        if (res = _xdg_app_map_item_find_const(item->app.app_files_map, name))
-            break;
+	for (folder = (XdgAppFolderItem *)folders_list.head; folder; folder = (XdgAppFolderItem *)folder->item.next, ++count)
+		total += folder->app.cache.header->app_files_map.count;
 
-        item = (XdgAppFolderItem *)item->item.next;
-    }
-    while (item);
+	cursors = malloc(count * sizeof(XdgAppIndexCursor));
 
-    return res;
+	for (i = 0, folder = (XdgAppFolderItem *)folders_list.head; folder; folder = (XdgAppFolderItem *)folder->item.next, ++i)
+	{
+		map = &folder->app.cache.header->app_files_map;
+		cursors[i].item = XDG_APP_CACHE_PTR(const XdgAppCacheItem *, map->items);
+		cursors[i].end = cursors[i].item + map->count;
+	}
+
+	free(apps_index.items);
+	apps_index.items = malloc(total * sizeof(XdgAppIndexItem));
+	apps_index.count = 0;
+
+	for (;;)
+	{
+		name = NULL;
+
+		for (i = 0; i < count; ++i)
+			if (cursors[i].item < cursors[i].end &&
+				(name == NULL || strcmp(XDG_APP_CACHE_STRING(cursors[i].item->key), name) < 0))
+				name = XDG_APP_CACHE_STRING(cursors[i].item->key);
+
+		if (name == NULL)
+			break;
+
+		item = &apps_index.items[apps_index.count++];
+		item->name = name;
+		item->first = item->app = NULL;
+
+		/* Folders are visited in the order of precedence */
+		for (i = 0; i < count; ++i)
+			if (cursors[i].item < cursors[i].end && strcmp(XDG_APP_CACHE_STRING(cursors[i].item->key), name) == 0)
+			{
+				app = XDG_APP_CACHE_PTR(const XdgAppCacheApp *, cursors[i].item->value);
+
+				if (item->first == NULL)
+					item->first = app;
+
+				if (item->app == NULL && app->groups)
+					item->app = app;
+
+				++cursors[i].item;
+			}
+	}
+
+	free(cursors);
+}
+
+static const XdgAppIndexItem *_xdg_app_index_search(const char *name)
+{
+	int res;
+	int first = 0;
+	int count = apps_index.count;
+	const XdgAppIndexItem *item;
+
+	while (first < count)
+	{
+		item = &apps_index.items[(first + count) / 2];
+
+		if ((res = strcmp(item->name, name)) == 0)
+			return item;
+		else
+			if (res < 0)
+				first = (first + count) / 2 + 1;
+			else
+				count = (first + count) / 2;
+	}
+
+	return NULL;
+}
+
+static XdgApp *_xdg_folders_list_find_app(const char *name)
+{
+	const XdgAppIndexItem *item = _xdg_app_index_search(name);
+
+	if (item)
+		return (XdgApp *)item->first;
+	else
+		return NULL;
 }
 
 static void _xdg_lst_group_read_entry_const(const char *line, AvlTree *lst_files_map)
@@ -704,7 +952,7 @@ static void _xdg_lst_group_read_entry_const(const char *line, AvlTree *lst_files
                     *sep = 0;
 
                     if (app = _xdg_folders_list_find_app(start))
-                        _xdg_lst_group_handle_default((XdgList *)&sub_type->apps, start, app);
+                        _xdg_lst_group_handle_default((XdgList *)&sub_type->apps, _xdg_intern(start), app);
 
                     start = sep + 1;
                 }
@@ -714,37 +962,63 @@ static void _xdg_lst_group_read_entry_const(const char *line, AvlTree *lst_files
                 *sep = 0;
 
                 if (app = _xdg_folders_list_find_app(start))
-                    _xdg_lst_group_handle_default((XdgList *)&sub_type->apps, start, app);
+                    _xdg_lst_group_handle_default((XdgList *)&sub_type->apps, _xdg_intern(start), app);
             }
         }
     }
 }
 
-static void _xdg_app_read_desktop_file(char *buffer, XdgAppData *data, FILE *file, const char *name)
+static void _xdg_app_read_desktop_file(XdgAppReader *reader, XdgApp *app, const char *line, const char *end)
 {
-	char *sep;
-	XdgApp *app;
+	const char *sep;
+	const char *eol;
 	XdgAppGroup *group = NULL;
 
-	app = _xdg_app_map_item_add(&data->app_files_map, name);
+	for (; line < end; line = eol + 1)
+	{
+		if ((eol = memchr(line, '\n', end - line)) == NULL)
+			eol = end;
 
-	while (fgets(buffer, READ_FROM_FILE_BUFFER_SIZE, file) != NULL)
-		if (buffer[0] != '#' && buffer[0] != '\r' && buffer[0] != '\n')
-			if (buffer[0] == '[')
+		if (line != eol && line[0] != '#' && line[0] != '\r')
+			if (line[0] == '[')
 			{
 				group = NULL;
 
-				if ((sep = strchr(buffer, ']')) != NULL)
-				{
-					*sep = 0;
-					group = _xdg_app_group_map_item_add(&app->groups->tree, buffer + 1);
-				}
+				if ((sep = memchr(line, ']', eol - line)) != NULL)
+					group = _xdg_app_group_map_item_add(&app->groups->tree, _xdg_intern_n(line + 1, sep - line - 1));
 			}
 			else
 				if (group)
-					_xdg_app_group_read_entry(group, app, name, &data->asoc_map, buffer);
+					_xdg_app_group_read_entry(reader, group, line, eol);
 				else
 					break;
+	}
+}
+
+/**
+ * Maps the file and parses it in place, \a app is created
+ * if it is \c NULL and the file can be opened.
+ */
+static void _xdg_app_load_desktop_file(XdgAppReader *reader, XdgApp **app, const char *file_name)
+{
+	int fd;
+	void *memory;
+	struct stat st;
+
+	if ((fd = open(file_name, O_RDONLY)) != -1)
+	{
+		if ((*app) == NULL)
+			(*app) = _xdg_app_new(&reader->arena);
+
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+			if ((memory = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED)
+			{
+				_xdg_app_read_desktop_file(reader, *app, memory, (const char *)memory + st.st_size);
+				munmap(memory, st.st_size);
+			}
+
+		close(fd);
+	}
 }
 
 static void _xdg_app_read_list_file(char *buffer, FILE *file, ReadListFileArgs *args)
@@ -779,7 +1053,50 @@ static void _xdg_app_read_list_file(char *buffer, FILE *file, ReadListFileArgs *
 					break;
 }
 
-static void __xdg_app_read_from_directory(char *buffer, XdgAppData *data, const char *directory_name, const char *preffix)
+static void _xdg_app_files_add(XdgAppFiles *files, char *file_name, const char *name, const struct stat *st)
+{
+	XdgAppFile *file;
+
+	if (files->count == files->allocated)
+	{
+		files->allocated = files->allocated ? files->allocated * 2 : 256;
+		files->files = realloc(files->files, files->allocated * sizeof(XdgAppFile));
+	}
+
+	file = &files->files[files->count++];
+	memset(file, 0, sizeof(XdgAppFile));
+
+	file->file_name = file_name;
+	file->name = name;
+	file->mtime = st->st_mtime;
+	file->size = st->st_size;
+	file->ino = st->st_ino;
+}
+
+static void _xdg_app_files_add_desktop_file(XdgAppFiles *files, XdgAppData *data, char *file_name, const char *preffix, const char *name)
+{
+	struct stat st;
+	char *file_name_preffix;
+
+	if (access(file_name, R_OK) == 0)
+	{
+		_xdg_file_watcher_list_add(&data->files, file_name, &st);
+
+		file_name_preffix = malloc(strlen(preffix) + strlen(name) + 1);
+		strcpy(file_name_preffix, preffix); strcat(file_name_preffix, name);
+
+		_xdg_app_files_add(files, file_name, _xdg_intern(file_name_preffix), &st);
+		free(file_name_preffix);
+	}
+	else
+		free(file_name);
+}
+
+/**
+ * Collects \a ".desktop" and \a ".list" files of the folder in
+ * the order they have to be indexed.
+ */
+static void _xdg_app_scan_directory(XdgAppFiles *files, XdgAppData *data, const char *directory_name, const char *preffix)
 {
 	DIR *dir;
 	struct stat st;
@@ -788,18 +1105,9 @@ static void __xdg_app_read_from_directory(char *buffer, XdgAppData *data, const
 
 	if (dir = opendir(directory_name))
 	{
-		FILE *file;
 		char *file_name;
 		struct dirent *entry;
 		char *file_name_preffix;
-		ReadListFileArgs args =
-		{
-		        _xdg_lst_group_handle_added,
-		        _xdg_lst_group_handle_default,
-		        _xdg_lst_group_handle_removed,
-		        data,
-		        (ReadListEntry)_xdg_lst_group_read_entry
-		};
 
 		while ((entry = readdir(dir)) != NULL)
 			if (entry->d_type == DT_DIR)
@@ -812,7 +1120,7 @@ static void __xdg_app_read_from_directory(char *buffer, XdgAppData *data, const
 					file_name_preffix = malloc(strlen(preffix) + strlen(entry->d_name) + 2);
 					strcpy(file_name_preffix, preffix); strcat(file_name_preffix, entry->d_name); strcat(file_name_preffix, "-");
 
-					__xdg_app_read_from_directory(buffer, data, file_name, file_name_preffix);
+					_xdg_app_scan_directory(files, data, file_name, file_name_preffix);
 
 					free(file_name_preffix);
 					free(file_name);
@@ -826,20 +1134,7 @@ static void __xdg_app_read_from_directory(char *buffer, XdgAppData *data, const
 						file_name = malloc(strlen(directory_name) + strlen(entry->d_name) + 2);
 						strcpy(file_name, directory_name); strcat(file_name, "/"); strcat(file_name, entry->d_name);
 
-						if (file = fopen(file_name, "r"))
-						{
-							_xdg_file_watcher_list_add(&data->files, file_name, &st);
-
-							file_name_preffix = malloc(strlen(preffix) + strlen(entry->d_name) + 1);
-							strcpy(file_name_preffix, preffix); strcat(file_name_preffix, entry->d_name);
-
-							_xdg_app_read_desktop_file(buffer, data, file, file_name_preffix);
-
-							free(file_name_preffix);
-							fclose(file);
-						}
-
-						free(file_name);
+						_xdg_app_files_add_desktop_file(files, data, file_name, preffix, entry->d_name);
 					}
 					else
 						if (fnmatch("*.item", entry->d_name, FNM_NOESCAPE) != FNM_NOMATCH)
@@ -847,14 +1142,13 @@ static void __xdg_app_read_from_directory(char *buffer, XdgAppData *data, const
 							file_name = malloc(strlen(directory_name) + strlen(entry->d_name) + 2);
 							strcpy(file_name, directory_name); strcat(file_name, "/"); strcat(file_name, entry->d_name);
 
-							if (file = fopen(file_name, "r"))
+							if (access(file_name, R_OK) == 0)
 							{
 								_xdg_file_watcher_list_add(&data->files, file_name, &st);
-								_xdg_app_read_list_file(buffer, file, &args);
-								fclose(file);
+								_xdg_app_files_add(files, file_name, NULL, &st);
 							}
-
-							free(file_name);
+							else
+								free(file_name);
 						}
 				}
 				else
@@ -869,26 +1163,16 @@ static void __xdg_app_read_from_directory(char *buffer, XdgAppData *data, const
                                 file_name_preffix = malloc(strlen(preffix) + strlen(entry->d_name) + 2);
                                 strcpy(file_name_preffix, preffix); strcat(file_name_preffix, entry->d_name); strcat(file_name_preffix, "-");
 
-                                __xdg_app_read_from_directory(buffer, data, file_name, file_name_preffix);
+                                _xdg_app_scan_directory(files, data, file_name, file_name_preffix);
 
                                 free(file_name_preffix);
                             }
                             else
                                 if (S_ISREG(st.st_mode) && fnmatch("*.desktop", entry->d_name, FNM_NOESCAPE) != FNM_NOMATCH)
                                 {
-                                    if (file = fopen(file_name, "r"))
-                                    {
-                                        _xdg_file_watcher_list_add(&data->files, file_name, &st);
-
-                                        file_name_preffix = malloc(strlen(preffix) + strlen(entry->d_name) + 1);
-                                        strcpy(file_name_preffix, preffix); strcat(file_name_preffix, entry->d_name);
-
-                                        _xdg_app_read_desktop_file(buffer, data, file, file_name_preffix);
-
-                                        free(file_name_preffix);
-                                        fclose(file);
-                                    }
-                                }
+                                    _xdg_app_files_add_desktop_file(files, data, file_name, preffix, entry->d_name);
+                                    file_name = NULL;
+                                }
 
                         free(file_name);
                     }
@@ -897,45 +1181,354 @@ static void __xdg_app_read_from_directory(char *buffer, XdgAppData *data, const
 	}
 }
 
-static void _xdg_app_read_from_directory(InitFromDirectoryArgs *args, const char *directory_name, const char *preffix)
+/**
+ * Chains files with the same id, all of them are read
+ * into the application of the first one.
+ */
+static void _xdg_app_files_link_duplicates(XdgAppFiles *files)
 {
-    XdgAppFolderItem *folder = (XdgAppFolderItem *)args->folders->head;
+	int i;
+	intptr_t *last;
+	AvlTree ids;
 
-    while (folder)
-    {
-        if (strcmp(folder->directory, directory_name) == 0)
-            return;
+	init_avl_tree(&ids, (DuplicateKey)_xdg_intern, NULL, _xdg_intern_compare);
 
-        folder = (XdgAppFolderItem *)folder->item.next;
-    }
+	for (i = 0; i < files->count; ++i)
+		if (files->files[i].name)
+		{
+			last = (intptr_t *)search_or_create_node(&ids, files->files[i].name);
 
-	char *file_name;
-	folder = _xdg_app_folder_item_new(args->folders, directory_name);
+			if (*last)
+			{
+				files->files[(*last) - 1].next = i;
+				files->files[i].duplicate = TRUE;
+			}
 
-	file_name = malloc(strlen(directory_name) + strlen(cache_file_name) + 2);
-	strcpy(file_name, directory_name); strcat(file_name, "/"); strcat(file_name, cache_file_name);
+			(*last) = i + 1;
+		}
 
-	_xdg_app_cache_new(&folder->app.cache.file, file_name);
+	clear_avl_tree(&ids);
+}
 
-	free(file_name);
+static int _xdg_app_files_compare(const XdgAppFile **file1, const XdgAppFile **file2)
+{
+	return strcmp((*file1)->file_name, (*file2)->file_name);
+}
+
+static BOOL _xdg_app_file_is_modified(const XdgAppFile *file, const XdgAppFile *old)
+{
+	return file->mtime != old->mtime || file->size != old->size || file->ino != old->ino || file->ino == 0;
+}
+
+/**
+ * Takes contents of files which were not modified since they were
+ * read, memory of the rest of \a old contents becomes garbage.
+ */
+static size_t _xdg_app_files_reuse(XdgAppFiles *files, const XdgAppFiles *old)
+{
+	int i;
+	size_t garbage = 0;
+	XdgAppFile *file;
+	XdgAppFile **found;
+	XdgAppFile **sorted = malloc(old->count * sizeof(XdgAppFile *));
+
+	for (i = 0; i < old->count; ++i)
+	{
+		sorted[i] = &old->files[i];
+		garbage += old->files[i].bytes;
+	}
+
+	qsort(sorted, old->count, sizeof(XdgAppFile *), (int (*)(const void *, const void *))_xdg_app_files_compare);
+
+	for (i = 0; i < files->count; ++i)
+	{
+		file = &files->files[i];
+
+		/* Files with the same id are read again together */
+		if (file->next || file->duplicate)
+			continue;
+
+		if ((found = bsearch(&file, sorted, old->count, sizeof(XdgAppFile *), (int (*)(const void *, const void *))_xdg_app_files_compare)) &&
+			(*found)->next == 0 && (*found)->duplicate == FALSE && (*found)->name == file->name &&
+			_xdg_app_file_is_modified(file, *found) == FALSE)
+		{
+			file->app = (*found)->app;
+			file->contents = (*found)->contents;
+			file->length = (*found)->length;
+			file->bytes = (*found)->bytes;
+			garbage -= file->bytes;
+		}
+	}
+
+	free(sorted);
+
+	return garbage;
+}
+
+static BOOL _xdg_app_file_is_read(const XdgAppFile *file)
+{
+	return file->app || file->contents || file->duplicate;
+}
+
+static void _xdg_app_group_entry_set_arena(const char *key, XdgAppGroupEntry *entry, XdgArena *arena)
+{
+	entry->localized.arena = arena;
+}
+
+static void _xdg_app_group_set_arena(const char *key, XdgAppGroup *group, XdgArena *arena)
+{
+	group->entries.arena = arena;
+	depth_first_search(&group->entries, (DepthFirstSearch)_xdg_app_group_entry_set_arena, arena);
+}
+
+/**
+ * Trees of \a app are created in the arena of a reader which is gone
+ * once the thread is done, they are pointed to the arena it is moved into.
+ */
+static void _xdg_app_set_arena(XdgApp *app, XdgArena *arena)
+{
+	app->groups->tree.arena = arena;
+	depth_first_search(&app->groups->tree, (DepthFirstSearch)_xdg_app_group_set_arena, arena);
+}
+
+static void *_xdg_app_read_desktop_files(XdgAppReader *reader)
+{
+	int i;
+	int j;
+	size_t bytes;
+	XdgAppFiles *files = reader->files;
+
+	while ((i = __sync_fetch_and_add(&files->next, 1)) < files->count)
+		if (files->files[i].name && _xdg_app_file_is_read(&files->files[i]) == FALSE)
+		{
+			bytes = reader->arena.bytes;
+			j = i;
+
+			do
+				_xdg_app_load_desktop_file(reader, &files->files[i].app, files->files[j].file_name);
+			while (j = files->files[j].next);
+
+			if (files->files[i].app)
+				_xdg_app_set_arena(files->files[i].app, reader->target);
+
+			files->files[i].bytes = reader->arena.bytes - bytes;
+		}
+
+	return NULL;
+}
+
+static void _xdg_app_read_desktop_files_in_parallel(XdgAppFiles *files, int count, XdgArena *arena)
+{
+#ifdef HAVE_PTHREAD
+	pthread_t threads[READ_DESKTOP_FILES_THREADS_MAX - 1];
+	XdgAppReader readers[READ_DESKTOP_FILES_THREADS_MAX];
+	long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int started = 0;
+
+	/* Threads only add their start up cost for a few files */
+	if (n_threads > count / READ_DESKTOP_FILES_PER_THREAD)
+		n_threads = count / READ_DESKTOP_FILES_PER_THREAD;
+
+	if (n_threads > READ_DESKTOP_FILES_THREADS_MAX)
+		n_threads = READ_DESKTOP_FILES_THREADS_MAX;
+
+	files->next = 0;
+
+	for (; started < n_threads - 1; ++started)
+	{
+		_xdg_app_reader_init(&readers[started + 1], files, arena);
+
+		if (pthread_create(&threads[started], NULL, (void *(*)(void *))_xdg_app_read_desktop_files, &readers[started + 1]) != 0)
+			break;
+	}
+
+	_xdg_app_reader_init(&readers[0], files, arena);
+	_xdg_app_read_desktop_files(&readers[0]);
+	_xdg_app_reader_free(&readers[0]);
+
+	while (started)
+	{
+		pthread_join(threads[--started], NULL);
+		_xdg_app_reader_free(&readers[started + 1]);
+	}
+#else
+	XdgAppReader reader;
+
+	files->next = 0;
+
+	_xdg_app_reader_init(&reader, files, arena);
+	_xdg_app_read_desktop_files(&reader);
+	_xdg_app_reader_free(&reader);
+#endif
+}
+
+static void _xdg_app_load_list_file(XdgArena *arena, XdgAppFile *file)
+{
+	int fd;
+	ssize_t res;
+	struct stat st;
+
+	if ((fd = open(file->file_name, O_RDONLY)) != -1)
+	{
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			file->contents = _xdg_arena_alloc(arena, st.st_size + 1, 1);
+			file->bytes = st.st_size + 1;
+
+			while (file->length < st.st_size &&
+				   ((res = read(fd, file->contents + file->length, st.st_size - file->length)) > 0 || (res == -1 && errno == EINTR)))
+				if (res > 0)
+					file->length += res;
+
+			file->contents[file->length] = 0;
+		}
+
+		close(fd);
+	}
+}
 
-	if (folder->app.cache.file.error == 0)
-		if (_xdg_app_cache_read(&folder->app.cache))
+/**
+ * Reads files which have no contents yet.
+ */
+static void _xdg_app_read_files(XdgAppFiles *files, XdgArena *arena)
+{
+	int i;
+	int count = 0;
+
+	for (i = 0; i < files->count; ++i)
+		if (_xdg_app_file_is_read(&files->files[i]) == FALSE)
 		{
-			folder->app.asoc_map = folder->app.cache.asoc_map;
-			folder->app.app_files_map = folder->app.cache.app_files_map;
-			folder->app.lst_files_map = folder->app.cache.lst_files_map;
+			if (files->files[i].name)
+				++count;
+			else
+				_xdg_app_load_list_file(arena, &files->files[i]);
+		}
+
+	if (count)
+		_xdg_app_read_desktop_files_in_parallel(files, count, arena);
+}
+
+static void _xdg_app_group_add_mime_types(const char *key, const XdgAppGroup *group, AddMimeTypesArgs *args)
+{
+	XdgValue *value;
+	XdgMimeSubType *sub_type;
+	XdgAppGroupEntry **entry = (XdgAppGroupEntry **)search_node(&group->entries, "MimeType");
+
+	if (entry)
+		for (value = (XdgValue *)(*entry)->values.head; value; value = (XdgValue *)value->item.next)
+			if (sub_type = _xdg_mime_sub_type_add(args->asoc_map, value->value))
+				_xdg_list_app_item_append((XdgList *)&sub_type->apps, args->name, args->app);
+}
 
-			return;
+static void _xdg_app_data_add_app(XdgAppData *data, XdgAppFile *item)
+{
+	AddMimeTypesArgs args = { &data->asoc_map, item->name, item->app };
+
+	(*(XdgApp **)search_or_create_node(&data->app_files_map, item->name)) = item->app;
+	depth_first_search(&item->app->groups->tree, (DepthFirstSearch)_xdg_app_group_add_mime_types, &args);
+}
+
+/**
+ * Indexes contents of files of the folder, nothing is read here.
+ */
+static void __xdg_app_read_from_directory(char *buffer, XdgAppData *data, const XdgAppFiles *files)
+{
+	int i;
+	FILE *file;
+	ReadListFileArgs args =
+	{
+	        _xdg_lst_group_handle_added,
+	        _xdg_lst_group_handle_default,
+	        _xdg_lst_group_handle_removed,
+	        data,
+	        (ReadListEntry)_xdg_lst_group_read_entry
+	};
+
+	/* Files are indexed in the order they were found,
+	 * no matter which thread has read them. */
+	for (i = 0; i < files->count; ++i)
+		if (files->files[i].app)
+			_xdg_app_data_add_app(data, &files->files[i]);
+
+	for (i = 0; i < files->count; ++i)
+		if (files->files[i].length && (file = fmemopen(files->files[i].contents, files->files[i].length, "r")))
+		{
+			_xdg_app_read_list_file(buffer, file, &args);
+			fclose(file);
 		}
+}
+
+static BOOL _xdg_app_cache_load(XdgAppCache *cache, const char *directory)
+{
+	char *file_name;
+
+	file_name = malloc(strlen(directory) + strlen(cache_file_name) + 2);
+	strcpy(file_name, directory); strcat(file_name, "/"); strcat(file_name, cache_file_name);
+
+	_xdg_app_cache_new(&cache->file, file_name);
+
+	free(file_name);
+
+	if (cache->file.error == 0)
+		if (cache->header = _xdg_app_cache_header(&cache->file))
+			return TRUE;
 		else
-			_xdg_app_cache_close(&folder->app.cache.file);
+			_xdg_app_cache_close(&cache->file);
 
-	__xdg_app_read_from_directory(args->buffer, &folder->app.data, directory_name, preffix);
+	return FALSE;
+}
 
-	folder->app.asoc_map = &folder->app.data.asoc_map;
-	folder->app.app_files_map = &folder->app.data.app_files_map;
-	folder->app.lst_files_map = &folder->app.data.lst_files_map;
+/**
+ * Builds the cache of the \a folder from contents of the \a directory,
+ * only files which were added or modified since the last build are read.
+ */
+static void _xdg_app_cache_build(XdgAppFolder *folder, char *buffer, const char *directory, const char *preffix)
+{
+	XdgAppData data;
+	XdgAppFiles files = { NULL, 0, 0, 0 };
+
+	/* Contents of files which are gone are released
+	 * once they take more memory than the rest. */
+	if (folder->garbage > folder->arena.bytes / 2)
+		_xdg_app_folder_clear_files(folder);
+
+	_xdg_app_data_init(&data);
+
+	_xdg_app_scan_directory(&files, &data, directory, preffix);
+	_xdg_app_files_link_duplicates(&files);
+	folder->garbage += _xdg_app_files_reuse(&files, &folder->files);
+	_xdg_app_read_files(&files, &folder->arena);
+
+	_xdg_app_files_free(&folder->files);
+	folder->files = files;
+
+	__xdg_app_read_from_directory(buffer, &data, &folder->files);
+
+	_xdg_app_cache_free(&folder->cache);
+	_xdg_app_cache_new_from_data(&folder->cache.file, &data.files, &data.app_files_map, &data.asoc_map, &data.lst_files_map, cache_locale);
+	folder->cache.header = _xdg_app_cache_header(&folder->cache.file);
+	folder->cache.bytes = folder->arena.bytes;
+	folder->cache.allocations = folder->arena.allocations;
+
+	_xdg_app_data_free(&data);
+}
+
+static void _xdg_app_read_from_directory(InitFromDirectoryArgs *args, const char *directory_name, const char *preffix)
+{
+    XdgAppFolderItem *folder = (XdgAppFolderItem *)args->folders->head;
+
+    while (folder)
+    {
+        if (strcmp(folder->directory, directory_name) == 0)
+            return;
+
+        folder = (XdgAppFolderItem *)folder->item.next;
+    }
+
+	folder = _xdg_app_folder_item_new(args->folders, directory_name);
+
+	if (_xdg_app_cache_load(&folder->app.cache, directory_name) == FALSE)
+		_xdg_app_cache_build(&folder->app, args->buffer, directory_name, preffix);
 }
 
 static int _init_from_directory(const char *directory, InitFromDirectoryArgs *user_data)
@@ -973,71 +1566,18 @@ static int _rebuild_directory_cache(const char *directory, RebuildDirectoryCache
 	return FALSE; /* Keep processing */
 }
 
-static void _xdg_app_fixup_links_between_folders(const char *name, XdgApp *app, const AvlTree *app_files_map)
-{
-	XdgApp **res = (XdgApp **)search_node(app_files_map, name);
-
-	if (res)
-		if (app->groups == NULL)
-			app->groups = (*res)->groups;
-		else
-			(*res)->groups = app->groups;
-}
-
-static void _xdg_app_fixup_links_to_desktop_files()
-{
-	assert(!_is_empty_list(&folders_list) && "Library was not initialized!");
-
-	XdgAppFolderItem *next;
-	XdgAppFolderItem *folder = (XdgAppFolderItem *)folders_list.head;
-	const AvlTree *app_files_map;
-
-	do
-	{
-		next = (XdgAppFolderItem *)folder->item.next;
-
-		while (next)
-		{
-			if (!_is_empty_list(&next->app.data.files))
-				app_files_map = &next->app.data.app_files_map;
-			else
-				app_files_map = next->app.cache.app_files_map;
-
-			if (is_empty_tree(app_files_map) == FALSE)
-				if (!_is_empty_list(&folder->app.data.files))
-					depth_first_search(&folder->app.data.app_files_map, (DepthFirstSearch)_xdg_app_fixup_links_between_folders, (void *)app_files_map);
-				else
-					depth_first_search(folder->app.cache.app_files_map, (DepthFirstSearch)_xdg_app_fixup_links_between_folders, (void *)app_files_map);
-
-			next = (XdgAppFolderItem *)next->item.next;
-		}
-
-		folder = (XdgAppFolderItem *)folder->item.next;
-	}
-	while (folder);
-}
-
-static void _xdg_app_cleanup_links_between_folders(const char *name, XdgApp *app)
-{
-	if (app->groups && app->groups->owner != app)
-		app->groups = NULL;
-}
-
-static void _xdg_app_cleanup_links_to_desktop_files()
+/**
+ * Applications with the same id share groups of the \a ".desktop"
+ * file found first in the folders list.
+ */
+static const XdgAppCacheMap *_xdg_app_groups(const XdgApp *app)
 {
-	assert(!_is_empty_list(&folders_list) && "Library was not initialized!");
-	XdgAppFolderItem *folder = (XdgAppFolderItem *)folders_list.head;
-
-	do
-	{
-		if (!_is_empty_list(&folder->app.data.files))
-			depth_first_search(&folder->app.data.app_files_map, (DepthFirstSearch)_xdg_app_cleanup_links_between_folders, NULL);
-		else
-			depth_first_search(folder->app.cache.app_files_map, (DepthFirstSearch)_xdg_app_cleanup_links_between_folders, NULL);
+	const XdgAppIndexItem *item = _xdg_app_index_search(XDG_APP_CACHE_STRING(((const XdgAppCacheApp *)app)->name));
 
-		folder = (XdgAppFolderItem *)folder->item.next;
-	}
-	while (folder);
+	if (item && item->app)
+		return XDG_APP_CACHE_PTR(const XdgAppCacheMap *, item->app->groups);
+	else
+		return NULL;
 }
 
 void _xdg_app_init()
@@ -1045,64 +1585,56 @@ void _xdg_app_init()
 	char buffer[READ_FROM_FILE_BUFFER_SIZE];
 	InitFromDirectoryArgs args = {buffer, &folders_list};
 
-	_xdg_for_each_data_dir((XdgDirectoryFunc)_init_from_directory, &args);
+	init_avl_tree(&joined_asoc_map, (DuplicateKey)_xdg_intern, NULL, _xdg_intern_compare);
+	init_avl_tree(&joined_lst_files_map, (DuplicateKey)_xdg_intern, NULL, _xdg_intern_compare);
 
-	_xdg_app_fixup_links_to_desktop_files();
+	_xdg_for_each_data_dir((XdgDirectoryFunc)_init_from_directory, &args);
+	_xdg_app_index_build();
 }
 
 void _xdg_app_shutdown()
 {
+	clear_avl_tree_and_values(&joined_asoc_map, (DestroyValue)_xdg_mime_type_map_item_free);
+	clear_avl_tree_and_values(&joined_lst_files_map, (DestroyValue)_xdg_mime_type_map_item_free);
 	_xdg_list_clear(&folders_list, (XdgListItemFree)_xdg_app_folder_item_free);
+
+	free(apps_index.items);
+	apps_index.items = NULL;
+	apps_index.count = 0;
 }
 
-static BOOL _xdg_check_time_stamp(const XdgList *files)
+static BOOL _xdg_check_time_stamp(const XdgAppCacheHeader *header)
 {
 	struct stat st;
-	XdgFileWatcher *file = (XdgFileWatcher *)files->head;
+	xdg_uint32_t i;
+	const XdgAppCacheFiles *files = XDG_APP_CACHE_PTR(const XdgAppCacheFiles *, header->files);
 
-	while (file)
-	{
-		if (stat(file->path, &st) == 0)
+	for (i = 0; i < files->count; ++i)
+		if (stat(XDG_APP_CACHE_STRING(files->files[i].path), &st) == 0)
 		{
-			if (st.st_mtime != file->mtime)
+			if (st.st_mtime != files->files[i].mtime ||
+				_xdg_file_watcher_size(&st) != files->files[i].size ||
+				st.st_ino != files->files[i].ino)
 				return FALSE;
 		}
 		else
-			if (file->mtime)
+			if (files->files[i].mtime || files->files[i].ino)
 				return FALSE;
 
-		file = (XdgFileWatcher *)file->item.next;
-	}
-
 	return TRUE;
 }
 
 int xdg_app_cache_file_is_valid(const char *directory)
 {
 	int res = FALSE;
-	char *file_name;
 	XdgAppCache cache;
 
 	_xdg_app_cache_init(&cache);
 
-	file_name = malloc(strlen(directory) + strlen(cache_file_name) + 2);
-	strcpy(file_name, directory); strcat(file_name, "/"); strcat(file_name, cache_file_name);
-
-	_xdg_app_cache_new(&cache.file, file_name);
-
-	free(file_name);
-
-	if (cache.file.error == 0)
+	if (_xdg_app_cache_load(&cache, directory))
 	{
-		void *memory = cache.file.memory;
-
-		if (read_version(&memory) == 1)
-		{
-			cache.files = read_file_watcher_list(&memory);
-			res = _xdg_check_time_stamp(cache.files);
-		}
-
-		_xdg_app_cache_close(&cache.file);
+		res = _xdg_check_time_stamp(cache.header);
+		_xdg_app_cache_free(&cache);
 	}
 
 	return res;
@@ -1110,36 +1642,29 @@ int xdg_app_cache_file_is_valid(const char *directory)
 
 int xdg_app_rebuild_cache_file(const char *directory)
 {
-	int res = 0;
+	int res;
 	char *file_name;
-	XdgAppCache cache;
-
-	_xdg_app_cache_init(&cache);
+	XdgAppFolder folder;
+	XdgAppCacheTemp temp;
+	char buffer[READ_FROM_FILE_BUFFER_SIZE];
 
 	file_name = malloc(strlen(directory) + strlen(cache_file_name) + 2);
 	strcpy(file_name, directory); strcat(file_name, "/"); strcat(file_name, cache_file_name);
 
-	_xdg_app_cache_new_empty(&cache.file, file_name);
-
-	free(file_name);
-
-	if (cache.file.error == 0)
+	/* The file is created before the directory is read, so the
+	 * time stamp of the directory saved in the cache includes it,
+	 * the rename into the final name is accounted for on save. */
+	if ((res = _xdg_app_cache_create(&temp, file_name)) == 0)
 	{
-		XdgAppData data;
-		char buffer[READ_FROM_FILE_BUFFER_SIZE];
-
-		_xdg_app_data_init(&data);
+		_xdg_app_folder_init(&folder);
+		_xdg_app_cache_build(&folder, buffer, directory, "");
 
-		__xdg_app_read_from_directory(buffer, &data, directory, "");
+		res = _xdg_app_cache_save(&folder.cache.file, &temp, file_name, directory);
 
-		_xdg_app_cache_write(&cache.file, &data);
-
-		_xdg_app_data_free(&data);
+		_xdg_app_folder_free(&folder);
 	}
-	else
-		res = cache.file.error;
 
-	_xdg_app_cache_free(&cache);
+	free(file_name);
 
 	return res;
 }
@@ -1153,81 +1678,95 @@ void xdg_app_rebuild_cache_in_each_data_dir(RebuildCacheResult *result)
 	_xdg_for_each_data_dir((XdgDirectoryFunc)_rebuild_directory_cache, &args);
 }
 
-static BOOL _xdg_load_cache(XdgAppFolderItem *folder)
+void xdg_app_refresh(RebuildResult *result)
 {
-	char *file_name;
+	assert(!_is_empty_list(&folders_list) && "Library was not initialized!");
+	char buffer[READ_FROM_FILE_BUFFER_SIZE];
+	XdgAppFolderItem *folder = (XdgAppFolderItem *)folders_list.head;
+	BOOL changed = FALSE;
 	XdgAppCache cache;
 
-	_xdg_app_cache_init(&cache);
+	clear_avl_tree_and_values(&joined_asoc_map, (DestroyValue)_xdg_mime_type_map_item_free);
+	clear_avl_tree_and_values(&joined_lst_files_map, (DestroyValue)_xdg_mime_type_map_item_free);
 
-	file_name = malloc(strlen(folder->directory) + strlen(cache_file_name) + 2);
-	strcpy(file_name, folder->directory); strcat(file_name, "/"); strcat(file_name, cache_file_name);
+	do
+	{
+		if (_xdg_check_time_stamp(folder->app.cache.header) == FALSE)
+		{
+			_xdg_app_cache_init(&cache);
 
-	_xdg_app_cache_new(&cache.file, file_name);
+			if (_xdg_app_cache_load(&cache, folder->directory))
+			{
+				_xdg_app_folder_clear_files(&folder->app);
+				_xdg_app_cache_free(&folder->app.cache);
+				memcpy(&folder->app.cache, &cache, sizeof(XdgAppCache));
+			}
+			else
+				_xdg_app_cache_build(&folder->app, buffer, folder->directory, "");
 
-	free(file_name);
+			changed = TRUE;
+		}
 
-	if (cache.file.error == 0)
-		if (_xdg_app_cache_read(&cache))
-		{
-			_xdg_app_cache_free(&folder->app.cache);
-			memcpy(&folder->app.cache, &cache, sizeof(XdgAppCache));
+		folder = (XdgAppFolderItem *)folder->item.next;
+	}
+	while (folder);
 
-			folder->app.asoc_map = folder->app.cache.asoc_map;
-			folder->app.app_files_map = folder->app.cache.app_files_map;
-			folder->app.lst_files_map = folder->app.cache.lst_files_map;
+	if (changed)
+		_xdg_app_index_build();
+}
 
-			return TRUE;
+int xdg_app_folders_stats(XdgAppFolderStats *stats, int count)
+{
+	int res = 0;
+	XdgAppFolderItem *folder = (XdgAppFolderItem *)folders_list.head;
+
+	for (; folder; folder = (XdgAppFolderItem *)folder->item.next, ++res)
+		if (res < count)
+		{
+			stats[res].directory = folder->directory;
+			stats[res].bytes = folder->app.cache.bytes;
+			stats[res].allocations = folder->app.cache.allocations;
 		}
-		else
-			_xdg_app_cache_close(&cache.file);
 
-	return FALSE;
+	return res;
 }
 
-void xdg_app_refresh(RebuildResult *result)
+static const XdgMimeSubTypeValue *_xdg_app_cache_sub_type_search(const XdgAppCacheMap *map, const char *type, const char *sub_type)
 {
-	assert(!_is_empty_list(&folders_list) && "Library was not initialized!");
-	char buffer[READ_FROM_FILE_BUFFER_SIZE];
-	XdgAppFolderItem *folder = (XdgAppFolderItem *)folders_list.head;
+	const XdgAppCacheMap *sub_types = _xdg_app_cache_search(map, type);
+
+	if (sub_types)
+		return _xdg_app_cache_search(sub_types, sub_type);
+	else
+		return NULL;
+}
 
-	_xdg_app_cleanup_links_to_desktop_files();
+static const XdgListItem *_xdg_joint_apps_join(AvlTree *joined_map, size_t map, const char *type, const char *sub_type)
+{
+	const XdgListItem *value;
+	XdgAppFolderItem *item = (XdgAppFolderItem *)folders_list.head;
+	XdgMimeSubType *res = _xdg_mime_sub_type_item_search_or_create(joined_map, type, sub_type);
 
 	do
 	{
-		if (!_is_empty_list(&folder->app.data.files))
-		{
-			if (_xdg_check_time_stamp(&folder->app.data.files) == FALSE)
-				if (_xdg_load_cache(folder) == FALSE)
-				{
-					_xdg_app_data_free(&folder->app.data);
-					_xdg_app_data_init(&folder->app.data);
+		value = (const XdgListItem *)_xdg_app_cache_sub_type_search((const XdgAppCacheMap *)((const char *)item->app.cache.header + map), type, sub_type);
 
-					__xdg_app_read_from_directory(buffer, &folder->app.data, folder->directory, "");
-				}
-		}
-		else
-			if (_xdg_check_time_stamp(folder->app.cache.files) == FALSE)
-				if (_xdg_load_cache(folder) == FALSE)
-				{
-					_xdg_app_data_free(&folder->app.data);
-					_xdg_app_data_init(&folder->app.data);
+		for (; value; value = xdg_list_next(value))
+			_xdg_list_app_item_append_copy((XdgList *)&res->apps, (XdgMimeSubTypeValue *)value);
 
-					__xdg_app_read_from_directory(buffer, &folder->app.data, folder->directory, "");
-				}
-
-		folder = (XdgAppFolderItem *)folder->item.next;
+		item = (XdgAppFolderItem *)item->item.next;
 	}
-	while (folder);
+	while (item);
+
+	_xdg_joint_list_apped(&res->apps, (XdgJointListItem *)res->apps.list.tail);
 
-	_xdg_app_fixup_links_to_desktop_files();
+	return res->apps.list.head;
 }
 
-const XdgJointListItem *xdg_apps_lookup(const char *mimeType)
+static const XdgJointListItem *_xdg_joint_apps_lookup(AvlTree *joined_map, size_t map, const char *mimeType)
 {
-	assert(!_is_empty_list(&folders_list) && "Library was not initialized!");
 	char buffer[MIME_TYPE_NAME_BUFFER_SIZE];
-	XdgJointList res = { { NULL, NULL }, NULL, NULL };
+	const XdgMimeSubTypeValue *res = NULL;
 	char *sep;
 
 	if ((sep = strchr(mimeType, '/')) != NULL)
@@ -1236,59 +1775,87 @@ const XdgJointListItem *xdg_apps_lookup(const char *mimeType)
 		buffer[sep - mimeType] = 0;
 		++sep;
 
-		XdgMimeSubType *sub_type;
+		const XdgMimeSubTypeValue *value;
+		XdgMimeSubType *sub_type = _xdg_mime_sub_type_item_search(joined_map, buffer, sep);
 		XdgAppFolderItem *item = (XdgAppFolderItem *)folders_list.head;
 
+		if (sub_type)
+			return (const XdgJointListItem *)sub_type->apps.list.head;
+
 		do
 		{
-			sub_type = _xdg_mime_sub_type_item_search(item->app.lst_files_map, buffer, sep);
+			value = _xdg_app_cache_sub_type_search((const XdgAppCacheMap *)((const char *)item->app.cache.header + map), buffer, sep);
 
-			if (sub_type)
-				_xdg_joint_list_apped(&res, (XdgJointListItem *)&sub_type->apps.list.tail);
+			if (value)
+				if (res == NULL)
+					res = value;
+				else
+					return (const XdgJointListItem *)_xdg_joint_apps_join(joined_map, map, buffer, sep);
 
 			item = (XdgAppFolderItem *)item->item.next;
 		}
 		while (item);
 	}
 
-    if (res.head)
-        return (const XdgJointListItem *)res.head->item.list->head;
-    else
-        return NULL;
+	return (const XdgJointListItem *)res;
+}
+
+const XdgJointListItem *xdg_apps_lookup(const char *mimeType)
+{
+	assert(!_is_empty_list(&folders_list) && "Library was not initialized!");
+	return _xdg_joint_apps_lookup(&joined_lst_files_map, offsetof(XdgAppCacheHeader, lst_files_map), mimeType);
 }
 
 const XdgJointListItem *xdg_known_apps_lookup(const char *mimeType)
 {
 	assert(!_is_empty_list(&folders_list) && "Library was not initialized!");
+	return _xdg_joint_apps_lookup(&joined_asoc_map, offsetof(XdgAppCacheHeader, asoc_map), mimeType);
+}
+
+/**
+ * Reads lists of all folders in place, unlike _xdg_joint_apps_lookup()
+ * nothing is joined, so there is nothing to write.
+ */
+static int _xdg_apps_lookup_r(size_t map, const char *mimeType, const XdgApp **apps, int count)
+{
+	int res = 0;
 	char buffer[MIME_TYPE_NAME_BUFFER_SIZE];
-	XdgJointList res = { { NULL, NULL }, NULL, NULL };
-	char *sep;
+	const XdgListItem *value;
+	XdgAppFolderItem *item;
+	const char *sep;
 
-	if ((sep = strchr(mimeType, '/')) != NULL)
+	if ((sep = strchr(mimeType, '/')) != NULL && sep - mimeType < MIME_TYPE_NAME_BUFFER_SIZE)
 	{
-		strncpy(buffer, mimeType, sep - mimeType);
+		memcpy(buffer, mimeType, sep - mimeType);
 		buffer[sep - mimeType] = 0;
 		++sep;
 
-		XdgMimeSubType *sub_type;
-		XdgAppFolderItem *item = (XdgAppFolderItem *)folders_list.head;
+		for (item = (XdgAppFolderItem *)folders_list.head; item; item = (XdgAppFolderItem *)item->item.next)
+			for (value = (const XdgListItem *)_xdg_app_cache_sub_type_search((const XdgAppCacheMap *)((const char *)item->app.cache.header + map), buffer, sep);
+				 value;
+				 value = xdg_list_next(value), ++res)
+				if (res < count)
+					apps[res] = _xdg_app_cache_value_app((const XdgMimeSubTypeValue *)value);
+	}
 
-		do
-		{
-			sub_type = _xdg_mime_sub_type_item_search(item->app.asoc_map, buffer, sep);
+	return res;
+}
 
-			if (sub_type)
-				_xdg_joint_list_apped(&res, (XdgJointListItem *)sub_type->apps.list.tail);
+int xdg_apps_lookup_r(const char *mimeType, const XdgApp **apps, int count)
+{
+	assert(!_is_empty_list(&folders_list) && "Library was not initialized!");
+	return _xdg_apps_lookup_r(offsetof(XdgAppCacheHeader, lst_files_map), mimeType, apps, count);
+}
 
-			item = (XdgAppFolderItem *)item->item.next;
-		}
-		while (item);
-	}
+int xdg_known_apps_lookup_r(const char *mimeType, const XdgApp **apps, int count)
+{
+	assert(!_is_empty_list(&folders_list) && "Library was not initialized!");
+	return _xdg_apps_lookup_r(offsetof(XdgAppCacheHeader, asoc_map), mimeType, apps, count);
+}
 
-	if (res.head)
-	    return (const XdgJointListItem *)res.head->item.list->head;
-	else
-	    return NULL;
+const char *xdg_app_id(const XdgApp *app)
+{
+	return XDG_APP_CACHE_STRING(((const XdgAppCacheApp *)app)->name);
 }
 
 static void _xdg_load_user_defined_apps(const char *directory, InitFromHomeDirectoryArgs *args)
@@ -1300,9 +1867,9 @@ static void _xdg_load_user_defined_apps(const char *directory, InitFromHomeDirec
     *args->apps = malloc(sizeof(XdgUserApps) + strlen(directory) + strlen("/applications/mimeapps.list"));
     strcpy((*args->apps)->fileName, directory); strcat((*args->apps)->fileName, "/applications/mimeapps.list");
 
-    init_avl_tree(&(*args->apps)->addedApps, strdup, (DestroyKey)free, strcmp);
-    init_avl_tree(&(*args->apps)->defaultApps, strdup, (DestroyKey)free, strcmp);
-    init_avl_tree(&(*args->apps)->removedApps, strdup, (DestroyKey)free, strcmp);
+    init_avl_tree(&(*args->apps)->addedApps, (DuplicateKey)_xdg_intern, NULL, _xdg_intern_compare);
+    init_avl_tree(&(*args->apps)->defaultApps, (DuplicateKey)_xdg_intern, NULL, _xdg_intern_compare);
+    init_avl_tree(&(*args->apps)->removedApps, (DuplicateKey)_xdg_intern, NULL, _xdg_intern_compare);
 
     if (file = fopen((*args->apps)->fileName, "r"))
     {
@@ -1463,14 +2030,14 @@ void xdg_user_defined_apps_free(XdgUserApps *apps, int save)
 char *xdg_app_icon_lookup(const XdgApp *app, const char *themeName, int size)
 {
 #ifdef THEMES_SPEC
-	XdgAppGroup **group = (XdgAppGroup **)search_node(&app->groups->tree, "Desktop Entry");
+	const XdgAppGroup *group = xdg_app_group_lookup(app, "Desktop Entry");
 
 	if (group)
 	{
-		XdgAppGroupEntry **entry = (XdgAppGroupEntry **)search_node(&(*group)->entries, "Icon");
+		const XdgListItem *value = xdg_app_entry_lookup(group, "Icon");
 
-		if (entry && !_is_empty_list(&(*entry)->values))
-			return xdg_icon_lookup(((XdgValue *)(*entry)->values.head)->value, size, XdgThemeApplications, themeName);
+		if (value)
+			return xdg_icon_lookup(((const XdgAppCacheValue *)value)->value, size, XdgThemeApplications, themeName);
 	}
 #endif
 
@@ -1479,153 +2046,179 @@ char *xdg_app_icon_lookup(const XdgApp *app, const char *themeName, int size)
 
 const XdgAppGroup *xdg_app_group_lookup(const XdgApp *app, const char *group)
 {
-	if (app->groups)
-	{
-		XdgAppGroup **res = (XdgAppGroup **)search_node(&app->groups->tree, group);
+	const XdgAppCacheMap *groups = _xdg_app_groups(app);
 
-		if (res)
-			return (*res);
-	}
+	if (groups)
+		return (const XdgAppGroup *)_xdg_app_cache_search(groups, group);
 
 	return NULL;
 }
 
 const XdgListItem *xdg_app_entry_lookup(const XdgAppGroup *group, const char *entry)
 {
-	XdgAppGroupEntry **res = (XdgAppGroupEntry **)search_node(&group->entries, entry);
+	const XdgAppCacheEntry *res = _xdg_app_cache_entry_search((const XdgAppCacheGroup *)group, entry);
 
 	if (res)
-		return (*res)->values.head;
+		return XDG_APP_CACHE_PTR(const XdgListItem *, res->values);
 	else
 		return NULL;
 }
 
-const XdgListItem *xdg_app_localized_entry_lookup(const XdgAppGroup *group, const char *entry, const char *lang, const char *country, const char *modifier)
+/**
+ * Appends \a "lang_country@modifier" (either of the last two may be
+ * \c NULL) to the chain of \a locale, the name is written into
+ * \a buffer and left out if it does not fit.
+ */
+static void _xdg_app_locale_add(XdgAppLocale *locale, char **buffer, size_t *size, const char *lang, const char *country, const char *modifier)
 {
-	XdgAppGroupEntry **value = (XdgAppGroupEntry **)search_node(&group->entries, entry);
+	int len = snprintf(*buffer, *size, "%s%s%s%s%s",
+					   lang,
+					   country ? "_" : "", country ? country : "",
+					   modifier ? "@" : "", modifier ? modifier : "");
 
-	if (value && *value)
+	if (len >= 0 && (size_t)len < (*size))
 	{
-        XdgList **res;
-		char buffer[LOCALE_NAME_BUFFER_SIZE];
+		locale->names[locale->count++] = (*buffer);
+		(*buffer) += (size_t)len + 1;
+		(*size) -= (size_t)len + 1;
+	}
+}
 
-		if (lang && *lang)
-			if (country && *country)
-				if (modifier && *modifier)
-				{
-					strcpy(buffer, lang);
-					strcat(buffer, "_");
-					strcat(buffer, country);
-					strcat(buffer, "@");
-					strcat(buffer, modifier);
+/**
+ * \a lang is used as is, the rest of names are written into \a buffer.
+ */
+static void _xdg_app_locale_init(XdgAppLocale *locale, char *buffer, size_t size, const char *lang, const char *country, const char *modifier)
+{
+	locale->count = 0;
 
-					res = (XdgList **)search_node(&(*value)->localized, buffer);
+	if (lang && *lang)
+	{
+		if (country && *country == 0)
+			country = NULL;
 
-					if (res && !_is_empty_list(*res))
-						return (*res)->head;
-					else
-					{
-						(*strchr(buffer, '@')) = 0;
+		if (modifier && *modifier == 0)
+			modifier = NULL;
 
-						res = (XdgList **)search_node(&(*value)->localized, buffer);
+		if (country && modifier)
+			_xdg_app_locale_add(locale, &buffer, &size, lang, country, modifier);
 
-	                    if (res && !_is_empty_list(*res))
-							return (*res)->head;
-						else
-						{
-							(*strchr(buffer, '_')) = 0;
-							strcat(buffer, "@");
-							strcat(buffer, modifier);
+		if (country)
+			_xdg_app_locale_add(locale, &buffer, &size, lang, country, NULL);
 
-							res = (XdgList **)search_node(&(*value)->localized, buffer);
+		if (modifier)
+			_xdg_app_locale_add(locale, &buffer, &size, lang, NULL, modifier);
 
-		                    if (res && !_is_empty_list(*res))
-								return (*res)->head;
-							else
-							{
-								res = (XdgList **)search_node(&(*value)->localized, lang);
+		locale->names[locale->count++] = lang;
+	}
+}
 
-			                    if (res && !_is_empty_list(*res))
-									return (*res)->head;
-								else
-									return (XdgListItem *)(*value)->values.head;
-							}
-						}
-					}
-				}
-				else
-				{
-					strcpy(buffer, lang);
-					strcat(buffer, "_");
-					strcat(buffer, country);
+/**
+ * Copies \a locale and its names into one allocation.
+ */
+static XdgAppLocale *_xdg_app_locale_dup(const XdgAppLocale *locale)
+{
+	int i;
+	char *buffer;
+	size_t size = sizeof(XdgAppLocale);
+	XdgAppLocale *res;
 
-					res = (XdgList **)search_node(&(*value)->localized, buffer);
+	for (i = 0; i < locale->count; ++i)
+		size += strlen(locale->names[i]) + 1;
 
-                    if (res && !_is_empty_list(*res))
-						return (*res)->head;
-					else
-					{
-						res = (XdgList **)search_node(&(*value)->localized, lang);
+	if ((res = malloc(size)) != NULL)
+	{
+		buffer = (char *)(res + 1);
+		res->count = locale->count;
 
-						if (res && !_is_empty_list(*res))
-							return (*res)->head;
-						else
-							return (XdgListItem *)(*value)->values.head;
-					}
-				}
-			else
-				if (modifier && *modifier)
-				{
-					strcpy(buffer, lang);
-					strcat(buffer, "@");
-					strcat(buffer, modifier);
+		for (i = 0; i < locale->count; ++i)
+		{
+			res->names[i] = strcpy(buffer, locale->names[i]);
+			buffer += strlen(buffer) + 1;
+		}
+	}
 
-					res = (XdgList **)search_node(&(*value)->localized, buffer);
+	return res;
+}
 
-					if (res && !_is_empty_list(*res))
-						return (*res)->head;
-					else
-					{
-						res = (XdgList **)search_node(&(*value)->localized, lang);
+const XdgListItem *xdg_app_localized_entry_lookup(const XdgAppGroup *group, const char *entry, const char *lang, const char *country, const char *modifier)
+{
+	XdgAppLocale locale;
+	char buffer[3 * LOCALE_NAME_BUFFER_SIZE];
 
-						if (res && !_is_empty_list(*res))
-							return (*res)->head;
-						else
-							return (XdgListItem *)(*value)->values.head;
-					}
-				}
-				else
-				{
-					res = (XdgList **)search_node(&(*value)->localized, lang);
+	_xdg_app_locale_init(&locale, buffer, sizeof(buffer), lang, country, modifier);
 
-					if (res && !_is_empty_list(*res))
-						return (*res)->head;
-					else
-						return (XdgListItem *)(*value)->values.head;
-				}
+	return xdg_app_localized_entry_lookup_l(group, entry, &locale);
+}
+
+XdgAppLocale *xdg_app_locale_new(const char *lang, const char *country, const char *modifier)
+{
+	XdgAppLocale locale;
+	size_t size = 3 * ((lang ? strlen(lang) : 0) + (country ? strlen(country) : 0) + (modifier ? strlen(modifier) : 0) + 3);
+	char *buffer = malloc(size);
+	XdgAppLocale *res = NULL;
+
+	if (buffer)
+	{
+		_xdg_app_locale_init(&locale, buffer, size, lang, country, modifier);
+		res = _xdg_app_locale_dup(&locale);
+		free(buffer);
+	}
+
+	return res;
+}
+
+void xdg_app_locale_free(XdgAppLocale *locale)
+{
+	free(locale);
+}
+
+const XdgListItem *xdg_app_localized_entry_lookup_l(const XdgAppGroup *group, const char *entry, const XdgAppLocale *locale)
+{
+	const XdgAppCacheGroup *cache_group = (const XdgAppCacheGroup *)group;
+	const XdgAppCacheEntry *value = _xdg_app_cache_entry_search(cache_group, entry);
+	const XdgListItem *res;
+
+	if (value)
+	{
+		if (cache_group->locale && locale->count &&
+			strcmp(XDG_APP_CACHE_STRING(cache_group->locale), locale->names[0]) == 0)
+			return XDG_APP_CACHE_PTR(const XdgListItem *, value->preferred);
 
-		return (XdgListItem *)(*value)->values.head;
+		if (res = _xdg_app_cache_locale_search(&value->localized, locale))
+			return res;
+
+		return XDG_APP_CACHE_PTR(const XdgListItem *, value->values);
 	}
 
 	return NULL;
 }
 
+void xdg_app_set_cache_locale(const XdgAppLocale *locale)
+{
+	free(cache_locale);
+
+	if (locale && locale->count)
+		cache_locale = _xdg_app_locale_dup(locale);
+	else
+		cache_locale = NULL;
+}
+
 const XdgApp *xdg_list_item_app(const XdgListItem *item)
 {
-    return ((XdgMimeSubTypeValue *)item)->app;
+    return _xdg_app_cache_value_app((const XdgMimeSubTypeValue *)item);
 }
 
 const XdgApp *xdg_joint_list_item_app(const XdgJointListItem *item)
 {
-	return ((XdgMimeSubTypeValue *)item)->app;
+	return _xdg_app_cache_value_app((const XdgMimeSubTypeValue *)item);
 }
 
 const char *xdg_joint_list_item_app_id(const XdgJointListItem *item)
 {
-	return ((XdgMimeSubTypeValue *)item)->name;
+	return _xdg_app_cache_value_name((const XdgMimeSubTypeValue *)item);
 }
 
 const char *xdg_list_item_app_group_entry_value(const XdgListItem *item)
 {
-	return ((XdgValue *)item)->value;
+	return ((const XdgAppCacheValue *)item)->value;
 }
@@ -34,6 +34,7 @@
 #define __XDG_APP_H_
 
 #include "../containers/xdglist.h"
+#include <stddef.h>
 
 
 #ifdef __cplusplus
@@ -43,6 +44,7 @@ extern "C" {
 typedef struct XdgApp      XdgApp;
 typedef struct XdgAppGroup XdgAppGroup;
 typedef struct XdgUserApps XdgUserApps;
+typedef struct XdgAppLocale XdgAppLocale;
 
 
 /**
@@ -93,6 +95,30 @@ struct RebuildResult
 };
 typedef struct RebuildResult RebuildResult;
 
+/**
+ * Represents memory which was used for reading
+ * \a ".desktop" and \a ".list" files of a folder.
+ */
+struct XdgAppFolderStats
+{
+	/**
+	 * Absolute path to directory.
+	 */
+	const char *directory;
+
+	/**
+	 * Number of bytes allocated, it is 0 if the
+	 * folder was loaded from the cache file.
+	 */
+	size_t bytes;
+
+	/**
+	 * Number of allocations.
+	 */
+	size_t allocations;
+};
+typedef struct XdgAppFolderStats XdgAppFolderStats;
+
 /**
  * Checks that cache file is valid (all data is up-to-date).
  *
@@ -146,6 +172,16 @@ void xdg_app_rebuild_cache_in_each_data_dir(RebuildCacheResult *result);
  */
 void xdg_app_refresh(RebuildResult *result);
 
+/**
+ * Reports memory held by contents of files of each folder,
+ * it is kept to read only modified files on xdg_app_refresh().
+ *
+ * @param stats array to fill.
+ * @param count size of \a stats.
+ * @return number of folders, it may be greater than \a count.
+ */
+int xdg_app_folders_stats(XdgAppFolderStats *stats, int count);
+
 /**
  * Looks for applications able to handle given mime type,
  * according to the information from the merged \a ".list" files.
@@ -166,6 +202,33 @@ const XdgJointListItem *xdg_apps_lookup(const char *mimeType);
  */
 const XdgJointListItem *xdg_known_apps_lookup(const char *mimeType);
 
+/**
+ * Same as xdg_apps_lookup() but the applications are stored into
+ * the \p "apps" array, nothing shared is modified, so it can be
+ * called from several threads at once.
+ *
+ * @param mimeType name of the mime type.
+ * @param apps array to fill, in the same order as the list
+ * returned by xdg_apps_lookup().
+ * @param count size of \p "apps".
+ * @return number of applications, it may be greater than \p "count".
+ *
+ * @note
+ * It must not be called concurrently with xdg_app_refresh().
+ */
+int xdg_apps_lookup_r(const char *mimeType, const XdgApp **apps, int count);
+
+/**
+ * Same as xdg_known_apps_lookup() but the applications are stored
+ * into the \p "apps" array, see xdg_apps_lookup_r().
+ */
+int xdg_known_apps_lookup_r(const char *mimeType, const XdgApp **apps, int count);
+
+/**
+ * Get id (\a ".desktop" file name) of a given \p "app".
+ */
+const char *xdg_app_id(const XdgApp *app);
+
 /**
  * Loads contents of \a "mimeapps.list" file from XDG_DATA_HOME directory
  * (according to Base Directory Layout specification).
@@ -246,6 +309,48 @@ const XdgListItem *xdg_app_localized_entry_lookup(
 		const char *country,
 		const char *modifier);
 
+/**
+ * Resolves the fallback chain of a locale (\a "lang_COUNTRY@MODIFIER",
+ * \a "lang_COUNTRY", \a "lang@MODIFIER", \a "lang") once, so it can be
+ * used by xdg_app_localized_entry_lookup_l() for any number of lookups.
+ *
+ * @param lang language, if it is \c NULL only default values are found.
+ * @param country country or \c NULL.
+ * @param modifier modifier or \c NULL.
+ * @return a new XdgAppLocale, it should be freed by xdg_app_locale_free(),
+ * or \c NULL if there is not enough memory.
+ */
+XdgAppLocale *xdg_app_locale_new(const char *lang, const char *country, const char *modifier);
+
+/**
+ * Frees a locale created by xdg_app_locale_new().
+ */
+void xdg_app_locale_free(XdgAppLocale *locale);
+
+/**
+ * Same as xdg_app_localized_entry_lookup() but for a \p "locale"
+ * created by xdg_app_locale_new().
+ *
+ * @note
+ * If caches were built for an equal locale (see xdg_app_set_cache_locale())
+ * the value is read right from the entry without any search.
+ */
+const XdgListItem *xdg_app_localized_entry_lookup_l(
+		const XdgAppGroup *group,
+		const char *entry,
+		const XdgAppLocale *locale);
+
+/**
+ * Sets the locale for which localized values are resolved while
+ * caches of folders are built, \c NULL (default) disables it.
+ *
+ * @note
+ * The locale is copied, it affects folders which are read after
+ * the call, that is all of them if it is called before the
+ * initialization, and xdg_app_rebuild_cache_file().
+ */
+void xdg_app_set_cache_locale(const XdgAppLocale *locale);
+
 /**
  * Get XdgApp item from a given \p list item.
  *
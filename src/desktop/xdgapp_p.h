@@ -33,6 +33,7 @@
 #include <xdg/config.h>
 
 #include <time.h>
+#include <sys/types.h>
 #include "xdgapp.h"
 
 #include "../mime/xdgmimeint.h"
@@ -47,18 +48,21 @@ struct XdgFileWatcher
 {
 	XdgListItem item;
 	time_t mtime;
+	off_t size;
+	ino_t ino;
 	char path[1];
 };
 typedef struct XdgFileWatcher XdgFileWatcher;
 
 
 /**
- * A list of XdgAppGroupEntry values.
+ * A list of XdgAppGroupEntry values, \a value points
+ * into the string arena of the folder being read.
  */
 struct XdgValue
 {
 	XdgListItem item;
-	char value[1];
+	const char *value;
 };
 typedef struct XdgValue XdgValue;
 
@@ -118,13 +122,14 @@ struct XdgApp
 
 
 /**
- * A list (XdgJointList) of pointers to XdgApp.
+ * A list (XdgJointList) of pointers to XdgApp, \a name
+ * is the interned id of the application.
  */
 struct XdgMimeSubTypeValue
 {
 	XdgJointListItem item;
 	XdgApp *app;
-	char name[1];
+	const char *name;
 };
 typedef struct XdgMimeSubTypeValue XdgMimeSubTypeValue;
 
@@ -146,6 +151,17 @@ struct XdgMimeType
 };
 typedef struct XdgMimeType XdgMimeType;
 
+/**
+ * Fallback chain of a locale, \a names go from the most specific
+ * one (\a "lang_COUNTRY@MODIFIER") to the least specific one
+ * (\a "lang"), so every name starts with the last one.
+ */
+struct XdgAppLocale
+{
+	int count;
+	const char *names[4];
+};
+
 
 /**
  * Initialization.
@@ -163,6 +179,9 @@ void _xdg_app_shutdown();
  */
 XdgMimeSubType *_xdg_mime_sub_type_add(AvlTree *map, const char *mime);
 
+/**
+ * \a name has to be interned.
+ */
 void _xdg_list_app_item_append(XdgList *list, const char *name, XdgApp *app);
 void _xdg_list_app_item_prepend(XdgList *list, const char *name, XdgApp *app);
 
@@ -29,20 +29,54 @@
 #include "xdgmimedefs.h"
 #include <errno.h>
 #include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 
 
-void _xdg_app_cache_new_empty(XdgAppCahceFile *cache, const char *file_name)
+/**
+ * Builds the cache in memory. Everything is addressed by offsets
+ * because the buffer moves while it grows.
+ */
+struct XdgAppCacheWriter
 {
-	cache->error = 0;
-	cache->fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-	cache->memory = MAP_FAILED;
-	cache->size = 0;
+	char *memory;
+	size_t size;
+	size_t allocated;
+	/**
+	 * Keys are interned, so every key is written only once,
+	 * this tree maps them to their offsets.
+	 */
+	AvlTree strings;
+	XdgArena arena;
+	/**
+	 * Values of entries are pre-resolved for this locale
+	 * (if not \c NULL), \a locale_name is its most specific name.
+	 */
+	const XdgAppLocale *locale;
+	size_t locale_name;
+};
+typedef struct XdgAppCacheWriter XdgAppCacheWriter;
+
+typedef size_t (*WriteCacheValue)(XdgAppCacheWriter *writer, size_t key, const void *value, void *user_data);
+typedef void (*WriteCacheItem)(XdgAppCacheWriter *writer, size_t item, const AvlNode *node, void *user_data);
+
+
+/**
+ * Just for passing arguments into write_map_item().
+ */
+struct WriteMapArgs
+{
+	WriteCacheValue write_value;
+	void *user_data;
+};
+typedef struct WriteMapArgs WriteMapArgs;
 
-	if (cache->fd == -1)
-		cache->error = errno;
-}
 
 void _xdg_app_cache_new(XdgAppCahceFile *cache, const char *file_name)
 {
@@ -57,21 +91,21 @@ void _xdg_app_cache_new(XdgAppCahceFile *cache, const char *file_name)
 
 		if (fstat(cache->fd, &st) == 0)
 		{
+			/* Nothing is written to the cache, so every process
+			 * shares the same pages of the page cache. */
 			cache->size = st.st_size;
-			cache->memory = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, cache->fd, 0);
+			cache->memory = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, cache->fd, 0);
 
 			if (cache->memory == MAP_FAILED)
 				cache->error = errno;
 			else
-			{
-				madvise(cache->memory, cache->size, POSIX_MADV_SEQUENTIAL);
 				return;
-			}
 		}
 		else
 			cache->error = errno;
 
 		close(cache->fd);
+		cache->fd = -1;
 	}
 	else
 		cache->error = errno;
@@ -87,281 +121,517 @@ void _xdg_app_cache_close(XdgAppCahceFile *cache)
 		close(cache->fd);
 		cache->fd = -1;
 	}
-}
+	else
+		if (cache->memory != MAP_FAILED)
+			free(cache->memory);
 
-void write_version(int fd, xdg_uint32_t version)
-{
-	write(fd, &version, sizeof(xdg_uint32_t));
+	cache->memory = MAP_FAILED;
+	cache->size = 0;
 }
 
-xdg_uint32_t read_version(void **memory)
+int _xdg_app_cache_create(XdgAppCacheTemp *temp, const char *file_name)
 {
-	xdg_uint32_t version = (*(xdg_uint32_t *)(*memory));
+	/* Other processes may have the cache mapped, so it is never
+	 * rewritten in place but replaced at once. */
+	temp->name = malloc(strlen(file_name) + 8);
+	sprintf(temp->name, "%s.XXXXXX", file_name);
 
-	(*memory) += sizeof(xdg_uint32_t);
+	if ((temp->fd = mkstemp(temp->name)) < 0)
+	{
+		free(temp->name);
+		temp->name = NULL;
+		return errno;
+	}
 
-	return version;
+	return 0;
 }
 
-void write_app_key(int fd, const char *key)
+/**
+ * The rename of the temporary file changes the time stamp of
+ * \a directory again, so the one saved in its watcher is updated
+ * in place once the file is in the final position.
+ */
+static int _xdg_app_cache_save_directory_time_stamp(const XdgAppCahceFile *cache, int fd, const char *directory)
 {
-	write(fd, key, strlen(key) + 1);
+	struct stat st;
+	xdg_uint32_t i;
+	const XdgAppCacheHeader *header;
+	const XdgAppCacheFiles *files;
+
+	if ((header = _xdg_app_cache_header(cache)) == NULL ||
+		(files = XDG_APP_CACHE_PTR(const XdgAppCacheFiles *, header->files)) == NULL)
+		return 0;
+
+	for (i = 0; i < files->count; ++i)
+		if (strcmp(XDG_APP_CACHE_STRING(files->files[i].path), directory) == 0)
+		{
+			if (stat(directory, &st) != 0)
+				return errno;
+
+			if (st.st_mtime != files->files[i].mtime &&
+				pwrite(fd, &st.st_mtime, sizeof(time_t),
+					   (const char *)&files->files[i].mtime - (const char *)cache->memory) != (ssize_t)sizeof(time_t))
+				return errno ? errno : EIO;
+
+			break;
+		}
+
+	return 0;
 }
 
-char *read_app_key(void **memory)
+int _xdg_app_cache_save(const XdgAppCahceFile *cache, XdgAppCacheTemp *temp, const char *file_name, const char *directory)
 {
-	char *res = (*memory);
+	size_t written = 0;
+	ssize_t n = 0;
+	int res = 0;
+
+	while (written < cache->size &&
+		   (n = write(temp->fd, (char *)cache->memory + written, cache->size - written)) > 0)
+		written += n;
+
+	if (n < 0)
+		res = errno;
+
+	if (fchmod(temp->fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) != 0 && res == 0)
+		res = errno;
+
+	if (res == 0)
+		if (rename(temp->name, file_name) == 0)
+			res = _xdg_app_cache_save_directory_time_stamp(cache, temp->fd, directory);
+		else
+		{
+			res = errno;
+			unlink(temp->name);
+		}
+	else
+		unlink(temp->name);
+
+	if (close(temp->fd) != 0 && res == 0)
+		res = errno;
 
-	(*memory) += strlen(res) + 1;
+	free(temp->name);
+	temp->name = NULL;
+	temp->fd = -1;
 
 	return res;
 }
 
-static void write_app_group_localized_entry(int fd, const XdgList *value)
+const XdgAppCacheHeader *_xdg_app_cache_header(const XdgAppCahceFile *cache)
 {
-    write(fd, value, sizeof(XdgList));
+	const XdgAppCacheHeader *header = cache->memory;
 
-    XdgValue *item = (XdgValue *)value->head;
+	if (cache->memory == MAP_FAILED ||
+		cache->size < sizeof(XdgAppCacheHeader) ||
+		header->version != XDG_APP_CACHE_VERSION ||
+		header->size != cache->size)
+		return NULL;
 
-    while (item)
-    {
-        write(fd, item, sizeof(XdgValue) + strlen(item->value));
-        item = (XdgValue *)item->item.next;
-    }
+	return header;
 }
 
-static void write_app_group_entry(int fd, const XdgAppGroupEntry *value)
+/**
+ * Every item of \a items starts with the offset of its key.
+ */
+static const void *search_items(const char *items, xdg_uint32_t count, size_t size, const char *key)
 {
-	write(fd, value, sizeof(XdgAppGroupEntry));
+	int res;
+	const char *item;
+	xdg_uint32_t first = 0;
 
-    XdgValue *item = (XdgValue *)value->values.head;
+	while (first < count)
+	{
+		item = items + ((first + count) / 2) * size;
 
-    while (item)
-    {
-        write(fd, item, sizeof(XdgValue) + strlen(item->value));
-        item = (XdgValue *)item->item.next;
-    }
+		if ((res = strcmp(XDG_APP_CACHE_STRING(*(const int *)item), key)) == 0)
+			return item;
+		else
+			if (res < 0)
+				first = (first + count) / 2 + 1;
+			else
+				count = (first + count) / 2;
+	}
 
-	write_to_file(fd, &value->localized, write_app_key, (WriteValue)write_app_group_localized_entry, NULL);
+	return NULL;
 }
 
-static void write_app_group(int fd, const XdgAppGroup *value)
+const void *_xdg_app_cache_search(const XdgAppCacheMap *map, const char *key)
 {
-	write_to_file(fd, &value->entries, write_app_key, (WriteValue)write_app_group_entry, NULL);
+	const XdgAppCacheItem *item = search_items(XDG_APP_CACHE_PTR(const char *, map->items), map->count, sizeof(XdgAppCacheItem), key);
+
+	if (item)
+		return XDG_APP_CACHE_PTR(const void *, item->value);
+	else
+		return NULL;
 }
 
-void write_app(int fd, const XdgApp *value)
+const XdgAppCacheEntry *_xdg_app_cache_entry_search(const XdgAppCacheGroup *group, const char *key)
 {
-	if (value->groups && value->groups->owner == value)
+	return search_items((const char *)group->entries, group->count, sizeof(XdgAppCacheEntry), key);
+}
+
+/**
+ * Every name of the chain starts with the language, so one bisection
+ * finds the range of locales to look at, it is only a few items long.
+ */
+const XdgListItem *_xdg_app_cache_locale_search(const XdgAppCacheMap *localized, const XdgAppLocale *locale)
+{
+	int i;
+	int best;
+	size_t len;
+	const char *lang;
+	const char *key;
+	const XdgAppCacheItem *res = NULL;
+	const XdgAppCacheItem *items = XDG_APP_CACHE_PTR(const XdgAppCacheItem *, localized->items);
+	xdg_uint32_t first = 0;
+	xdg_uint32_t count = localized->count;
+
+	if (locale->count == 0)
+		return NULL;
+
+	lang = locale->names[locale->count - 1];
+	len = strlen(lang);
+
+	while (first < count)
+		if (strcmp(XDG_APP_CACHE_STRING(items[(first + count) / 2].key), lang) < 0)
+			first = (first + count) / 2 + 1;
+		else
+			count = (first + count) / 2;
+
+	for (best = locale->count; best && first < localized->count; ++first)
 	{
-		write(fd, value, sizeof(XdgApp));
-		write(fd, value->groups, sizeof(XdgAppGroups));
-		write_to_file(fd, &value->groups->tree, write_app_key, (WriteValue)write_app_group, NULL);
+		key = XDG_APP_CACHE_STRING(items[first].key);
+
+		if (strncmp(key, lang, len) != 0)
+			break;
+
+		/* Empty values give way to less specific locales */
+		if (items[first].value == 0)
+			continue;
+
+		for (i = 0; i < best; ++i)
+			if (strcmp(key, locale->names[i]) == 0)
+			{
+				res = &items[first];
+				best = i;
+				break;
+			}
 	}
+
+	if (res)
+		return XDG_APP_CACHE_PTR(const XdgListItem *, res->value);
+	else
+		return NULL;
+}
+
+const XdgApp *_xdg_app_cache_value_app(const XdgMimeSubTypeValue *value)
+{
+	if (value->item.item.list)
+		return value->app;
+	else
+		return (const XdgApp *)((const char *)&value->app + (intptr_t)value->app);
+}
+
+const char *_xdg_app_cache_value_name(const XdgMimeSubTypeValue *value)
+{
+	if (value->item.item.list)
+		return value->name;
 	else
+		return (const char *)&value->name + (intptr_t)value->name;
+}
+
+
+/**
+ * Serialization
+ */
+static size_t writer_alloc(XdgAppCacheWriter *writer, size_t size, size_t align)
+{
+	size_t res = (writer->size + align - 1) & ~(align - 1);
+
+	if (res + size > writer->allocated)
 	{
-		XdgApp empty;
-		memset(&empty, 0, sizeof(XdgApp));
-		write(fd, &empty, sizeof(XdgApp));
+		while (res + size > writer->allocated)
+			writer->allocated = writer->allocated ? writer->allocated * 2 : 64 * 1024;
+
+		writer->memory = realloc(writer->memory, writer->allocated);
 	}
+
+	memset(writer->memory + writer->size, 0, res + size - writer->size);
+	writer->size = res + size;
+
+	return res;
 }
 
-static void *read_app_group_localized_entry(void **memory)
+static void writer_link(XdgAppCacheWriter *writer, size_t field, size_t target)
 {
-    XdgList *list = (*memory);
-    (*memory) += sizeof(XdgList);
+	if (target)
+		(*(int *)(writer->memory + field)) = (int)((ptrdiff_t)target - (ptrdiff_t)field);
+}
 
-    if (list->head)
-    {
-        XdgValue *tmp;
-        XdgValue *prev = (*memory);
+static size_t writer_string(XdgAppCacheWriter *writer, const char *value)
+{
+	size_t len = strlen(value) + 1;
+	size_t res = writer_alloc(writer, len, 1);
 
-        list->head = (XdgListItem *)prev;
-        prev->item.list = list;
-        (*memory) += sizeof(XdgValue) + strlen(prev->value);
+	memcpy(writer->memory + res, value, len);
 
-        while (prev->item.next)
-        {
-            tmp = (*memory);
-            prev->item.next = (XdgListItem *)tmp;
-            tmp->item.prev = (XdgListItem *)prev;
-            tmp->item.list = list;
-            prev = tmp;
-            (*memory) += sizeof(XdgValue) + strlen(prev->value);
-        }
+	return res;
+}
 
-        list->tail = (XdgListItem *)prev;
-    }
+static char *pool_key(const char *key)
+{
+	return (char *)key;
+}
 
-    return list;
+static int pool_compare(const char *key1, const char *key2)
+{
+	return (key1 > key2) - (key1 < key2);
 }
 
-static void *read_app_group_entry(void **memory)
+static size_t writer_pool_string(XdgAppCacheWriter *writer, const char *value)
 {
-	XdgAppGroupEntry *res = (*memory);
-	(*memory) += sizeof(XdgAppGroupEntry);
+	size_t *res = (size_t *)search_or_create_node(&writer->strings, value);
 
-    if (res->values.head)
-    {
-        XdgValue *tmp;
-        XdgValue *prev = (*memory);
+	if ((*res) == 0)
+		(*res) = writer_string(writer, value);
 
-        res->values.head = (XdgListItem *)prev;
-        prev->item.list = &res->values;
-        (*memory) += sizeof(XdgValue) + strlen(prev->value);
+	return (*res);
+}
 
-        while (prev->item.next)
-        {
-            tmp = (*memory);
-            prev->item.next = (XdgListItem *)tmp;
-            tmp->item.prev = (XdgListItem *)prev;
-            tmp->item.list = &res->values;
-            prev = tmp;
-            (*memory) += sizeof(XdgValue) + strlen(prev->value);
-        }
+static xdg_uint32_t count_nodes(const AvlNode *node)
+{
+	if (node)
+		return count_nodes(node->links.left) + 1 + count_nodes(node->links.right);
+	else
+		return 0;
+}
 
-        res->values.tail = (XdgListItem *)prev;
-    }
+/**
+ * Writes nodes in order, so items end up sorted the same way
+ * as keys of the tree (trees of desktop data are sorted by strcmp).
+ */
+static void write_items(XdgAppCacheWriter *writer, size_t *item, size_t size, const AvlNode *node, WriteCacheItem write_item, void *user_data)
+{
+	if (node)
+	{
+		write_items(writer, item, size, node->links.left, write_item, user_data);
+		write_item(writer, *item, node, user_data);
+		(*item) += size;
+		write_items(writer, item, size, node->links.right, write_item, user_data);
+	}
+}
 
-	memcpy(&res->localized, map_from_memory(memory, (ReadKey)read_app_key, (ReadValue)read_app_group_localized_entry, strcmp, NULL), sizeof(AvlTree));
+static void write_map_item(XdgAppCacheWriter *writer, size_t item, const AvlNode *node, WriteMapArgs *args)
+{
+	size_t key = writer_pool_string(writer, node->key);
 
-	return res;
+	writer_link(writer, item + offsetof(XdgAppCacheItem, key), key);
+	writer_link(writer, item + offsetof(XdgAppCacheItem, value), args->write_value(writer, key, node->value, args->user_data));
 }
 
-static void *read_app_group(void **memory)
+static void write_map(XdgAppCacheWriter *writer, size_t map, const AvlTree *value, WriteCacheValue write_value, void *user_data)
 {
-	XdgAppGroup *value = (*memory);
+	WriteMapArgs args = { write_value, user_data };
+	xdg_uint32_t count = count_nodes(value->tree_root);
+	size_t items;
+
+	if (count)
+	{
+		items = writer_alloc(writer, count * sizeof(XdgAppCacheItem), sizeof(int));
+
+		((XdgAppCacheMap *)(writer->memory + map))->count = count;
+		writer_link(writer, map + offsetof(XdgAppCacheMap, items), items);
 
-	map_from_memory(memory, (ReadKey)read_app_key, (ReadValue)read_app_group_entry, strcmp, NULL);
+		write_items(writer, &items, sizeof(XdgAppCacheItem), value->tree_root, (WriteCacheItem)write_map_item, &args);
+	}
+}
 
-	return value;
+static void write_list_item_next(XdgAppCacheWriter *writer, size_t item, size_t next)
+{
+	((XdgListItem *)(writer->memory + item))->next = (XdgListItem *)(intptr_t)((ptrdiff_t)next - (ptrdiff_t)item);
 }
 
-void *read_app(void **memory)
+static size_t write_values(XdgAppCacheWriter *writer, size_t key, const XdgList *value, void *user_data)
 {
-	XdgApp *value = (*memory);
-	(*memory) += sizeof(XdgApp);
+	size_t res = 0;
+	size_t prev = 0;
+	size_t item;
+	XdgValue *value_item = (XdgValue *)value->head;
 
-	if (value->groups)
+	while (value_item)
 	{
-		value->groups = (*memory);
-		(*memory) += sizeof(XdgAppGroups);
+		item = writer_alloc(writer, sizeof(XdgAppCacheValue) + strlen(value_item->value), sizeof(void *));
+		strcpy(((XdgAppCacheValue *)(writer->memory + item))->value, value_item->value);
 
-		value->groups->owner = value;
-		memcpy(&value->groups->tree, map_from_memory(memory, (ReadKey)read_app_key, (ReadValue)read_app_group, strcmp, NULL), sizeof(AvlTree));
+		if (prev)
+			write_list_item_next(writer, prev, item);
+		else
+			res = item;
+
+		prev = item;
+		value_item = (XdgValue *)value_item->item.next;
 	}
 
-	return value;
+	return res;
 }
 
-static void write_mime_group_sub_type(int fd, const XdgMimeSubType *value)
+static void write_app_group_entry(XdgAppCacheWriter *writer, size_t item, const AvlNode *node, void *user_data)
 {
-	write(fd, value, sizeof(XdgMimeSubType));
+	const XdgAppGroupEntry *value = node->value;
+	size_t key = writer_pool_string(writer, node->key);
+	size_t values = write_values(writer, key, &value->values, NULL);
+	size_t localized = item + offsetof(XdgAppCacheEntry, localized);
+	const char *res;
 
-    XdgMimeSubTypeValue *item = (XdgMimeSubTypeValue *)value->apps.list.head;
+	writer_link(writer, item + offsetof(XdgAppCacheEntry, key), key);
+	writer_link(writer, item + offsetof(XdgAppCacheEntry, values), values);
+	write_map(writer, localized, &value->localized, (WriteCacheValue)write_values, NULL);
+
+	if (writer->locale)
+	{
+		if (res = (const char *)_xdg_app_cache_locale_search((const XdgAppCacheMap *)(writer->memory + localized), writer->locale))
+			values = res - writer->memory;
 
-    while (item)
-    {
-        write(fd, item, sizeof(XdgMimeSubTypeValue) + strlen(item->name));
-        item = (XdgMimeSubTypeValue *)item->item.item.next;
-    }
+		writer_link(writer, item + offsetof(XdgAppCacheEntry, preferred), values);
+	}
 }
 
-void write_mime_group_type(int fd, const XdgMimeType *value)
+static size_t write_app_group(XdgAppCacheWriter *writer, size_t key, const XdgAppGroup *value, void *user_data)
 {
-	write_to_file(fd, &value->sub_types, write_app_key, (WriteValue)write_mime_group_sub_type, NULL);
+	xdg_uint32_t count = count_nodes(value->entries.tree_root);
+	size_t res = writer_alloc(writer,
+							  sizeof(XdgAppCacheGroup) + (count ? count - 1 : 0) * sizeof(XdgAppCacheEntry),
+							  sizeof(int));
+	size_t item = res + offsetof(XdgAppCacheGroup, entries);
+
+	((XdgAppCacheGroup *)(writer->memory + res))->count = count;
+	writer_link(writer, res + offsetof(XdgAppCacheGroup, locale), writer->locale_name);
+	write_items(writer, &item, sizeof(XdgAppCacheEntry), value->entries.tree_root, write_app_group_entry, NULL);
+
+	return res;
 }
 
-static void *read_mime_group_sub_type(void **memory, const AvlTree *app_files_map)
+static size_t write_app(XdgAppCacheWriter *writer, size_t key, const XdgApp *value, void *user_data)
 {
-    XdgApp **app;
-	XdgMimeSubType *res = (*memory);
-	(*memory) += sizeof(XdgMimeSubType);
+	size_t res = writer_alloc(writer, sizeof(XdgAppCacheApp), sizeof(int));
 
-    if (res->apps.list.head)
-    {
-        XdgMimeSubTypeValue *tmp;
-        XdgMimeSubTypeValue *prev = (*memory);
+	writer_link(writer, res + offsetof(XdgAppCacheApp, name), key);
 
-        res->apps.list.head = (XdgListItem *)prev;
-        prev->item.item.list = &res->apps.list;
-        (*memory) += sizeof(XdgMimeSubTypeValue) + strlen(prev->name);
-
-        if (app = (XdgApp **)search_node(app_files_map, prev->name))
-            prev->app = (*app);
-        else
-            prev->app = NULL;
+	if (value->groups && value->groups->owner == value)
+	{
+		size_t groups = writer_alloc(writer, sizeof(XdgAppCacheMap), sizeof(int));
 
-        while (prev->item.item.next)
-        {
-            tmp = (*memory);
-            prev->item.item.next = (XdgListItem *)tmp;
-            tmp->item.item.prev = (XdgListItem *)prev;
-            tmp->item.item.list = &res->apps.list;
+		write_map(writer, groups, &value->groups->tree, (WriteCacheValue)write_app_group, NULL);
+		writer_link(writer, res + offsetof(XdgAppCacheApp, groups), groups);
+	}
 
-            if (app = (XdgApp **)search_node(app_files_map, tmp->name))
-                tmp->app = (*app);
-            else
-                tmp->app = NULL;
+	return res;
+}
 
-            prev = tmp;
-            (*memory) += sizeof(XdgMimeSubTypeValue) + strlen(prev->name);
-        }
+static size_t write_mime_group_sub_type(XdgAppCacheWriter *writer, size_t key, const XdgMimeSubType *value, size_t *app_files_map)
+{
+	size_t res = 0;
+	size_t prev = 0;
+	size_t item;
+	size_t app;
+	size_t name;
+	XdgMimeSubTypeValue *value_item = (XdgMimeSubTypeValue *)value->apps.list.head;
+
+	while (value_item)
+	{
+		item = writer_alloc(writer, sizeof(XdgMimeSubTypeValue), sizeof(void *));
+		name = writer_pool_string(writer, value_item->name);
+		((XdgMimeSubTypeValue *)(writer->memory + item))->name =
+				(const char *)(intptr_t)((ptrdiff_t)name - (ptrdiff_t)(item + offsetof(XdgMimeSubTypeValue, name)));
+
+		/* Every application of the lists is in the map of the same folder */
+		app = (const char *)_xdg_app_cache_search((const XdgAppCacheMap *)(writer->memory + (*app_files_map)), value_item->name) - writer->memory;
+		((XdgMimeSubTypeValue *)(writer->memory + item))->app =
+				(XdgApp *)(intptr_t)((ptrdiff_t)app - (ptrdiff_t)(item + offsetof(XdgMimeSubTypeValue, app)));
+
+		if (prev)
+			write_list_item_next(writer, prev, item);
+		else
+			res = item;
 
-        res->apps.list.tail = (XdgListItem *)prev;
-    }
+		prev = item;
+		value_item = (XdgMimeSubTypeValue *)value_item->item.item.next;
+	}
 
 	return res;
 }
 
-void *read_mime_group_type(void **memory, const AvlTree *app_files_map)
+static size_t write_mime_group_type(XdgAppCacheWriter *writer, size_t key, const XdgMimeType *value, size_t *app_files_map)
 {
-	XdgMimeType *value = (*memory);
+	size_t res = writer_alloc(writer, sizeof(XdgAppCacheMap), sizeof(int));
 
-	map_from_memory(memory, (ReadKey)read_app_key, (ReadValue)read_mime_group_sub_type, strcmp, (void *)app_files_map);
+	write_map(writer, res, &value->sub_types, (WriteCacheValue)write_mime_group_sub_type, app_files_map);
 
-	return value;
+	return res;
 }
 
-void write_file_watcher_list(int fd, const XdgList *list)
+static size_t write_file_watcher_list(XdgAppCacheWriter *writer, const XdgList *list)
 {
-    write(fd, list, sizeof(XdgList));
+	size_t res;
+	xdg_uint32_t count = 0;
+	XdgFileWatcher *file;
+
+	for (file = (XdgFileWatcher *)list->head; file; file = (XdgFileWatcher *)file->item.next)
+		++count;
 
-    XdgFileWatcher *file = (XdgFileWatcher *)list->head;
+	res = writer_alloc(writer,
+					   sizeof(XdgAppCacheFiles) + (count ? count - 1 : 0) * sizeof(XdgAppCacheFileWatcher),
+					   sizeof(time_t));
+	((XdgAppCacheFiles *)(writer->memory + res))->count = count;
+
+	for (count = 0, file = (XdgFileWatcher *)list->head; file; file = (XdgFileWatcher *)file->item.next, ++count)
+	{
+		size_t watcher = res + offsetof(XdgAppCacheFiles, files) + count * sizeof(XdgAppCacheFileWatcher);
+
+		((XdgAppCacheFileWatcher *)(writer->memory + watcher))->mtime = file->mtime;
+		((XdgAppCacheFileWatcher *)(writer->memory + watcher))->size = file->size;
+		((XdgAppCacheFileWatcher *)(writer->memory + watcher))->ino = file->ino;
+		writer_link(writer, watcher + offsetof(XdgAppCacheFileWatcher, path), writer_string(writer, file->path));
+	}
 
-    while (file)
-    {
-        write(fd, file, sizeof(XdgFileWatcher) + strlen(file->path));
-        file = (XdgFileWatcher *)file->item.next;
-    }
+	return res;
 }
 
-const XdgList *read_file_watcher_list(void **memory)
+void _xdg_app_cache_new_from_data(XdgAppCahceFile *cache,
+		const XdgList *files,
+		const AvlTree *app_files_map,
+		const AvlTree *asoc_map,
+		const AvlTree *lst_files_map,
+		const XdgAppLocale *locale)
 {
-    XdgList *list = (*memory);
-	(*memory) += sizeof(XdgList);
+	XdgAppCacheWriter writer;
+	size_t header;
+	size_t apps;
+
+	memset(&writer, 0, sizeof(XdgAppCacheWriter));
+	header = writer_alloc(&writer, sizeof(XdgAppCacheHeader), sizeof(time_t));
+	apps = header + offsetof(XdgAppCacheHeader, app_files_map);
 
-	if (list->head)
+	_xdg_arena_init(&writer.arena);
+	init_avl_tree_in_arena(&writer.strings, &writer.arena, pool_key, pool_compare);
+
+	if (locale && locale->count)
 	{
-	    XdgFileWatcher *tmp;
-		XdgFileWatcher *prev = (*memory);
+		writer.locale = locale;
+		writer.locale_name = writer_string(&writer, locale->names[0]);
+	}
 
-		list->head = (XdgListItem *)prev;
-		prev->item.list = list;
-        (*memory) += sizeof(XdgFileWatcher) + strlen(prev->path);
+	writer_link(&writer, header + offsetof(XdgAppCacheHeader, files), write_file_watcher_list(&writer, files));
+	write_map(&writer, apps, app_files_map, (WriteCacheValue)write_app, NULL);
+	write_map(&writer, header + offsetof(XdgAppCacheHeader, asoc_map), asoc_map, (WriteCacheValue)write_mime_group_type, &apps);
+	write_map(&writer, header + offsetof(XdgAppCacheHeader, lst_files_map), lst_files_map, (WriteCacheValue)write_mime_group_type, &apps);
 
-		while (prev->item.next)
-		{
-		    tmp = (*memory);
-		    prev->item.next = (XdgListItem *)tmp;
-		    tmp->item.prev = (XdgListItem *)prev;
-		    tmp->item.list = list;
-		    prev = tmp;
-		    (*memory) += sizeof(XdgFileWatcher) + strlen(prev->path);
-		}
+	((XdgAppCacheHeader *)writer.memory)->version = XDG_APP_CACHE_VERSION;
+	((XdgAppCacheHeader *)writer.memory)->size = writer.size;
 
-		list->tail = (XdgListItem *)prev;
-	}
+	_xdg_arena_free(&writer.arena);
 
-	return list;
+	cache->error = 0;
+	cache->fd = -1;
+	cache->memory = writer.memory;
+	cache->size = writer.size;
 }
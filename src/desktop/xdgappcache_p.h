@@ -25,6 +25,7 @@
  * Boston, MA 02111-1307, USA.
  */
 
+
 #ifndef XDGAPPCACHE_P_H_
 #define XDGAPPCACHE_P_H_
 
@@ -37,6 +38,27 @@
 #include "xdgapp_p.h"
 
 
+/**
+ * Version of \a "applications.cache" layout.
+ *
+ * @n All references inside of the cache are offsets relative to the
+ * field which holds them (0 stands for \c NULL), so the cache is used
+ * right from the read-only shared mapping without any relocation.
+ */
+#define XDG_APP_CACHE_VERSION 6
+
+/**
+ * Resolves the self-relative offset stored in \p field.
+ */
+#define XDG_APP_CACHE_PTR(type, field) \
+	((field) ? (type)((const char *)&(field) + (field)) : (type)NULL)
+
+/**
+ * Resolves the self-relative offset of a string, it is never 0.
+ */
+#define XDG_APP_CACHE_STRING(field) ((const char *)&(field) + (field))
+
+
 struct XdgAppCahceFile
 {
 	int error;
@@ -46,31 +68,153 @@ struct XdgAppCahceFile
 };
 typedef struct XdgAppCahceFile XdgAppCahceFile;
 
+/**
+ * A temporary file the cache is written into before it
+ * replaces \a "applications.cache".
+ */
+struct XdgAppCacheTemp
+{
+	int fd;
+	char *name;
+};
+typedef struct XdgAppCacheTemp XdgAppCacheTemp;
+
 
 /**
- * Initialization of cache file
+ * An item of XdgAppCacheMap.
  */
-void _xdg_app_cache_new_empty(XdgAppCahceFile *cache, const char *file_name);
-void _xdg_app_cache_new(XdgAppCahceFile *cache, const char *file_name);
-void _xdg_app_cache_close(XdgAppCahceFile *cache);
+struct XdgAppCacheItem
+{
+	int key;
+	int value;
+};
+typedef struct XdgAppCacheItem XdgAppCacheItem;
+
+/**
+ * A map, \a items points to an array of \a count items sorted
+ * by keys, it is searched by bisection.
+ *
+ * @n Used for applications, groups of XdgAppCacheApp, locales
+ * of XdgAppCacheEntry and (sub) types of mime types.
+ */
+struct XdgAppCacheMap
+{
+	xdg_uint32_t count;
+	int items;
+};
+typedef struct XdgAppCacheMap XdgAppCacheMap;
+
+/**
+ * The header of the cache.
+ */
+struct XdgAppCacheHeader
+{
+	xdg_uint32_t version;
+	xdg_uint32_t size;
+	int files;
+	XdgAppCacheMap app_files_map;
+	XdgAppCacheMap asoc_map;
+	XdgAppCacheMap lst_files_map;
+};
+typedef struct XdgAppCacheHeader XdgAppCacheHeader;
 
+/**
+ * A \a ".desktop" file, \a groups points to XdgAppCacheMap of
+ * XdgAppCacheGroup, it is 0 if the application is only mentioned
+ * in \a ".list" files of the folder.
+ *
+ * @n Values of \a "applications" map, pointers to these structures
+ * are handed out as XdgApp.
+ */
+struct XdgAppCacheApp
+{
+	int name;
+	int groups;
+};
+typedef struct XdgAppCacheApp XdgAppCacheApp;
 
 /**
- * Serialization
+ * A value of an entry, unlike XdgValue the string
+ * is stored right after the list item.
  */
-void write_version(int fd, xdg_uint32_t version);
-xdg_uint32_t read_version(void **memory);
+struct XdgAppCacheValue
+{
+	XdgListItem item;
+	char value[1];
+};
+typedef struct XdgAppCacheValue XdgAppCacheValue;
 
-void write_app_key(int fd, const char *key);
-char *read_app_key(void **memory);
+/**
+ * An entry of a group, \a values points to the head of a relocatable
+ * list of XdgAppCacheValue, \a localized maps locales to such lists.
+ *
+ * @n \a preferred points to the list chosen for the locale of the
+ * group, it is 0 if the cache was built without a locale.
+ */
+struct XdgAppCacheEntry
+{
+	int key;
+	int values;
+	int preferred;
+	XdgAppCacheMap localized;
+};
+typedef struct XdgAppCacheEntry XdgAppCacheEntry;
+
+/**
+ * A group, entries are stored right in it sorted by keys,
+ * pointers to these structures are handed out as XdgAppGroup.
+ *
+ * @n \a locale is the most specific name of the locale for which
+ * \a preferred values of entries were resolved (0 if none).
+ */
+struct XdgAppCacheGroup
+{
+	xdg_uint32_t count;
+	int locale;
+	XdgAppCacheEntry entries[1];
+};
+typedef struct XdgAppCacheGroup XdgAppCacheGroup;
+
+struct XdgAppCacheFileWatcher
+{
+	time_t mtime;
+	off_t size;
+	ino_t ino;
+	int path;
+};
+typedef struct XdgAppCacheFileWatcher XdgAppCacheFileWatcher;
+
+struct XdgAppCacheFiles
+{
+	xdg_uint32_t count;
+	XdgAppCacheFileWatcher files[1];
+};
+typedef struct XdgAppCacheFiles XdgAppCacheFiles;
 
-void write_app(int fd, const XdgApp *value);
-void *read_app(void **memory);
 
-void write_mime_group_type(int fd, const XdgMimeType *value);
-void *read_mime_group_type(void **memory, const AvlTree *app_files_map);
+/**
+ * Initialization of cache file
+ */
+void _xdg_app_cache_new(XdgAppCahceFile *cache, const char *file_name);
+void _xdg_app_cache_new_from_data(XdgAppCahceFile *cache,
+		const XdgList *files,
+		const AvlTree *app_files_map,
+		const AvlTree *asoc_map,
+		const AvlTree *lst_files_map,
+		const XdgAppLocale *locale);
+int _xdg_app_cache_create(XdgAppCacheTemp *temp, const char *file_name);
+int _xdg_app_cache_save(const XdgAppCahceFile *cache, XdgAppCacheTemp *temp, const char *file_name, const char *directory);
+void _xdg_app_cache_close(XdgAppCahceFile *cache);
+
 
-void write_file_watcher_list(int fd, const XdgList *list);
-const XdgList *read_file_watcher_list(void **memory);
+/**
+ * Access to the cache contents
+ */
+const XdgAppCacheHeader *_xdg_app_cache_header(const XdgAppCahceFile *cache);
+const void *_xdg_app_cache_search(const XdgAppCacheMap *map, const char *key);
+const XdgAppCacheEntry *_xdg_app_cache_entry_search(const XdgAppCacheGroup *group, const char *key);
+const XdgListItem *_xdg_app_cache_locale_search(const XdgAppCacheMap *localized, const XdgAppLocale *locale);
+const XdgApp *_xdg_app_cache_value_app(const XdgMimeSubTypeValue *value);
+const char *_xdg_app_cache_value_name(const XdgMimeSubTypeValue *value);
 
 #endif /* XDGAPPCACHE_P_H_ */
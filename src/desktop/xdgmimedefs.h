@@ -36,6 +36,9 @@
 #define MIME_TYPE_NAME_BUFFER_SIZE 256
 #define LOCALE_NAME_BUFFER_SIZE    64
 
+#define READ_DESKTOP_FILES_THREADS_MAX 8
+#define READ_DESKTOP_FILES_PER_THREAD  64
+
 #define REMOVE_WHITE_SPACES_LEFT(line, ptr) \
 	do { *ptr = 0; --ptr; } while(ptr > line && (*ptr) == ' ');
 
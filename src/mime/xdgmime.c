@@ -31,12 +31,19 @@
 #include "xdgmime.h"
 #include "xdgmime_p.h"
 #include "xdgmimeint.h"
+#include "xdgmimectx.h"
 #include "xdgmimeglob.h"
+#include "xdgmimeglobindex.h"
 #include "xdgmimemagic.h"
 #include "xdgmimealias.h"
 #include "xdgmimeicon.h"
 #include "xdgmimeparent.h"
+#include "xdgmimestrpool.h"
+#include "xdgmimexml.h"
+#include "xdgmimetree.h"
+#include "xdgmimepath.h"
 #include "xdgmimecache.h"
+#include "xdgmimesnapshot.h"
 #include "../basedirectory/xdgbasedirectory.h"
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -47,6 +54,9 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include <assert.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 typedef struct XdgDirTimeList XdgDirTimeList;
 typedef struct XdgCallbackList XdgCallbackList;
@@ -61,9 +71,18 @@ static XdgDirTimeList *dir_time_list = NULL;
 static XdgCallbackList *callback_list = NULL;
 static XdgIconList *icon_list = NULL;
 static XdgIconList *generic_icon_list = NULL;
+static XdgGlobIndex *glob_index = NULL;
+static XdgStringPool *string_pool = NULL;
+static XdgTreeMagic *tree_magic = NULL;
+static XdgPathRules *path_rules = NULL;
+static int snapshot_loaded = FALSE;
 
 XdgMimeCache **_caches = NULL;
+XdgXmlNamespaceList *_xml_namespaces = NULL;
 static int n_caches = 0;
+static int cache_load_flags = XDG_MIME_CACHE_LOAD_DEFAULT;
+int _magic_flags = XDG_MIME_MAGIC_DEFAULT;
+unsigned int _xdg_mime_generation = 0;
 
 const char xdg_mime_type_unknown[] = "application/octet-stream";
 const char xdg_mime_type_empty[] = "application/x-zerosize";
@@ -132,24 +151,163 @@ xdg_dir_time_list_free (XdgDirTimeList *list)
     }
 }
 
+/* The text files of one data directory.  Globs, magic and the rest
+ * are loaded into disjoint structures, so they can be parsed at the
+ * same time. */
+typedef struct
+{
+  const char *directory;
+  char *globs;
+  time_t globs_mtime;
+  int globs_version_two;
+  char *magic;
+  time_t magic_mtime;
+} XdgMimeDirectoryFiles;
+
+static void *
+xdg_mime_read_globs (void *data)
+{
+  XdgMimeDirectoryFiles *files = data;
+
+  _xdg_mime_glob_read_from_file (global_hash, files->globs, files->globs_version_two);
+
+  return NULL;
+}
+
+static void *
+xdg_mime_read_magic (void *data)
+{
+  XdgMimeDirectoryFiles *files = data;
+
+  _xdg_mime_magic_read_from_file (global_magic, files->magic);
+
+  return NULL;
+}
+
+/* These lists share string_pool and must be read by the same thread */
+static void *
+xdg_mime_read_lists (void *data)
+{
+  const char *directory = ((XdgMimeDirectoryFiles *) data)->directory;
+  char *file_name;
+
+  file_name = malloc (strlen (directory) + strlen ("/mime/aliases") + 1);
+  strcpy (file_name, directory); strcat (file_name, "/mime/aliases");
+  _xdg_mime_alias_read_from_file (alias_list, file_name);
+  free (file_name);
+
+  file_name = malloc (strlen (directory) + strlen ("/mime/subclasses") + 1);
+  strcpy (file_name, directory); strcat (file_name, "/mime/subclasses");
+  _xdg_mime_parent_read_from_file (parent_list, file_name);
+  free (file_name);
+
+  file_name = malloc (strlen (directory) + strlen ("/mime/XMLnamespaces") + 1);
+  strcpy (file_name, directory); strcat (file_name, "/mime/XMLnamespaces");
+  _xdg_mime_xml_namespace_read_from_file (_xml_namespaces, file_name);
+  free (file_name);
+
+  file_name = malloc (strlen (directory) + strlen ("/mime/icons") + 1);
+  strcpy (file_name, directory); strcat (file_name, "/mime/icons");
+  _xdg_mime_icon_read_from_file (icon_list, file_name);
+  free (file_name);
+
+  file_name = malloc (strlen (directory) + strlen ("/mime/generic-icons") + 1);
+  strcpy (file_name, directory); strcat (file_name, "/mime/generic-icons");
+  _xdg_mime_icon_read_from_file (generic_icon_list, file_name);
+  free (file_name);
+
+  return NULL;
+}
+
+static void
+xdg_mime_read_directory_files (XdgMimeDirectoryFiles *files)
+{
+  void *(*tasks[3]) (void *);
+  int n_tasks = 0;
+  int i;
+#ifdef HAVE_PTHREAD
+  pthread_t threads[2];
+  int started[2];
+#endif
+
+  if (files->globs)
+    tasks[n_tasks++] = xdg_mime_read_globs;
+  if (files->magic)
+    tasks[n_tasks++] = xdg_mime_read_magic;
+  tasks[n_tasks++] = xdg_mime_read_lists;
+
+#ifdef HAVE_PTHREAD
+  /* The last task is run by the calling thread, and so is any task no
+   * thread could be started for.  With a single CPU threads only add
+   * their start up cost. */
+  for (i = 0; i < n_tasks - 1; i++)
+    started[i] = sysconf (_SC_NPROCESSORS_ONLN) > 1 &&
+		 pthread_create (&threads[i], NULL, tasks[i], files) == 0;
+
+  tasks[n_tasks - 1] (files);
+
+  for (i = 0; i < n_tasks - 1; i++)
+    {
+      if (started[i])
+	pthread_join (threads[i], NULL);
+      else
+	tasks[i] (files);
+    }
+#else
+  for (i = 0; i < n_tasks; i++)
+    tasks[i] (files);
+#endif
+}
+
 static int
 xdg_mime_init_from_directory (const char *directory)
 {
+  XdgMimeDirectoryFiles files;
   char *file_name;
   struct stat st;
 
   assert (directory != NULL);
 
+  /* mime.cache has no treemagic section */
+  file_name = malloc (strlen (directory) + strlen ("/mime/treemagic") + 1);
+  strcpy (file_name, directory); strcat (file_name, "/mime/treemagic");
+  if (stat (file_name, &st) == 0)
+    {
+      _xdg_mime_tree_magic_read_from_file (tree_magic, file_name);
+      xdg_dir_time_list_add (file_name, st.st_mtime);
+    }
+  else
+    {
+      free (file_name);
+    }
+
+  /* Neither are the full path rules */
+  file_name = malloc (strlen (directory) + strlen ("/mime/paths") + 1);
+  strcpy (file_name, directory); strcat (file_name, "/mime/paths");
+  if (stat (file_name, &st) == 0)
+    {
+      _xdg_mime_path_rules_read_from_file (path_rules, file_name);
+      xdg_dir_time_list_add (file_name, st.st_mtime);
+    }
+  else
+    {
+      free (file_name);
+    }
+
   file_name = malloc (strlen (directory) + strlen ("/mime/mime.cache") + 1);
   strcpy (file_name, directory); strcat (file_name, "/mime/mime.cache");
   if (stat (file_name, &st) == 0)
     {
-      XdgMimeCache *cache = _xdg_mime_cache_new_from_file (file_name);
+      XdgMimeCache *cache = _xdg_mime_cache_new_from_file (file_name, cache_load_flags);
 
       if (cache != NULL)
 	{
 	  xdg_dir_time_list_add (file_name, st.st_mtime);
 
+	  _xdg_mime_cache_xml_namespace_foreach (cache,
+						 (XdgXmlNamespaceForeachFunc) _xdg_mime_xml_namespace_list_add,
+						 _xml_namespaces);
+
 	  _caches = realloc (_caches, sizeof (XdgMimeCache *) * (n_caches + 2));
 	  _caches[n_caches] = cache;
           _caches[n_caches + 1] = NULL;
@@ -160,12 +318,17 @@ xdg_mime_init_from_directory (const char *directory)
     }
   free (file_name);
 
+  files.directory = directory;
+  files.globs = NULL;
+  files.magic = NULL;
+
   file_name = malloc (strlen (directory) + strlen ("/mime/globs2") + 1);
   strcpy (file_name, directory); strcat (file_name, "/mime/globs2");
   if (stat (file_name, &st) == 0)
     {
-      _xdg_mime_glob_read_from_file (global_hash, file_name, TRUE);
-      xdg_dir_time_list_add (file_name, st.st_mtime);
+      files.globs = file_name;
+      files.globs_mtime = st.st_mtime;
+      files.globs_version_two = TRUE;
     }
   else
     {
@@ -174,8 +337,9 @@ xdg_mime_init_from_directory (const char *directory)
       strcpy (file_name, directory); strcat (file_name, "/mime/globs");
       if (stat (file_name, &st) == 0)
         {
-          _xdg_mime_glob_read_from_file (global_hash, file_name, FALSE);
-          xdg_dir_time_list_add (file_name, st.st_mtime);
+	  files.globs = file_name;
+	  files.globs_mtime = st.st_mtime;
+	  files.globs_version_two = FALSE;
         }
       else
         {
@@ -187,33 +351,22 @@ xdg_mime_init_from_directory (const char *directory)
   strcpy (file_name, directory); strcat (file_name, "/mime/magic");
   if (stat (file_name, &st) == 0)
     {
-      _xdg_mime_magic_read_from_file (global_magic, file_name);
-      xdg_dir_time_list_add (file_name, st.st_mtime);
+      files.magic = file_name;
+      files.magic_mtime = st.st_mtime;
     }
   else
     {
       free (file_name);
     }
 
-  file_name = malloc (strlen (directory) + strlen ("/mime/aliases") + 1);
-  strcpy (file_name, directory); strcat (file_name, "/mime/aliases");
-  _xdg_mime_alias_read_from_file (alias_list, file_name);
-  free (file_name);
+  /* The snapshot already holds what these files define */
+  if (!snapshot_loaded)
+    xdg_mime_read_directory_files (&files);
 
-  file_name = malloc (strlen (directory) + strlen ("/mime/subclasses") + 1);
-  strcpy (file_name, directory); strcat (file_name, "/mime/subclasses");
-  _xdg_mime_parent_read_from_file (parent_list, file_name);
-  free (file_name);
-
-  file_name = malloc (strlen (directory) + strlen ("/mime/icons") + 1);
-  strcpy (file_name, directory); strcat (file_name, "/mime/icons");
-  _xdg_mime_icon_read_from_file (icon_list, file_name);
-  free (file_name);
-
-  file_name = malloc (strlen (directory) + strlen ("/mime/generic-icons") + 1);
-  strcpy (file_name, directory); strcat (file_name, "/mime/generic-icons");
-  _xdg_mime_icon_read_from_file (generic_icon_list, file_name);
-  free (file_name);
+  if (files.globs)
+    xdg_dir_time_list_add (files.globs, files.globs_mtime);
+  if (files.magic)
+    xdg_dir_time_list_add (files.magic, files.magic_mtime);
 
   return FALSE; /* Keep processing */
 }
@@ -268,6 +421,28 @@ xdg_check_dir (const char *directory,
 
   assert (directory != NULL);
 
+  /* Check the treemagic file, it is read next to mime.cache too */
+  file_name = malloc (strlen (directory) + strlen ("/mime/treemagic") + 1);
+  strcpy (file_name, directory); strcat (file_name, "/mime/treemagic");
+  invalid = xdg_check_file (file_name, NULL);
+  free (file_name);
+  if (invalid)
+    {
+      *invalid_dir_list = TRUE;
+      return TRUE;
+    }
+
+  /* And the full path rules */
+  file_name = malloc (strlen (directory) + strlen ("/mime/paths") + 1);
+  strcpy (file_name, directory); strcat (file_name, "/mime/paths");
+  invalid = xdg_check_file (file_name, NULL);
+  free (file_name);
+  if (invalid)
+    {
+      *invalid_dir_list = TRUE;
+      return TRUE;
+    }
+
   /* Check the mime.cache file */
   file_name = malloc (strlen (directory) + strlen ("/mime/mime.cache") + 1);
   strcpy (file_name, directory); strcat (file_name, "/mime/mime.cache");
@@ -357,17 +532,87 @@ xdg_check_time_and_dirs (void)
   return retval;
 }
 
+static void
+xdg_mime_init_from_snapshot (const char *stamp)
+{
+  XdgMimeCache *cache = _xdg_mime_snapshot_load (stamp, cache_load_flags);
+
+  if (cache == NULL)
+    return;
+
+  _xdg_mime_cache_xml_namespace_foreach (cache,
+					 (XdgXmlNamespaceForeachFunc) _xdg_mime_xml_namespace_list_add,
+					 _xml_namespaces);
+
+  _caches = realloc (_caches, sizeof (XdgMimeCache *) * (n_caches + 2));
+  _caches[n_caches] = cache;
+  _caches[n_caches + 1] = NULL;
+  n_caches++;
+
+  snapshot_loaded = TRUE;
+}
+
+/* Other processes map the snapshot instead of parsing the files again */
+static void
+xdg_mime_save_snapshot (const char *stamp)
+{
+  XdgMimeCacheWriter *writer = _xdg_mime_cache_writer_new ();
+
+  _xdg_glob_hash_serialize (global_hash, writer);
+  _xdg_mime_magic_serialize (global_magic, writer);
+  _xdg_mime_alias_list_serialize (alias_list, writer);
+  _xdg_mime_parent_list_serialize (parent_list, writer);
+  _xdg_mime_icon_list_serialize (icon_list, writer, FALSE);
+  _xdg_mime_icon_list_serialize (generic_icon_list, writer, TRUE);
+  _xdg_mime_xml_namespace_list_serialize (_xml_namespaces, writer);
+
+  _xdg_mime_snapshot_save (writer, stamp);
+  _xdg_mime_cache_writer_free (writer);
+}
+
 void
 _xdg_mime_init (void)
 {
+	char *stamp = NULL;
+
+	_xdg_mime_generation++;
+
 	global_hash = _xdg_glob_hash_new ();
 	global_magic = _xdg_mime_magic_new ();
-	alias_list = _xdg_mime_alias_list_new ();
-	parent_list = _xdg_mime_parent_list_new ();
-	icon_list = _xdg_mime_icon_list_new ();
-	generic_icon_list = _xdg_mime_icon_list_new ();
+	string_pool = _xdg_string_pool_new ();
+	alias_list = _xdg_mime_alias_list_new (string_pool);
+	parent_list = _xdg_mime_parent_list_new (string_pool);
+	icon_list = _xdg_mime_icon_list_new (string_pool);
+	generic_icon_list = _xdg_mime_icon_list_new (string_pool);
+	_xml_namespaces = _xdg_mime_xml_namespace_list_new ();
+	tree_magic = _xdg_mime_tree_magic_new ();
+	path_rules = _xdg_mime_path_rules_new ();
+
+	if (cache_load_flags & XDG_MIME_CACHE_LOAD_SNAPSHOT)
+		stamp = _xdg_mime_snapshot_stamp ();
+	if (stamp)
+		xdg_mime_init_from_snapshot (stamp);
 
 	_xdg_for_each_data_dir((XdgDirectoryFunc)xdg_mime_init_from_directory, NULL);
+
+	_xdg_mime_alias_list_build_index (alias_list);
+	_xdg_mime_parent_list_build_index (parent_list);
+	_xdg_mime_icon_list_build_index (icon_list);
+	_xdg_mime_icon_list_build_index (generic_icon_list);
+	_xdg_mime_xml_namespace_list_build_index (_xml_namespaces);
+	_xdg_mime_magic_compile (global_magic);
+	_xdg_mime_tree_magic_compile (tree_magic);
+	_xdg_mime_path_rules_compile (path_rules);
+
+	if (stamp && !snapshot_loaded && !_caches)
+		xdg_mime_save_snapshot (stamp);
+	free (stamp);
+
+	glob_index = _xdg_glob_index_new ();
+	if (_caches)
+		_xdg_mime_cache_glob_foreach ((XdgGlobForeachFunc)_xdg_glob_index_add, glob_index);
+	_xdg_glob_hash_foreach (global_hash, (XdgGlobForeachFunc)_xdg_glob_index_add, glob_index);
+	_xdg_glob_index_build (glob_index);
 }
 
 void
@@ -380,10 +625,11 @@ xdg_mime_refresh (void)
 	}
 }
 
-const char *
-xdg_mime_get_mime_type_for_data (const void *data,
-				 size_t      len,
-				 int        *result_prio)
+static const char *
+mime_get_mime_type_for_data (XdgMimeLookupCtx *ctx,
+			     const void       *data,
+			     size_t            len,
+			     int              *result_prio)
 {
   const char *mime_type;
 
@@ -394,9 +640,12 @@ xdg_mime_get_mime_type_for_data (const void *data,
     }
 
   if (_caches)
-    mime_type = _xdg_mime_cache_get_mime_type_for_data (data, len, result_prio);
+    mime_type = _xdg_mime_cache_get_mime_type_for_data (ctx, data, len, result_prio);
   else
-    mime_type = _xdg_mime_magic_lookup_data (global_magic, data, len, result_prio, NULL, 0);
+    {
+      mime_type = _xdg_mime_magic_lookup_data (global_magic, ctx, data, len, result_prio, NULL, 0);
+      mime_type = _xdg_mime_xml_namespace_refine (data, len, mime_type, result_prio);
+    }
 
   if (mime_type)
     return mime_type;
@@ -405,35 +654,82 @@ xdg_mime_get_mime_type_for_data (const void *data,
 }
 
 const char *
-xdg_mime_get_mime_type_for_file (const char  *file_name,
-                                 struct stat *statbuf)
+xdg_mime_get_mime_type_for_data (const void *data,
+				 size_t      len,
+				 int        *result_prio)
+{
+  return mime_get_mime_type_for_data (NULL, data, len, result_prio);
+}
+
+/* A path rule classifies a whole subtree, so it skips the remaining glob
+ * stages and the contents.  Only literal file names take precedence. */
+static const char *
+mime_lookup_path_rules (XdgMimeLookupCtx *ctx,
+			const char       *file_name,
+			XdgMimeDetection *detection)
 {
   const char *mime_type;
-  /* currently, only a few globs occur twice, and none
-   * more often, so 5 seems plenty.
-   */
-  const char *mime_types[5];
-  FILE *file;
+  const char *directory;
+  const char *base_name;
+  int weight;
+
+  mime_type = _xdg_mime_path_rules_lookup (path_rules, file_name, &weight, &directory);
+  if (mime_type == NULL)
+    return NULL;
+
+  base_name = _xdg_get_base_name (file_name);
+  if (_caches ?
+      _xdg_mime_cache_has_literal (ctx, base_name) :
+      _xdg_glob_hash_has_literal (global_hash, ctx, base_name))
+    return NULL;
+
+  if (detection)
+    {
+      detection->stage = XDG_MIME_STAGE_PATH;
+      detection->directory = directory;
+      detection->n_candidates = 1;
+      detection->candidates[0] = mime_type;
+      detection->weights[0] = weight;
+    }
+
+  return mime_type;
+}
+
+static const char *
+mime_get_mime_type_for_file (XdgMimeLookupCtx *ctx,
+			     const char       *file_name,
+			     struct stat      *statbuf,
+			     XdgMimeDetection *detection)
+{
+  const char *mime_type;
+  const char *magic_type;
   unsigned char *data;
-  int max_extent;
-  int bytes_read;
+  size_t bytes_read;
   struct stat buf;
   const char *base_name;
-  int n;
+  int n, prio;
 
   if (file_name == NULL)
     return NULL;
   if (! _xdg_utf8_validate (file_name))
     return NULL;
 
+  ctx->stats.n_lookups++;
+
+  if (path_rules && (mime_type = mime_lookup_path_rules (ctx, file_name, detection)))
+    {
+      ctx->n_mimes = 0;
+      return mime_type;
+    }
+
   if (_caches)
-    return _xdg_mime_cache_get_mime_type_for_file (file_name, statbuf);
+    return _xdg_mime_cache_get_mime_type_for_file (ctx, file_name, statbuf, detection);
 
   base_name = _xdg_get_base_name (file_name);
-  n = _xdg_glob_hash_lookup_file_name (global_hash, base_name, mime_types, 5);
+  n = _xdg_glob_hash_lookup_file_name (global_hash, ctx, base_name, detection);
 
   if (n == 1)
-    return mime_types[0];
+    return ctx->mime_types[0];
 
   if (!statbuf)
     {
@@ -449,50 +745,106 @@ xdg_mime_get_mime_type_for_file (const char  *file_name,
   /* FIXME: Need to make sure that max_extent isn't totally broken.  This could
    * be large and need getting from a stream instead of just reading it all
    * in. */
-  max_extent = _xdg_mime_magic_get_buffer_extents (global_magic);
-  data = malloc (max_extent);
+  data = _xdg_mime_lookup_ctx_read_file (ctx, file_name,
+					 _xdg_mime_magic_get_buffer_extents (global_magic),
+					 &bytes_read);
   if (data == NULL)
     return XDG_MIME_TYPE_UNKNOWN;
-        
-  file = fopen (file_name, "r");
-  if (file == NULL)
+
+  magic_type = _xdg_mime_magic_lookup_data (global_magic, ctx, data, bytes_read, &prio,
+					    ctx->mime_types, n);
+  mime_type = _xdg_mime_xml_namespace_refine (data, bytes_read, magic_type, &prio);
+
+  if (detection)
     {
-      free (data);
-      return XDG_MIME_TYPE_UNKNOWN;
+      detection->bytes_read = bytes_read;
+      if (prio > 0)
+	{
+	  detection->magic_priority = prio;
+	  detection->stage = mime_type == magic_type ? XDG_MIME_STAGE_MAGIC : XDG_MIME_STAGE_XML;
+	}
     }
 
-  bytes_read = fread (data, 1, max_extent, file);
-  if (ferror (file))
+  if (!mime_type)
+    mime_type = _xdg_binary_or_text_fallback(data, bytes_read);
+
+  return mime_type;
+}
+
+static const char *
+mime_get_mime_type_for_file_ex (XdgMimeLookupCtx *ctx,
+				const char       *file_name,
+				struct stat      *statbuf,
+				XdgMimeDetection *detection)
+{
+  const char *mime_type;
+
+  if (detection == NULL)
+    return mime_get_mime_type_for_file (ctx, file_name, statbuf, NULL);
+
+  memset (detection, 0, sizeof (XdgMimeDetection));
+
+  mime_type = mime_get_mime_type_for_file (ctx, file_name, statbuf, detection);
+
+  /* Only the fallbacks return these very strings, rules point into
+   * the caches or into their own copies. */
+  if (mime_type == XDG_MIME_TYPE_UNKNOWN ||
+      mime_type == XDG_MIME_TYPE_EMPTY ||
+      mime_type == XDG_MIME_TYPE_TEXTPLAIN)
     {
-      free (data);
-      fclose (file);
-      return XDG_MIME_TYPE_UNKNOWN;
+      detection->stage = XDG_MIME_STAGE_FALLBACK;
+      detection->directory = NULL;
     }
 
-  mime_type = _xdg_mime_magic_lookup_data (global_magic, data, bytes_read, NULL,
-					   mime_types, n);
+  detection->mime_type = mime_type;
+  return mime_type;
+}
 
-  free (data);
-  fclose (file);
+const char *
+xdg_mime_get_mime_type_for_file (const char  *file_name,
+                                 struct stat *statbuf)
+{
+  return xdg_mime_get_mime_type_for_file_ex (file_name, statbuf, NULL);
+}
 
-  if (mime_type)
-    return mime_type;
+const char *
+xdg_mime_get_mime_type_for_file_ex (const char       *file_name,
+				    struct stat      *statbuf,
+				    XdgMimeDetection *detection)
+{
+  XdgMimeLookupCtx ctx;
+  const char *mime_type;
+
+  _xdg_mime_lookup_ctx_init (&ctx);
+  mime_type = mime_get_mime_type_for_file_ex (&ctx, file_name, statbuf, detection);
+  _xdg_mime_lookup_ctx_clear (&ctx);
+
+  return mime_type;
+}
+
+void
+xdg_mime_get_mime_types_for_files (const char *file_names[],
+				   const char *mime_types[],
+				   int         n_files)
+{
+  XdgMimeLookupCtx ctx;
 
-  return _xdg_binary_or_text_fallback(data, bytes_read);
+  _xdg_mime_lookup_ctx_init (&ctx);
+  xdg_mime_get_mime_types_for_files_ctx (&ctx, file_names, mime_types, n_files);
+  _xdg_mime_lookup_ctx_clear (&ctx);
 }
 
 const char *
 xdg_mime_get_mime_type_from_file_name (const char *file_name)
 {
+  XdgMimeLookupCtx ctx;
   const char *mime_type;
 
-  if (_caches)
-    return _xdg_mime_cache_get_mime_type_from_file_name (file_name);
+  _xdg_mime_lookup_ctx_init (&ctx);
+  mime_type = xdg_mime_get_mime_type_from_file_name_ctx (&ctx, file_name);
+  _xdg_mime_lookup_ctx_clear (&ctx);
 
-  if (_xdg_glob_hash_lookup_file_name (global_hash, file_name, &mime_type, 1))
-    return mime_type;
-  else
-    return XDG_MIME_TYPE_UNKNOWN;
+  return mime_type;
 }
 
 int
@@ -500,10 +852,136 @@ xdg_mime_get_mime_types_from_file_name (const char *file_name,
 					const char  *mime_types[],
 					int          n_mime_types)
 {
+  XdgMimeLookupCtx ctx;
+  int n;
+
+  _xdg_mime_lookup_ctx_init (&ctx);
+  n = xdg_mime_get_mime_types_from_file_name_ctx (&ctx, file_name, mime_types, n_mime_types);
+  _xdg_mime_lookup_ctx_clear (&ctx);
+
+  return n < n_mime_types ? n : n_mime_types;
+}
+
+XdgMimeLookupCtx *
+xdg_mime_lookup_ctx_new (void)
+{
+  XdgMimeLookupCtx *ctx;
+
+  ctx = malloc (sizeof (XdgMimeLookupCtx));
+  if (ctx)
+    _xdg_mime_lookup_ctx_init (ctx);
+
+  return ctx;
+}
+
+void
+xdg_mime_lookup_ctx_free (XdgMimeLookupCtx *ctx)
+{
+  if (ctx == NULL)
+    return;
+
+  _xdg_mime_lookup_ctx_clear (ctx);
+  free (ctx);
+}
+
+const char *const *
+xdg_mime_lookup_ctx_get_candidates (XdgMimeLookupCtx *ctx,
+				    int              *n_candidates)
+{
+  int i;
+
+  /* The magic stage clears the candidates it ruled out in place */
+  for (i = 0; i < ctx->n_mimes; i++)
+    ctx->mime_types[i] = ctx->mimes[i].mime;
+
+  *n_candidates = ctx->n_mimes;
+  return ctx->mime_types;
+}
+
+void
+xdg_mime_lookup_ctx_set_magic_flags (XdgMimeLookupCtx *ctx,
+				     int               flags)
+{
+  ctx->magic_flags = flags;
+}
+
+void
+xdg_mime_lookup_ctx_get_stats (XdgMimeLookupCtx   *ctx,
+			       XdgMimeLookupStats *stats)
+{
+  *stats = ctx->stats;
+}
+
+const char *
+xdg_mime_get_mime_type_for_data_ctx (XdgMimeLookupCtx *ctx,
+				     const void       *data,
+				     size_t            len,
+				     int              *result_prio)
+{
+  ctx->stats.n_lookups++;
+  ctx->n_mimes = 0;
+
+  return mime_get_mime_type_for_data (ctx, data, len, result_prio);
+}
+
+const char *
+xdg_mime_get_mime_type_for_file_ctx (XdgMimeLookupCtx *ctx,
+				     const char       *file_name,
+				     struct stat      *statbuf,
+				     XdgMimeDetection *detection)
+{
+  return mime_get_mime_type_for_file_ex (ctx, file_name, statbuf, detection);
+}
+
+void
+xdg_mime_get_mime_types_for_files_ctx (XdgMimeLookupCtx *ctx,
+				       const char       *file_names[],
+				       const char       *mime_types[],
+				       int               n_files)
+{
+  int i;
+
+  for (i = 0; i < n_files; i++)
+    mime_types[i] = mime_get_mime_type_for_file (ctx, file_names[i], NULL, NULL);
+}
+
+const char *
+xdg_mime_get_mime_type_from_file_name_ctx (XdgMimeLookupCtx *ctx,
+					   const char       *file_name)
+{
+  int n;
+
+  ctx->stats.n_lookups++;
+
+  if (_caches)
+    n = _xdg_mime_cache_lookup_file_name (ctx, file_name);
+  else
+    n = _xdg_glob_hash_lookup_file_name (global_hash, ctx, file_name, NULL);
+
+  if (n > 0)
+    return ctx->mime_types[0];
+  else
+    return XDG_MIME_TYPE_UNKNOWN;
+}
+
+int
+xdg_mime_get_mime_types_from_file_name_ctx (XdgMimeLookupCtx *ctx,
+					    const char       *file_name,
+					    const char       *mime_types[],
+					    int               n_mime_types)
+{
+  int n;
+
+  ctx->stats.n_lookups++;
+
   if (_caches)
-    return _xdg_mime_cache_get_mime_types_from_file_name (file_name, mime_types, n_mime_types);
-  
-  return _xdg_glob_hash_lookup_file_name (global_hash, file_name, mime_types, n_mime_types);
+    n = _xdg_mime_cache_lookup_file_name (ctx, file_name);
+  else
+    n = _xdg_glob_hash_lookup_file_name (global_hash, ctx, file_name, NULL);
+
+  _xdg_mime_lookup_ctx_copy (ctx, mime_types, n_mime_types);
+
+  return n;
 }
 
 int
@@ -525,6 +1003,12 @@ _xdg_mime_shutdown (void)
       dir_time_list = NULL;
     }
 	
+  if (glob_index)
+    {
+      _xdg_glob_index_free (glob_index);
+      glob_index = NULL;
+    }
+
   if (global_hash)
     {
       _xdg_glob_hash_free (global_hash);
@@ -559,6 +1043,30 @@ _xdg_mime_shutdown (void)
       _xdg_mime_icon_list_free (generic_icon_list);
       generic_icon_list = NULL;
     }
+
+  if (_xml_namespaces)
+    {
+      _xdg_mime_xml_namespace_list_free (_xml_namespaces);
+      _xml_namespaces = NULL;
+    }
+
+  if (tree_magic)
+    {
+      _xdg_mime_tree_magic_free (tree_magic);
+      tree_magic = NULL;
+    }
+
+  if (path_rules)
+    {
+      _xdg_mime_path_rules_free (path_rules);
+      path_rules = NULL;
+    }
+
+  if (string_pool)
+    {
+      _xdg_string_pool_free (string_pool);
+      string_pool = NULL;
+    }
   
   if (_caches)
     {
@@ -570,6 +1078,7 @@ _xdg_mime_shutdown (void)
       _caches = NULL;
       n_caches = 0;
     }
+  snapshot_loaded = FALSE;
 
   for (list = callback_list; list; list = list->next)
     (list->callback) (list->data);
@@ -705,6 +1214,29 @@ xdg_mime_mime_type_subclass (const char *mime,
   return _xdg_mime_mime_type_subclass (mime, base);
 }
 
+int
+xdg_mime_get_parents_into (const char *mime,
+			   const char *parents[],
+			   int         n_parents)
+{
+  const char **list;
+  int i;
+
+  if (_caches)
+    return _xdg_mime_cache_get_mime_parents (mime, parents, n_parents);
+
+  list = xdg_mime_get_mime_parents (mime);
+
+  if (!list)
+    return 0;
+
+  for (i = 0; list[i]; i++)
+    if (i < n_parents)
+      parents[i] = list[i];
+
+  return i;
+}
+
 char **
 xdg_mime_list_mime_parents (const char *mime)
 {
@@ -739,6 +1271,33 @@ xdg_mime_get_mime_parents (const char *mime)
   return _xdg_mime_parent_list_lookup (parent_list, umime);
 }
 
+int
+xdg_mime_get_globs_for_type (const char *mime,
+			     const char *globs[],
+			     int         n_globs)
+{
+  int n;
+
+  if (glob_index == NULL)
+    return 0;
+
+  n = _xdg_glob_index_lookup (glob_index, mime, globs, n_globs);
+
+  if (n == 0)
+    n = _xdg_glob_index_lookup (glob_index, _xdg_mime_unalias_mime_type (mime), globs, n_globs);
+
+  return n;
+}
+
+const char *
+xdg_mime_get_tree_type (const char *root)
+{
+  if (tree_magic == NULL)
+    return NULL;
+
+  return _xdg_mime_tree_magic_lookup (tree_magic, root);
+}
+
 void 
 xdg_mime_dump (void)
 {
@@ -791,7 +1350,7 @@ xdg_mime_remove_callback (int callback_id)
       if (list->callback_id == callback_id)
 	{
 	  if (list->next)
-	    list->next = list->prev;
+	    list->next->prev = list->prev;
 
 	  if (list->prev)
 	    list->prev->next = list->next;
@@ -799,13 +1358,50 @@ xdg_mime_remove_callback (int callback_id)
 	    callback_list = list->next;
 
 	  /* invoke the destroy handler */
-	  (list->destroy) (list->data);
+	  if (list->destroy)
+	    (list->destroy) (list->data);
 	  free (list);
 	  return;
 	}
     }
 }
 
+void
+xdg_mime_set_cache_load_flags (int flags)
+{
+  cache_load_flags = flags;
+}
+
+int
+xdg_mime_get_cache_load_flags (void)
+{
+  return cache_load_flags;
+}
+
+void
+xdg_mime_set_magic_flags (int flags)
+{
+  _magic_flags = flags;
+}
+
+int
+xdg_mime_get_magic_flags (void)
+{
+  return _magic_flags;
+}
+
+void
+xdg_mime_dump_magic_profile (void)
+{
+  printf ("*** MAGIC PROFILE ***\n\n");
+  printf ("priority mime_type evaluations matches bytes_compared [directory]\n");
+
+  if (_caches)
+    _xdg_mime_cache_magic_dump_profile ();
+  else if (global_magic)
+    _xdg_mime_magic_dump_profile (global_magic);
+}
+
 const char *
 xdg_mime_get_icon (const char *mime)
 {
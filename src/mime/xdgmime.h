@@ -50,10 +50,87 @@ extern "C" {
 typedef void (*XdgMimeCallback) (void *user_data);
 typedef void (*XdgMimeDestroy)  (void *user_data);
 
+/* Controls how binary "mime.cache" files are brought into memory.  The
+ * flags take effect the next time the caches are (re)loaded.
+ */
+typedef enum
+{
+  XDG_MIME_CACHE_LOAD_DEFAULT  = 0,
+  XDG_MIME_CACHE_LOAD_POPULATE = 1 << 0, /* prefault the whole mapping */
+  XDG_MIME_CACHE_LOAD_WILLNEED = 1 << 1, /* prefetch the glob and magic sections */
+  XDG_MIME_CACHE_LOAD_MLOCK    = 1 << 2, /* keep the cache resident */
+  XDG_MIME_CACHE_LOAD_HUGEPAGE = 1 << 3, /* copy small caches into huge pages */
+  XDG_MIME_CACHE_LOAD_SNAPSHOT = 1 << 4  /* share directories without a mime.cache through
+					    one snapshot in $XDG_CACHE_HOME */
+} XdgMimeCacheLoadFlags;
+
+/* Optional instrumentation and ordering of magic rules, see
+ * xdg_mime_set_magic_flags().
+ */
+typedef enum
+{
+  XDG_MIME_MAGIC_DEFAULT = 0,
+  XDG_MIME_MAGIC_PROFILE = 1 << 0, /* count evaluations, matches and bytes compared per rule */
+  XDG_MIME_MAGIC_REORDER = 1 << 1  /* try rules that matched more often with a lookup context
+				      first within a priority */
+} XdgMimeMagicFlags;
+
+#define XDG_MIME_DETECTION_MAX_CANDIDATES 10
+
+/* The rule that decided the type returned by
+ * xdg_mime_get_mime_type_for_file_ex().
+ */
+typedef enum
+{
+  XDG_MIME_STAGE_NONE,     /* no glob matched the file name */
+  XDG_MIME_STAGE_LITERAL,  /* a literal file name ("Makefile") */
+  XDG_MIME_STAGE_PATH,     /* a full path rule from a "paths" file */
+  XDG_MIME_STAGE_SUFFIX,   /* a suffix glob ("*.png") */
+  XDG_MIME_STAGE_GLOB,     /* any other glob, matched with fnmatch() */
+  XDG_MIME_STAGE_MAGIC,    /* a magic rule */
+  XDG_MIME_STAGE_XML,      /* the namespace of the root XML element */
+  XDG_MIME_STAGE_FALLBACK  /* unreadable or empty file, or a guess from the contents */
+} XdgMimeStage;
+
+typedef struct XdgMimeDetection XdgMimeDetection;
+struct XdgMimeDetection
+{
+  const char   *mime_type;
+  XdgMimeStage  stage;
+
+  /* glob matches of the file name, heaviest first */
+  int           n_candidates;
+  const char   *candidates[XDG_MIME_DETECTION_MAX_CANDIDATES];
+  int           weights[XDG_MIME_DETECTION_MAX_CANDIDATES];
+
+  int           magic_priority;  /* 0 if no magic rule matched */
+  const char   *directory;       /* "mime" directory of the mime.cache the rule came from, or NULL */
+  int           bytes_read;      /* bytes of the file examined, 0 if it was not opened */
+};
+
+/* Scratch space of the lookups: glob candidates, the lowercase file
+ * name and the buffer files are sniffed into.  A context is not thread
+ * safe, create one per thread and pass it to the *_ctx lookups so
+ * nothing is allocated once its buffers have grown.
+ */
+typedef struct XdgMimeLookupCtx XdgMimeLookupCtx;
+
+typedef struct XdgMimeLookupStats XdgMimeLookupStats;
+struct XdgMimeLookupStats
+{
+  unsigned long n_lookups;       /* lookups made with the context */
+  unsigned long n_files_read;    /* files opened to sniff their contents */
+  unsigned long n_bytes_read;
+  unsigned long n_candidates;    /* glob candidates found in total */
+  int           max_candidates;  /* most glob candidates of a single lookup */
+  int           n_allocations;   /* times a buffer of the context had to grow */
+};
+
   
 #ifdef XDG_PREFIX
 #define xdg_mime_get_mime_type_for_data       XDG_ENTRY(get_mime_type_for_data)
 #define xdg_mime_get_mime_type_for_file       XDG_ENTRY(get_mime_type_for_file)
+#define xdg_mime_get_mime_type_for_file_ex    XDG_ENTRY(get_mime_type_for_file_ex)
 #define xdg_mime_get_mime_type_from_file_name XDG_ENTRY(get_mime_type_from_file_name)
 #define xdg_mime_get_mime_types_from_file_name XDG_ENTRY(get_mime_types_from_file_name)
 #define xdg_mime_is_valid_mime_type           XDG_ENTRY(is_valid_mime_type)
@@ -61,6 +138,7 @@ typedef void (*XdgMimeDestroy)  (void *user_data);
 #define xdg_mime_media_type_equal             XDG_ENTRY(media_type_equal)
 #define xdg_mime_mime_type_subclass           XDG_ENTRY(mime_type_subclass)
 #define xdg_mime_list_mime_parents            XDG_ENTRY(list_mime_parents)
+#define xdg_mime_get_parents_into             XDG_ENTRY(get_parents_into)
 #define xdg_mime_unalias_mime_type            XDG_ENTRY(unalias_mime_type)
 #define xdg_mime_get_max_buffer_extents       XDG_ENTRY(get_max_buffer_extents)
 #define xdg_mime_dump                         XDG_ENTRY(dump)
@@ -71,6 +149,24 @@ typedef void (*XdgMimeDestroy)  (void *user_data);
 #define xdg_mime_type_textplain               XDG_ENTRY(type_textplain)
 #define xdg_mime_get_icon                     XDG_ENTRY(get_icon)
 #define xdg_mime_get_generic_icon             XDG_ENTRY(get_generic_icon)
+#define xdg_mime_set_cache_load_flags         XDG_ENTRY(set_cache_load_flags)
+#define xdg_mime_get_cache_load_flags         XDG_ENTRY(get_cache_load_flags)
+#define xdg_mime_get_globs_for_type           XDG_ENTRY(get_globs_for_type)
+#define xdg_mime_set_magic_flags              XDG_ENTRY(set_magic_flags)
+#define xdg_mime_get_magic_flags              XDG_ENTRY(get_magic_flags)
+#define xdg_mime_dump_magic_profile           XDG_ENTRY(dump_magic_profile)
+#define xdg_mime_get_mime_types_for_files     XDG_ENTRY(get_mime_types_for_files)
+#define xdg_mime_get_tree_type                XDG_ENTRY(get_tree_type)
+#define xdg_mime_lookup_ctx_new               XDG_ENTRY(lookup_ctx_new)
+#define xdg_mime_lookup_ctx_free              XDG_ENTRY(lookup_ctx_free)
+#define xdg_mime_lookup_ctx_get_candidates    XDG_ENTRY(lookup_ctx_get_candidates)
+#define xdg_mime_lookup_ctx_set_magic_flags   XDG_ENTRY(lookup_ctx_set_magic_flags)
+#define xdg_mime_lookup_ctx_get_stats         XDG_ENTRY(lookup_ctx_get_stats)
+#define xdg_mime_get_mime_type_for_data_ctx   XDG_ENTRY(get_mime_type_for_data_ctx)
+#define xdg_mime_get_mime_type_for_file_ctx   XDG_ENTRY(get_mime_type_for_file_ctx)
+#define xdg_mime_get_mime_types_for_files_ctx XDG_ENTRY(get_mime_types_for_files_ctx)
+#define xdg_mime_get_mime_type_from_file_name_ctx XDG_ENTRY(get_mime_type_from_file_name_ctx)
+#define xdg_mime_get_mime_types_from_file_name_ctx XDG_ENTRY(get_mime_types_from_file_name_ctx)
 
 #define _xdg_mime_mime_type_equal             XDG_RESERVED_ENTRY(mime_type_equal)
 #define _xdg_mime_mime_type_subclass          XDG_RESERVED_ENTRY(mime_type_subclass)
@@ -91,10 +187,64 @@ const char  *xdg_mime_get_mime_type_for_data       (const void *data,
 						    int        *result_prio);
 const char  *xdg_mime_get_mime_type_for_file       (const char *file_name,
                                                     struct stat *statbuf);
+/* Same as xdg_mime_get_mime_type_for_file(), additionally describes in
+ * detection how the type was chosen.  detection may be NULL. */
+const char  *xdg_mime_get_mime_type_for_file_ex    (const char       *file_name,
+						    struct stat      *statbuf,
+						    XdgMimeDetection *detection);
+/* Looks up the types of n_files files at once, with the same results as
+ * looking them up one by one. */
+void         xdg_mime_get_mime_types_for_files     (const char *file_names[],
+						    const char *mime_types[],
+						    int         n_files);
 const char  *xdg_mime_get_mime_type_from_file_name (const char *file_name);
 int          xdg_mime_get_mime_types_from_file_name(const char *file_name,
 						    const char *mime_types[],
 						    int         n_mime_types);
+
+XdgMimeLookupCtx *xdg_mime_lookup_ctx_new          (void);
+void         xdg_mime_lookup_ctx_free              (XdgMimeLookupCtx   *ctx);
+/* Returns all glob candidates of the last file name or file lookup made
+ * with ctx, heaviest first.  They stay valid until the next lookup. */
+const char *const *xdg_mime_lookup_ctx_get_candidates (XdgMimeLookupCtx *ctx,
+						    int                *n_candidates);
+/* XdgMimeMagicFlags of the lookups made with ctx in addition to the
+ * global ones, e.g. to opt in to XDG_MIME_MAGIC_REORDER for one context. */
+void         xdg_mime_lookup_ctx_set_magic_flags   (XdgMimeLookupCtx   *ctx,
+						    int                 flags);
+void         xdg_mime_lookup_ctx_get_stats         (XdgMimeLookupCtx   *ctx,
+						    XdgMimeLookupStats *stats);
+/* The lookups above, using the buffers of ctx.  detection may be NULL. */
+const char  *xdg_mime_get_mime_type_for_data_ctx   (XdgMimeLookupCtx   *ctx,
+						    const void         *data,
+						    size_t              len,
+						    int                *result_prio);
+const char  *xdg_mime_get_mime_type_for_file_ctx   (XdgMimeLookupCtx   *ctx,
+						    const char         *file_name,
+						    struct stat        *statbuf,
+						    XdgMimeDetection   *detection);
+void         xdg_mime_get_mime_types_for_files_ctx (XdgMimeLookupCtx   *ctx,
+						    const char         *file_names[],
+						    const char         *mime_types[],
+						    int                 n_files);
+const char  *xdg_mime_get_mime_type_from_file_name_ctx (XdgMimeLookupCtx *ctx,
+						    const char         *file_name);
+/* Stores up to n_mime_types candidates, unlike the variant without a
+ * context returns the total number of them. */
+int          xdg_mime_get_mime_types_from_file_name_ctx (XdgMimeLookupCtx *ctx,
+						    const char         *file_name,
+						    const char         *mime_types[],
+						    int                 n_mime_types);
+
+/* Stores up to n_globs globs ("*.png", "Makefile", ...) mapping to mime,
+ * heaviest first, and returns the total number of such globs.  The
+ * strings stay valid until the mime database is reloaded. */
+int          xdg_mime_get_globs_for_type           (const char *mime,
+						    const char *globs[],
+						    int         n_globs);
+/* Returns the x-content/... type of the directory tree mounted at root
+ * according to the treemagic rules, or NULL if none matches. */
+const char  *xdg_mime_get_tree_type                (const char *root);
 int          xdg_mime_is_valid_mime_type           (const char *mime_type);
 int          xdg_mime_mime_type_equal              (const char *mime_a,
 						    const char *mime_b);
@@ -104,6 +254,11 @@ int          xdg_mime_mime_type_subclass           (const char *mime_a,
 						    const char *mime_b);
 
 char **      xdg_mime_list_mime_parents		   (const char *mime);
+/* Allocation free variant of xdg_mime_list_mime_parents(): stores up to
+ * n_parents parents of mime and returns the total number of parents. */
+int          xdg_mime_get_parents_into             (const char *mime,
+						    const char *parents[],
+						    int         n_parents);
 const char  *xdg_mime_unalias_mime_type		   (const char *mime);
 const char  *xdg_mime_get_icon                     (const char *mime);
 const char  *xdg_mime_get_generic_icon             (const char *mime);
@@ -113,6 +268,18 @@ int          xdg_mime_register_reload_callback     (XdgMimeCallback  callback,
 						    void            *data,
 						    XdgMimeDestroy   destroy);
 void         xdg_mime_remove_callback              (int              callback_id);
+void         xdg_mime_set_cache_load_flags         (int              flags);
+int          xdg_mime_get_cache_load_flags         (void);
+/* Rules are only reordered while there are no glob results to rule out,
+ * each lookup context keeps its own order.  When rules of the same
+ * priority overlap, the first one tried wins, so with
+ * XDG_MIME_MAGIC_REORDER the type of such data depends on the lookups
+ * made before with the context.  Profile counters start over whenever
+ * the database is reloaded, a mime.cache is only profiled if
+ * XDG_MIME_MAGIC_PROFILE was set when it was loaded. */
+void         xdg_mime_set_magic_flags              (int              flags);
+int          xdg_mime_get_magic_flags              (void);
+void         xdg_mime_dump_magic_profile           (void);
 
 
 #ifdef __cplusplus
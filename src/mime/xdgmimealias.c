@@ -30,6 +30,7 @@
 
 #include "xdgmimealias.h"
 #include "xdgmimeint.h"
+#include "xdgmimestrpool.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
@@ -48,18 +49,21 @@ typedef struct XdgAlias XdgAlias;
 
 struct XdgAlias 
 {
-  char *alias;
-  char *mime_type;
+  const char *alias;
+  const char *mime_type;
 };
 
 struct XdgAliasList
 {
   struct XdgAlias *aliases;
   int n_aliases;
+
+  XdgStringPool *pool;
+  XdgStringIndex *index;
 };
 
 XdgAliasList *
-_xdg_mime_alias_list_new (void)
+_xdg_mime_alias_list_new (XdgStringPool *pool)
 {
   XdgAliasList *list;
 
@@ -67,6 +71,8 @@ _xdg_mime_alias_list_new (void)
 
   list->aliases = NULL;
   list->n_aliases = 0;
+  list->pool = pool;
+  list->index = NULL;
 
   return list;
 }
@@ -74,42 +80,40 @@ _xdg_mime_alias_list_new (void)
 void         
 _xdg_mime_alias_list_free (XdgAliasList *list)
 {
-  int i;
-
-  if (list->aliases)
-    {
-      for (i = 0; i < list->n_aliases; i++)
-	{
-	  free (list->aliases[i].alias);
-	  free (list->aliases[i].mime_type);
-	}
-      free (list->aliases);
-    }
+  /* The strings belong to the pool */
+  if (list->index)
+    _xdg_string_index_free (list->index);
+  free (list->aliases);
   free (list);
 }
 
-static int
-alias_entry_cmp (const void *v1, const void *v2)
+/* Builds the hash index, must be called once all files have been read.
+ * When an alias is defined more than once the first definition wins. */
+void
+_xdg_mime_alias_list_build_index (XdgAliasList *list)
 {
-  return strcmp (((XdgAlias *)v1)->alias, ((XdgAlias *)v2)->alias);
+  int i;
+
+  if (list->index)
+    _xdg_string_index_free (list->index);
+
+  list->index = _xdg_string_index_new (list->n_aliases);
+
+  for (i = 0; i < list->n_aliases; i++)
+    _xdg_string_index_insert (list->index, list->aliases[i].alias, i);
 }
 
 const char  *
 _xdg_mime_alias_list_lookup (XdgAliasList *list,
 			     const char   *alias)
 {
-  XdgAlias *entry;
-  XdgAlias key;
+  int i;
 
-  if (list->n_aliases > 0)
+  if (list->index && (alias = _xdg_string_pool_lookup (list->pool, alias)) != NULL)
     {
-      key.alias = (char *)alias;
-      key.mime_type = NULL;
-
-      entry = bsearch (&key, list->aliases, list->n_aliases,
-		       sizeof (XdgAlias), alias_entry_cmp);
-      if (entry)
-        return entry->mime_type;
+      i = _xdg_string_index_lookup (list->index, alias);
+      if (i >= 0)
+        return list->aliases[i].mime_type;
     }
 
   return NULL;
@@ -119,20 +123,20 @@ void
 _xdg_mime_alias_read_from_file (XdgAliasList *list,
 				const char   *file_name)
 {
-  FILE *file;
-  char line[255];
+  char *buffer, *cursor, *line;
+  size_t size;
   int alloc;
 
-  file = fopen (file_name, "r");
+  buffer = _xdg_map_file (file_name, &size);
 
-  if (file == NULL)
+  if (buffer == NULL)
     return;
 
-  /* FIXME: Not UTF-8 safe.  Doesn't work if lines are greater than 255 chars.
-   * Blah */
+  /* FIXME: Not UTF-8 safe. */
   alloc = list->n_aliases + 16;
   list->aliases = realloc (list->aliases, alloc * sizeof (XdgAlias));
-  while (fgets (line, 255, file) != NULL)
+  cursor = buffer;
+  while ((line = _xdg_next_line (&cursor, buffer + size)) != NULL)
     {
       char *sep;
       if (line[0] == '#')
@@ -142,25 +146,20 @@ _xdg_mime_alias_read_from_file (XdgAliasList *list,
       if (sep == NULL)
 	continue;
       *(sep++) = '\000';
-      sep[strlen (sep) -1] = '\000';
       if (list->n_aliases == alloc)
 	{
 	  alloc <<= 1;
 	  list->aliases = realloc (list->aliases, 
 				   alloc * sizeof (XdgAlias));
 	}
-      list->aliases[list->n_aliases].alias = strdup (line);
-      list->aliases[list->n_aliases].mime_type = strdup (sep);
+      list->aliases[list->n_aliases].alias = _xdg_string_pool_intern (list->pool, line);
+      list->aliases[list->n_aliases].mime_type = _xdg_string_pool_intern (list->pool, sep);
       list->n_aliases++;
     }
   list->aliases = realloc (list->aliases, 
 			   list->n_aliases * sizeof (XdgAlias));
 
-  fclose (file);  
-  
-  if (list->n_aliases > 1)
-    qsort (list->aliases, list->n_aliases, 
-           sizeof (XdgAlias), alias_entry_cmp);
+  _xdg_unmap_file (buffer, size);
 }
 
 
@@ -180,4 +179,18 @@ _xdg_mime_alias_list_dump (XdgAliasList *list)
     }
 }
 
+void
+_xdg_mime_alias_list_serialize (XdgAliasList       *list,
+				XdgMimeCacheWriter *writer)
+{
+  int i;
 
+  for (i = 0; i < list->n_aliases; i++)
+    {
+      /* Skip the definitions the first one overrides */
+      if (_xdg_string_index_lookup (list->index, list->aliases[i].alias) == i)
+	_xdg_mime_cache_writer_add_alias (writer,
+					  list->aliases[i].alias,
+					  list->aliases[i].mime_type);
+    }
+}
@@ -28,7 +28,8 @@
 #ifndef __XDG_MIME_ALIAS_H__
 #define __XDG_MIME_ALIAS_H__
 
-#include "xdgmime.h"
+#include "xdgmimestrpool.h"
+#include "xdgmimecachewriter.h"
 
 typedef struct XdgAliasList XdgAliasList;
 
@@ -37,15 +38,21 @@ typedef struct XdgAliasList XdgAliasList;
 #define _xdg_mime_alias_list_new              XDG_RESERVED_ENTRY(alias_list_new)
 #define _xdg_mime_alias_list_free             XDG_RESERVED_ENTRY(alias_list_free)
 #define _xdg_mime_alias_list_lookup           XDG_RESERVED_ENTRY(alias_list_lookup)
+#define _xdg_mime_alias_list_build_index      XDG_RESERVED_ENTRY(alias_list_build_index)
 #define _xdg_mime_alias_list_dump             XDG_RESERVED_ENTRY(alias_list_dump)
+#define _xdg_mime_alias_list_serialize        XDG_RESERVED_ENTRY(alias_list_serialize)
 #endif
 
 void          _xdg_mime_alias_read_from_file (XdgAliasList *list,
 					      const char   *file_name);
-XdgAliasList *_xdg_mime_alias_list_new       (void);
+XdgAliasList *_xdg_mime_alias_list_new       (XdgStringPool *pool);
 void          _xdg_mime_alias_list_free      (XdgAliasList *list);
+void          _xdg_mime_alias_list_build_index (XdgAliasList *list);
 const char   *_xdg_mime_alias_list_lookup    (XdgAliasList *list,
 					      const char  *alias);
 void          _xdg_mime_alias_list_dump      (XdgAliasList *list);
+/* Adds the aliases in effect to writer, the index must be built */
+void          _xdg_mime_alias_list_serialize (XdgAliasList       *list,
+					      XdgMimeCacheWriter *writer);
 
 #endif /* __XDG_MIME_ALIAS_H__ */
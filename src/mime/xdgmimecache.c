@@ -49,6 +49,9 @@
 
 #include "xdgmimecache.h"
 #include "xdgmimeint.h"
+#include "xdgmimectx.h"
+#include "xdgmimexml.h"
+#include "xdgmimemagic.h"
 
 #ifndef MAX
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
@@ -74,13 +77,32 @@
 #define MINOR_VERSION_MIN 1
 #define MINOR_VERSION_MAX 2
 
+/* Caches up to this size may be copied into huge page backed memory
+ * when XDG_MIME_CACHE_LOAD_HUGEPAGE is requested.
+ */
+#define HUGEPAGE_SIZE            (2 * 1024 * 1024)
+#define HUGEPAGE_COPY_MAX_SIZE   (16 * 1024 * 1024)
+
+typedef struct
+{
+  unsigned long n_evaluations;
+  unsigned long n_matches;
+  unsigned long n_bytes;
+} CacheMagicStats;
+
 struct _XdgMimeCache
 {
   int ref_count;
   int minor;
+  int load_flags;
 
   size_t  size;
   char   *buffer;
+  char   *directory;
+
+  /* Per magic rule counters of XDG_MIME_MAGIC_PROFILE, allocated on
+   * load if it is set then, and shared by all threads. */
+  CacheMagicStats *magic_stats;
 };
 
 #define GET_UINT16(cache,offset) (ntohs(*(xdg_uint16_t*)((cache) + (offset))))
@@ -101,14 +123,100 @@ _xdg_mime_cache_unref (XdgMimeCache *cache)
   if (cache->ref_count == 0)
     {
 #ifdef HAVE_MMAP
-      munmap (cache->buffer, cache->size);
+      if (cache->load_flags & XDG_MIME_CACHE_LOAD_MLOCK)
+	munlock (cache->buffer, cache->size);
+
+      if (cache->load_flags & XDG_MIME_CACHE_LOAD_HUGEPAGE)
+	free (cache->buffer);
+      else
+	munmap (cache->buffer, cache->size);
 #endif
+      free (cache->directory);
+      free (cache->magic_stats);
       free (cache);
     }
 }
 
+#ifdef HAVE_MMAP
+/* Reads the whole file into a buffer aligned to, and advised for, huge
+ * pages.  Lookups touch the glob and magic sections more or less at
+ * random, so a couple of TLB entries are much cheaper than a page fault
+ * per 4k page of a freshly mapped file.
+ */
+static char *
+cache_copy_to_hugepages (int fd, size_t size)
+{
+  char *buffer;
+  size_t alloc_size;
+  size_t done = 0;
+  ssize_t n;
+
+  alloc_size = (size + HUGEPAGE_SIZE - 1) & ~((size_t) HUGEPAGE_SIZE - 1);
+
+  if (posix_memalign ((void **) &buffer, HUGEPAGE_SIZE, alloc_size) != 0)
+    return NULL;
+
+#ifdef MADV_HUGEPAGE
+  madvise (buffer, alloc_size, MADV_HUGEPAGE);
+#endif
+
+  while (done < size)
+    {
+      n = pread (fd, buffer + done, size - done, done);
+
+      if (n <= 0)
+	{
+	  free (buffer);
+	  return NULL;
+	}
+
+      done += n;
+    }
+
+  return buffer;
+}
+
+/* Issues MADV_WILLNEED for the sections consulted by every file name or
+ * data lookup: the literal list, the reverse suffix tree, the glob list
+ * and the magic list.  The header only records where a section starts,
+ * so a section is taken to extend to the nearest following one.
+ */
+static void
+cache_advise_hot_sections (char *buffer, size_t size)
+{
+  static const xdg_uint32_t hot_sections[] = { 12, 16, 20, 24 };
+  size_t page_size = sysconf (_SC_PAGESIZE);
+  xdg_uint32_t start, end, offset;
+  size_t aligned;
+  int i, j;
+
+  if (size < 40)
+    return;
+
+  for (i = 0; i < sizeof (hot_sections) / sizeof (hot_sections[0]); i++)
+    {
+      start = GET_UINT32 (buffer, hot_sections[i]);
+      end = size;
+
+      if (start >= size)
+	continue;
+
+      for (j = 4; j < 40; j += 4)
+	{
+	  offset = GET_UINT32 (buffer, j);
+	  if (offset > start && offset < end)
+	    end = offset;
+	}
+
+      aligned = start & ~(page_size - 1);
+      madvise (buffer + aligned, end - aligned, MADV_WILLNEED);
+    }
+}
+#endif  /* HAVE_MMAP */
+
 XdgMimeCache *
-_xdg_mime_cache_new_from_file (const char *file_name)
+_xdg_mime_cache_new_from_file (const char *file_name,
+			       int         load_flags)
 {
   XdgMimeCache *cache = NULL;
 
@@ -116,6 +224,7 @@ _xdg_mime_cache_new_from_file (const char *file_name)
   int fd = -1;
   struct stat st;
   char *buffer = NULL;
+  int mmap_flags = MAP_SHARED;
   int minor;
 
   /* Open the file and map it into memory */
@@ -127,10 +236,26 @@ _xdg_mime_cache_new_from_file (const char *file_name)
   if (fstat (fd, &st) < 0 || st.st_size < 4)
     goto done;
 
-  buffer = (char *) mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if ((load_flags & XDG_MIME_CACHE_LOAD_HUGEPAGE) &&
+      st.st_size <= HUGEPAGE_COPY_MAX_SIZE)
+    buffer = cache_copy_to_hugepages (fd, st.st_size);
+  else
+    load_flags &= ~XDG_MIME_CACHE_LOAD_HUGEPAGE;
 
-  if (buffer == MAP_FAILED)
-    goto done;
+  if (buffer == NULL)
+    {
+      load_flags &= ~XDG_MIME_CACHE_LOAD_HUGEPAGE;
+
+#ifdef MAP_POPULATE
+      if (load_flags & XDG_MIME_CACHE_LOAD_POPULATE)
+	mmap_flags |= MAP_POPULATE;
+#endif
+
+      buffer = (char *) mmap (NULL, st.st_size, PROT_READ, mmap_flags, fd, 0);
+
+      if (buffer == MAP_FAILED)
+	goto done;
+    }
 
   minor = GET_UINT16 (buffer, 2);
   /* Verify version */
@@ -138,16 +263,35 @@ _xdg_mime_cache_new_from_file (const char *file_name)
       (minor < MINOR_VERSION_MIN ||
        minor > MINOR_VERSION_MAX))
     {
-      munmap (buffer, st.st_size);
+      if (load_flags & XDG_MIME_CACHE_LOAD_HUGEPAGE)
+	free (buffer);
+      else
+	munmap (buffer, st.st_size);
 
       goto done;
     }
+
+  if (load_flags & XDG_MIME_CACHE_LOAD_WILLNEED)
+    cache_advise_hot_sections (buffer, st.st_size);
+
+  /* Failing to lock (e.g. because of RLIMIT_MEMLOCK) is not fatal */
+  if ((load_flags & XDG_MIME_CACHE_LOAD_MLOCK) &&
+      mlock (buffer, st.st_size) != 0)
+    load_flags &= ~XDG_MIME_CACHE_LOAD_MLOCK;
   
   cache = (XdgMimeCache *) malloc (sizeof (XdgMimeCache));
   cache->minor = minor;
   cache->ref_count = 1;
+  cache->load_flags = load_flags;
   cache->buffer = buffer;
   cache->size = st.st_size;
+  cache->directory = strdup (file_name);
+  cache->magic_stats = NULL;
+  if (_magic_flags & XDG_MIME_MAGIC_PROFILE)
+    cache->magic_stats = calloc (GET_UINT32 (buffer, GET_UINT32 (buffer, 24)),
+				 sizeof (CacheMagicStats));
+  if (strrchr (cache->directory, '/'))
+    *strrchr (cache->directory, '/') = '\000';
 
  done:
   if (fd != -1)
@@ -158,11 +302,28 @@ _xdg_mime_cache_new_from_file (const char *file_name)
   return cache;
 }
 
+const char *
+_xdg_mime_cache_get_stamp (XdgMimeCache *cache)
+{
+  xdg_uint32_t offset;
+
+  if (cache->size < 48 || memcmp (cache->buffer + cache->size - 4, "XDGS", 4) != 0)
+    return NULL;
+
+  offset = GET_UINT32 (cache->buffer, cache->size - 8);
+  if (offset < 40 || offset >= cache->size - 8 ||
+      memchr (cache->buffer + offset, 0, cache->size - 8 - offset) == NULL)
+    return NULL;
+
+  return cache->buffer + offset;
+}
+
 static int
-cache_magic_matchlet_compare_to_data (XdgMimeCache *cache, 
-				      xdg_uint32_t  offset,
-				      const void   *data,
-				      size_t        len)
+cache_magic_matchlet_compare_to_data (XdgMimeCache  *cache, 
+				      xdg_uint32_t   offset,
+				      const void    *data,
+				      size_t         len,
+				      unsigned long *n_bytes)
 {
   xdg_uint32_t range_start = GET_UINT32 (cache->buffer, offset);
   xdg_uint32_t range_length = GET_UINT32 (cache->buffer, offset + 4);
@@ -179,6 +340,9 @@ cache_magic_matchlet_compare_to_data (XdgMimeCache *cache,
       if (i + data_length > len)
 	return FALSE;
 
+      if (n_bytes)
+	*n_bytes += data_length;
+
       if (mask_offset)
 	{
 	  for (j = 0; j < data_length; j++)
@@ -204,17 +368,18 @@ cache_magic_matchlet_compare_to_data (XdgMimeCache *cache,
 }
 
 static int
-cache_magic_matchlet_compare (XdgMimeCache *cache, 
-			      xdg_uint32_t  offset,
-			      const void   *data,
-			      size_t        len)
+cache_magic_matchlet_compare (XdgMimeCache  *cache, 
+			      xdg_uint32_t   offset,
+			      const void    *data,
+			      size_t         len,
+			      unsigned long *n_bytes)
 {
   xdg_uint32_t n_children = GET_UINT32 (cache->buffer, offset + 24);
   xdg_uint32_t child_offset = GET_UINT32 (cache->buffer, offset + 28);
 
   int i;
   
-  if (cache_magic_matchlet_compare_to_data (cache, offset, data, len))
+  if (cache_magic_matchlet_compare_to_data (cache, offset, data, len, n_bytes))
     {
       if (n_children == 0)
 	return TRUE;
@@ -222,7 +387,7 @@ cache_magic_matchlet_compare (XdgMimeCache *cache,
       for (i = 0; i < n_children; i++)
 	{
 	  if (cache_magic_matchlet_compare (cache, child_offset + 32 * i,
-					    data, len))
+					    data, len, n_bytes))
 	    return TRUE;
 	}
     }
@@ -231,11 +396,12 @@ cache_magic_matchlet_compare (XdgMimeCache *cache,
 }
 
 static const char *
-cache_magic_compare_to_data (XdgMimeCache *cache, 
-			     xdg_uint32_t  offset,
-			     const void   *data, 
-			     size_t        len, 
-			     int          *prio)
+cache_magic_compare_to_data (XdgMimeCache  *cache, 
+			     xdg_uint32_t   offset,
+			     const void    *data, 
+			     size_t         len, 
+			     int           *prio,
+			     unsigned long *n_bytes)
 {
   xdg_uint32_t priority = GET_UINT32 (cache->buffer, offset);
   xdg_uint32_t mimetype_offset = GET_UINT32 (cache->buffer, offset + 4);
@@ -247,7 +413,7 @@ cache_magic_compare_to_data (XdgMimeCache *cache,
   for (i = 0; i < n_matchlets; i++)
     {
       if (cache_magic_matchlet_compare (cache, matchlet_offset + i * 32, 
-					data, len))
+					data, len, n_bytes))
 	{
 	  *prio = priority;
 	  
@@ -260,6 +426,7 @@ cache_magic_compare_to_data (XdgMimeCache *cache,
 
 static const char *
 cache_magic_lookup_data (XdgMimeCache *cache, 
+			 XdgMimeLookupCtx *ctx,
 			 const void   *data, 
 			 size_t        len, 
 			 int          *prio,
@@ -269,6 +436,10 @@ cache_magic_lookup_data (XdgMimeCache *cache,
   xdg_uint32_t list_offset;
   xdg_uint32_t n_entries;
   xdg_uint32_t offset;
+  xdg_uint32_t k;
+  unsigned long n_bytes;
+  XdgMimeMagicOrder *order = NULL;
+  int profile;
 
   int j, n;
 
@@ -277,21 +448,48 @@ cache_magic_lookup_data (XdgMimeCache *cache,
   list_offset = GET_UINT32 (cache->buffer, 24);
   n_entries = GET_UINT32 (cache->buffer, list_offset);
   offset = GET_UINT32 (cache->buffer, list_offset + 8);
-  
+
+  /* Glob results are ruled out by the rules tried before the match, so
+   * only reorder without them. */
+  if (n_mime_types == 0 && _xdg_mime_lookup_ctx_reorder (ctx))
+    order = _xdg_mime_lookup_ctx_magic_order (ctx, cache, n_entries);
+
+  profile = (_magic_flags & XDG_MIME_MAGIC_PROFILE) && cache->magic_stats;
+
   for (j = 0; j < n_entries; j++)
     {
       const char *match;
 
-      match = cache_magic_compare_to_data (cache, offset + 16 * j, 
-					   data, len, prio);
+      k = order ? order->order[j] : j;
+
+      if (profile)
+	{
+	  n_bytes = 0;
+	  match = cache_magic_compare_to_data (cache, offset + 16 * k, 
+					       data, len, prio, &n_bytes);
+	  __sync_fetch_and_add (&cache->magic_stats[k].n_evaluations, 1);
+	  __sync_fetch_and_add (&cache->magic_stats[k].n_bytes, n_bytes);
+	}
+      else
+	match = cache_magic_compare_to_data (cache, offset + 16 * k, 
+					     data, len, prio, NULL);
       if (match)
-	return match;
+	{
+	  if (profile)
+	    __sync_fetch_and_add (&cache->magic_stats[k].n_matches, 1);
+
+	  if (order)
+	    _xdg_mime_magic_order_matched (order, (unsigned int) j, j > 0 &&
+					   GET_UINT32 (cache->buffer, offset + 16 * order->order[j - 1]) == *prio);
+
+	  return match;
+	}
       else
 	{
 	  xdg_uint32_t mimetype_offset;
 	  const char *non_match;
 	  
-	  mimetype_offset = GET_UINT32 (cache->buffer, offset + 16 * j + 4);
+	  mimetype_offset = GET_UINT32 (cache->buffer, offset + 16 * k + 4);
 	  non_match = cache->buffer + mimetype_offset;
 
 	  for (n = 0; n < n_mime_types; n++)
@@ -344,16 +542,11 @@ cache_alias_lookup (const char *alias)
   return NULL;
 }
 
-typedef struct {
-  const char *mime;
-  int weight;
-} MimeWeight;
-
 static int
-cache_glob_lookup_literal (const char *file_name,
-			   const char *mime_types[],
-			   int         n_mime_types,
-			   int         case_sensitive_check)
+cache_glob_lookup_literal (XdgMimeLookupCtx *ctx,
+			   const char       *file_name,
+			   int               case_sensitive_check,
+			   XdgMimeCache    **source)
 {
   const char *ptr;
   int i, min, max, mid, cmp;
@@ -388,9 +581,9 @@ cache_glob_lookup_literal (const char *file_name,
 	      if (case_sensitive_check || !case_sensitive)
 		{
 		  offset = GET_UINT32 (cache->buffer, list_offset + 4 + 12 * mid + 4);
-		  mime_types[0] = (const char *)(cache->buffer + offset);
+		  *source = cache;
 
-		  return 1;
+		  return _xdg_mime_lookup_ctx_add (ctx, cache->buffer + offset, weight);
 		}
 	      return 0;
 	    }
@@ -401,10 +594,10 @@ cache_glob_lookup_literal (const char *file_name,
 }
 
 static int
-cache_glob_lookup_fnmatch (const char *file_name,
-			   MimeWeight  mime_types[],
-			   int         n_mime_types,
-			   int         case_sensitive_check)
+cache_glob_lookup_fnmatch (XdgMimeLookupCtx *ctx,
+			   const char       *file_name,
+			   int               case_sensitive_check,
+			   XdgMimeCache    **source)
 {
   const char *mime_type;
   const char *ptr;
@@ -419,7 +612,7 @@ cache_glob_lookup_fnmatch (const char *file_name,
       xdg_uint32_t list_offset = GET_UINT32 (cache->buffer, 20);
       xdg_uint32_t n_entries = GET_UINT32 (cache->buffer, list_offset);
 
-      for (j = 0; j < n_entries && n < n_mime_types; j++)
+      for (j = 0; j < n_entries; j++)
 	{
 	  xdg_uint32_t offset = GET_UINT32 (cache->buffer, list_offset + 4 + 12 * j);
 	  xdg_uint32_t mimetype_offset = GET_UINT32 (cache->buffer, list_offset + 4 + 12 * j + 4);
@@ -431,31 +624,30 @@ cache_glob_lookup_fnmatch (const char *file_name,
 	  if (case_sensitive_check || !case_sensitive)
 	    {
 	      /* FIXME: Not UTF-8 safe */
-	      if (fnmatch (ptr, file_name, 0) == 0)
-	        {
-	          mime_types[n].mime = mime_type;
-	          mime_types[n].weight = weight;
-	          n++;
-	        }
+	      if (fnmatch (ptr, file_name, 0) == 0 &&
+		  _xdg_mime_lookup_ctx_add (ctx, mime_type, weight))
+	        n++;
 	    }
 	}
 
       if (n > 0)
-	return n;
+	{
+	  *source = cache;
+	  return n;
+	}
     }
   
   return 0;
 }
 
 static int
-cache_glob_node_lookup_suffix (XdgMimeCache  *cache,
-			       xdg_uint32_t   n_entries,
-			       xdg_uint32_t   offset,
-			       const char    *file_name,
-			       int            len,
-			       int            case_sensitive_check,
-			       MimeWeight     mime_types[],
-			       int            n_mime_types)
+cache_glob_node_lookup_suffix (XdgMimeCache     *cache,
+			       xdg_uint32_t      n_entries,
+			       xdg_uint32_t      offset,
+			       const char       *file_name,
+			       int               len,
+			       int               case_sensitive_check,
+			       XdgMimeLookupCtx *ctx)
 {
   xdg_unichar_t character;
   xdg_unichar_t match_char;
@@ -494,13 +686,12 @@ cache_glob_node_lookup_suffix (XdgMimeCache  *cache,
                                                  n_children, child_offset,
                                                  file_name, len, 
                                                  case_sensitive_check,
-                                                 mime_types,
-                                                 n_mime_types);
+                                                 ctx);
             }
           if (n == 0)
             {
 	      i = 0;
-	      while (n < n_mime_types && i < n_children)
+	      while (i < n_children)
 		{
 		  match_char = GET_UINT32 (cache->buffer, child_offset + 12 * i);
 		  if (match_char != 0)
@@ -511,12 +702,9 @@ cache_glob_node_lookup_suffix (XdgMimeCache  *cache,
 		  case_sensitive = weight & 0x100;
 		  weight = weight & 0xff;
 
-		  if (case_sensitive_check || !case_sensitive)
-		    {
-		      mime_types[n].mime = cache->buffer + mimetype_offset;
-		      mime_types[n].weight = weight;
-		      n++;
-		    }
+		  if ((case_sensitive_check || !case_sensitive) &&
+		      _xdg_mime_lookup_ctx_add (ctx, cache->buffer + mimetype_offset, weight))
+		    n++;
 		  i++;
 		}
 	    }
@@ -527,11 +715,11 @@ cache_glob_node_lookup_suffix (XdgMimeCache  *cache,
 }
 
 static int
-cache_glob_lookup_suffix (const char *file_name,
-			  int         len,
-			  int         ignore_case,
-			  MimeWeight  mime_types[],
-			  int         n_mime_types)
+cache_glob_lookup_suffix (XdgMimeLookupCtx *ctx,
+			  const char       *file_name,
+			  int               len,
+			  int               ignore_case,
+			  XdgMimeCache    **source)
 {
   int i, n;
 
@@ -547,91 +735,90 @@ cache_glob_lookup_suffix (const char *file_name,
 					 n_entries, offset, 
 					 file_name, len,
 					 ignore_case,
-					 mime_types,
-					 n_mime_types);
+					 ctx);
       if (n > 0)
-	return n;
+	{
+	  *source = cache;
+	  return n;
+	}
     }
 
   return 0;
 }
 
-static int compare_mime_weight (const void *a, const void *b)
-{
-  const MimeWeight *aa = (const MimeWeight *)a;
-  const MimeWeight *bb = (const MimeWeight *)b;
-
-  return bb->weight - aa->weight;
-}
-
-#define ISUPPER(c)		((c) >= 'A' && (c) <= 'Z')
-static char *
-ascii_tolower (const char *str)
-{
-  char *p, *lower;
-
-  lower = strdup (str);
-  p = lower;
-  while (*p != 0)
-    {
-      char c = *p;
-      *p++ = ISUPPER (c) ? c - 'A' + 'a' : c;
-    }
-  return lower;
-}
-
 static int
-cache_glob_lookup_file_name (const char *file_name, 
-			     const char *mime_types[],
-			     int         n_mime_types)
+cache_glob_lookup_file_name (XdgMimeLookupCtx *ctx,
+			     const char       *file_name, 
+			     XdgMimeDetection *detection)
 {
   int n;
-  MimeWeight mimes[10];
-  int n_mimes = 10;
-  int i;
   int len;
-  char *lower_case;
+  const char *lower_case;
+  XdgMimeCache *source = NULL;
+  XdgMimeStage stage;
+
+  assert (file_name != NULL);
 
-  assert (file_name != NULL && n_mime_types > 0);
+  ctx->n_mimes = 0;
 
   /* First, check the literals */
 
-  lower_case = ascii_tolower (file_name);
+  lower_case = _xdg_mime_lookup_ctx_lower_case (ctx, file_name);
+  if (lower_case == NULL)
+    return 0;
+
+  stage = XDG_MIME_STAGE_LITERAL;
+  n = cache_glob_lookup_literal (ctx, lower_case, FALSE, &source);
+  if (n == 0)
+    n = cache_glob_lookup_literal (ctx, file_name, TRUE, &source);
 
-  n = cache_glob_lookup_literal (lower_case, mime_types, n_mime_types, FALSE);
-  if (n > 0)
+  len = strlen (file_name);
+  if (n == 0)
     {
-      free (lower_case);
-      return n;
+      stage = XDG_MIME_STAGE_SUFFIX;
+      n = cache_glob_lookup_suffix (ctx, lower_case, len, FALSE, &source);
+      if (n == 0)
+	n = cache_glob_lookup_suffix (ctx, file_name, len, TRUE, &source);
     }
 
-  n = cache_glob_lookup_literal (file_name, mime_types, n_mime_types, TRUE);
-  if (n > 0)
+  /* Last, try fnmatch */
+  if (n == 0)
     {
-      free (lower_case);
-      return n;
+      stage = XDG_MIME_STAGE_GLOB;
+      n = cache_glob_lookup_fnmatch (ctx, lower_case, FALSE, &source);
+      if (n == 0)
+	n = cache_glob_lookup_fnmatch (ctx, file_name, TRUE, &source);
     }
 
-  len = strlen (file_name);
-  n = cache_glob_lookup_suffix (lower_case, len, FALSE, mimes, n_mimes);
-  if (n == 0)
-    n = cache_glob_lookup_suffix (file_name, len, TRUE, mimes, n_mimes);
+  _xdg_mime_lookup_ctx_sort (ctx, detection, stage, source ? source->directory : NULL);
 
-  /* Last, try fnmatch */
-  if (n == 0)
-    n = cache_glob_lookup_fnmatch (lower_case, mimes, n_mimes, FALSE);
-  if (n == 0)
-    n = cache_glob_lookup_fnmatch (file_name, mimes, n_mimes, TRUE);
+  return ctx->n_mimes;
+}
+
+int
+_xdg_mime_cache_lookup_file_name (XdgMimeLookupCtx *ctx,
+				  const char       *file_name)
+{
+  return cache_glob_lookup_file_name (ctx, file_name, NULL);
+}
 
-  free (lower_case);
+int
+_xdg_mime_cache_has_literal (XdgMimeLookupCtx *ctx,
+			     const char       *file_name)
+{
+  XdgMimeCache *source;
+  const char *lower_case;
+  int n;
 
-  qsort (mimes, n, sizeof (MimeWeight), compare_mime_weight);
+  ctx->n_mimes = 0;
 
-  if (n_mime_types < n)
-    n = n_mime_types;
+  lower_case = _xdg_mime_lookup_ctx_lower_case (ctx, file_name);
+  if (lower_case == NULL)
+    return 0;
 
-  for (i = 0; i < n; i++)
-    mime_types[i] = mimes[i].mime;
+  n = cache_glob_lookup_literal (ctx, lower_case, FALSE, &source);
+  if (n == 0)
+    n = cache_glob_lookup_literal (ctx, file_name, TRUE, &source);
 
   return n;
 }
@@ -656,13 +843,17 @@ _xdg_mime_cache_get_max_buffer_extents (void)
 }
 
 static const char *
-cache_get_mime_type_for_data (const void *data,
-			      size_t      len,
-			      int        *result_prio,
-			      const char *mime_types[],
-			      int         n_mime_types)
+cache_get_mime_type_for_data (XdgMimeLookupCtx *ctx,
+			      const void       *data,
+			      size_t            len,
+			      int              *result_prio,
+			      const char       *mime_types[],
+			      int               n_mime_types,
+			      XdgMimeDetection *detection)
 {
   const char *mime_type;
+  const char *magic_type;
+  XdgMimeCache *source = NULL;
   int i, n, priority;
 
   priority = 0;
@@ -674,18 +865,30 @@ cache_get_mime_type_for_data (const void *data,
       int prio;
       const char *match;
 
-      match = cache_magic_lookup_data (cache, data, len, &prio, 
+      match = cache_magic_lookup_data (cache, ctx, data, len, &prio, 
 				       mime_types, n_mime_types);
       if (prio > priority)
 	{
 	  priority = prio;
 	  mime_type = match;
+	  source = cache;
 	}
     }
 
+  /* Documents with a generic XML type may be told apart by their root element */
+  magic_type = mime_type;
+  mime_type = _xdg_mime_xml_namespace_refine (data, len, mime_type, &priority);
+
   if (result_prio)
     *result_prio = priority;
 
+  if (detection && priority > 0)
+    {
+      detection->magic_priority = priority;
+      detection->stage = mime_type == magic_type ? XDG_MIME_STAGE_MAGIC : XDG_MIME_STAGE_XML;
+      detection->directory = mime_type == magic_type ? source->directory : NULL;
+    }
+
   if (priority > 0)
     {
       /* Pick glob-result R where mime_type inherits from R */
@@ -710,23 +913,23 @@ cache_get_mime_type_for_data (const void *data,
 }
 
 const char *
-_xdg_mime_cache_get_mime_type_for_data (const void *data,
-					size_t      len,
-					int        *result_prio)
+_xdg_mime_cache_get_mime_type_for_data (XdgMimeLookupCtx *ctx,
+					const void       *data,
+					size_t            len,
+					int              *result_prio)
 {
-  return cache_get_mime_type_for_data (data, len, result_prio, NULL, 0);
+  return cache_get_mime_type_for_data (ctx, data, len, result_prio, NULL, 0, NULL);
 }
 
 const char *
-_xdg_mime_cache_get_mime_type_for_file (const char  *file_name,
-					struct stat *statbuf)
+_xdg_mime_cache_get_mime_type_for_file (XdgMimeLookupCtx *ctx,
+					const char       *file_name,
+					struct stat      *statbuf,
+					XdgMimeDetection *detection)
 {
   const char *mime_type;
-  const char *mime_types[10];
-  FILE *file;
   unsigned char *data;
-  int max_extent;
-  int bytes_read;
+  size_t bytes_read;
   struct stat buf;
   const char *base_name;
   int n;
@@ -738,10 +941,10 @@ _xdg_mime_cache_get_mime_type_for_file (const char  *file_name,
     return NULL;
 
   base_name = _xdg_get_base_name (file_name);
-  n = cache_glob_lookup_file_name (base_name, mime_types, 10);
+  n = cache_glob_lookup_file_name (ctx, base_name, detection);
 
   if (n == 1)
-    return mime_types[0];
+    return ctx->mime_types[0];
 
   if (!statbuf)
     {
@@ -760,57 +963,24 @@ _xdg_mime_cache_get_mime_type_for_file (const char  *file_name,
   /* FIXME: Need to make sure that max_extent isn't totally broken.  This could
    * be large and need getting from a stream instead of just reading it all
    * in. */
-  max_extent = _xdg_mime_cache_get_max_buffer_extents ();
-  data = malloc (max_extent);
+  data = _xdg_mime_lookup_ctx_read_file (ctx, file_name,
+					 _xdg_mime_cache_get_max_buffer_extents (),
+					 &bytes_read);
   if (data == NULL)
     return XDG_MIME_TYPE_UNKNOWN;
-        
-  file = fopen (file_name, "r");
-  if (file == NULL)
-    {
-      free (data);
-      return XDG_MIME_TYPE_UNKNOWN;
-    }
 
-  bytes_read = fread (data, 1, max_extent, file);
-  if (ferror (file))
-    {
-      free (data);
-      fclose (file);
-      return XDG_MIME_TYPE_UNKNOWN;
-    }
+  if (detection)
+    detection->bytes_read = bytes_read;
 
-  mime_type = cache_get_mime_type_for_data (data, bytes_read, NULL,
-					    mime_types, n);
+  mime_type = cache_get_mime_type_for_data (ctx, data, bytes_read, NULL,
+					    ctx->mime_types, n, detection);
 
   if (!mime_type)
     mime_type = _xdg_binary_or_text_fallback(data, bytes_read);
 
-  free (data);
-  fclose (file);
-
   return mime_type;
 }
 
-const char *
-_xdg_mime_cache_get_mime_type_from_file_name (const char *file_name)
-{
-  const char *mime_type;
-
-  if (cache_glob_lookup_file_name (file_name, &mime_type, 1))
-    return mime_type;
-  else
-    return XDG_MIME_TYPE_UNKNOWN;
-}
-
-int
-_xdg_mime_cache_get_mime_types_from_file_name (const char *file_name,
-					       const char  *mime_types[],
-					       int          n_mime_types)
-{
-  return cache_glob_lookup_file_name (file_name, mime_types, n_mime_types);
-}
-
 #if 1
 static int
 is_super_type (const char *mime)
@@ -828,13 +998,42 @@ is_super_type (const char *mime)
 }
 #endif
 
+/* Returns the offset of the parents of mime in cache, 0 if it has none */
+static xdg_uint32_t
+cache_parents_lookup (XdgMimeCache *cache,
+		      const char   *mime)
+{
+  xdg_uint32_t list_offset = GET_UINT32 (cache->buffer, 8);
+  xdg_uint32_t n_entries = GET_UINT32 (cache->buffer, list_offset);
+  xdg_uint32_t offset;
+  int min, max, med, cmp;
+
+  min = 0; 
+  max = n_entries - 1;
+  while (max >= min)
+    {
+      med = (min + max)/2;
+
+      offset = GET_UINT32 (cache->buffer, list_offset + 4 + 8 * med);
+      cmp = strcmp (cache->buffer + offset, mime);
+      if (cmp < 0)
+	min = med + 1;
+      else if (cmp > 0)
+	max = med - 1;
+      else
+	return GET_UINT32 (cache->buffer, list_offset + 4 + 8 * med + 4);
+    }
+
+  return 0;
+}
+
 int
 _xdg_mime_cache_mime_type_subclass (const char *mime,
 				    const char *base)
 {
   const char *umime, *ubase;
 
-  int i, j, min, max, med, cmp;
+  int i, j;
   
   umime = _xdg_mime_cache_unalias_mime_type (mime);
   ubase = _xdg_mime_cache_unalias_mime_type (base);
@@ -863,37 +1062,18 @@ _xdg_mime_cache_mime_type_subclass (const char *mime,
   for (i = 0; _caches[i]; i++)
     {
       XdgMimeCache *cache = _caches[i];
-      
-      xdg_uint32_t list_offset = GET_UINT32 (cache->buffer, 8);
-      xdg_uint32_t n_entries = GET_UINT32 (cache->buffer, list_offset);
       xdg_uint32_t offset, n_parents, parent_offset;
 
-      min = 0; 
-      max = n_entries - 1;
-      while (max >= min)
-	{
-	  med = (min + max)/2;
-	  
-	  offset = GET_UINT32 (cache->buffer, list_offset + 4 + 8 * med);
-	  cmp = strcmp (cache->buffer + offset, umime);
-	  if (cmp < 0)
-	    min = med + 1;
-	  else if (cmp > 0)
-	    max = med - 1;
-	  else
-	    {
-	      offset = GET_UINT32 (cache->buffer, list_offset + 4 + 8 * med + 4);
-	      n_parents = GET_UINT32 (cache->buffer, offset);
-	      
-	      for (j = 0; j < n_parents; j++)
-		{
-		  parent_offset = GET_UINT32 (cache->buffer, offset + 4 + 4 * j);
-		  if (_xdg_mime_cache_mime_type_subclass (cache->buffer + parent_offset, ubase))
-		    return 1;
-		}
+      offset = cache_parents_lookup (cache, umime);
+      if (offset == 0)
+	continue;
 
-	      break;
-	    }
+      n_parents = GET_UINT32 (cache->buffer, offset);
+      for (j = 0; j < n_parents; j++)
+	{
+	  parent_offset = GET_UINT32 (cache->buffer, offset + 4 + 4 * j);
+	  if (_xdg_mime_cache_mime_type_subclass (cache->buffer + parent_offset, ubase))
+	    return 1;
 	}
     }
 
@@ -913,58 +1093,76 @@ _xdg_mime_cache_unalias_mime_type (const char *mime)
   return mime;  
 }
 
-char **
-_xdg_mime_cache_list_mime_parents (const char *mime)
+/* Stores up to n_parents distinct parents of mime and returns how many
+ * there are in total, so the caller can retry with a bigger buffer. */
+int
+_xdg_mime_cache_get_mime_parents (const char *mime,
+				  const char *parents[],
+				  int         n_parents)
 {
+  const char *parent;
+  xdg_uint32_t offset, prev_offset, count, prev_count;
   int i, j, k, l, p;
-  char *all_parents[128]; /* we'll stop at 128 */ 
-  char **result;
 
-  mime = xdg_mime_unalias_mime_type (mime);
+  mime = _xdg_mime_cache_unalias_mime_type (mime);
 
   p = 0;
   for (i = 0; _caches[i]; i++)
     {
       XdgMimeCache *cache = _caches[i];
-  
-      xdg_uint32_t list_offset = GET_UINT32 (cache->buffer, 8);
-      xdg_uint32_t n_entries = GET_UINT32 (cache->buffer, list_offset);
 
-      for (j = 0; j < n_entries; j++)
-	{
-	  xdg_uint32_t mimetype_offset = GET_UINT32 (cache->buffer, list_offset + 4 + 8 * j);
-	  xdg_uint32_t parents_offset = GET_UINT32 (cache->buffer, list_offset + 4 + 8 * j + 4);
+      offset = cache_parents_lookup (cache, mime);
+      if (offset == 0)
+	continue;
 
-	  if (strcmp (cache->buffer + mimetype_offset, mime) == 0)
+      count = GET_UINT32 (cache->buffer, offset);
+      for (k = 0; k < count; k++)
+	{
+	  parent = cache->buffer + GET_UINT32 (cache->buffer, offset + 4 + 4 * k);
+
+	  /* Don't add same parent multiple times.
+	   * This can happen for instance if the same type is listed in multiple directories.
+	   * Only the lists of the preceding caches need to be checked, a single
+	   * cache never lists a parent twice.
+	   */
+	  for (j = 0; j < i; j++)
 	    {
-	      xdg_uint32_t parent_mime_offset;
-	      xdg_uint32_t n_parents = GET_UINT32 (cache->buffer, parents_offset);
+	      prev_offset = cache_parents_lookup (_caches[j], mime);
+	      if (prev_offset == 0)
+		continue;
 
-	      for (k = 0; k < n_parents && p < 127; k++)
-		{
-		  parent_mime_offset = GET_UINT32 (cache->buffer, parents_offset + 4 + 4 * k);
-
-		  /* Don't add same parent multiple times.
-		   * This can happen for instance if the same type is listed in multiple directories
-		   */
-		  for (l = 0; l < p; l++)
-		    {
-		      if (strcmp (all_parents[l], cache->buffer + parent_mime_offset) == 0)
-			break;
-		    }
-
-		  if (l == p)
-		    all_parents[p++] = cache->buffer + parent_mime_offset;
-		}
+	      prev_count = GET_UINT32 (_caches[j]->buffer, prev_offset);
+	      for (l = 0; l < prev_count; l++)
+		if (strcmp (_caches[j]->buffer + GET_UINT32 (_caches[j]->buffer, prev_offset + 4 + 4 * l), parent) == 0)
+		  break;
+
+	      if (l < prev_count)
+		break;
+	    }
 
-	      break;
+	  if (j == i)
+	    {
+	      if (p < n_parents)
+		parents[p] = parent;
+	      p++;
 	    }
 	}
     }
-  all_parents[p++] = NULL;
-  
-  result = (char **) malloc (p * sizeof (char *));
-  memcpy (result, all_parents, p * sizeof (char *));
+
+  return p;
+}
+
+char **
+_xdg_mime_cache_list_mime_parents (const char *mime)
+{
+  char **result;
+  int n;
+
+  n = _xdg_mime_cache_get_mime_parents (mime, NULL, 0);
+
+  result = (char **) malloc ((n + 1) * sizeof (char *));
+  _xdg_mime_cache_get_mime_parents (mime, (const char **) result, n);
+  result[n] = NULL;
 
   return result;
 }
@@ -1019,6 +1217,125 @@ _xdg_mime_cache_get_icon (const char *mime)
   return cache_lookup_icon (mime, 32);
 }
 
+static void
+cache_glob_node_foreach (XdgMimeCache       *cache,
+			 xdg_uint32_t        n_entries,
+			 xdg_uint32_t        offset,
+			 xdg_unichar_t      *path,
+			 int                 depth,
+			 XdgGlobForeachFunc  func,
+			 void               *user_data)
+{
+  xdg_unichar_t character;
+  xdg_uint32_t n_children;
+  xdg_uint32_t child_offset;
+  char glob[256 * 6 + 2];
+  char *p;
+  int i, j, k;
+
+  if (depth >= 256)
+    return;
+
+  for (i = 0; i < n_entries; i++)
+    {
+      character = GET_UINT32 (cache->buffer, offset + 12 * i);
+      n_children = GET_UINT32 (cache->buffer, offset + 12 * i + 4);
+      child_offset = GET_UINT32 (cache->buffer, offset + 12 * i + 8);
+
+      if (character == 0)
+	continue;
+
+      path[depth] = character;
+
+      /* Leaves come first among the children, the tree is built from
+       * reversed suffixes */
+      for (j = 0; j < n_children && GET_UINT32 (cache->buffer, child_offset + 12 * j) == 0; j++)
+	{
+	  if (j == 0)
+	    {
+	      p = glob;
+	      *p++ = '*';
+	      for (k = depth; k >= 0; k--)
+		p += _xdg_ucs4_to_utf8 (path[k], p);
+	      *p = 0;
+	    }
+
+	  func (glob,
+		cache->buffer + GET_UINT32 (cache->buffer, child_offset + 12 * j + 4),
+		GET_UINT32 (cache->buffer, child_offset + 12 * j + 8) & 0xff,
+		user_data);
+	}
+
+      cache_glob_node_foreach (cache, n_children, child_offset, path, depth + 1, func, user_data);
+    }
+}
+
+/* Calls func for every literal, suffix and full glob of all caches */
+void
+_xdg_mime_cache_glob_foreach (XdgGlobForeachFunc  func,
+			      void               *user_data)
+{
+  xdg_unichar_t path[256];
+  xdg_uint32_t list_offset, n_entries, offset;
+  int i, j;
+
+  for (i = 0; _caches[i]; i++)
+    {
+      XdgMimeCache *cache = _caches[i];
+
+      list_offset = GET_UINT32 (cache->buffer, 12);
+      n_entries = GET_UINT32 (cache->buffer, list_offset);
+      for (j = 0; j < n_entries; j++)
+	{
+	  offset = list_offset + 4 + 12 * j;
+	  func (cache->buffer + GET_UINT32 (cache->buffer, offset),
+		cache->buffer + GET_UINT32 (cache->buffer, offset + 4),
+		GET_UINT32 (cache->buffer, offset + 8) & 0xff,
+		user_data);
+	}
+
+      list_offset = GET_UINT32 (cache->buffer, 16);
+      n_entries = GET_UINT32 (cache->buffer, list_offset);
+      offset = GET_UINT32 (cache->buffer, list_offset + 4);
+      cache_glob_node_foreach (cache, n_entries, offset, path, 0, func, user_data);
+
+      list_offset = GET_UINT32 (cache->buffer, 20);
+      n_entries = GET_UINT32 (cache->buffer, list_offset);
+      for (j = 0; j < n_entries; j++)
+	{
+	  offset = list_offset + 4 + 12 * j;
+	  func (cache->buffer + GET_UINT32 (cache->buffer, offset),
+		cache->buffer + GET_UINT32 (cache->buffer, offset + 4),
+		GET_UINT32 (cache->buffer, offset + 8) & 0xff,
+		user_data);
+	}
+    }
+}
+
+/* Calls func for every rootXML rule of cache */
+void
+_xdg_mime_cache_xml_namespace_foreach (XdgMimeCache               *cache,
+				       XdgXmlNamespaceForeachFunc  func,
+				       void                       *user_data)
+{
+  xdg_uint32_t list_offset, n_entries, offset;
+  int j;
+
+  list_offset = GET_UINT32 (cache->buffer, 28);
+  if (list_offset == 0 || list_offset >= cache->size)
+    return;
+
+  n_entries = GET_UINT32 (cache->buffer, list_offset);
+  for (j = 0; j < n_entries; j++)
+    {
+      offset = list_offset + 4 + 12 * j;
+      func (cache->buffer + GET_UINT32 (cache->buffer, offset),
+	    cache->buffer + GET_UINT32 (cache->buffer, offset + 4),
+	    cache->buffer + GET_UINT32 (cache->buffer, offset + 8),
+	    user_data);
+    }
+}
+
 static void
 dump_glob_node (XdgMimeCache *cache,
 		xdg_uint32_t  offset,
@@ -1065,4 +1382,39 @@ _xdg_mime_cache_glob_dump (void)
   }
 }
 
+/* Prints the counters of every magic rule that has been tried.
+ */
+void
+_xdg_mime_cache_magic_dump_profile (void)
+{
+  xdg_uint32_t list_offset, n_entries, offset, k;
+  int i, j;
+
+  for (i = 0; _caches[i]; i++)
+    {
+      XdgMimeCache *cache = _caches[i];
+
+      if (cache->magic_stats == NULL)
+	continue;
 
+      list_offset = GET_UINT32 (cache->buffer, 24);
+      n_entries = GET_UINT32 (cache->buffer, list_offset);
+      offset = GET_UINT32 (cache->buffer, list_offset + 8);
+
+      for (j = 0; j < n_entries; j++)
+	{
+	  k = j;
+
+	  if (cache->magic_stats[k].n_evaluations == 0 && cache->magic_stats[k].n_matches == 0)
+	    continue;
+
+	  printf ("%d %s %lu %lu %lu %s\n",
+		  GET_UINT32 (cache->buffer, offset + 16 * k),
+		  cache->buffer + GET_UINT32 (cache->buffer, offset + 16 * k + 4),
+		  cache->magic_stats[k].n_evaluations,
+		  cache->magic_stats[k].n_matches,
+		  cache->magic_stats[k].n_bytes,
+		  cache->directory);
+	}
+    }
+}
@@ -27,7 +27,8 @@
 #ifndef __XDG_MIME_CACHE_H__
 #define __XDG_MIME_CACHE_H__
 
-#include "xdgmime.h"
+#include "xdgmimeglob.h"
+#include "xdgmimexml.h"
 
 typedef struct _XdgMimeCache XdgMimeCache;
 
@@ -38,32 +39,44 @@ typedef struct _XdgMimeCache XdgMimeCache;
 #define _xdg_mime_cache_get_max_buffer_extents        XDG_RESERVED_ENTRY(cache_get_max_buffer_extents)
 #define _xdg_mime_cache_get_mime_type_for_data        XDG_RESERVED_ENTRY(cache_get_mime_type_for_data)
 #define _xdg_mime_cache_get_mime_type_for_file        XDG_RESERVED_ENTRY(cache_get_mime_type_for_file)
-#define _xdg_mime_cache_get_mime_type_from_file_name  XDG_RESERVED_ENTRY(cache_get_mime_type_from_file_name)
-#define _xdg_mime_cache_get_mime_types_from_file_name XDG_RESERVED_ENTRY(cache_get_mime_types_from_file_name)
+#define _xdg_mime_cache_lookup_file_name              XDG_RESERVED_ENTRY(cache_lookup_file_name)
+#define _xdg_mime_cache_has_literal                   XDG_RESERVED_ENTRY(cache_has_literal)
 #define _xdg_mime_cache_list_mime_parents             XDG_RESERVED_ENTRY(cache_list_mime_parents)
+#define _xdg_mime_cache_get_mime_parents              XDG_RESERVED_ENTRY(cache_get_mime_parents)
 #define _xdg_mime_cache_mime_type_subclass            XDG_RESERVED_ENTRY(cache_mime_type_subclass)
 #define _xdg_mime_cache_unalias_mime_type             XDG_RESERVED_ENTRY(cache_unalias_mime_type)
 #define _xdg_mime_cache_get_icon                      XDG_RESERVED_ENTRY(cache_get_icon)
 #define _xdg_mime_cache_get_generic_icon              XDG_RESERVED_ENTRY(cache_get_generic_icon)
 #define _xdg_mime_cache_glob_dump                     XDG_RESERVED_ENTRY(cache_glob_dump)
+#define _xdg_mime_cache_magic_dump_profile            XDG_RESERVED_ENTRY(cache_magic_dump_profile)
+#define _xdg_mime_cache_glob_foreach                  XDG_RESERVED_ENTRY(cache_glob_foreach)
+#define _xdg_mime_cache_xml_namespace_foreach         XDG_RESERVED_ENTRY(cache_xml_namespace_foreach)
+#define _xdg_mime_cache_get_stamp                     XDG_RESERVED_ENTRY(cache_get_stamp)
 #endif
 
 extern XdgMimeCache **_caches;
 
-XdgMimeCache *_xdg_mime_cache_new_from_file (const char   *file_name);
+XdgMimeCache *_xdg_mime_cache_new_from_file (const char   *file_name,
+					     int           load_flags);
 XdgMimeCache *_xdg_mime_cache_ref           (XdgMimeCache *cache);
 void          _xdg_mime_cache_unref         (XdgMimeCache *cache);
+/* Returns the stamp the writer appended to the cache, or NULL */
+const char   *_xdg_mime_cache_get_stamp     (XdgMimeCache *cache);
 
 
-const char  *_xdg_mime_cache_get_mime_type_for_data       (const void *data,
-		 				           size_t      len,
-							   int        *result_prio);
-const char  *_xdg_mime_cache_get_mime_type_for_file       (const char  *file_name,
-							   struct stat *statbuf);
-int          _xdg_mime_cache_get_mime_types_from_file_name (const char *file_name,
-							    const char  *mime_types[],
-							    int          n_mime_types);
-const char  *_xdg_mime_cache_get_mime_type_from_file_name (const char *file_name);
+const char  *_xdg_mime_cache_get_mime_type_for_data       (XdgMimeLookupCtx *ctx,
+							   const void       *data,
+		 				           size_t            len,
+							   int              *result_prio);
+const char  *_xdg_mime_cache_get_mime_type_for_file       (XdgMimeLookupCtx *ctx,
+							   const char       *file_name,
+							   struct stat      *statbuf,
+							   XdgMimeDetection *detection);
+/* Leaves all candidates in ctx, heaviest first, and returns their number */
+int          _xdg_mime_cache_lookup_file_name             (XdgMimeLookupCtx *ctx,
+							   const char       *file_name);
+int          _xdg_mime_cache_has_literal                  (XdgMimeLookupCtx *ctx,
+							   const char       *file_name);
 int          _xdg_mime_cache_is_valid_mime_type           (const char *mime_type);
 int          _xdg_mime_cache_mime_type_equal              (const char *mime_a,
 						           const char *mime_b);
@@ -72,10 +85,19 @@ int          _xdg_mime_cache_media_type_equal             (const char *mime_a,
 int          _xdg_mime_cache_mime_type_subclass           (const char *mime_a,
 							   const char *mime_b);
 char       **_xdg_mime_cache_list_mime_parents		  (const char *mime);
+int          _xdg_mime_cache_get_mime_parents             (const char *mime,
+							   const char *parents[],
+							   int         n_parents);
 const char  *_xdg_mime_cache_unalias_mime_type            (const char *mime);
 int          _xdg_mime_cache_get_max_buffer_extents       (void);
 const char  *_xdg_mime_cache_get_icon                     (const char *mime);
 const char  *_xdg_mime_cache_get_generic_icon             (const char *mime);
 void         _xdg_mime_cache_glob_dump                    (void);
+void         _xdg_mime_cache_magic_dump_profile           (void);
+void         _xdg_mime_cache_glob_foreach                 (XdgGlobForeachFunc  func,
+							   void               *user_data);
+void         _xdg_mime_cache_xml_namespace_foreach        (XdgMimeCache               *cache,
+							   XdgXmlNamespaceForeachFunc  func,
+							   void                       *user_data);
 
 #endif /* __XDG_MIME_CACHE_H__ */
@@ -0,0 +1,895 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimecachewriter.c: Private file.  Writer for binary mime.cache files.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <xdg/config.h>
+
+#include "xdgmimecachewriter.h"
+#include "xdgmimeint.h"
+#include "xdgmimestrpool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <netinet/in.h> /* for htonl/htons */
+
+#define MAJOR_VERSION 1
+#define MINOR_VERSION 2
+#define HEADER_SIZE   40
+
+/* Optional trailer: offset of the stamp string, then STAMP_MAGIC */
+#define STAMP_MAGIC   "XDGS"
+
+typedef struct WriterPair WriterPair;
+typedef struct WriterGlob WriterGlob;
+typedef struct WriterNamespace WriterNamespace;
+typedef struct WriterMatch WriterMatch;
+typedef struct WriterMatchlet WriterMatchlet;
+typedef struct WriterNode WriterNode;
+
+struct WriterPair
+{
+  const char *key;
+  const char *value;
+  xdg_uint32_t seq;
+};
+
+struct WriterGlob
+{
+  const char *glob;
+  const char *mime_type;
+  xdg_uint32_t weight;
+  xdg_uint32_t seq;
+};
+
+struct WriterNamespace
+{
+  const char *namespace_uri;
+  const char *local_name;
+  const char *mime_type;
+};
+
+struct WriterMatch
+{
+  int priority;
+  const char *mime_type;
+  xdg_uint32_t seq;
+
+  /* Top level matchlets, linked through WriterMatchlet.next */
+  xdg_uint32_t n_matchlets;
+  int first;
+  int last;
+};
+
+struct WriterMatchlet
+{
+  xdg_uint32_t range_start;
+  xdg_uint32_t range_length;
+  xdg_uint32_t word_size;
+  xdg_uint32_t value_length;
+  unsigned char *value;
+  unsigned char *mask;
+
+  xdg_uint32_t n_children;
+  int first_child;
+  int last_child;
+  int next;
+};
+
+/* Node of the reverse suffix tree.  Children are kept sorted by
+ * character with the leaves (character 0) first. */
+struct WriterNode
+{
+  xdg_unichar_t character;
+  const char *mime_type;
+  xdg_uint32_t weight;
+
+  WriterNode *children;
+  xdg_uint32_t n_children;
+  xdg_uint32_t n_children_allocated;
+};
+
+typedef struct
+{
+  WriterPair *pairs;
+  xdg_uint32_t n_pairs;
+  xdg_uint32_t n_pairs_allocated;
+} WriterPairList;
+
+struct XdgMimeCacheWriter
+{
+  XdgStringPool *strings;
+
+  WriterPairList aliases;
+  WriterPairList parents;
+  WriterPairList icons;
+  WriterPairList generic_icons;
+
+  WriterGlob *globs;
+  xdg_uint32_t n_globs;
+  xdg_uint32_t n_globs_allocated;
+
+  WriterNamespace *namespaces;
+  xdg_uint32_t n_namespaces;
+  xdg_uint32_t n_namespaces_allocated;
+
+  WriterMatch *matches;
+  xdg_uint32_t n_matches;
+  xdg_uint32_t n_matches_allocated;
+
+  WriterMatchlet *matchlets;
+  xdg_uint32_t n_matchlets;
+  xdg_uint32_t n_matchlets_allocated;
+
+  char *stamp;
+
+  /* Output buffer and the offsets of the strings already written to it */
+  char *buffer;
+  size_t size;
+  size_t allocated;
+  XdgStringIndex *offsets;
+};
+
+static void *
+writer_grow (void         *array,
+	     xdg_uint32_t  n,
+	     xdg_uint32_t *n_allocated,
+	     size_t        element_size)
+{
+  if (n < *n_allocated)
+    return array;
+
+  *n_allocated = *n_allocated ? *n_allocated * 2 : 16;
+
+  return realloc (array, *n_allocated * element_size);
+}
+
+XdgMimeCacheWriter *
+_xdg_mime_cache_writer_new (void)
+{
+  XdgMimeCacheWriter *writer;
+
+  writer = calloc (1, sizeof (XdgMimeCacheWriter));
+  writer->strings = _xdg_string_pool_new ();
+
+  return writer;
+}
+
+static void
+writer_node_free (WriterNode *node)
+{
+  xdg_uint32_t i;
+
+  for (i = 0; i < node->n_children; i++)
+    writer_node_free (&node->children[i]);
+
+  free (node->children);
+}
+
+void
+_xdg_mime_cache_writer_free (XdgMimeCacheWriter *writer)
+{
+  xdg_uint32_t i;
+
+  for (i = 0; i < writer->n_matchlets; i++)
+    {
+      free (writer->matchlets[i].value);
+      free (writer->matchlets[i].mask);
+    }
+
+  free (writer->aliases.pairs);
+  free (writer->parents.pairs);
+  free (writer->icons.pairs);
+  free (writer->generic_icons.pairs);
+  free (writer->globs);
+  free (writer->namespaces);
+  free (writer->matches);
+  free (writer->matchlets);
+  free (writer->stamp);
+  free (writer->buffer);
+  _xdg_string_pool_free (writer->strings);
+  free (writer);
+}
+
+void
+_xdg_mime_cache_writer_set_stamp (XdgMimeCacheWriter *writer,
+				  const char         *stamp)
+{
+  free (writer->stamp);
+  writer->stamp = stamp ? strdup (stamp) : NULL;
+}
+
+static void
+writer_add_pair (XdgMimeCacheWriter *writer,
+		 WriterPairList     *list,
+		 const char         *key,
+		 const char         *value)
+{
+  WriterPair *pair;
+
+  list->pairs = writer_grow (list->pairs, list->n_pairs, &list->n_pairs_allocated, sizeof (WriterPair));
+  pair = &list->pairs[list->n_pairs];
+  pair->key = _xdg_string_pool_intern (writer->strings, key);
+  pair->value = _xdg_string_pool_intern (writer->strings, value);
+  pair->seq = list->n_pairs++;
+}
+
+void
+_xdg_mime_cache_writer_add_alias (XdgMimeCacheWriter *writer,
+				  const char         *alias,
+				  const char         *mime_type)
+{
+  writer_add_pair (writer, &writer->aliases, alias, mime_type);
+}
+
+void
+_xdg_mime_cache_writer_add_parent (XdgMimeCacheWriter *writer,
+				   const char         *mime_type,
+				   const char         *parent)
+{
+  writer_add_pair (writer, &writer->parents, mime_type, parent);
+}
+
+void
+_xdg_mime_cache_writer_add_icon (XdgMimeCacheWriter *writer,
+				 const char         *mime_type,
+				 const char         *icon)
+{
+  writer_add_pair (writer, &writer->icons, mime_type, icon);
+}
+
+void
+_xdg_mime_cache_writer_add_generic_icon (XdgMimeCacheWriter *writer,
+					 const char         *mime_type,
+					 const char         *icon)
+{
+  writer_add_pair (writer, &writer->generic_icons, mime_type, icon);
+}
+
+/* Case insensitive globs are stored lower cased, as the lookups lower
+ * case the file name before trying them. */
+static char *
+writer_lower_case (const char *str)
+{
+  xdg_unichar_t *ucs4;
+  char *lower, *p;
+  int len, i;
+
+  ucs4 = _xdg_convert_to_ucs4 (str, &len);
+  lower = malloc ((size_t) len * 6 + 1);
+
+  for (i = 0, p = lower; i < len; i++)
+    p += _xdg_ucs4_to_utf8 (_xdg_ucs4_to_lower (ucs4[i]), p);
+  *p = 0;
+
+  free (ucs4);
+
+  return lower;
+}
+
+void
+_xdg_mime_cache_writer_add_glob (XdgMimeCacheWriter *writer,
+				 const char         *glob,
+				 const char         *mime_type,
+				 int                 weight,
+				 int                 case_sensitive)
+{
+  WriterGlob *entry;
+
+  writer->globs = writer_grow (writer->globs, writer->n_globs, &writer->n_globs_allocated, sizeof (WriterGlob));
+  entry = &writer->globs[writer->n_globs];
+
+  if (case_sensitive)
+    entry->glob = _xdg_string_pool_intern (writer->strings, glob);
+  else
+    {
+      char *lower = writer_lower_case (glob);
+      entry->glob = _xdg_string_pool_intern (writer->strings, lower);
+      free (lower);
+    }
+
+  entry->mime_type = _xdg_string_pool_intern (writer->strings, mime_type);
+  entry->weight = (xdg_uint32_t) (weight & 0xff) | (case_sensitive ? 0x100 : 0);
+  entry->seq = writer->n_globs++;
+}
+
+void
+_xdg_mime_cache_writer_add_namespace (XdgMimeCacheWriter *writer,
+				      const char         *namespace_uri,
+				      const char         *local_name,
+				      const char         *mime_type)
+{
+  WriterNamespace *entry;
+
+  writer->namespaces = writer_grow (writer->namespaces, writer->n_namespaces, &writer->n_namespaces_allocated, sizeof (WriterNamespace));
+  entry = &writer->namespaces[writer->n_namespaces++];
+  entry->namespace_uri = _xdg_string_pool_intern (writer->strings, namespace_uri);
+  entry->local_name = _xdg_string_pool_intern (writer->strings, local_name);
+  entry->mime_type = _xdg_string_pool_intern (writer->strings, mime_type);
+}
+
+int
+_xdg_mime_cache_writer_add_magic (XdgMimeCacheWriter *writer,
+				  int                 priority,
+				  const char         *mime_type)
+{
+  WriterMatch *match;
+
+  writer->matches = writer_grow (writer->matches, writer->n_matches, &writer->n_matches_allocated, sizeof (WriterMatch));
+  match = &writer->matches[writer->n_matches];
+  match->priority = priority;
+  match->mime_type = _xdg_string_pool_intern (writer->strings, mime_type);
+  match->seq = writer->n_matches;
+  match->n_matchlets = 0;
+  match->first = -1;
+  match->last = -1;
+
+  return (int) writer->n_matches++;
+}
+
+int
+_xdg_mime_cache_writer_add_matchlet (XdgMimeCacheWriter *writer,
+				     int                 magic,
+				     int                 parent,
+				     unsigned int        range_start,
+				     unsigned int        range_length,
+				     unsigned int        word_size,
+				     const void         *value,
+				     const void         *mask,
+				     unsigned int        value_length)
+{
+  WriterMatchlet *matchlet;
+  xdg_uint32_t *n;
+  int *first, *last;
+  int index;
+
+  writer->matchlets = writer_grow (writer->matchlets, writer->n_matchlets, &writer->n_matchlets_allocated, sizeof (WriterMatchlet));
+  index = (int) writer->n_matchlets++;
+
+  matchlet = &writer->matchlets[index];
+  matchlet->range_start = range_start;
+  matchlet->range_length = range_length ? range_length : 1;
+  matchlet->word_size = word_size;
+  matchlet->value_length = value_length;
+  matchlet->value = malloc (value_length);
+  memcpy (matchlet->value, value, value_length);
+  if (mask)
+    {
+      matchlet->mask = malloc (value_length);
+      memcpy (matchlet->mask, mask, value_length);
+    }
+  else
+    matchlet->mask = NULL;
+  matchlet->n_children = 0;
+  matchlet->first_child = -1;
+  matchlet->last_child = -1;
+  matchlet->next = -1;
+
+  if (parent < 0)
+    {
+      n = &writer->matches[magic].n_matchlets;
+      first = &writer->matches[magic].first;
+      last = &writer->matches[magic].last;
+    }
+  else
+    {
+      n = &writer->matchlets[parent].n_children;
+      first = &writer->matchlets[parent].first_child;
+      last = &writer->matchlets[parent].last_child;
+    }
+
+  if (*last < 0)
+    *first = index;
+  else
+    writer->matchlets[*last].next = index;
+  *last = index;
+  (*n)++;
+
+  return index;
+}
+
+
+/* Output buffer
+ */
+static xdg_uint32_t
+writer_alloc (XdgMimeCacheWriter *writer,
+	      size_t              size)
+{
+  xdg_uint32_t offset = (xdg_uint32_t) ((writer->size + 3) & ~(size_t) 3);
+
+  if (offset + size > writer->allocated)
+    {
+      while (offset + size > writer->allocated)
+	writer->allocated = writer->allocated ? writer->allocated * 2 : 4096;
+      writer->buffer = realloc (writer->buffer, writer->allocated);
+    }
+
+  memset (writer->buffer + writer->size, 0, offset + size - writer->size);
+  writer->size = offset + size;
+
+  return offset;
+}
+
+static void
+writer_put (XdgMimeCacheWriter *writer,
+	    xdg_uint32_t        offset,
+	    xdg_uint32_t        value)
+{
+  value = htonl (value);
+  memcpy (writer->buffer + offset, &value, 4);
+}
+
+static xdg_uint32_t
+writer_data (XdgMimeCacheWriter *writer,
+	     const void         *data,
+	     size_t              len)
+{
+  xdg_uint32_t offset = writer_alloc (writer, len);
+
+  memcpy (writer->buffer + offset, data, len);
+
+  return offset;
+}
+
+/* Writes each pooled string once and returns its offset */
+static xdg_uint32_t
+writer_string (XdgMimeCacheWriter *writer,
+	       const char         *str)
+{
+  int offset = _xdg_string_index_lookup (writer->offsets, str);
+  xdg_uint32_t res;
+
+  if (offset >= 0)
+    return (xdg_uint32_t) offset;
+
+  res = writer_data (writer, str, strlen (str) + 1);
+  _xdg_string_index_insert (writer->offsets, str, (int) res);
+
+  return res;
+}
+
+
+/* Sections
+ */
+static int
+compare_pairs (const void *a,
+	       const void *b)
+{
+  const WriterPair *pa = a;
+  const WriterPair *pb = b;
+  int cmp = strcmp (pa->key, pb->key);
+
+  return cmp ? cmp : (pa->seq > pb->seq) - (pa->seq < pb->seq);
+}
+
+/* Aliases, icons and generic icons: a sorted list of key, value offsets */
+static xdg_uint32_t
+writer_write_pairs (XdgMimeCacheWriter *writer,
+		    WriterPairList     *list)
+{
+  xdg_uint32_t list_offset;
+  xdg_uint32_t i, n;
+
+  qsort (list->pairs, list->n_pairs, sizeof (WriterPair), compare_pairs);
+
+  for (i = 0, n = 0; i < list->n_pairs; i++)
+    if (i == 0 || list->pairs[i].key != list->pairs[i - 1].key)
+      n++;
+
+  list_offset = writer_alloc (writer, 4 + 8 * n);
+  writer_put (writer, list_offset, n);
+
+  for (i = 0, n = 0; i < list->n_pairs; i++)
+    if (i == 0 || list->pairs[i].key != list->pairs[i - 1].key)
+      {
+	writer_put (writer, list_offset + 4 + 8 * n, writer_string (writer, list->pairs[i].key));
+	writer_put (writer, list_offset + 4 + 8 * n + 4, writer_string (writer, list->pairs[i].value));
+	n++;
+      }
+
+  return list_offset;
+}
+
+static xdg_uint32_t
+writer_write_parents (XdgMimeCacheWriter *writer)
+{
+  WriterPair *pairs = writer->parents.pairs;
+  xdg_uint32_t list_offset, parents_offset;
+  xdg_uint32_t i, j, k, n;
+
+  qsort (pairs, writer->parents.n_pairs, sizeof (WriterPair), compare_pairs);
+
+  for (i = 0, n = 0; i < writer->parents.n_pairs; i++)
+    if (i == 0 || pairs[i].key != pairs[i - 1].key)
+      n++;
+
+  list_offset = writer_alloc (writer, 4 + 8 * n);
+  writer_put (writer, list_offset, n);
+
+  for (i = 0, n = 0; i < writer->parents.n_pairs; i = j, n++)
+    {
+      for (j = i + 1; j < writer->parents.n_pairs && pairs[j].key == pairs[i].key; j++) ;
+
+      parents_offset = writer_alloc (writer, 4 + 4 * (j - i));
+      writer_put (writer, parents_offset, j - i);
+      for (k = i; k < j; k++)
+	writer_put (writer, parents_offset + 4 + 4 * (k - i), writer_string (writer, pairs[k].value));
+
+      writer_put (writer, list_offset + 4 + 8 * n, writer_string (writer, pairs[i].key));
+      writer_put (writer, list_offset + 4 + 8 * n + 4, parents_offset);
+    }
+
+  return list_offset;
+}
+
+static int
+compare_globs (const void *a,
+	       const void *b)
+{
+  const WriterGlob *ga = a;
+  const WriterGlob *gb = b;
+  int cmp = strcmp (ga->glob, gb->glob);
+
+  return cmp ? cmp : (ga->seq > gb->seq) - (ga->seq < gb->seq);
+}
+
+static WriterNode *
+writer_node_child (WriterNode    *node,
+		   xdg_unichar_t  character)
+{
+  xdg_uint32_t min, max, mid;
+
+  min = 0;
+  max = node->n_children;
+  while (min < max)
+    {
+      mid = (min + max) / 2;
+      if (node->children[mid].character < character)
+	min = mid + 1;
+      else if (node->children[mid].character > character)
+	max = mid;
+      else
+	return &node->children[mid];
+    }
+
+  node->children = writer_grow (node->children, node->n_children, &node->n_children_allocated, sizeof (WriterNode));
+  memmove (&node->children[min + 1], &node->children[min], (node->n_children - min) * sizeof (WriterNode));
+  node->n_children++;
+
+  memset (&node->children[min], 0, sizeof (WriterNode));
+  node->children[min].character = character;
+
+  return &node->children[min];
+}
+
+static void
+writer_node_insert (WriterNode   *root,
+		    const char   *suffix,
+		    const char   *mime_type,
+		    xdg_uint32_t  weight)
+{
+  WriterNode *node = root;
+  xdg_unichar_t *ucs4;
+  xdg_uint32_t i;
+  int len;
+
+  ucs4 = _xdg_convert_to_ucs4 (suffix, &len);
+  while (len > 0)
+    node = writer_node_child (node, ucs4[--len]);
+  free (ucs4);
+
+  /* Leaves go after the leaves already there, in insertion order */
+  for (i = 0; i < node->n_children && node->children[i].character == 0; i++)
+    if (node->children[i].mime_type == mime_type)
+      return;
+
+  node->children = writer_grow (node->children, node->n_children, &node->n_children_allocated, sizeof (WriterNode));
+  memmove (&node->children[i + 1], &node->children[i], (node->n_children - i) * sizeof (WriterNode));
+  node->n_children++;
+
+  memset (&node->children[i], 0, sizeof (WriterNode));
+  node->children[i].mime_type = mime_type;
+  node->children[i].weight = weight;
+}
+
+static xdg_uint32_t
+writer_write_nodes (XdgMimeCacheWriter *writer,
+		    WriterNode         *nodes,
+		    xdg_uint32_t        n_nodes)
+{
+  xdg_uint32_t offset = writer_alloc (writer, 12 * n_nodes);
+  xdg_uint32_t i;
+
+  for (i = 0; i < n_nodes; i++)
+    if (nodes[i].character == 0)
+      {
+	writer_put (writer, offset + 12 * i + 4, writer_string (writer, nodes[i].mime_type));
+	writer_put (writer, offset + 12 * i + 8, nodes[i].weight);
+      }
+    else
+      {
+	writer_put (writer, offset + 12 * i, nodes[i].character);
+	writer_put (writer, offset + 12 * i + 4, nodes[i].n_children);
+	writer_put (writer, offset + 12 * i + 8, writer_write_nodes (writer, nodes[i].children, nodes[i].n_children));
+      }
+
+  return offset;
+}
+
+static xdg_uint32_t
+writer_write_glob_list (XdgMimeCacheWriter *writer,
+			WriterGlob         *globs,
+			xdg_uint32_t        n_globs)
+{
+  xdg_uint32_t list_offset;
+  xdg_uint32_t i;
+
+  list_offset = writer_alloc (writer, 4 + 12 * n_globs);
+  writer_put (writer, list_offset, n_globs);
+
+  for (i = 0; i < n_globs; i++)
+    {
+      writer_put (writer, list_offset + 4 + 12 * i, writer_string (writer, globs[i].glob));
+      writer_put (writer, list_offset + 4 + 12 * i + 4, writer_string (writer, globs[i].mime_type));
+      writer_put (writer, list_offset + 4 + 12 * i + 8, globs[i].weight);
+    }
+
+  return list_offset;
+}
+
+/* Splits the globs the way update-mime-database does: plain file names
+ * go to the sorted literal list, "*<suffix>" patterns to the reverse
+ * suffix tree and everything else to the fnmatch list. */
+static void
+writer_write_globs (XdgMimeCacheWriter *writer)
+{
+  WriterGlob *literals, *patterns;
+  xdg_uint32_t n_literals = 0, n_patterns = 0;
+  WriterNode root;
+  xdg_uint32_t offset;
+  xdg_uint32_t i;
+
+  literals = malloc ((writer->n_globs + 1) * sizeof (WriterGlob));
+  patterns = malloc ((writer->n_globs + 1) * sizeof (WriterGlob));
+  memset (&root, 0, sizeof (root));
+
+  for (i = 0; i < writer->n_globs; i++)
+    {
+      const char *glob = writer->globs[i].glob;
+
+      if (strpbrk (glob, "*?[") == NULL)
+	literals[n_literals++] = writer->globs[i];
+      else if (glob[0] == '*' && glob[1] && strpbrk (glob + 1, "*?[") == NULL)
+	writer_node_insert (&root, glob + 1, writer->globs[i].mime_type, writer->globs[i].weight);
+      else
+	patterns[n_patterns++] = writer->globs[i];
+    }
+
+  qsort (literals, n_literals, sizeof (WriterGlob), compare_globs);
+  writer_put (writer, 12, writer_write_glob_list (writer, literals, n_literals));
+
+  offset = writer_alloc (writer, 8);
+  writer_put (writer, 16, offset);
+  writer_put (writer, offset, root.n_children);
+  writer_put (writer, offset + 4, writer_write_nodes (writer, root.children, root.n_children));
+
+  writer_put (writer, 20, writer_write_glob_list (writer, patterns, n_patterns));
+
+  writer_node_free (&root);
+  free (literals);
+  free (patterns);
+}
+
+static int
+compare_matches (const void *a,
+		 const void *b)
+{
+  const WriterMatch *ma = a;
+  const WriterMatch *mb = b;
+
+  if (ma->priority != mb->priority)
+    return mb->priority - ma->priority;
+
+  return (ma->seq > mb->seq) - (ma->seq < mb->seq);
+}
+
+static xdg_uint32_t
+writer_write_matchlets (XdgMimeCacheWriter *writer,
+			int                 first,
+			xdg_uint32_t        n_matchlets)
+{
+  xdg_uint32_t offset = writer_alloc (writer, 32 * n_matchlets);
+  WriterMatchlet *matchlet;
+  xdg_uint32_t i;
+  int index;
+
+  for (i = 0, index = first; i < n_matchlets; i++, index = matchlet->next)
+    {
+      xdg_uint32_t base = offset + 32 * i;
+
+      matchlet = &writer->matchlets[index];
+      writer_put (writer, base, matchlet->range_start);
+      writer_put (writer, base + 4, matchlet->range_length);
+      writer_put (writer, base + 8, matchlet->word_size);
+      writer_put (writer, base + 12, matchlet->value_length);
+      writer_put (writer, base + 16, writer_data (writer, matchlet->value, matchlet->value_length));
+      if (matchlet->mask)
+	writer_put (writer, base + 20, writer_data (writer, matchlet->mask, matchlet->value_length));
+      writer_put (writer, base + 24, matchlet->n_children);
+      if (matchlet->n_children)
+	writer_put (writer, base + 28, writer_write_matchlets (writer, matchlet->first_child, matchlet->n_children));
+    }
+
+  return offset;
+}
+
+static void
+writer_write_magic (XdgMimeCacheWriter *writer)
+{
+  xdg_uint32_t list_offset, offset;
+  xdg_uint32_t max_extent = 0;
+  xdg_uint32_t i;
+
+  for (i = 0; i < writer->n_matchlets; i++)
+    {
+      WriterMatchlet *matchlet = &writer->matchlets[i];
+
+      if (matchlet->range_start + matchlet->range_length + matchlet->value_length > max_extent)
+	max_extent = matchlet->range_start + matchlet->range_length + matchlet->value_length;
+    }
+
+  qsort (writer->matches, writer->n_matches, sizeof (WriterMatch), compare_matches);
+
+  list_offset = writer_alloc (writer, 12);
+  writer_put (writer, 24, list_offset);
+  writer_put (writer, list_offset, writer->n_matches);
+  writer_put (writer, list_offset + 4, max_extent);
+
+  offset = writer_alloc (writer, 16 * writer->n_matches);
+  writer_put (writer, list_offset + 8, offset);
+
+  for (i = 0; i < writer->n_matches; i++)
+    {
+      WriterMatch *match = &writer->matches[i];
+
+      writer_put (writer, offset + 16 * i, (xdg_uint32_t) match->priority);
+      writer_put (writer, offset + 16 * i + 4, writer_string (writer, match->mime_type));
+      writer_put (writer, offset + 16 * i + 8, match->n_matchlets);
+      writer_put (writer, offset + 16 * i + 12, writer_write_matchlets (writer, match->first, match->n_matchlets));
+    }
+}
+
+static int
+compare_namespaces (const void *a,
+		    const void *b)
+{
+  const WriterNamespace *na = a;
+  const WriterNamespace *nb = b;
+  int cmp = strcmp (na->namespace_uri, nb->namespace_uri);
+
+  return cmp ? cmp : strcmp (na->local_name, nb->local_name);
+}
+
+static xdg_uint32_t
+writer_write_namespaces (XdgMimeCacheWriter *writer)
+{
+  xdg_uint32_t list_offset;
+  xdg_uint32_t i;
+
+  qsort (writer->namespaces, writer->n_namespaces, sizeof (WriterNamespace), compare_namespaces);
+
+  list_offset = writer_alloc (writer, 4 + 12 * writer->n_namespaces);
+  writer_put (writer, list_offset, writer->n_namespaces);
+
+  for (i = 0; i < writer->n_namespaces; i++)
+    {
+      writer_put (writer, list_offset + 4 + 12 * i, writer_string (writer, writer->namespaces[i].namespace_uri));
+      writer_put (writer, list_offset + 4 + 12 * i + 4, writer_string (writer, writer->namespaces[i].local_name));
+      writer_put (writer, list_offset + 4 + 12 * i + 8, writer_string (writer, writer->namespaces[i].mime_type));
+    }
+
+  return list_offset;
+}
+
+static int
+writer_save (XdgMimeCacheWriter *writer,
+	     const char         *file_name)
+{
+  char *tmp_name;
+  size_t written = 0;
+  ssize_t n = 0;
+  int fd;
+
+  tmp_name = malloc (strlen (file_name) + 8);
+  sprintf (tmp_name, "%s.XXXXXX", file_name);
+
+  fd = mkstemp (tmp_name);
+  if (fd < 0)
+    {
+      free (tmp_name);
+      return FALSE;
+    }
+
+  while (written < writer->size &&
+	 (n = write (fd, writer->buffer + written, writer->size - written)) > 0)
+    written += (size_t) n;
+
+  if (fchmod (fd, 0644) != 0 || close (fd) != 0 || written < writer->size ||
+      rename (tmp_name, file_name) != 0)
+    {
+      unlink (tmp_name);
+      free (tmp_name);
+      return FALSE;
+    }
+
+  free (tmp_name);
+  return TRUE;
+}
+
+int
+_xdg_mime_cache_writer_write (XdgMimeCacheWriter *writer,
+			      const char         *file_name)
+{
+  xdg_uint16_t version[2];
+  int n_strings;
+
+  n_strings = (int) (2 * (writer->aliases.n_pairs + writer->parents.n_pairs +
+			  writer->icons.n_pairs + writer->generic_icons.n_pairs +
+			  writer->n_globs) +
+		     3 * writer->n_namespaces + writer->n_matches);
+
+  writer->size = 0;
+  writer->offsets = _xdg_string_index_new (n_strings);
+
+  writer_alloc (writer, HEADER_SIZE);
+  version[0] = htons (MAJOR_VERSION);
+  version[1] = htons (MINOR_VERSION);
+  memcpy (writer->buffer, version, sizeof (version));
+
+  writer_put (writer, 4, writer_write_pairs (writer, &writer->aliases));
+  writer_put (writer, 8, writer_write_parents (writer));
+  writer_write_globs (writer);
+  writer_write_magic (writer);
+  writer_put (writer, 28, writer_write_namespaces (writer));
+  writer_put (writer, 32, writer_write_pairs (writer, &writer->icons));
+  writer_put (writer, 36, writer_write_pairs (writer, &writer->generic_icons));
+
+  if (writer->stamp)
+    {
+      xdg_uint32_t offset = writer_data (writer, writer->stamp, strlen (writer->stamp) + 1);
+      xdg_uint32_t trailer = writer_alloc (writer, 8);
+
+      writer_put (writer, trailer, offset);
+      memcpy (writer->buffer + trailer + 4, STAMP_MAGIC, 4);
+    }
+
+  _xdg_string_index_free (writer->offsets);
+  writer->offsets = NULL;
+
+  return writer_save (writer, file_name);
+}
@@ -0,0 +1,96 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimecachewriter.h: Private file.  Writer for binary mime.cache files.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __XDG_MIME_CACHE_WRITER_H__
+#define __XDG_MIME_CACHE_WRITER_H__
+
+#include "xdgmime.h"
+
+typedef struct XdgMimeCacheWriter XdgMimeCacheWriter;
+
+#ifdef XDG_PREFIX
+#define _xdg_mime_cache_writer_new               XDG_RESERVED_ENTRY(cache_writer_new)
+#define _xdg_mime_cache_writer_free              XDG_RESERVED_ENTRY(cache_writer_free)
+#define _xdg_mime_cache_writer_add_alias         XDG_RESERVED_ENTRY(cache_writer_add_alias)
+#define _xdg_mime_cache_writer_add_parent        XDG_RESERVED_ENTRY(cache_writer_add_parent)
+#define _xdg_mime_cache_writer_add_glob          XDG_RESERVED_ENTRY(cache_writer_add_glob)
+#define _xdg_mime_cache_writer_add_magic         XDG_RESERVED_ENTRY(cache_writer_add_magic)
+#define _xdg_mime_cache_writer_add_matchlet      XDG_RESERVED_ENTRY(cache_writer_add_matchlet)
+#define _xdg_mime_cache_writer_add_namespace     XDG_RESERVED_ENTRY(cache_writer_add_namespace)
+#define _xdg_mime_cache_writer_add_icon          XDG_RESERVED_ENTRY(cache_writer_add_icon)
+#define _xdg_mime_cache_writer_add_generic_icon  XDG_RESERVED_ENTRY(cache_writer_add_generic_icon)
+#define _xdg_mime_cache_writer_set_stamp         XDG_RESERVED_ENTRY(cache_writer_set_stamp)
+#define _xdg_mime_cache_writer_write             XDG_RESERVED_ENTRY(cache_writer_write)
+#endif
+
+XdgMimeCacheWriter *_xdg_mime_cache_writer_new              (void);
+void                _xdg_mime_cache_writer_free             (XdgMimeCacheWriter *writer);
+void                _xdg_mime_cache_writer_add_alias        (XdgMimeCacheWriter *writer,
+							     const char         *alias,
+							     const char         *mime_type);
+void                _xdg_mime_cache_writer_add_parent       (XdgMimeCacheWriter *writer,
+							     const char         *mime_type,
+							     const char         *parent);
+void                _xdg_mime_cache_writer_add_glob         (XdgMimeCacheWriter *writer,
+							     const char         *glob,
+							     const char         *mime_type,
+							     int                 weight,
+							     int                 case_sensitive);
+/* Returns a handle for _xdg_mime_cache_writer_add_matchlet() */
+int                 _xdg_mime_cache_writer_add_magic        (XdgMimeCacheWriter *writer,
+							     int                 priority,
+							     const char         *mime_type);
+/* Adds a matchlet to the rule magic, below the matchlet parent unless
+ * parent is -1.  mask may be NULL.  Returns a handle usable as parent. */
+int                 _xdg_mime_cache_writer_add_matchlet     (XdgMimeCacheWriter *writer,
+							     int                 magic,
+							     int                 parent,
+							     unsigned int        range_start,
+							     unsigned int        range_length,
+							     unsigned int        word_size,
+							     const void         *value,
+							     const void         *mask,
+							     unsigned int        value_length);
+void                _xdg_mime_cache_writer_add_namespace    (XdgMimeCacheWriter *writer,
+							     const char         *namespace_uri,
+							     const char         *local_name,
+							     const char         *mime_type);
+void                _xdg_mime_cache_writer_add_icon         (XdgMimeCacheWriter *writer,
+							     const char         *mime_type,
+							     const char         *icon);
+void                _xdg_mime_cache_writer_add_generic_icon (XdgMimeCacheWriter *writer,
+							     const char         *mime_type,
+							     const char         *icon);
+/* Appends stamp after the sections, readers of the cache ignore it and
+ * _xdg_mime_cache_get_stamp() returns it. */
+void                _xdg_mime_cache_writer_set_stamp        (XdgMimeCacheWriter *writer,
+							     const char         *stamp);
+/* Atomically replaces file_name.  Returns TRUE on success. */
+int                 _xdg_mime_cache_writer_write            (XdgMimeCacheWriter *writer,
+							     const char         *file_name);
+
+#endif /* __XDG_MIME_CACHE_WRITER_H__ */
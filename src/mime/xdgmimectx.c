@@ -0,0 +1,331 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimectx.c: Private per thread scratch space of the lookups.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <xdg/config.h>
+
+#include "xdgmimectx.h"
+#include "xdgmimeint.h"
+#include "xdgmimemagic.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+void
+_xdg_mime_lookup_ctx_init (XdgMimeLookupCtx *ctx)
+{
+  memset (ctx, 0, sizeof (XdgMimeLookupCtx));
+
+  ctx->mimes = ctx->mimes_inline;
+  ctx->mime_types = ctx->mime_types_inline;
+  ctx->n_mimes_allocated = XDG_MIME_LOOKUP_CTX_INLINE;
+}
+
+void
+_xdg_mime_lookup_ctx_clear (XdgMimeLookupCtx *ctx)
+{
+  int i;
+
+  if (ctx->mimes != ctx->mimes_inline)
+    {
+      free (ctx->mimes);
+      free (ctx->mime_types);
+    }
+
+  free (ctx->lower_case);
+  free (ctx->data);
+
+  for (i = 0; i < ctx->n_magic_orders; i++)
+    free (ctx->magic_orders[i].n_matches);
+  free (ctx->magic_orders);
+}
+
+int
+_xdg_mime_lookup_ctx_add (XdgMimeLookupCtx *ctx,
+			  const char       *mime,
+			  int               weight)
+{
+  if (ctx->n_mimes == ctx->n_mimes_allocated)
+    {
+      int n_allocated = ctx->n_mimes_allocated * 2;
+      XdgMimeWeight *mimes;
+      const char **mime_types;
+
+      if (ctx->mimes == ctx->mimes_inline)
+	{
+	  mimes = malloc (sizeof (XdgMimeWeight) * n_allocated);
+	  mime_types = malloc (sizeof (char *) * n_allocated);
+	  if (mimes == NULL || mime_types == NULL)
+	    {
+	      free (mimes);
+	      free (mime_types);
+	      return FALSE;
+	    }
+	  memcpy (mimes, ctx->mimes, sizeof (XdgMimeWeight) * ctx->n_mimes);
+	}
+      else
+	{
+	  mimes = realloc (ctx->mimes, sizeof (XdgMimeWeight) * n_allocated);
+	  if (mimes == NULL)
+	    return FALSE;
+	  ctx->mimes = mimes;
+
+	  mime_types = realloc (ctx->mime_types, sizeof (char *) * n_allocated);
+	  if (mime_types == NULL)
+	    return FALSE;
+	}
+
+      ctx->mimes = mimes;
+      ctx->mime_types = mime_types;
+      ctx->n_mimes_allocated = n_allocated;
+      ctx->stats.n_allocations++;
+    }
+
+  ctx->mimes[ctx->n_mimes].mime = mime;
+  ctx->mimes[ctx->n_mimes].weight = weight;
+  ctx->n_mimes++;
+
+  return TRUE;
+}
+
+static int
+compare_mime_weight (const void *a, const void *b)
+{
+  const XdgMimeWeight *aa = (const XdgMimeWeight *)a;
+  const XdgMimeWeight *bb = (const XdgMimeWeight *)b;
+
+  return bb->weight - aa->weight;
+}
+
+void
+_xdg_mime_lookup_ctx_sort (XdgMimeLookupCtx *ctx,
+			   XdgMimeDetection *detection,
+			   XdgMimeStage      stage,
+			   const char       *directory)
+{
+  int i, n = ctx->n_mimes;
+
+  qsort (ctx->mimes, n, sizeof (XdgMimeWeight), compare_mime_weight);
+
+  for (i = 0; i < n; i++)
+    ctx->mime_types[i] = ctx->mimes[i].mime;
+
+  ctx->stats.n_candidates += n;
+  if (ctx->stats.max_candidates < n)
+    ctx->stats.max_candidates = n;
+
+  if (detection)
+    {
+      detection->stage = n > 0 ? stage : XDG_MIME_STAGE_NONE;
+      detection->directory = directory;
+
+      /* The context keeps the candidates beyond these */
+      if (n > XDG_MIME_DETECTION_MAX_CANDIDATES)
+	n = XDG_MIME_DETECTION_MAX_CANDIDATES;
+
+      detection->n_candidates = n;
+      for (i = 0; i < n; i++)
+	{
+	  detection->candidates[i] = ctx->mimes[i].mime;
+	  detection->weights[i] = ctx->mimes[i].weight;
+	}
+    }
+}
+
+int
+_xdg_mime_lookup_ctx_copy (XdgMimeLookupCtx *ctx,
+			   const char       *mime_types[],
+			   int               n_mime_types)
+{
+  int n = ctx->n_mimes;
+
+  if (n_mime_types < n)
+    n = n_mime_types;
+
+  memcpy (mime_types, ctx->mime_types, sizeof (char *) * n);
+
+  return n;
+}
+
+#define ISUPPER(c)		((c) >= 'A' && (c) <= 'Z')
+const char *
+_xdg_mime_lookup_ctx_lower_case (XdgMimeLookupCtx *ctx,
+				 const char       *str)
+{
+  size_t len = strlen (str) + 1;
+  char *p;
+
+  if (ctx->lower_case_allocated < len)
+    {
+      size_t allocated = ctx->lower_case_allocated ? ctx->lower_case_allocated : 64;
+
+      while (allocated < len)
+	allocated *= 2;
+
+      p = realloc (ctx->lower_case, allocated);
+      if (p == NULL)
+	return NULL;
+
+      ctx->lower_case = p;
+      ctx->lower_case_allocated = allocated;
+      ctx->stats.n_allocations++;
+    }
+
+  for (p = ctx->lower_case; *str != 0; str++)
+    *p++ = ISUPPER (*str) ? *str - 'A' + 'a' : *str;
+  *p = 0;
+
+  return ctx->lower_case;
+}
+
+unsigned char *
+_xdg_mime_lookup_ctx_read_file (XdgMimeLookupCtx *ctx,
+				const char       *file_name,
+				size_t            size,
+				size_t           *bytes_read)
+{
+  unsigned char *data;
+  size_t n = 0;
+  ssize_t r;
+  int fd;
+
+  /* The magic extents of the rules do not change until the database is
+   * reloaded, so this is only reallocated for the first file. */
+  if (ctx->data_allocated < size || ctx->data == NULL)
+    {
+      data = realloc (ctx->data, size ? size : 1);
+      if (data == NULL)
+	return NULL;
+
+      ctx->data = data;
+      ctx->data_allocated = size;
+      ctx->stats.n_allocations++;
+    }
+
+  fd = open (file_name, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  while (n < size)
+    {
+      r = read (fd, ctx->data + n, size - n);
+      if (r < 0 && errno == EINTR)
+	continue;
+      if (r < 0)
+	{
+	  close (fd);
+	  return NULL;
+	}
+      if (r == 0)
+	break;
+      n += r;
+    }
+
+  close (fd);
+
+  ctx->stats.n_files_read++;
+  ctx->stats.n_bytes_read += n;
+
+  *bytes_read = n;
+  return ctx->data;
+}
+
+int
+_xdg_mime_lookup_ctx_reorder (XdgMimeLookupCtx *ctx)
+{
+  return ctx && ((_magic_flags | ctx->magic_flags) & XDG_MIME_MAGIC_REORDER);
+}
+
+XdgMimeMagicOrder *
+_xdg_mime_lookup_ctx_magic_order (XdgMimeLookupCtx *ctx,
+				  const void       *database,
+				  unsigned int      n_rules)
+{
+  XdgMimeMagicOrder *order;
+  unsigned int k;
+  int i;
+
+  for (i = 0; i < ctx->n_magic_orders; i++)
+    if (ctx->magic_orders[i].database == database)
+      break;
+
+  if (i == ctx->n_magic_orders)
+    {
+      order = realloc (ctx->magic_orders, sizeof (XdgMimeMagicOrder) * (size_t) (i + 1));
+      if (order == NULL)
+	return NULL;
+
+      memset (&order[i], 0, sizeof (XdgMimeMagicOrder));
+      order[i].database = database;
+      ctx->magic_orders = order;
+      ctx->n_magic_orders++;
+    }
+
+  order = &ctx->magic_orders[i];
+
+  /* A database reloaded at the same address starts over */
+  if (order->n_matches == NULL || order->generation != _xdg_mime_generation)
+    {
+      free (order->n_matches);
+      order->n_rules = 0;
+
+      order->n_matches = malloc ((sizeof (unsigned long) + sizeof (unsigned int)) * n_rules);
+      if (order->n_matches == NULL)
+	return NULL;
+
+      order->order = (unsigned int *) (order->n_matches + n_rules);
+      order->generation = _xdg_mime_generation;
+      order->n_rules = n_rules;
+      for (k = 0; k < n_rules; k++)
+	{
+	  order->order[k] = k;
+	  order->n_matches[k] = 0;
+	}
+
+      ctx->stats.n_allocations++;
+    }
+
+  return order;
+}
+
+void
+_xdg_mime_magic_order_matched (XdgMimeMagicOrder *order,
+			       unsigned int       i,
+			       int                same_priority)
+{
+  unsigned int k = order->order[i];
+
+  order->n_matches[k]++;
+
+  if (same_priority && order->n_matches[order->order[i - 1]] < order->n_matches[k])
+    {
+      order->order[i] = order->order[i - 1];
+      order->order[i - 1] = k;
+    }
+}
@@ -0,0 +1,136 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimectx.h: Private per thread scratch space of the lookups.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef __XDG_MIME_CTX_H__
+#define __XDG_MIME_CTX_H__
+
+#include "xdgmime.h"
+
+/* Glob results carry inline storage for this many candidates, enough
+ * for every file name of the shared database. */
+#define XDG_MIME_LOOKUP_CTX_INLINE 10
+
+typedef struct {
+  const char *mime;
+  int weight;
+} XdgMimeWeight;
+
+/* Order a context tries the magic rules of one database in with
+ * XDG_MIME_MAGIC_REORDER, and how often each rule matched. */
+typedef struct {
+  const void    *database;
+  unsigned int   generation;
+  unsigned int   n_rules;
+  unsigned int  *order;
+  unsigned long *n_matches;
+} XdgMimeMagicOrder;
+
+struct XdgMimeLookupCtx
+{
+  /* Glob candidates of the last file name lookup, heaviest first once
+   * sorted, and the same types on their own for the magic stage */
+  XdgMimeWeight *mimes;
+  const char   **mime_types;
+  int            n_mimes;
+  int            n_mimes_allocated;
+
+  char          *lower_case;
+  size_t         lower_case_allocated;
+
+  unsigned char *data;
+  size_t         data_allocated;
+
+  XdgMimeLookupStats stats;
+
+  /* XdgMimeMagicFlags of the lookups in addition to the global ones,
+   * and the order of the rules of every database they reordered */
+  int                magic_flags;
+  XdgMimeMagicOrder *magic_orders;
+  int                n_magic_orders;
+
+  XdgMimeWeight  mimes_inline[XDG_MIME_LOOKUP_CTX_INLINE];
+  const char    *mime_types_inline[XDG_MIME_LOOKUP_CTX_INLINE];
+};
+
+#ifdef XDG_PREFIX
+#define _xdg_mime_lookup_ctx_init       XDG_RESERVED_ENTRY(lookup_ctx_init)
+#define _xdg_mime_lookup_ctx_clear      XDG_RESERVED_ENTRY(lookup_ctx_clear)
+#define _xdg_mime_lookup_ctx_add        XDG_RESERVED_ENTRY(lookup_ctx_add)
+#define _xdg_mime_lookup_ctx_sort       XDG_RESERVED_ENTRY(lookup_ctx_sort)
+#define _xdg_mime_lookup_ctx_copy       XDG_RESERVED_ENTRY(lookup_ctx_copy)
+#define _xdg_mime_lookup_ctx_lower_case XDG_RESERVED_ENTRY(lookup_ctx_lower_case)
+#define _xdg_mime_lookup_ctx_read_file  XDG_RESERVED_ENTRY(lookup_ctx_read_file)
+#define _xdg_mime_lookup_ctx_reorder    XDG_RESERVED_ENTRY(lookup_ctx_reorder)
+#define _xdg_mime_lookup_ctx_magic_order XDG_RESERVED_ENTRY(lookup_ctx_magic_order)
+#define _xdg_mime_magic_order_matched   XDG_RESERVED_ENTRY(magic_order_matched)
+#define _xdg_mime_generation            XDG_RESERVED_ENTRY(generation)
+#endif
+
+/* Incremented whenever the databases are (re)loaded */
+extern unsigned int _xdg_mime_generation;
+
+/* For contexts living on the stack of the functions without one */
+void           _xdg_mime_lookup_ctx_init       (XdgMimeLookupCtx *ctx);
+void           _xdg_mime_lookup_ctx_clear      (XdgMimeLookupCtx *ctx);
+/* Appends a glob candidate, returns FALSE if out of memory */
+int            _xdg_mime_lookup_ctx_add        (XdgMimeLookupCtx *ctx,
+						const char       *mime,
+						int               weight);
+/* Orders the candidates heaviest first and describes them in detection
+ * (may be NULL), directory is the one of the rules they came from. */
+void           _xdg_mime_lookup_ctx_sort       (XdgMimeLookupCtx *ctx,
+						XdgMimeDetection *detection,
+						XdgMimeStage      stage,
+						const char       *directory);
+/* Stores up to n_mime_types candidates, returns how many were stored */
+int            _xdg_mime_lookup_ctx_copy       (XdgMimeLookupCtx *ctx,
+						const char       *mime_types[],
+						int               n_mime_types);
+/* Returns an ASCII lowercase copy of str, valid until the next call */
+const char    *_xdg_mime_lookup_ctx_lower_case (XdgMimeLookupCtx *ctx,
+						const char       *str);
+/* Reads up to size bytes from the start of file_name into the context,
+ * returns them or NULL on errors. */
+unsigned char *_xdg_mime_lookup_ctx_read_file  (XdgMimeLookupCtx *ctx,
+						const char       *file_name,
+						size_t            size,
+						size_t           *bytes_read);
+/* Returns TRUE if lookups with ctx (may be NULL) reorder magic rules */
+int            _xdg_mime_lookup_ctx_reorder    (XdgMimeLookupCtx *ctx);
+/* Returns the order ctx tries the n_rules magic rules of database in,
+ * or NULL if out of memory. */
+XdgMimeMagicOrder *_xdg_mime_lookup_ctx_magic_order (XdgMimeLookupCtx *ctx,
+						const void       *database,
+						unsigned int      n_rules);
+/* Counts a match of the rule tried i-th and moves it one step ahead if
+ * the rule before has the same priority and matched less often. */
+void           _xdg_mime_magic_order_matched   (XdgMimeMagicOrder *order,
+						unsigned int       i,
+						int                same_priority);
+
+#endif /* __XDG_MIME_CTX_H__ */
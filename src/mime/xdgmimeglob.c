@@ -30,6 +30,8 @@
 
 #include "xdgmimeglob.h"
 #include "xdgmimeint.h"
+#include "xdgmimectx.h"
+#include "xdgmimestrpool.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
@@ -70,6 +72,7 @@ struct XdgGlobHash
   XdgGlobList *literal_list;
   XdgGlobHashNode *simple_node;
   XdgGlobList *full_list;
+  XdgStringPool *strings; /* every glob and mime type */
 };
 
 
@@ -96,20 +99,16 @@ _xdg_glob_list_free (XdgGlobList *glob_list)
   while (ptr != NULL)
     {
       next = ptr->next;
-
-      if (ptr->data)
-	free ((void *) ptr->data);
-      if (ptr->mime_type)
-	free ((void *) ptr->mime_type);
       free (ptr);
 
       ptr = next;
     }
 }
 
+/* data and mime_type are interned */
 static XdgGlobList *
 _xdg_glob_list_append (XdgGlobList *glob_list,
-		       void        *data,
+		       const char  *data,
 		       const char  *mime_type,
 		       int          weight,
 		       int          case_sensitive)
@@ -120,8 +119,8 @@ _xdg_glob_list_append (XdgGlobList *glob_list,
   tmp_element = glob_list;
   while (tmp_element != NULL)
     {
-      if (strcmp (tmp_element->data, data) == 0 &&
-	  strcmp (tmp_element->mime_type, mime_type) == 0)
+      if (tmp_element->data == data &&
+	  tmp_element->mime_type == mime_type)
 	return glob_list;
 
       tmp_element = tmp_element->next;
@@ -265,7 +264,7 @@ _xdg_glob_hash_insert_ucs4 (XdgGlobHashNode *glob_hash_node,
 		{
 		  child = _xdg_glob_hash_node_new ();
 		  child->character = 0;
-		  child->mime_type = strdup (mime_type);
+		  child->mime_type = mime_type;
 		  child->weight = weight;
 		  child->case_sensitive = case_sensitive;
 		  child->child = NULL;
@@ -276,7 +275,7 @@ _xdg_glob_hash_insert_ucs4 (XdgGlobHashNode *glob_hash_node,
 	}
       else
 	{
-	  node->mime_type = strdup (mime_type);
+	  node->mime_type = mime_type;
 	  node->weight = weight;
 	  node->case_sensitive = case_sensitive;
 	}
@@ -307,18 +306,12 @@ _xdg_glob_hash_insert_text (XdgGlobHashNode *glob_hash_node,
   return node;
 }
 
-typedef struct {
-  const char *mime;
-  int weight;
-} MimeWeight;
-
 static int
-_xdg_glob_hash_node_lookup_file_name (XdgGlobHashNode *glob_hash_node,
-				      const char      *file_name,
-				      int              len,
-				      int              case_sensitive_check,
-				      MimeWeight       mime_types[],
-				      int              n_mime_types)
+_xdg_glob_hash_node_lookup_file_name (XdgGlobHashNode  *glob_hash_node,
+				      const char       *file_name,
+				      int               len,
+				      int               case_sensitive_check,
+				      XdgMimeLookupCtx *ctx)
 {
   int n;
   XdgGlobHashNode *node;
@@ -341,30 +334,23 @@ _xdg_glob_hash_node_lookup_file_name (XdgGlobHashNode *glob_hash_node,
 							file_name,
 							len,
 							case_sensitive_check,
-							mime_types,
-							n_mime_types);
+							ctx);
 	    }
 	  if (n == 0)
 	    {
               if (node->mime_type &&
 		  (case_sensitive_check ||
-		   !node->case_sensitive))
-                {
-	          mime_types[n].mime = node->mime_type;
-		  mime_types[n].weight = node->weight;
-		  n++; 
-                }
+		   !node->case_sensitive) &&
+		  _xdg_mime_lookup_ctx_add (ctx, node->mime_type, node->weight))
+		n++; 
 	      node = node->child;
-	      while (n < n_mime_types && node && node->character == 0)
+	      while (node && node->character == 0)
 		{
                   if (node->mime_type &&
 		      (case_sensitive_check ||
-		       !node->case_sensitive))
-		    {
-		      mime_types[n].mime = node->mime_type;
-		      mime_types[n].weight = node->weight;
-		      n++;
-		    }
+		       !node->case_sensitive) &&
+		      _xdg_mime_lookup_ctx_add (ctx, node->mime_type, node->weight))
+		    n++;
 		  node = node->next;
 		}
 	    }
@@ -375,107 +361,99 @@ _xdg_glob_hash_node_lookup_file_name (XdgGlobHashNode *glob_hash_node,
   return 0;
 }
 
-static int compare_mime_weight (const void *a, const void *b)
+static int
+glob_hash_lookup_literal (XdgGlobHash      *glob_hash,
+			  XdgMimeLookupCtx *ctx,
+			  const char       *file_name,
+			  const char       *lower_case)
 {
-  const MimeWeight *aa = (const MimeWeight *)a;
-  const MimeWeight *bb = (const MimeWeight *)b;
+  XdgGlobList *list;
+
+  for (list = glob_hash->literal_list; list; list = list->next)
+    {
+      if (strcmp ((const char *)list->data, file_name) == 0)
+	return _xdg_mime_lookup_ctx_add (ctx, list->mime_type, list->weight);
+    }
+
+  for (list = glob_hash->literal_list; list; list = list->next)
+    {
+      if (!list->case_sensitive &&
+	  strcmp ((const char *)list->data, lower_case) == 0)
+	return _xdg_mime_lookup_ctx_add (ctx, list->mime_type, list->weight);
+    }
 
-  return bb->weight - aa->weight;
+  return 0;
 }
 
-#define ISUPPER(c)		((c) >= 'A' && (c) <= 'Z')
-static char *
-ascii_tolower (const char *str)
+int
+_xdg_glob_hash_has_literal (XdgGlobHash      *glob_hash,
+			    XdgMimeLookupCtx *ctx,
+			    const char       *file_name)
 {
-  char *p, *lower;
+  const char *lower_case;
 
-  lower = strdup (str);
-  p = lower;
-  while (*p != 0)
-    {
-      char c = *p;
-      *p++ = ISUPPER (c) ? c - 'A' + 'a' : c;
-    }
-  return lower;
+  ctx->n_mimes = 0;
+
+  lower_case = _xdg_mime_lookup_ctx_lower_case (ctx, file_name);
+  if (lower_case == NULL)
+    return 0;
+
+  return glob_hash_lookup_literal (glob_hash, ctx, file_name, lower_case);
 }
 
 int
-_xdg_glob_hash_lookup_file_name (XdgGlobHash *glob_hash,
-				 const char  *file_name,
-				 const char  *mime_types[],
-				 int          n_mime_types)
+_xdg_glob_hash_lookup_file_name (XdgGlobHash      *glob_hash,
+				 XdgMimeLookupCtx *ctx,
+				 const char       *file_name,
+				 XdgMimeDetection *detection)
 {
   XdgGlobList *list;
-  int i, n;
-  MimeWeight mimes[10];
-  int n_mimes = 10;
+  int n;
   int len;
-  char *lower_case;
+  const char *lower_case;
+  XdgMimeStage stage;
 
   /* First, check the literals */
 
-  assert (file_name != NULL && n_mime_types > 0);
+  assert (file_name != NULL);
 
-  n = 0;
+  ctx->n_mimes = 0;
 
-  lower_case = ascii_tolower (file_name);
+  stage = XDG_MIME_STAGE_LITERAL;
 
-  for (list = glob_hash->literal_list; list; list = list->next)
-    {
-      if (strcmp ((const char *)list->data, file_name) == 0)
-	{
-	  mime_types[0] = list->mime_type;
-	  free (lower_case);
-	  return 1;
-	}
-    }
-
-  for (list = glob_hash->literal_list; list; list = list->next)
-    {
-      if (!list->case_sensitive &&
-	  strcmp ((const char *)list->data, lower_case) == 0)
-	{
-	  mime_types[0] = list->mime_type;
-	  free (lower_case);
-	  return 1;
-	}
-    }
+  lower_case = _xdg_mime_lookup_ctx_lower_case (ctx, file_name);
+  if (lower_case == NULL)
+    return 0;
 
+  n = glob_hash_lookup_literal (glob_hash, ctx, file_name, lower_case);
 
   len = strlen (file_name);
-  n = _xdg_glob_hash_node_lookup_file_name (glob_hash->simple_node, lower_case, len, FALSE,
-					    mimes, n_mimes);
   if (n == 0)
-    n = _xdg_glob_hash_node_lookup_file_name (glob_hash->simple_node, file_name, len, TRUE,
-					      mimes, n_mimes);
+    {
+      stage = XDG_MIME_STAGE_SUFFIX;
+      n = _xdg_glob_hash_node_lookup_file_name (glob_hash->simple_node, lower_case, len, FALSE,
+						ctx);
+      if (n == 0)
+	n = _xdg_glob_hash_node_lookup_file_name (glob_hash->simple_node, file_name, len, TRUE,
+						  ctx);
+    }
 
   if (n == 0)
     {
-      for (list = glob_hash->full_list; list && n < n_mime_types; list = list->next)
+      stage = XDG_MIME_STAGE_GLOB;
+      for (list = glob_hash->full_list; list; list = list->next)
         {
           if (fnmatch ((const char *)list->data, file_name, 0) == 0)
-	    {
-	      mimes[n].mime = list->mime_type;
-	      mimes[n].weight = list->weight;
-	      n++;
-	    }
+	    _xdg_mime_lookup_ctx_add (ctx, list->mime_type, list->weight);
         }
     }
-  free (lower_case);
-
-  qsort (mimes, n, sizeof (MimeWeight), compare_mime_weight);
-
-  if (n_mime_types < n)
-    n = n_mime_types;
 
-  for (i = 0; i < n; i++)
-    mime_types[i] = mimes[i].mime;
+  _xdg_mime_lookup_ctx_sort (ctx, detection, stage, NULL);
 
-  return n;
+  return ctx->n_mimes;
 }
 
 
-
 /* XdgGlobHash
  */
 
@@ -485,6 +463,7 @@ _xdg_glob_hash_new (void)
   XdgGlobHash *glob_hash;
 
   glob_hash = calloc (1, sizeof (XdgGlobHash));
+  glob_hash->strings = _xdg_string_pool_new ();
 
   return glob_hash;
 }
@@ -499,8 +478,6 @@ _xdg_glob_hash_free_nodes (XdgGlobHashNode *node)
        _xdg_glob_hash_free_nodes (node->child);
       if (node->next)
        _xdg_glob_hash_free_nodes (node->next);
-      if (node->mime_type)
-	free ((void *) node->mime_type);
       free (node);
     }
 }
@@ -511,6 +488,7 @@ _xdg_glob_hash_free (XdgGlobHash *glob_hash)
   _xdg_glob_list_free (glob_hash->literal_list);
   _xdg_glob_list_free (glob_hash->full_list);
   _xdg_glob_hash_free_nodes (glob_hash->simple_node);
+  _xdg_string_pool_free (glob_hash->strings);
   free (glob_hash);
 }
 
@@ -553,17 +531,18 @@ _xdg_glob_hash_append_glob (XdgGlobHash *glob_hash,
   assert (glob != NULL);
 
   type = _xdg_glob_determine_type (glob);
+  mime_type = _xdg_string_pool_intern (glob_hash->strings, mime_type);
 
   switch (type)
     {
     case XDG_GLOB_LITERAL:
-      glob_hash->literal_list = _xdg_glob_list_append (glob_hash->literal_list, strdup (glob), strdup (mime_type), weight, case_sensitive);
+      glob_hash->literal_list = _xdg_glob_list_append (glob_hash->literal_list, _xdg_string_pool_intern (glob_hash->strings, glob), mime_type, weight, case_sensitive);
       break;
     case XDG_GLOB_SIMPLE:
       glob_hash->simple_node = _xdg_glob_hash_insert_text (glob_hash->simple_node, glob + 1, mime_type, weight, case_sensitive);
       break;
     case XDG_GLOB_FULL:
-      glob_hash->full_list = _xdg_glob_list_append (glob_hash->full_list, strdup (glob), strdup (mime_type), weight, case_sensitive);
+      glob_hash->full_list = _xdg_glob_list_append (glob_hash->full_list, _xdg_string_pool_intern (glob_hash->strings, glob), mime_type, weight, case_sensitive);
       break;
     }
 }
@@ -604,37 +583,143 @@ _xdg_glob_hash_dump (XdgGlobHash *glob_hash)
     }
 }
 
+static void
+_xdg_glob_hash_node_foreach (XdgGlobHashNode    *glob_hash_node,
+			     xdg_unichar_t      *path,
+			     int                 depth,
+			     XdgGlobForeachFunc  func,
+			     void               *user_data)
+{
+  XdgGlobHashNode *node, *child;
+  char glob[256 * 6 + 2];
+  char *p;
+  int i;
+
+  for (node = glob_hash_node; node; node = node->next)
+    {
+      if (node->character == 0 || depth >= 256)
+	continue;
+
+      path[depth] = node->character;
+
+      if (node->mime_type)
+	{
+	  /* The tree is built from reversed suffixes */
+	  p = glob;
+	  *p++ = '*';
+	  for (i = depth; i >= 0; i--)
+	    p += _xdg_ucs4_to_utf8 (path[i], p);
+	  *p = 0;
+
+	  func (glob, node->mime_type, node->weight, user_data);
+
+	  for (child = node->child; child && child->character == 0; child = child->next)
+	    func (glob, child->mime_type, child->weight, user_data);
+	}
+
+      _xdg_glob_hash_node_foreach (node->child, path, depth + 1, func, user_data);
+    }
+}
+
+void
+_xdg_glob_hash_foreach (XdgGlobHash        *glob_hash,
+			XdgGlobForeachFunc  func,
+			void               *user_data)
+{
+  xdg_unichar_t path[256];
+  XdgGlobList *list;
+
+  for (list = glob_hash->literal_list; list; list = list->next)
+    func (list->data, list->mime_type, list->weight, user_data);
+
+  _xdg_glob_hash_node_foreach (glob_hash->simple_node, path, 0, func, user_data);
+
+  for (list = glob_hash->full_list; list; list = list->next)
+    func (list->data, list->mime_type, list->weight, user_data);
+}
+
+static void
+_xdg_glob_hash_node_serialize (XdgGlobHashNode    *glob_hash_node,
+			       xdg_unichar_t      *path,
+			       int                 depth,
+			       XdgMimeCacheWriter *writer)
+{
+  XdgGlobHashNode *node, *child;
+  char glob[256 * 6 + 2];
+  char *p;
+  int i;
+
+  for (node = glob_hash_node; node; node = node->next)
+    {
+      if (node->character == 0 || depth >= 256)
+	continue;
+
+      path[depth] = node->character;
+
+      if (node->mime_type)
+	{
+	  p = glob;
+	  *p++ = '*';
+	  for (i = depth; i >= 0; i--)
+	    p += _xdg_ucs4_to_utf8 (path[i], p);
+	  *p = 0;
+
+	  _xdg_mime_cache_writer_add_glob (writer, glob, node->mime_type,
+					   node->weight, node->case_sensitive);
+
+	  for (child = node->child; child && child->character == 0; child = child->next)
+	    _xdg_mime_cache_writer_add_glob (writer, glob, child->mime_type,
+					     child->weight, child->case_sensitive);
+	}
+
+      _xdg_glob_hash_node_serialize (node->child, path, depth + 1, writer);
+    }
+}
+
+void
+_xdg_glob_hash_serialize (XdgGlobHash        *glob_hash,
+			  XdgMimeCacheWriter *writer)
+{
+  xdg_unichar_t path[256];
+  XdgGlobList *list;
+
+  for (list = glob_hash->literal_list; list; list = list->next)
+    _xdg_mime_cache_writer_add_glob (writer, list->data, list->mime_type,
+				     list->weight, list->case_sensitive);
+
+  _xdg_glob_hash_node_serialize (glob_hash->simple_node, path, 0, writer);
+
+  for (list = glob_hash->full_list; list; list = list->next)
+    _xdg_mime_cache_writer_add_glob (writer, list->data, list->mime_type,
+				     list->weight, list->case_sensitive);
+}
 
 void
 _xdg_mime_glob_read_from_file (XdgGlobHash *glob_hash,
 			       const char  *file_name,
 			       int          version_two)
 {
-  FILE *glob_file;
-  char line[255];
+  char *buffer, *cursor, *line;
+  size_t size;
   char *p;
 
-  glob_file = fopen (file_name, "r");
+  buffer = _xdg_map_file (file_name, &size);
 
-  if (glob_file == NULL)
+  if (buffer == NULL)
     return;
 
-  /* FIXME: Not UTF-8 safe.  Doesn't work if lines are greater than 255 chars.
-   * Blah */
-  while (fgets (line, 255, glob_file) != NULL)
+  /* FIXME: Not UTF-8 safe. */
+  cursor = buffer;
+  while ((line = _xdg_next_line (&cursor, buffer + size)) != NULL)
     {
       char *colon;
-      char *mimetype, *glob, *end;
+      char *mimetype, *glob;
       int weight;
       int case_sensitive;
 
       if (line[0] == '#' || line[0] == 0)
 	continue;
 
-      end = line + strlen(line) - 1;
-      if (*end == '\n')
-	*end = 0;
-
       p = line;
       if (version_two)
 	{
@@ -686,5 +771,5 @@ _xdg_mime_glob_read_from_file (XdgGlobHash *glob_hash,
       _xdg_glob_hash_append_glob (glob_hash, glob, mimetype, weight, case_sensitive);
     }
 
-  fclose (glob_file);
+  _xdg_unmap_file (buffer, size);
 }
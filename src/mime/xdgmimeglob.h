@@ -29,6 +29,7 @@
 #define __XDG_MIME_GLOB_H__
 
 #include "xdgmime.h"
+#include "xdgmimecachewriter.h"
 
 typedef struct XdgGlobHash XdgGlobHash;
 
@@ -39,15 +40,24 @@ typedef enum
   XDG_GLOB_FULL     /* x*.[ch] */
 } XdgGlobType;
 
+/* Called once for every glob found in the glob data */
+typedef void (*XdgGlobForeachFunc) (const char *glob,
+				    const char *mime_type,
+				    int         weight,
+				    void       *user_data);
+
   
 #ifdef XDG_PREFIX
 #define _xdg_mime_glob_read_from_file         XDG_RESERVED_ENTRY(glob_read_from_file)
 #define _xdg_glob_hash_new                    XDG_RESERVED_ENTRY(hash_new)
 #define _xdg_glob_hash_free                   XDG_RESERVED_ENTRY(hash_free)
 #define _xdg_glob_hash_lookup_file_name       XDG_RESERVED_ENTRY(hash_lookup_file_name)
+#define _xdg_glob_hash_has_literal            XDG_RESERVED_ENTRY(hash_has_literal)
 #define _xdg_glob_hash_append_glob            XDG_RESERVED_ENTRY(hash_append_glob)
 #define _xdg_glob_determine_type              XDG_RESERVED_ENTRY(determine_type)
 #define _xdg_glob_hash_dump                   XDG_RESERVED_ENTRY(hash_dump)
+#define _xdg_glob_hash_foreach                XDG_RESERVED_ENTRY(hash_foreach)
+#define _xdg_glob_hash_serialize              XDG_RESERVED_ENTRY(hash_serialize)
 #endif
 
 void         _xdg_mime_glob_read_from_file   (XdgGlobHash *glob_hash,
@@ -55,10 +65,14 @@ void         _xdg_mime_glob_read_from_file   (XdgGlobHash *glob_hash,
 					      int          version_two);
 XdgGlobHash *_xdg_glob_hash_new              (void);
 void         _xdg_glob_hash_free             (XdgGlobHash *glob_hash);
+/* Leaves all candidates in ctx, heaviest first, and returns their number */
 int          _xdg_glob_hash_lookup_file_name (XdgGlobHash *glob_hash,
+					      XdgMimeLookupCtx *ctx,
 					      const char  *text,
-					      const char  *mime_types[],
-					      int          n_mime_types);
+					      XdgMimeDetection *detection);
+int          _xdg_glob_hash_has_literal      (XdgGlobHash *glob_hash,
+					      XdgMimeLookupCtx *ctx,
+					      const char  *file_name);
 void         _xdg_glob_hash_append_glob      (XdgGlobHash *glob_hash,
 					      const char  *glob,
 					      const char  *mime_type,
@@ -66,5 +80,11 @@ void         _xdg_glob_hash_append_glob      (XdgGlobHash *glob_hash,
 					      int          case_sensitive);
 XdgGlobType  _xdg_glob_determine_type        (const char  *glob);
 void         _xdg_glob_hash_dump             (XdgGlobHash *glob_hash);
+void         _xdg_glob_hash_foreach          (XdgGlobHash        *glob_hash,
+					      XdgGlobForeachFunc  func,
+					      void               *user_data);
+/* Adds every glob to writer, keeping their case sensitivity */
+void         _xdg_glob_hash_serialize        (XdgGlobHash        *glob_hash,
+					      XdgMimeCacheWriter *writer);
 
 #endif /* __XDG_MIME_GLOB_H__ */
@@ -0,0 +1,227 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimeglobindex.c: Private file.  Reverse index from mime types to globs.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <xdg/config.h>
+
+#include "xdgmimeglobindex.h"
+#include "xdgmimeint.h"
+#include "xdgmimestrpool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+typedef struct XdgGlobIndexEntry XdgGlobIndexEntry;
+typedef struct XdgGlobIndexGroup XdgGlobIndexGroup;
+
+struct XdgGlobIndexEntry
+{
+  const char *glob;
+  const char *mime_type;
+  int weight;
+  int seq;
+};
+
+/* All globs of one mime type, they are stored in globs[first..first+count) */
+struct XdgGlobIndexGroup
+{
+  xdg_uint32_t hash;
+  const char *mime_type;
+  int first;
+  int count;
+};
+
+struct XdgGlobIndex
+{
+  XdgGlobIndexEntry *entries;
+  int n_entries;
+  int n_allocated;
+
+  const char **globs;
+  XdgGlobIndexGroup *groups;
+  int n_groups;
+
+  /* Open addressing table of group index + 1, 0 marks an empty slot */
+  int *table;
+  xdg_uint32_t mask;
+
+  XdgStringPool *strings;
+};
+
+XdgGlobIndex *
+_xdg_glob_index_new (void)
+{
+  XdgGlobIndex *index;
+
+  index = calloc (1, sizeof (XdgGlobIndex));
+  index->strings = _xdg_string_pool_new ();
+
+  return index;
+}
+
+void
+_xdg_glob_index_free (XdgGlobIndex *index)
+{
+  _xdg_string_pool_free (index->strings);
+  free (index->entries);
+  free (index->globs);
+  free (index->groups);
+  free (index->table);
+  free (index);
+}
+
+/* The glob is copied, the mime type has to stay valid for the lifetime
+ * of the index. */
+void
+_xdg_glob_index_add (const char   *glob,
+		     const char   *mime_type,
+		     int           weight,
+		     XdgGlobIndex *index)
+{
+  XdgGlobIndexEntry *entry;
+
+  assert (index->table == NULL);
+
+  if (index->n_entries == index->n_allocated)
+    {
+      index->n_allocated = index->n_allocated ? index->n_allocated * 2 : 256;
+      index->entries = realloc (index->entries, index->n_allocated * sizeof (XdgGlobIndexEntry));
+    }
+
+  entry = &index->entries[index->n_entries];
+  entry->glob = _xdg_string_pool_intern (index->strings, glob);
+  entry->mime_type = mime_type;
+  entry->weight = weight;
+  entry->seq = index->n_entries++;
+}
+
+static int
+compare_entries (const void *a, const void *b)
+{
+  const XdgGlobIndexEntry *aa = (const XdgGlobIndexEntry *)a;
+  const XdgGlobIndexEntry *bb = (const XdgGlobIndexEntry *)b;
+  int res;
+
+  if ((res = strcmp (aa->mime_type, bb->mime_type)) != 0)
+    return res;
+
+  if (aa->weight != bb->weight)
+    return bb->weight - aa->weight;
+
+  return aa->seq - bb->seq;
+}
+
+/* Sorts the collected globs and builds the hash table over mime types.
+ * No globs can be added afterwards. */
+void
+_xdg_glob_index_build (XdgGlobIndex *index)
+{
+  XdgGlobIndexGroup *group = NULL;
+  xdg_uint32_t size, slot;
+  int i, j, n;
+
+  qsort (index->entries, index->n_entries, sizeof (XdgGlobIndexEntry), compare_entries);
+
+  index->globs = malloc ((index->n_entries + 1) * sizeof (char *));
+  index->groups = malloc ((index->n_entries + 1) * sizeof (XdgGlobIndexGroup));
+
+  for (i = 0, n = 0; i < index->n_entries; i++)
+    {
+      XdgGlobIndexEntry *entry = &index->entries[i];
+
+      if (group == NULL || strcmp (group->mime_type, entry->mime_type) != 0)
+	{
+	  group = &index->groups[index->n_groups++];
+	  group->hash = _xdg_hash_string (entry->mime_type);
+	  group->mime_type = entry->mime_type;
+	  group->first = n;
+	  group->count = 0;
+	}
+
+      /* The same glob may come from several caches, keep the heaviest one */
+      for (j = group->first; j < n; j++)
+	if (index->globs[j] == entry->glob)
+	  break;
+
+      if (j == n)
+	{
+	  index->globs[n++] = entry->glob;
+	  group->count++;
+	}
+    }
+
+  free (index->entries);
+  index->entries = NULL;
+  index->n_entries = index->n_allocated = 0;
+
+  for (size = 16; size < index->n_groups * 2; size <<= 1) ;
+
+  index->mask = size - 1;
+  index->table = calloc (size, sizeof (int));
+
+  for (i = 0; i < index->n_groups; i++)
+    {
+      for (slot = index->groups[i].hash & index->mask;
+	   index->table[slot];
+	   slot = (slot + 1) & index->mask) ;
+
+      index->table[slot] = i + 1;
+    }
+}
+
+/* Stores up to n_globs globs of mime_type, heaviest first, and returns
+ * the total number of globs known for it. */
+int
+_xdg_glob_index_lookup (XdgGlobIndex *index,
+			const char   *mime_type,
+			const char   *globs[],
+			int           n_globs)
+{
+  XdgGlobIndexGroup *group;
+  xdg_uint32_t hash, slot;
+
+  if (index->table == NULL)
+    return 0;
+
+  hash = _xdg_hash_string (mime_type);
+
+  for (slot = hash & index->mask; index->table[slot]; slot = (slot + 1) & index->mask)
+    {
+      group = &index->groups[index->table[slot] - 1];
+
+      if (group->hash == hash && strcmp (group->mime_type, mime_type) == 0)
+	{
+	  if (n_globs > group->count)
+	    n_globs = group->count;
+
+	  if (n_globs > 0)
+	    memcpy (globs, &index->globs[group->first], n_globs * sizeof (char *));
+
+	  return group->count;
+	}
+    }
+
+  return 0;
+}
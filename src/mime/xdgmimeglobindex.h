@@ -0,0 +1,54 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimeglobindex.h: Private file.  Reverse index from mime types to globs.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __XDG_MIME_GLOB_INDEX_H__
+#define __XDG_MIME_GLOB_INDEX_H__
+
+#include "xdgmimeglob.h"
+
+typedef struct XdgGlobIndex XdgGlobIndex;
+
+#ifdef XDG_PREFIX
+#define _xdg_glob_index_new                   XDG_RESERVED_ENTRY(glob_index_new)
+#define _xdg_glob_index_free                  XDG_RESERVED_ENTRY(glob_index_free)
+#define _xdg_glob_index_add                   XDG_RESERVED_ENTRY(glob_index_add)
+#define _xdg_glob_index_build                 XDG_RESERVED_ENTRY(glob_index_build)
+#define _xdg_glob_index_lookup                XDG_RESERVED_ENTRY(glob_index_lookup)
+#endif
+
+XdgGlobIndex *_xdg_glob_index_new    (void);
+void          _xdg_glob_index_free   (XdgGlobIndex *index);
+void          _xdg_glob_index_add    (const char   *glob,
+				      const char   *mime_type,
+				      int           weight,
+				      XdgGlobIndex *index);
+void          _xdg_glob_index_build  (XdgGlobIndex *index);
+int           _xdg_glob_index_lookup (XdgGlobIndex *index,
+				      const char   *mime_type,
+				      const char   *globs[],
+				      int           n_globs);
+
+#endif /* __XDG_MIME_GLOB_INDEX_H__ */
@@ -29,6 +29,7 @@
 
 #include "xdgmimeicon.h"
 #include "xdgmimeint.h"
+#include "xdgmimestrpool.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
@@ -47,18 +48,21 @@ typedef struct XdgIcon XdgIcon;
 
 struct XdgIcon 
 {
-  char *mime_type;
-  char *icon_name;
+  const char *mime_type;
+  const char *icon_name;
 };
 
 struct XdgIconList
 {
   struct XdgIcon *icons;
   int n_icons;
+
+  XdgStringPool *pool;
+  XdgStringIndex *index;
 };
 
 XdgIconList *
-_xdg_mime_icon_list_new (void)
+_xdg_mime_icon_list_new (XdgStringPool *pool)
 {
   XdgIconList *list;
 
@@ -66,6 +70,8 @@ _xdg_mime_icon_list_new (void)
 
   list->icons = NULL;
   list->n_icons = 0;
+  list->pool = pool;
+  list->index = NULL;
 
   return list;
 }
@@ -73,42 +79,40 @@ _xdg_mime_icon_list_new (void)
 void         
 _xdg_mime_icon_list_free (XdgIconList *list)
 {
-  int i;
-
-  if (list->icons)
-    {
-      for (i = 0; i < list->n_icons; i++)
-	{
-	  free (list->icons[i].mime_type);
-	  free (list->icons[i].icon_name);
-	}
-      free (list->icons);
-    }
+  /* The strings belong to the pool */
+  if (list->index)
+    _xdg_string_index_free (list->index);
+  free (list->icons);
   free (list);
 }
 
-static int
-icon_entry_cmp (const void *v1, const void *v2)
+/* Builds the hash index, must be called once all files have been read.
+ * When an icon is defined more than once the first definition wins. */
+void
+_xdg_mime_icon_list_build_index (XdgIconList *list)
 {
-  return strcmp (((XdgIcon *)v1)->mime_type, ((XdgIcon *)v2)->mime_type);
+  int i;
+
+  if (list->index)
+    _xdg_string_index_free (list->index);
+
+  list->index = _xdg_string_index_new (list->n_icons);
+
+  for (i = 0; i < list->n_icons; i++)
+    _xdg_string_index_insert (list->index, list->icons[i].mime_type, i);
 }
 
 const char  *
 _xdg_mime_icon_list_lookup (XdgIconList *list,
 			    const char  *mime_type)
 {
-  XdgIcon *entry;
-  XdgIcon key;
+  int i;
 
-  if (list->n_icons > 0)
+  if (list->index && (mime_type = _xdg_string_pool_lookup (list->pool, mime_type)) != NULL)
     {
-      key.mime_type = (char *)mime_type;
-      key.icon_name = NULL;
-
-      entry = bsearch (&key, list->icons, list->n_icons,
-		       sizeof (XdgIcon), icon_entry_cmp);
-      if (entry)
-        return entry->icon_name;
+      i = _xdg_string_index_lookup (list->index, mime_type);
+      if (i >= 0)
+        return list->icons[i].icon_name;
     }
 
   return NULL;
@@ -118,20 +122,20 @@ void
 _xdg_mime_icon_read_from_file (XdgIconList *list,
 			       const char   *file_name)
 {
-  FILE *file;
-  char line[255];
+  char *buffer, *cursor, *line;
+  size_t size;
   int alloc;
 
-  file = fopen (file_name, "r");
+  buffer = _xdg_map_file (file_name, &size);
 
-  if (file == NULL)
+  if (buffer == NULL)
     return;
 
-  /* FIXME: Not UTF-8 safe.  Doesn't work if lines are greater than 255 chars.
-   * Blah */
+  /* FIXME: Not UTF-8 safe. */
   alloc = list->n_icons + 16;
   list->icons = realloc (list->icons, alloc * sizeof (XdgIcon));
-  while (fgets (line, 255, file) != NULL)
+  cursor = buffer;
+  while ((line = _xdg_next_line (&cursor, buffer + size)) != NULL)
     {
       char *sep;
       if (line[0] == '#')
@@ -141,25 +145,20 @@ _xdg_mime_icon_read_from_file (XdgIconList *list,
       if (sep == NULL)
 	continue;
       *(sep++) = '\000';
-      sep[strlen (sep) -1] = '\000';
       if (list->n_icons == alloc)
 	{
 	  alloc <<= 1;
 	  list->icons = realloc (list->icons, 
 				   alloc * sizeof (XdgIcon));
 	}
-      list->icons[list->n_icons].mime_type = strdup (line);
-      list->icons[list->n_icons].icon_name = strdup (sep);
+      list->icons[list->n_icons].mime_type = _xdg_string_pool_intern (list->pool, line);
+      list->icons[list->n_icons].icon_name = _xdg_string_pool_intern (list->pool, sep);
       list->n_icons++;
     }
   list->icons = realloc (list->icons, 
 			   list->n_icons * sizeof (XdgIcon));
 
-  fclose (file);  
-  
-  if (list->n_icons > 1)
-    qsort (list->icons, list->n_icons, 
-           sizeof (XdgIcon), icon_entry_cmp);
+  _xdg_unmap_file (buffer, size);
 }
 
 
@@ -179,4 +178,25 @@ _xdg_mime_icon_list_dump (XdgIconList *list)
     }
 }
 
+void
+_xdg_mime_icon_list_serialize (XdgIconList        *list,
+			       XdgMimeCacheWriter *writer,
+			       int                 generic)
+{
+  int i;
+
+  for (i = 0; i < list->n_icons; i++)
+    {
+      if (_xdg_string_index_lookup (list->index, list->icons[i].mime_type) != i)
+	continue;
 
+      if (generic)
+	_xdg_mime_cache_writer_add_generic_icon (writer,
+						 list->icons[i].mime_type,
+						 list->icons[i].icon_name);
+      else
+	_xdg_mime_cache_writer_add_icon (writer,
+					 list->icons[i].mime_type,
+					 list->icons[i].icon_name);
+    }
+}
@@ -27,7 +27,8 @@
 #ifndef __XDG_MIME_ICON_H__
 #define __XDG_MIME_ICON_H__
 
-#include "xdgmime.h"
+#include "xdgmimestrpool.h"
+#include "xdgmimecachewriter.h"
 
 typedef struct XdgIconList XdgIconList;
 
@@ -36,15 +37,22 @@ typedef struct XdgIconList XdgIconList;
 #define _xdg_mime_icon_list_new              XDG_ENTRY(icon_list_new)
 #define _xdg_mime_icon_list_free             XDG_ENTRY(icon_list_free)
 #define _xdg_mime_icon_list_lookup           XDG_ENTRY(icon_list_lookup)
+#define _xdg_mime_icon_list_build_index      XDG_ENTRY(icon_list_build_index)
 #define _xdg_mime_icon_list_dump             XDG_ENTRY(icon_list_dump)
+#define _xdg_mime_icon_list_serialize        XDG_RESERVED_ENTRY(icon_list_serialize)
 #endif
 
 void          _xdg_mime_icon_read_from_file (XdgIconList *list,
 					    const char   *file_name);
-XdgIconList  *_xdg_mime_icon_list_new       (void);
+XdgIconList  *_xdg_mime_icon_list_new       (XdgStringPool *pool);
 void          _xdg_mime_icon_list_free      (XdgIconList *list);
+void          _xdg_mime_icon_list_build_index (XdgIconList *list);
 const char   *_xdg_mime_icon_list_lookup    (XdgIconList *list,
 					     const char  *mime);
 void          _xdg_mime_icon_list_dump      (XdgIconList *list);
+/* Adds the icons in effect to writer as icons, or as generic icons */
+void          _xdg_mime_icon_list_serialize (XdgIconList        *list,
+					     XdgMimeCacheWriter *writer,
+					     int                 generic);
 
 #endif /* __XDG_MIME_ICON_H__ */
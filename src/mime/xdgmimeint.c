@@ -32,6 +32,12 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
 #ifndef	FALSE
 #define	FALSE	(0)
@@ -189,6 +195,69 @@ _xdg_reverse_ucs4 (xdg_unichar_t *source, int len)
     }
 }
 
+/* Writes the UTF-8 encoding of source to dest, which must have room for
+ * 6 bytes, and returns the number of bytes written. */
+int
+_xdg_ucs4_to_utf8 (xdg_unichar_t source, char *dest)
+{
+  int len, first, i;
+
+  if (source < 0x80)
+    {
+      first = 0;
+      len = 1;
+    }
+  else if (source < 0x800)
+    {
+      first = 0xc0;
+      len = 2;
+    }
+  else if (source < 0x10000)
+    {
+      first = 0xe0;
+      len = 3;
+    }
+  else if (source < 0x200000)
+    {
+      first = 0xf0;
+      len = 4;
+    }
+  else if (source < 0x4000000)
+    {
+      first = 0xf8;
+      len = 5;
+    }
+  else
+    {
+      first = 0xfc;
+      len = 6;
+    }
+
+  for (i = len - 1; i > 0; --i)
+    {
+      dest[i] = (source & 0x3f) | 0x80;
+      source >>= 6;
+    }
+  dest[0] = source | first;
+
+  return len;
+}
+
+/* FNV-1a, used by the hash indexes built over the mime data. */
+xdg_uint32_t
+_xdg_hash_string (const char *source)
+{
+  xdg_uint32_t hash = 2166136261U;
+
+  while (*source)
+    {
+      hash ^= (unsigned char) *source++;
+      hash *= 16777619U;
+    }
+
+  return hash;
+}
+
 const char *
 _xdg_binary_or_text_fallback(const void *data, size_t len)
 {
@@ -204,3 +273,95 @@ _xdg_binary_or_text_fallback(const void *data, size_t len)
 
   return XDG_MIME_TYPE_TEXTPLAIN;
 }
+
+/* Maps file_name privately and writable, so parsers may tokenize it in
+ * place, and NUL terminates it: the byte at size is always mapped.
+ * Release with _xdg_unmap_file().
+ */
+char *
+_xdg_map_file (const char *file_name, size_t *size)
+{
+  struct stat st;
+  char *buffer;
+  int fd;
+
+  fd = open (file_name, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  if (fstat (fd, &st) != 0)
+    {
+      close (fd);
+      return NULL;
+    }
+
+#ifdef HAVE_MMAP
+  /* Reserve one more byte than the file has, then put the file over
+   * the start of the reservation. */
+  buffer = mmap (NULL, st.st_size + 1, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffer == MAP_FAILED)
+    {
+      close (fd);
+      return NULL;
+    }
+
+  if (st.st_size > 0 &&
+      mmap (buffer, st.st_size, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+      munmap (buffer, st.st_size + 1);
+      close (fd);
+      return NULL;
+    }
+#else
+  buffer = malloc (st.st_size + 1);
+  if (buffer == NULL || read (fd, buffer, st.st_size) != st.st_size)
+    {
+      free (buffer);
+      close (fd);
+      return NULL;
+    }
+#endif
+
+  close (fd);
+
+  buffer[st.st_size] = '\000';
+  *size = st.st_size;
+
+  return buffer;
+}
+
+void
+_xdg_unmap_file (char *buffer, size_t size)
+{
+#ifdef HAVE_MMAP
+  munmap (buffer, size + 1);
+#else
+  free (buffer);
+#endif
+}
+
+/* Returns the line at *cursor with its newline replaced by a NUL and
+ * moves *cursor past it, NULL once end is reached.
+ */
+char *
+_xdg_next_line (char **cursor, char *end)
+{
+  char *line = *cursor;
+  char *newline;
+
+  if (line >= end)
+    return NULL;
+
+  newline = memchr (line, '\n', end - line);
+  if (newline)
+    {
+      *newline = '\000';
+      *cursor = newline + 1;
+    }
+  else
+    *cursor = end;
+
+  return line;
+}
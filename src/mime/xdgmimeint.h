@@ -53,6 +53,11 @@ typedef unsigned int   xdg_uint32_t;
 #define _xdg_get_base_name   XDG_RESERVED_ENTRY(get_base_name)
 #define _xdg_convert_to_ucs4 XDG_RESERVED_ENTRY(convert_to_ucs4)
 #define _xdg_reverse_ucs4    XDG_RESERVED_ENTRY(reverse_ucs4)
+#define _xdg_ucs4_to_utf8    XDG_RESERVED_ENTRY(ucs4_to_utf8)
+#define _xdg_hash_string     XDG_RESERVED_ENTRY(hash_string)
+#define _xdg_map_file        XDG_RESERVED_ENTRY(map_file)
+#define _xdg_unmap_file      XDG_RESERVED_ENTRY(unmap_file)
+#define _xdg_next_line       XDG_RESERVED_ENTRY(next_line)
 #endif
 
 #define SWAP_BE16_TO_LE16(val) (xdg_uint16_t)(((xdg_uint16_t)(val) << 8)|((xdg_uint16_t)(val) >> 8))
@@ -72,7 +77,15 @@ xdg_unichar_t  _xdg_ucs4_to_lower (xdg_unichar_t  source);
 int            _xdg_utf8_validate (const char    *source);
 xdg_unichar_t *_xdg_convert_to_ucs4 (const char *source, int *len);
 void           _xdg_reverse_ucs4 (xdg_unichar_t *source, int len);
+int            _xdg_ucs4_to_utf8 (xdg_unichar_t  source, char *dest);
+xdg_uint32_t   _xdg_hash_string  (const char    *source);
 const char    *_xdg_get_base_name (const char    *file_name);
 const char    *_xdg_binary_or_text_fallback(const void *data, size_t len);
+char          *_xdg_map_file      (const char    *file_name,
+				   size_t        *size);
+void           _xdg_unmap_file    (char          *buffer,
+				   size_t         size);
+char          *_xdg_next_line     (char         **cursor,
+				   char          *end);
 
 #endif /* __XDG_MIME_INT_H__ */
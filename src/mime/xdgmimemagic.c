@@ -31,6 +31,7 @@
 #include <assert.h>
 #include "xdgmimemagic.h"
 #include "xdgmimeint.h"
+#include "xdgmimectx.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -46,12 +47,33 @@
 #define	TRUE	(!FALSE)
 #endif
 
-#if !defined getc_unlocked && !defined HAVE_GETC_UNLOCKED
-# define getc_unlocked(fp) getc (fp)
-#endif
+/* The magic file is parsed straight out of its mapping */
+typedef struct
+{
+  const unsigned char *p;
+  const unsigned char *end;
+} XdgMimeMagicReader;
+
+#define magic_getc(r)     ((r)->p < (r)->end ? *(r)->p++ : EOF)
+#define magic_ungetc(c,r) ((c) != EOF ? (r)->p-- : 0)
+#define magic_eof(r)      ((r)->p >= (r)->end)
+
+static size_t
+magic_read (void *ptr, size_t size, XdgMimeMagicReader *reader)
+{
+  if (size > reader->end - reader->p)
+    size = reader->end - reader->p;
+
+  memcpy (ptr, reader->p, size);
+  reader->p += size;
+
+  return size;
+}
 
 typedef struct XdgMimeMagicMatch XdgMimeMagicMatch;
 typedef struct XdgMimeMagicMatchlet XdgMimeMagicMatchlet;
+typedef struct XdgMimeMagicRule XdgMimeMagicRule;
+typedef struct XdgMimeMagicNode XdgMimeMagicNode;
 
 typedef enum
 {
@@ -83,10 +105,46 @@ struct XdgMimeMagicMatchlet
 };
 
 
+/* Compiled form of a match, its matchlets are nodes[first..end) */
+struct XdgMimeMagicRule
+{
+  const char *mime_type;
+  int priority;
+  int first;
+  int end;
+
+  unsigned long n_evaluations;
+  unsigned long n_matches;
+  unsigned long n_bytes;
+};
+
+/* Compiled form of a matchlet.  The children of a node directly follow
+ * it, skip is the index of its next sibling (or of whatever follows the
+ * parent), so a node without children has skip == index + 1.
+ */
+struct XdgMimeMagicNode
+{
+  const unsigned char *value;
+  const unsigned char *mask;
+  int offset;
+  unsigned int value_length;
+  unsigned int range_length;
+  int indent;
+  int skip;
+};
+
 struct XdgMimeMagic
 {
   XdgMimeMagicMatch *match_list;
   int max_extent;
+
+  /* Filled in by _xdg_mime_magic_compile(), which consumes match_list.
+   * Values, masks and mime types all live in arena. */
+  XdgMimeMagicRule *rules;
+  int n_rules;
+  XdgMimeMagicNode *nodes;
+  int n_nodes;
+  unsigned char *arena;
 };
 
 static XdgMimeMagicMatch *
@@ -158,7 +216,7 @@ _xdg_mime_magic_match_free (XdgMimeMagicMatch *mime_magic_match)
  * returned string is null terminated, and doesn't include the newline.
  */
 static unsigned char *
-_xdg_mime_magic_read_to_newline (FILE *magic_file,
+_xdg_mime_magic_read_to_newline (XdgMimeMagicReader *magic_file,
 				 int  *end_of_file)
 {
   unsigned char *retval;
@@ -172,7 +230,7 @@ _xdg_mime_magic_read_to_newline (FILE *magic_file,
 
   while (TRUE)
     {
-      c = getc_unlocked (magic_file);
+      c = magic_getc (magic_file);
       if (c == EOF)
 	{
 	  *end_of_file = TRUE;
@@ -195,7 +253,7 @@ _xdg_mime_magic_read_to_newline (FILE *magic_file,
 /* Returns the number read from the file, or -1 if no number could be read.
  */
 static int
-_xdg_mime_magic_read_a_number (FILE *magic_file,
+_xdg_mime_magic_read_a_number (XdgMimeMagicReader *magic_file,
 			       int  *end_of_file)
 {
   /* LONG_MAX is about 20 characters on my system */
@@ -207,7 +265,7 @@ _xdg_mime_magic_read_a_number (FILE *magic_file,
 
   while (TRUE)
     {
-      c = getc_unlocked (magic_file);
+      c = magic_getc (magic_file);
 
       if (c == EOF)
 	{
@@ -216,7 +274,7 @@ _xdg_mime_magic_read_a_number (FILE *magic_file,
 	}
       if (! isdigit (c))
 	{
-	  ungetc (c, magic_file);
+	  magic_ungetc (c, magic_file);
 	  break;
 	}
       number_string[pos] = (char) c;
@@ -241,7 +299,7 @@ _xdg_mime_magic_read_a_number (FILE *magic_file,
  * [<priority>:<mime-type>]
  */
 static XdgMimeMagicState
-_xdg_mime_magic_parse_header (FILE *magic_file, XdgMimeMagicMatch *match)
+_xdg_mime_magic_parse_header (XdgMimeMagicReader *magic_file, XdgMimeMagicMatch *match)
 {
   int c;
   char *buffer;
@@ -251,7 +309,7 @@ _xdg_mime_magic_parse_header (FILE *magic_file, XdgMimeMagicMatch *match)
   assert (magic_file != NULL);
   assert (match != NULL);
 
-  c = getc_unlocked (magic_file);
+  c = magic_getc (magic_file);
   if (c == EOF)
     return XDG_MIME_MAGIC_EOF;
   if (c != '[')
@@ -263,7 +321,7 @@ _xdg_mime_magic_parse_header (FILE *magic_file, XdgMimeMagicMatch *match)
   if (match->priority == -1)
     return XDG_MIME_MAGIC_ERROR;
 
-  c = getc_unlocked (magic_file);
+  c = magic_getc (magic_file);
   if (c == EOF)
     return XDG_MIME_MAGIC_EOF;
   if (c != ':')
@@ -290,13 +348,13 @@ _xdg_mime_magic_parse_header (FILE *magic_file, XdgMimeMagicMatch *match)
 }
 
 static XdgMimeMagicState
-_xdg_mime_magic_parse_error (FILE *magic_file)
+_xdg_mime_magic_parse_error (XdgMimeMagicReader *magic_file)
 {
   int c;
 
   while (1)
     {
-      c = getc_unlocked (magic_file);
+      c = magic_getc (magic_file);
       if (c == EOF)
 	return XDG_MIME_MAGIC_EOF;
       if (c == '\n')
@@ -309,8 +367,8 @@ _xdg_mime_magic_parse_error (FILE *magic_file)
  * [ "&" mask ] [ "~" word-size ] [ "+" range-length ] "\n"
  */
 static XdgMimeMagicState
-_xdg_mime_magic_parse_magic_line (FILE              *magic_file,
-				  XdgMimeMagicMatch *match)
+_xdg_mime_magic_parse_magic_line (XdgMimeMagicReader *magic_file,
+				  XdgMimeMagicMatch  *match)
 {
   XdgMimeMagicMatchlet *matchlet;
   int c;
@@ -321,12 +379,12 @@ _xdg_mime_magic_parse_magic_line (FILE              *magic_file,
   assert (magic_file != NULL);
 
   /* Sniff the buffer to make sure it's a valid line */
-  c = getc_unlocked (magic_file);
+  c = magic_getc (magic_file);
   if (c == EOF)
     return XDG_MIME_MAGIC_EOF;
   else if (c == '[')
     {
-      ungetc (c, magic_file);
+      magic_ungetc (c, magic_file);
       return XDG_MIME_MAGIC_SECTION;
     }
   else if (c == '\n')
@@ -336,13 +394,13 @@ _xdg_mime_magic_parse_magic_line (FILE              *magic_file,
   end_of_file = FALSE;
   if (isdigit (c))
     {
-      ungetc (c, magic_file);
+      magic_ungetc (c, magic_file);
       indent = _xdg_mime_magic_read_a_number (magic_file, &end_of_file);
       if (end_of_file)
 	return XDG_MIME_MAGIC_EOF;
       if (indent == -1)
 	return XDG_MIME_MAGIC_ERROR;
-      c = getc_unlocked (magic_file);
+      c = magic_getc (magic_file);
       if (c == EOF)
 	return XDG_MIME_MAGIC_EOF;
     }
@@ -363,7 +421,7 @@ _xdg_mime_magic_parse_magic_line (FILE              *magic_file,
       _xdg_mime_magic_matchlet_free (matchlet);
       return XDG_MIME_MAGIC_ERROR;
     }
-  c = getc_unlocked (magic_file);
+  c = magic_getc (magic_file);
   if (c == EOF)
     {
       _xdg_mime_magic_matchlet_free (matchlet);
@@ -377,7 +435,7 @@ _xdg_mime_magic_parse_magic_line (FILE              *magic_file,
 
   /* Next two bytes determine how long the value is */
   matchlet->value_length = 0;
-  c = getc_unlocked (magic_file);
+  c = magic_getc (magic_file);
   if (c == EOF)
     {
       _xdg_mime_magic_matchlet_free (matchlet);
@@ -386,7 +444,7 @@ _xdg_mime_magic_parse_magic_line (FILE              *magic_file,
   matchlet->value_length = c & 0xFF;
   matchlet->value_length = matchlet->value_length << 8;
 
-  c = getc_unlocked (magic_file);
+  c = magic_getc (magic_file);
   if (c == EOF)
     {
       _xdg_mime_magic_matchlet_free (matchlet);
@@ -402,17 +460,17 @@ _xdg_mime_magic_parse_magic_line (FILE              *magic_file,
       _xdg_mime_magic_matchlet_free (matchlet);
       return XDG_MIME_MAGIC_ERROR;
     }
-  bytes_read = fread (matchlet->value, 1, matchlet->value_length, magic_file);
+  bytes_read = magic_read (matchlet->value, matchlet->value_length, magic_file);
   if (bytes_read != matchlet->value_length)
     {
       _xdg_mime_magic_matchlet_free (matchlet);
-      if (feof (magic_file))
+      if (magic_eof (magic_file))
 	return XDG_MIME_MAGIC_EOF;
       else
 	return XDG_MIME_MAGIC_ERROR;
     }
 
-  c = getc_unlocked (magic_file);
+  c = magic_getc (magic_file);
   if (c == '&')
     {
       matchlet->mask = malloc (matchlet->value_length);
@@ -422,16 +480,16 @@ _xdg_mime_magic_parse_magic_line (FILE              *magic_file,
 	  _xdg_mime_magic_matchlet_free (matchlet);
 	  return XDG_MIME_MAGIC_ERROR;
 	}
-      bytes_read = fread (matchlet->mask, 1, matchlet->value_length, magic_file);
+      bytes_read = magic_read (matchlet->mask, matchlet->value_length, magic_file);
       if (bytes_read != matchlet->value_length)
 	{
 	  _xdg_mime_magic_matchlet_free (matchlet);
-	  if (feof (magic_file))
+	  if (magic_eof (magic_file))
 	    return XDG_MIME_MAGIC_EOF;
 	  else
 	    return XDG_MIME_MAGIC_ERROR;
 	}
-      c = getc_unlocked (magic_file);
+      c = magic_getc (magic_file);
     }
 
   if (c == '~')
@@ -450,7 +508,7 @@ _xdg_mime_magic_parse_magic_line (FILE              *magic_file,
 	  _xdg_mime_magic_matchlet_free (matchlet);
 	  return XDG_MIME_MAGIC_ERROR;
 	}
-      c = getc_unlocked (magic_file);
+      c = magic_getc (magic_file);
     }
 
   if (c == '+')
@@ -466,7 +524,7 @@ _xdg_mime_magic_parse_magic_line (FILE              *magic_file,
 	  _xdg_mime_magic_matchlet_free (matchlet);
 	  return XDG_MIME_MAGIC_ERROR;
 	}
-      c = getc_unlocked (magic_file);
+      c = magic_getc (magic_file);
     }
 
 
@@ -516,84 +574,89 @@ _xdg_mime_magic_parse_magic_line (FILE              *magic_file,
 }
 
 static int
-_xdg_mime_magic_matchlet_compare_to_data (XdgMimeMagicMatchlet *matchlet,
-					  const void           *data,
-					  size_t                len)
+_xdg_mime_magic_node_compare_to_data (const XdgMimeMagicNode *node,
+				      const void             *data,
+				      size_t                  len,
+				      unsigned long          *n_bytes)
 {
+  const unsigned char *bytes;
   int i, j;
-  for (i = matchlet->offset; i < matchlet->offset + matchlet->range_length; i++)
-    {
-      int valid_matchlet = TRUE;
 
-      if (i + matchlet->value_length > len)
+  for (i = node->offset; i < node->offset + node->range_length; i++)
+    {
+      if (i + node->value_length > len)
 	return FALSE;
 
-      if (matchlet->mask)
-	{
-	  for (j = 0; j < matchlet->value_length; j++)
-	    {
-	      if ((matchlet->value[j] & matchlet->mask[j]) !=
-		  ((((unsigned char *) data)[j + i]) & matchlet->mask[j]))
-		{
-		  valid_matchlet = FALSE;
-		  break;
-		}
-	    }
-	}
-      else
+      if (n_bytes)
+	*n_bytes += node->value_length;
+
+      bytes = (const unsigned char *) data + i;
+
+      if (node->mask)
 	{
-	  for (j = 0; j <  matchlet->value_length; j++)
+	  for (j = 0; j < node->value_length; j++)
 	    {
-	      if (matchlet->value[j] != ((unsigned char *) data)[j + i])
-		{
-		  valid_matchlet = FALSE;
-		  break;
-		}
+	      if ((node->value[j] & node->mask[j]) != (bytes[j] & node->mask[j]))
+		break;
 	    }
+	  if (j == node->value_length)
+	    return TRUE;
 	}
-      if (valid_matchlet)
+      else if (memcmp (node->value, bytes, node->value_length) == 0)
 	return TRUE;
     }
   return FALSE;
 }
 
+/* Returns TRUE if any of the nodes at indent in nodes[i..end) matches,
+ * together with one of its children if it has any.
+ */
 static int
-_xdg_mime_magic_matchlet_compare_level (XdgMimeMagicMatchlet *matchlet,
-					const void           *data,
-					size_t                len,
-					int                   indent)
+_xdg_mime_magic_node_compare_level (const XdgMimeMagicNode *nodes,
+				    int                     i,
+				    int                     end,
+				    const void             *data,
+				    size_t                  len,
+				    int                     indent,
+				    unsigned long          *n_bytes)
 {
-  while ((matchlet != NULL) && (matchlet->indent == indent))
+  while (i < end && nodes[i].indent == indent)
     {
-      if (_xdg_mime_magic_matchlet_compare_to_data (matchlet, data, len))
+      if (_xdg_mime_magic_node_compare_to_data (&nodes[i], data, len, n_bytes))
 	{
-	  if ((matchlet->next == NULL) ||
-	      (matchlet->next->indent <= indent))
+	  if (nodes[i].skip == i + 1)
 	    return TRUE;
 
-	  if (_xdg_mime_magic_matchlet_compare_level (matchlet->next,
-						      data,
-						      len,
-						      indent + 1))
+	  if (_xdg_mime_magic_node_compare_level (nodes, i + 1, nodes[i].skip,
+						  data, len, indent + 1, n_bytes))
 	    return TRUE;
 	}
 
-      do
-	{
-	  matchlet = matchlet->next;
-	}
-      while (matchlet && matchlet->indent > indent);
+      i = nodes[i].skip;
     }
 
   return FALSE;
 }
 
 static int
-_xdg_mime_magic_match_compare_to_data (XdgMimeMagicMatch *match,
-				       const void        *data,
-				       size_t             len)
+_xdg_mime_magic_rule_compare_to_data (XdgMimeMagic     *mime_magic,
+				      XdgMimeMagicRule *rule,
+				      const void       *data,
+				      size_t            len)
 {
-  return _xdg_mime_magic_matchlet_compare_level (match->matchlet, data, len, 0);
+  unsigned long n_bytes = 0;
+  int matched;
+
+  if (!(_magic_flags & XDG_MIME_MAGIC_PROFILE))
+    return _xdg_mime_magic_node_compare_level (mime_magic->nodes, rule->first, rule->end,
+					       data, len, 0, NULL);
+
+  matched = _xdg_mime_magic_node_compare_level (mime_magic->nodes, rule->first, rule->end,
+						data, len, 0, &n_bytes);
+  __sync_fetch_and_add (&rule->n_evaluations, 1);
+  __sync_fetch_and_add (&rule->n_bytes, n_bytes);
+
+  return matched;
 }
 
 static void
@@ -641,6 +704,9 @@ _xdg_mime_magic_free (XdgMimeMagic *mime_magic)
 {
   if (mime_magic) {
     _xdg_mime_magic_match_free (mime_magic->match_list);
+    free (mime_magic->rules);
+    free (mime_magic->nodes);
+    free (mime_magic->arena);
     free (mime_magic);
   }
 }
@@ -652,26 +718,42 @@ _xdg_mime_magic_get_buffer_extents (XdgMimeMagic *mime_magic)
 }
 
 const char *
-_xdg_mime_magic_lookup_data (XdgMimeMagic *mime_magic,
-			     const void   *data,
-			     size_t        len,
-			     int           *result_prio,
-                             const char   *mime_types[],
-                             int           n_mime_types)
+_xdg_mime_magic_lookup_data (XdgMimeMagic     *mime_magic,
+			     XdgMimeLookupCtx *ctx,
+			     const void       *data,
+			     size_t            len,
+			     int              *result_prio,
+                             const char       *mime_types[],
+                             int               n_mime_types)
 {
-  XdgMimeMagicMatch *match;
+  XdgMimeMagicOrder *order = NULL;
+  XdgMimeMagicRule *rule;
   const char *mime_type;
-  int n;
+  int i, n;
   int prio;
 
+  /* Glob results are ruled out by the rules tried before the match, so
+   * only reorder without them. */
+  if (n_mime_types == 0 && _xdg_mime_lookup_ctx_reorder (ctx))
+    order = _xdg_mime_lookup_ctx_magic_order (ctx, mime_magic, (unsigned int) mime_magic->n_rules);
+
   prio = 0;
   mime_type = NULL;
-  for (match = mime_magic->match_list; match; match = match->next)
+  for (i = 0; i < mime_magic->n_rules; i++)
     {
-      if (_xdg_mime_magic_match_compare_to_data (match, data, len))
+      rule = &mime_magic->rules[order ? order->order[i] : (unsigned int) i];
+
+      if (_xdg_mime_magic_rule_compare_to_data (mime_magic, rule, data, len))
 	{
-	  prio = match->priority;
-	  mime_type = match->mime_type;
+	  prio = rule->priority;
+	  mime_type = rule->mime_type;
+
+	  if (_magic_flags & XDG_MIME_MAGIC_PROFILE)
+	    __sync_fetch_and_add (&rule->n_matches, 1);
+
+	  if (order)
+	    _xdg_mime_magic_order_matched (order, (unsigned int) i,
+					   i > 0 && mime_magic->rules[order->order[i - 1]].priority == prio);
 	  break;
 	}
       else 
@@ -679,7 +761,7 @@ _xdg_mime_magic_lookup_data (XdgMimeMagic *mime_magic,
 	  for (n = 0; n < n_mime_types; n++)
 	    {
 	      if (mime_types[n] && 
-		  _xdg_mime_mime_type_equal (mime_types[n], match->mime_type))
+		  _xdg_mime_mime_type_equal (mime_types[n], rule->mime_type))
 		mime_types[n] = NULL;
 	    }
 	}
@@ -749,8 +831,8 @@ _xdg_mime_magic_matchlet_mirror (XdgMimeMagicMatchlet *matchlets)
 }
 
 static void
-_xdg_mime_magic_read_magic_file (XdgMimeMagic *mime_magic,
-				 FILE         *magic_file)
+_xdg_mime_magic_read_magic_file (XdgMimeMagic       *mime_magic,
+				 XdgMimeMagicReader *magic_file)
 {
   XdgMimeMagicState state;
   XdgMimeMagicMatch *match = NULL; /* Quiet compiler */
@@ -794,19 +876,165 @@ void
 _xdg_mime_magic_read_from_file (XdgMimeMagic *mime_magic,
 				const char   *file_name)
 {
-  FILE *magic_file;
-  char header[12];
+  XdgMimeMagicReader magic_file;
+  char *buffer;
+  size_t size;
 
-  magic_file = fopen (file_name, "r");
+  buffer = _xdg_map_file (file_name, &size);
 
-  if (magic_file == NULL)
+  if (buffer == NULL)
     return;
 
-  if (fread (header, 1, 12, magic_file) == 12)
+  if (size >= 12 && memcmp ("MIME-Magic\0\n", buffer, 12) == 0)
+    {
+      magic_file.p = (const unsigned char *) buffer + 12;
+      magic_file.end = (const unsigned char *) buffer + size;
+      _xdg_mime_magic_read_magic_file (mime_magic, &magic_file);
+    }
+
+  _xdg_unmap_file (buffer, size);
+}
+
+/* Freezes the matches read so far into flat arrays.  Must be called
+ * once all files have been read, and before any lookup.
+ */
+void
+_xdg_mime_magic_compile (XdgMimeMagic *mime_magic)
+{
+  XdgMimeMagicMatch *match;
+  XdgMimeMagicMatchlet *matchlet;
+  XdgMimeMagicRule *rule;
+  XdgMimeMagicNode *node;
+  unsigned char *arena;
+  size_t arena_size = 0;
+  int n_rules = 0, n_nodes = 0;
+  int i, j;
+
+  for (match = mime_magic->match_list; match; match = match->next)
+    {
+      n_rules++;
+      arena_size += strlen (match->mime_type) + 1;
+
+      for (matchlet = match->matchlet; matchlet; matchlet = matchlet->next)
+	{
+	  n_nodes++;
+	  arena_size += matchlet->mask ? 2 * matchlet->value_length : matchlet->value_length;
+	}
+    }
+
+  free (mime_magic->rules);
+  free (mime_magic->nodes);
+  free (mime_magic->arena);
+
+  mime_magic->rules = malloc (n_rules * sizeof (XdgMimeMagicRule) + 1);
+  mime_magic->nodes = malloc (n_nodes * sizeof (XdgMimeMagicNode) + 1);
+  mime_magic->arena = arena = malloc (arena_size + 1);
+  mime_magic->n_rules = n_rules;
+  mime_magic->n_nodes = n_nodes;
+
+  rule = mime_magic->rules;
+  node = mime_magic->nodes;
+  for (match = mime_magic->match_list; match; match = match->next, rule++)
+    {
+      rule->mime_type = strcpy ((char *) arena, match->mime_type);
+      arena += strlen (match->mime_type) + 1;
+      rule->priority = match->priority;
+      rule->first = node - mime_magic->nodes;
+      rule->n_evaluations = 0;
+      rule->n_matches = 0;
+      rule->n_bytes = 0;
+
+      for (matchlet = match->matchlet; matchlet; matchlet = matchlet->next, node++)
+	{
+	  node->value = memcpy (arena, matchlet->value, matchlet->value_length);
+	  arena += matchlet->value_length;
+	  if (matchlet->mask)
+	    {
+	      node->mask = memcpy (arena, matchlet->mask, matchlet->value_length);
+	      arena += matchlet->value_length;
+	    }
+	  else
+	    node->mask = NULL;
+	  node->offset = matchlet->offset;
+	  node->value_length = matchlet->value_length;
+	  node->range_length = matchlet->range_length;
+	  node->indent = matchlet->indent;
+	}
+
+      rule->end = node - mime_magic->nodes;
+
+      for (i = rule->first; i < rule->end; i++)
+	{
+	  for (j = i + 1; j < rule->end; j++)
+	    if (mime_magic->nodes[j].indent <= mime_magic->nodes[i].indent)
+	      break;
+
+	  mime_magic->nodes[i].skip = j;
+	}
+    }
+
+  _xdg_mime_magic_match_free (mime_magic->match_list);
+  mime_magic->match_list = NULL;
+}
+
+/* Values were swapped to host order while parsing, so every matchlet is
+ * written with a word size of 1.
+ */
+void
+_xdg_mime_magic_serialize (XdgMimeMagic       *mime_magic,
+			   XdgMimeCacheWriter *writer)
+{
+  XdgMimeMagicRule *rule;
+  XdgMimeMagicNode *node;
+  int parents[64], indents[64];
+  int depth, handle;
+  int i, j;
+
+  for (i = 0; i < mime_magic->n_rules; i++)
     {
-      if (memcmp ("MIME-Magic\0\n", header, 12) == 0)
-        _xdg_mime_magic_read_magic_file (mime_magic, magic_file);
+      rule = &mime_magic->rules[i];
+      handle = _xdg_mime_cache_writer_add_magic (writer, rule->priority, rule->mime_type);
+      depth = 0;
+
+      for (j = rule->first; j < rule->end; j++)
+	{
+	  node = &mime_magic->nodes[j];
+
+	  while (depth > 0 && indents[depth - 1] >= node->indent)
+	    depth--;
+
+	  parents[depth] = _xdg_mime_cache_writer_add_matchlet (writer, handle,
+								depth > 0 ? parents[depth - 1] : -1,
+								node->offset, node->range_length, 1,
+								node->value, node->mask,
+								node->value_length);
+	  indents[depth] = node->indent;
+	  if (depth < 63)
+	    depth++;
+	}
     }
+}
 
-  fclose (magic_file);
+/* Prints the counters of every rule that has been tried.
+ */
+void
+_xdg_mime_magic_dump_profile (XdgMimeMagic *mime_magic)
+{
+  XdgMimeMagicRule *rule;
+  int i;
+
+  for (i = 0; i < mime_magic->n_rules; i++)
+    {
+      rule = &mime_magic->rules[i];
+
+      if (rule->n_evaluations == 0 && rule->n_matches == 0)
+	continue;
+
+      printf ("%d %s %lu %lu %lu\n",
+	      rule->priority,
+	      rule->mime_type,
+	      rule->n_evaluations,
+	      rule->n_matches,
+	      rule->n_bytes);
+    }
 }
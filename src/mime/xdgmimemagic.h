@@ -30,6 +30,7 @@
 
 #include <unistd.h>
 #include "xdgmime.h"
+#include "xdgmimecachewriter.h"
 typedef struct XdgMimeMagic XdgMimeMagic;
 
 #ifdef XDG_PREFIX
@@ -39,19 +40,32 @@ typedef struct XdgMimeMagic XdgMimeMagic;
 #define _xdg_mime_magic_free                      XDG_RESERVED_ENTRY(magic_free)
 #define _xdg_mime_magic_get_buffer_extents        XDG_RESERVED_ENTRY(magic_get_buffer_extents)
 #define _xdg_mime_magic_lookup_data               XDG_RESERVED_ENTRY(magic_lookup_data)
+#define _xdg_mime_magic_dump_profile              XDG_RESERVED_ENTRY(magic_dump_profile)
+#define _xdg_mime_magic_compile                   XDG_RESERVED_ENTRY(magic_compile)
+#define _xdg_mime_magic_serialize                 XDG_RESERVED_ENTRY(magic_serialize)
+#define _magic_flags                              XDG_RESERVED_ENTRY(magic_flags)
 #endif
 
+extern int _magic_flags;
+
 
 XdgMimeMagic *_xdg_mime_magic_new                (void);
 void          _xdg_mime_magic_read_from_file     (XdgMimeMagic *mime_magic,
 						  const char   *file_name);
 void          _xdg_mime_magic_free               (XdgMimeMagic *mime_magic);
+void          _xdg_mime_magic_compile            (XdgMimeMagic *mime_magic);
 int           _xdg_mime_magic_get_buffer_extents (XdgMimeMagic *mime_magic);
-const char   *_xdg_mime_magic_lookup_data        (XdgMimeMagic *mime_magic,
-						  const void   *data,
-						  size_t        len,
-						  int          *result_prio,
-						  const char   *mime_types[],
-						  int           n_mime_types);
+/* Rules may be reordered for ctx, which may be NULL */
+const char   *_xdg_mime_magic_lookup_data        (XdgMimeMagic     *mime_magic,
+						  XdgMimeLookupCtx *ctx,
+						  const void       *data,
+						  size_t            len,
+						  int              *result_prio,
+						  const char       *mime_types[],
+						  int               n_mime_types);
+void          _xdg_mime_magic_dump_profile       (XdgMimeMagic *mime_magic);
+/* Adds the compiled rules to writer */
+void          _xdg_mime_magic_serialize          (XdgMimeMagic       *mime_magic,
+						  XdgMimeCacheWriter *writer);
 
 #endif /* __XDG_MIME_MAGIC_H__ */
@@ -30,6 +30,7 @@
 
 #include "xdgmimeparent.h"
 #include "xdgmimeint.h"
+#include "xdgmimestrpool.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
@@ -45,29 +46,46 @@
 #endif
 
 typedef struct XdgMimeParents XdgMimeParents;
+typedef struct XdgMimeParentPair XdgMimeParentPair;
 
 struct XdgMimeParents
 {
-  char *mime;
-  char **parents;
+  const char *mime;
+  const char **parents;
   int n_parents;
 };
 
+/* One line of a subclasses file */
+struct XdgMimeParentPair
+{
+  const char *mime;
+  const char *parent;
+  int seq;
+};
+
 struct XdgParentList
 {
   struct XdgMimeParents *parents;
   int n_mimes;
+
+  /* NULL terminated parent arrays of all entries */
+  const char **parent_data;
+
+  struct XdgMimeParentPair *pairs;
+  int n_pairs;
+  int n_allocated;
+
+  XdgStringPool *pool;
+  XdgStringIndex *index;
 };
 
 XdgParentList *
-_xdg_mime_parent_list_new (void)
+_xdg_mime_parent_list_new (XdgStringPool *pool)
 {
   XdgParentList *list;
 
-  list = malloc (sizeof (XdgParentList));
-
-  list->parents = NULL;
-  list->n_mimes = 0;
+  list = calloc (1, sizeof (XdgParentList));
+  list->pool = pool;
 
   return list;
 }
@@ -75,46 +93,93 @@ _xdg_mime_parent_list_new (void)
 void         
 _xdg_mime_parent_list_free (XdgParentList *list)
 {
-  int i;
-  char **p;
+  /* The strings belong to the pool */
+  if (list->index)
+    _xdg_string_index_free (list->index);
+  free (list->parent_data);
+  free (list->parents);
+  free (list->pairs);
+  free (list);
+}
 
-  if (list->parents)
+static int
+parent_pair_cmp (const void *v1, const void *v2)
+{
+  const XdgMimeParentPair *p1 = (const XdgMimeParentPair *)v1;
+  const XdgMimeParentPair *p2 = (const XdgMimeParentPair *)v2;
+
+  /* Interned strings, so comparing pointers groups equal types */
+  if (p1->mime != p2->mime)
+    return p1->mime < p2->mime ? -1 : 1;
+
+  return p1->seq - p2->seq;
+}
+
+/* Groups the parents read so far by mime type and builds the hash index,
+ * must be called once all files have been read. */
+void
+_xdg_mime_parent_list_build_index (XdgParentList *list)
+{
+  XdgMimeParents *entry = NULL;
+  const char **data;
+  int i, j;
+
+  if (list->index)
+    _xdg_string_index_free (list->index);
+  free (list->parent_data);
+  free (list->parents);
+
+  if (list->n_pairs > 1)
+    qsort (list->pairs, list->n_pairs, sizeof (XdgMimeParentPair), parent_pair_cmp);
+
+  list->n_mimes = 0;
+  list->parents = malloc ((list->n_pairs + 1) * sizeof (XdgMimeParents));
+  list->parent_data = malloc ((list->n_pairs * 2 + 1) * sizeof (char *));
+  data = list->parent_data;
+
+  for (i = 0; i < list->n_pairs; i++)
     {
-      for (i = 0; i < list->n_mimes; i++)
+      if (entry == NULL || entry->mime != list->pairs[i].mime)
 	{
-	  for (p = list->parents[i].parents; *p; p++)
-	    free (*p);
+	  if (entry)
+	    *data++ = NULL;
 
-	  free (list->parents[i].parents);
-	  free (list->parents[i].mime);
+	  entry = &list->parents[list->n_mimes++];
+	  entry->mime = list->pairs[i].mime;
+	  entry->parents = data;
+	  entry->n_parents = 0;
+	}
+
+      /* The same line may appear in several directories */
+      for (j = 0; j < entry->n_parents; j++)
+	if (entry->parents[j] == list->pairs[i].parent)
+	  break;
+
+      if (j == entry->n_parents)
+	{
+	  *data++ = list->pairs[i].parent;
+	  entry->n_parents++;
 	}
-      free (list->parents);
     }
-  free (list);
-}
+  *data = NULL;
 
-static int
-parent_entry_cmp (const void *v1, const void *v2)
-{
-  return strcmp (((XdgMimeParents *)v1)->mime, ((XdgMimeParents *)v2)->mime);
+  list->index = _xdg_string_index_new (list->n_mimes);
+
+  for (i = 0; i < list->n_mimes; i++)
+    _xdg_string_index_insert (list->index, list->parents[i].mime, i);
 }
 
 const char **
 _xdg_mime_parent_list_lookup (XdgParentList *list,
 			      const char    *mime)
 {
-  XdgMimeParents *entry;
-  XdgMimeParents key;
+  int i;
 
-  if (list->n_mimes > 0)
+  if (list->index && (mime = _xdg_string_pool_lookup (list->pool, mime)) != NULL)
     {
-      key.mime = (char *)mime;
-      key.parents = NULL;
-
-      entry = bsearch (&key, list->parents, list->n_mimes,
-		       sizeof (XdgMimeParents), &parent_entry_cmp);
-      if (entry)
-        return (const char **)entry->parents;
+      i = _xdg_string_index_lookup (list->index, mime);
+      if (i >= 0)
+        return list->parents[i].parents;
     }
 
   return NULL;
@@ -124,21 +189,18 @@ void
 _xdg_mime_parent_read_from_file (XdgParentList *list,
 				 const char    *file_name)
 {
-  FILE *file;
-  char line[255];
-  int i, alloc;
-  XdgMimeParents *entry;
+  char *buffer, *cursor, *line;
+  size_t size;
+  XdgMimeParentPair *pair;
 
-  file = fopen (file_name, "r");
+  buffer = _xdg_map_file (file_name, &size);
 
-  if (file == NULL)
+  if (buffer == NULL)
     return;
 
-  /* FIXME: Not UTF-8 safe.  Doesn't work if lines are greater than 255 chars.
-   * Blah */
-  alloc = list->n_mimes + 16;
-  list->parents = realloc (list->parents, alloc * sizeof (XdgMimeParents));
-  while (fgets (line, 255, file) != NULL)
+  /* FIXME: Not UTF-8 safe. */
+  cursor = buffer;
+  while ((line = _xdg_next_line (&cursor, buffer + size)) != NULL)
     {
       char *sep;
       if (line[0] == '#')
@@ -148,54 +210,21 @@ _xdg_mime_parent_read_from_file (XdgParentList *list,
       if (sep == NULL)
 	continue;
       *(sep++) = '\000';
-      sep[strlen (sep) -1] = '\000';
-      entry = NULL;
-      for (i = 0; i < list->n_mimes; i++)
-	{
-	  if (strcmp (list->parents[i].mime, line) == 0)
-	    {
-	      entry = &(list->parents[i]);
-	      break;
-	    }
-	}
-      
-      if (!entry)
-	{
-	  if (list->n_mimes == alloc)
-	    {
-	      alloc <<= 1;
-	      list->parents = realloc (list->parents, 
-				       alloc * sizeof (XdgMimeParents));
-	    }
-	  list->parents[list->n_mimes].mime = strdup (line);
-	  list->parents[list->n_mimes].parents = NULL;
-	  entry = &(list->parents[list->n_mimes]);
-	  list->n_mimes++;
-	}
 
-      if (!entry->parents)
-	{
-	  entry->n_parents = 1;
-	  entry->parents = malloc ((entry->n_parents + 1) * sizeof (char *));
-	}
-      else
+      if (list->n_pairs == list->n_allocated)
 	{
-	  entry->n_parents += 1;
-	  entry->parents = realloc (entry->parents, 
-				    (entry->n_parents + 2) * sizeof (char *));
+	  list->n_allocated = list->n_allocated ? list->n_allocated * 2 : 64;
+	  list->pairs = realloc (list->pairs, 
+				 list->n_allocated * sizeof (XdgMimeParentPair));
 	}
-      entry->parents[entry->n_parents - 1] = strdup (sep);
-      entry->parents[entry->n_parents] = NULL;
-    }
 
-  list->parents = realloc (list->parents, 
-			   list->n_mimes * sizeof (XdgMimeParents));
+      pair = &list->pairs[list->n_pairs];
+      pair->mime = _xdg_string_pool_intern (list->pool, line);
+      pair->parent = _xdg_string_pool_intern (list->pool, sep);
+      pair->seq = list->n_pairs++;
+    }
 
-  fclose (file);  
-  
-  if (list->n_mimes > 1)
-    qsort (list->parents, list->n_mimes, 
-           sizeof (XdgMimeParents), &parent_entry_cmp);
+  _xdg_unmap_file (buffer, size);
 }
 
 
@@ -203,7 +232,7 @@ void
 _xdg_mime_parent_list_dump (XdgParentList *list)
 {
   int i;
-  char **p;
+  const char **p;
 
   if (list->parents)
     {
@@ -215,4 +244,15 @@ _xdg_mime_parent_list_dump (XdgParentList *list)
     }
 }
 
+void
+_xdg_mime_parent_list_serialize (XdgParentList      *list,
+				 XdgMimeCacheWriter *writer)
+{
+  int i, j;
 
+  for (i = 0; i < list->n_mimes; i++)
+    for (j = 0; j < list->parents[i].n_parents; j++)
+      _xdg_mime_cache_writer_add_parent (writer,
+					 list->parents[i].mime,
+					 list->parents[i].parents[j]);
+}
@@ -28,7 +28,8 @@
 #ifndef __XDG_MIME_PARENT_H__
 #define __XDG_MIME_PARENT_H__
 
-#include "xdgmime.h"
+#include "xdgmimestrpool.h"
+#include "xdgmimecachewriter.h"
 
 typedef struct XdgParentList XdgParentList;
 
@@ -37,15 +38,21 @@ typedef struct XdgParentList XdgParentList;
 #define _xdg_mime_parent_list_new              XDG_RESERVED_ENTRY(parent_list_new)
 #define _xdg_mime_parent_list_free             XDG_RESERVED_ENTRY(parent_list_free)
 #define _xdg_mime_parent_list_lookup           XDG_RESERVED_ENTRY(parent_list_lookup)
+#define _xdg_mime_parent_list_build_index      XDG_RESERVED_ENTRY(parent_list_build_index)
 #define _xdg_mime_parent_list_dump             XDG_RESERVED_ENTRY(parent_list_dump)
+#define _xdg_mime_parent_list_serialize        XDG_RESERVED_ENTRY(parent_list_serialize)
 #endif
 
 void          _xdg_mime_parent_read_from_file (XdgParentList *list,
 					       const char    *file_name);
-XdgParentList *_xdg_mime_parent_list_new       (void);
+XdgParentList *_xdg_mime_parent_list_new       (XdgStringPool *pool);
 void           _xdg_mime_parent_list_free      (XdgParentList *list);
+void           _xdg_mime_parent_list_build_index (XdgParentList *list);
 const char   **_xdg_mime_parent_list_lookup    (XdgParentList *list,
 						const char    *mime);
 void           _xdg_mime_parent_list_dump      (XdgParentList *list);
+/* Adds the parents to writer, the index must be built */
+void           _xdg_mime_parent_list_serialize (XdgParentList      *list,
+						XdgMimeCacheWriter *writer);
 
 #endif /* __XDG_MIME_PARENT_H__ */
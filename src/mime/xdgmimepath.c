@@ -0,0 +1,436 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimepath.c: Private file.  Datastructure for storing the full path rules.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <xdg/config.h>
+
+#include "xdgmimepath.h"
+#include "xdgmimeint.h"
+#include "xdgmimestrpool.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Sets of automaton states up to this size live on the stack */
+#define STACK_WORDS 16
+
+typedef struct XdgPathRule XdgPathRule;
+typedef struct XdgPathNode XdgPathNode;
+
+typedef enum
+{
+  XDG_PATH_NODE_CHAR,
+  XDG_PATH_NODE_ANY,
+  XDG_PATH_NODE_CLASS,
+  XDG_PATH_NODE_STAR,
+  XDG_PATH_NODE_ACCEPT
+} XdgPathNodeType;
+
+struct XdgPathRule
+{
+  const char *pattern;
+  const char *mime_type;
+  const char *directory;
+  int weight;
+  int case_sensitive;
+};
+
+/* One state per pattern element.  The state following a matched
+ * element is the next one in the array, a star also loops onto itself. */
+struct XdgPathNode
+{
+  unsigned char type;
+  unsigned char fold;
+  unsigned char c;
+  int arg;
+};
+
+struct XdgPathRules
+{
+  XdgPathRule *rules;
+  int n_rules;
+  int n_rules_allocated;
+
+  /* The automaton of all rules, built by _xdg_mime_path_rules_compile() */
+  XdgPathNode *nodes;
+  int n_nodes;
+  unsigned char (*classes)[32];
+  int n_classes;
+  int n_words;
+  uint64_t *start;
+
+  XdgStringPool *strings;
+};
+
+XdgPathRules *
+_xdg_mime_path_rules_new (void)
+{
+  XdgPathRules *path_rules;
+
+  path_rules = calloc (1, sizeof (XdgPathRules));
+  path_rules->strings = _xdg_string_pool_new ();
+
+  return path_rules;
+}
+
+void
+_xdg_mime_path_rules_free (XdgPathRules *path_rules)
+{
+  _xdg_string_pool_free (path_rules->strings);
+  free (path_rules->rules);
+  free (path_rules->nodes);
+  free (path_rules->classes);
+  free (path_rules->start);
+  free (path_rules);
+}
+
+/* Reads "weight:mime/type:pattern[:cs]" lines.  Unlike globs, patterns
+ * are matched against the whole path given to the lookup and '*' also
+ * matches '/': "*.git/objects*" covers everything below .git/objects. */
+void
+_xdg_mime_path_rules_read_from_file (XdgPathRules *path_rules,
+				     const char   *file_name)
+{
+  char *buffer, *cursor, *line;
+  const char *directory;
+  char *colon, *p;
+  size_t size;
+  XdgPathRule *rule;
+
+  buffer = _xdg_map_file (file_name, &size);
+
+  if (buffer == NULL)
+    return;
+
+  p = strrchr (file_name, '/');
+  directory = _xdg_string_pool_intern_len (path_rules->strings, file_name, p ? p - file_name : 0);
+
+  cursor = buffer;
+  while ((line = _xdg_next_line (&cursor, buffer + size)) != NULL)
+    {
+      char *mime_type, *pattern;
+      int weight;
+
+      if (line[0] == '#' || line[0] == 0)
+	continue;
+
+      if ((colon = strchr (line, ':')) == NULL)
+	continue;
+      *colon = 0;
+      weight = atoi (line);
+
+      mime_type = colon + 1;
+      if ((colon = strchr (mime_type, ':')) == NULL)
+	continue;
+      *colon = 0;
+
+      pattern = colon + 1;
+      pattern[strcspn (pattern, "\r")] = 0;
+
+      if (path_rules->n_rules == path_rules->n_rules_allocated)
+	{
+	  path_rules->n_rules_allocated = path_rules->n_rules_allocated ? path_rules->n_rules_allocated * 2 : 16;
+	  path_rules->rules = realloc (path_rules->rules, path_rules->n_rules_allocated * sizeof (XdgPathRule));
+	}
+
+      rule = &path_rules->rules[path_rules->n_rules];
+      rule->weight = weight;
+      rule->case_sensitive = FALSE;
+
+      /* Patterns may not contain ':', so the last one starts the flags */
+      if ((colon = strrchr (pattern, ':')) != NULL)
+	{
+	  *colon = 0;
+	  rule->case_sensitive = strcmp (colon + 1, "cs") == 0;
+	}
+
+      if (pattern[0] == 0)
+	continue;
+
+      rule->pattern = _xdg_string_pool_intern (path_rules->strings, pattern);
+      rule->mime_type = _xdg_string_pool_intern (path_rules->strings, mime_type);
+      rule->directory = directory;
+      path_rules->n_rules++;
+    }
+
+  _xdg_unmap_file (buffer, size);
+}
+
+static unsigned char
+ascii_tolower (unsigned char c)
+{
+  return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+static XdgPathNode *
+path_rules_add_node (XdgPathRules    *path_rules,
+		     XdgPathNodeType  type,
+		     int              arg)
+{
+  XdgPathNode *node = &path_rules->nodes[path_rules->n_nodes++];
+
+  node->type = type;
+  node->fold = FALSE;
+  node->c = 0;
+  node->arg = arg;
+
+  return node;
+}
+
+/* Parses the bracket expression at p ("[a-z]", "[!.]"), returns the
+ * character following it or NULL if it is not terminated. */
+static const char *
+path_rules_add_class (XdgPathRules *path_rules,
+		      const char   *p,
+		      int           case_sensitive)
+{
+  unsigned char class[32];
+  int negate = FALSE;
+  int c, last, i;
+
+  memset (class, 0, sizeof (class));
+
+  p++;
+  if (*p == '!' || *p == '^')
+    {
+      negate = TRUE;
+      p++;
+    }
+
+  /* A ']' right at the start is literal */
+  for (last = -1; *p && (*p != ']' || last == -1); p++)
+    {
+      c = (unsigned char) *p;
+
+      if (c == '-' && last >= 0 && p[1] && p[1] != ']')
+	{
+	  for (c = last; c <= (unsigned char) p[1]; c++)
+	    class[c >> 3] |= 1 << (c & 7);
+	  p++;
+	  last = -2;
+	  continue;
+	}
+
+      class[c >> 3] |= 1 << (c & 7);
+      last = c;
+    }
+
+  if (*p != ']')
+    return NULL;
+
+  if (!case_sensitive)
+    for (c = 'a'; c <= 'z'; c++)
+      if (class[c >> 3] & (1 << (c & 7)) || class[(c - 32) >> 3] & (1 << ((c - 32) & 7)))
+	{
+	  class[c >> 3] |= 1 << (c & 7);
+	  class[(c - 32) >> 3] |= 1 << ((c - 32) & 7);
+	}
+
+  if (negate)
+    for (i = 0; i < 32; i++)
+      class[i] = ~class[i];
+
+  memcpy (path_rules->classes[path_rules->n_classes], class, sizeof (class));
+  path_rules_add_node (path_rules, XDG_PATH_NODE_CLASS, path_rules->n_classes++);
+
+  return p + 1;
+}
+
+static void
+path_rules_add_state (const XdgPathNode *nodes,
+		      uint64_t          *set,
+		      int                i)
+{
+  /* A star may match nothing, so its successor is reached as well */
+  for (;;)
+    {
+      set[i >> 6] |= (uint64_t) 1 << (i & 63);
+      if (nodes[i].type != XDG_PATH_NODE_STAR)
+	break;
+      i++;
+    }
+}
+
+void
+_xdg_mime_path_rules_compile (XdgPathRules *path_rules)
+{
+  int n_nodes = 0, n_classes = 0;
+  int i, first;
+  const char *p;
+
+  for (i = 0; i < path_rules->n_rules; i++)
+    {
+      n_nodes += strlen (path_rules->rules[i].pattern) + 1;
+      for (p = path_rules->rules[i].pattern; (p = strchr (p, '[')); p++)
+	n_classes++;
+    }
+
+  if (n_nodes == 0)
+    return;
+
+  path_rules->nodes = malloc (n_nodes * sizeof (XdgPathNode));
+  path_rules->classes = malloc ((n_classes + 1) * sizeof (path_rules->classes[0]));
+  path_rules->n_words = (n_nodes + 63) / 64;
+  path_rules->start = calloc (path_rules->n_words, sizeof (uint64_t));
+
+  for (i = 0; i < path_rules->n_rules; i++)
+    {
+      const XdgPathRule *rule = &path_rules->rules[i];
+      XdgPathNode *node;
+      const char *next;
+
+      first = path_rules->n_nodes;
+
+      for (p = rule->pattern; *p; p++)
+	switch (*p)
+	  {
+	  case '*':
+	    if (path_rules->n_nodes == first ||
+		path_rules->nodes[path_rules->n_nodes - 1].type != XDG_PATH_NODE_STAR)
+	      path_rules_add_node (path_rules, XDG_PATH_NODE_STAR, 0);
+	    break;
+	  case '?':
+	    path_rules_add_node (path_rules, XDG_PATH_NODE_ANY, 0);
+	    break;
+	  case '[':
+	    if ((next = path_rules_add_class (path_rules, p, rule->case_sensitive)) != NULL)
+	      {
+		p = next - 1;
+		break;
+	      }
+	    /* Unterminated, so a literal '[' */
+	  default:
+	    if (*p == '\\' && p[1])
+	      p++;
+	    node = path_rules_add_node (path_rules, XDG_PATH_NODE_CHAR, 0);
+	    node->fold = !rule->case_sensitive;
+	    node->c = node->fold ? ascii_tolower (*p) : (unsigned char) *p;
+	    break;
+	  }
+
+      path_rules_add_node (path_rules, XDG_PATH_NODE_ACCEPT, i);
+      path_rules_add_state (path_rules->nodes, path_rules->start, first);
+    }
+}
+
+const char *
+_xdg_mime_path_rules_lookup (XdgPathRules  *path_rules,
+			     const char    *path,
+			     int           *weight,
+			     const char   **directory)
+{
+  uint64_t stack[2 * STACK_WORDS];
+  uint64_t *current, *next, *tmp;
+  const XdgPathNode *nodes = path_rules->nodes;
+  const XdgPathRule *best = NULL;
+  int n_words = path_rules->n_words;
+  unsigned char c, lower;
+  uint64_t bits, alive;
+  const char *p;
+  int i, w;
+
+  if (path_rules->n_nodes == 0)
+    return NULL;
+
+  if (n_words <= STACK_WORDS)
+    current = stack;
+  else
+    current = malloc (2 * n_words * sizeof (uint64_t));
+  next = current + n_words;
+
+  memcpy (current, path_rules->start, n_words * sizeof (uint64_t));
+
+  for (p = path; *p; p++)
+    {
+      c = (unsigned char) *p;
+      lower = ascii_tolower (c);
+
+      memset (next, 0, n_words * sizeof (uint64_t));
+
+      for (w = 0; w < n_words; w++)
+	for (bits = current[w]; bits; bits &= bits - 1)
+	  {
+	    i = (w << 6) + __builtin_ctzll (bits);
+
+	    switch (nodes[i].type)
+	      {
+	      case XDG_PATH_NODE_CHAR:
+		if (nodes[i].c == (nodes[i].fold ? lower : c))
+		  path_rules_add_state (nodes, next, i + 1);
+		break;
+	      case XDG_PATH_NODE_ANY:
+		path_rules_add_state (nodes, next, i + 1);
+		break;
+	      case XDG_PATH_NODE_CLASS:
+		if (path_rules->classes[nodes[i].arg][c >> 3] & (1 << (c & 7)))
+		  path_rules_add_state (nodes, next, i + 1);
+		break;
+	      case XDG_PATH_NODE_STAR:
+		path_rules_add_state (nodes, next, i);
+		break;
+	      default:
+		break;
+	      }
+	  }
+
+      tmp = current;
+      current = next;
+      next = tmp;
+
+      /* Most paths leave the automaton after a few characters */
+      for (w = 0, alive = 0; w < n_words; w++)
+	alive |= current[w];
+      if (!alive)
+	break;
+    }
+
+  if (*p == 0)
+    for (w = 0; w < n_words; w++)
+      for (bits = current[w]; bits; bits &= bits - 1)
+	{
+	  i = (w << 6) + __builtin_ctzll (bits);
+
+	  /* Rules read first win among equally heavy ones */
+	  if (nodes[i].type == XDG_PATH_NODE_ACCEPT &&
+	      (best == NULL || path_rules->rules[nodes[i].arg].weight > best->weight ||
+	       (path_rules->rules[nodes[i].arg].weight == best->weight &&
+		&path_rules->rules[nodes[i].arg] < best)))
+	    best = &path_rules->rules[nodes[i].arg];
+	}
+
+  if (current != stack && next != stack)
+    free (current < next ? current : next);
+
+  if (best == NULL)
+    return NULL;
+
+  if (weight)
+    *weight = best->weight;
+  if (directory)
+    *directory = best->directory;
+
+  return best->mime_type;
+}
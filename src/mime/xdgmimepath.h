@@ -0,0 +1,56 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimepath.h: Private file.  Datastructure for storing the full path rules.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __XDG_MIME_PATH_H__
+#define __XDG_MIME_PATH_H__
+
+#include "xdgmime.h"
+
+typedef struct XdgPathRules XdgPathRules;
+
+#ifdef XDG_PREFIX
+#define _xdg_mime_path_rules_read_from_file   XDG_RESERVED_ENTRY(path_rules_read_from_file)
+#define _xdg_mime_path_rules_new              XDG_RESERVED_ENTRY(path_rules_new)
+#define _xdg_mime_path_rules_free             XDG_RESERVED_ENTRY(path_rules_free)
+#define _xdg_mime_path_rules_compile          XDG_RESERVED_ENTRY(path_rules_compile)
+#define _xdg_mime_path_rules_lookup           XDG_RESERVED_ENTRY(path_rules_lookup)
+#endif
+
+void          _xdg_mime_path_rules_read_from_file (XdgPathRules  *path_rules,
+						   const char    *file_name);
+XdgPathRules *_xdg_mime_path_rules_new            (void);
+void          _xdg_mime_path_rules_free           (XdgPathRules  *path_rules);
+void          _xdg_mime_path_rules_compile        (XdgPathRules  *path_rules);
+/* Returns the type of the heaviest rule matching the whole of path, or
+ * NULL.  weight and directory (the "mime" directory of the rule) may be
+ * NULL. */
+const char   *_xdg_mime_path_rules_lookup         (XdgPathRules  *path_rules,
+						   const char    *path,
+						   int           *weight,
+						   const char   **directory);
+
+#endif /* __XDG_MIME_PATH_H__ */
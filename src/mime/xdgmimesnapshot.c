@@ -0,0 +1,202 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimesnapshot.c: Shared snapshot of the text MIME databases.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <xdg/config.h>
+
+#include "xdgmimesnapshot.h"
+#include "xdgmimeint.h"
+#include "../basedirectory/xdgbasedirectory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define SNAPSHOT_FILE "libxdg/mime.cache"
+
+/* Every file xdg_mime_init_from_directory() may read besides treemagic
+ * and paths, which are always read from the directories. */
+static const char *const source_files[] =
+{
+  "globs2", "globs", "magic", "aliases", "subclasses",
+  "XMLnamespaces", "icons", "generic-icons"
+};
+
+typedef struct
+{
+  char *data;
+  size_t len;
+  size_t allocated;
+  int has_cache;
+} SnapshotStamp;
+
+static void
+stamp_append (SnapshotStamp *stamp,
+	      const char    *line)
+{
+  size_t len = strlen (line);
+
+  if (stamp->len + len + 1 > stamp->allocated)
+    {
+      while (stamp->len + len + 1 > stamp->allocated)
+	stamp->allocated = stamp->allocated ? stamp->allocated * 2 : 1024;
+      stamp->data = realloc (stamp->data, stamp->allocated);
+    }
+
+  memcpy (stamp->data + stamp->len, line, len + 1);
+  stamp->len += len;
+}
+
+static int
+stamp_directory (const char    *directory,
+		 SnapshotStamp *stamp)
+{
+  struct stat st;
+  char *file_name;
+  char *line;
+  int i;
+
+  file_name = malloc (strlen (directory) + strlen ("/mime/generic-icons") + 1);
+
+  strcpy (file_name, directory); strcat (file_name, "/mime/mime.cache");
+  if (stat (file_name, &st) == 0)
+    {
+      free (file_name);
+      stamp->has_cache = TRUE;
+      return TRUE; /* Stop processing */
+    }
+
+  line = malloc (strlen (directory) + strlen ("/mime/generic-icons") + 3 * 24);
+
+  for (i = 0; i < sizeof (source_files) / sizeof (source_files[0]); i++)
+    {
+      strcpy (file_name, directory); strcat (file_name, "/mime/"); strcat (file_name, source_files[i]);
+      if (stat (file_name, &st) != 0)
+	continue;
+
+      sprintf (line, "%s %ld %lld %lu\n", file_name, (long) st.st_mtime,
+	       (long long) st.st_size, (unsigned long) st.st_ino);
+      stamp_append (stamp, line);
+    }
+
+  free (line);
+  free (file_name);
+
+  return FALSE; /* Keep processing */
+}
+
+char *
+_xdg_mime_snapshot_stamp (void)
+{
+  SnapshotStamp stamp;
+  char *file_name;
+
+  file_name = _xdg_cache_home_file (SNAPSHOT_FILE);
+  if (file_name == NULL)
+    return NULL;
+  free (file_name);
+
+  memset (&stamp, 0, sizeof (stamp));
+  _xdg_for_each_data_dir ((XdgDirectoryFunc) stamp_directory, &stamp);
+
+  if (stamp.has_cache || stamp.data == NULL)
+    {
+      free (stamp.data);
+      return NULL;
+    }
+
+  return stamp.data;
+}
+
+XdgMimeCache *
+_xdg_mime_snapshot_load (const char *stamp,
+			 int         load_flags)
+{
+  XdgMimeCache *cache;
+  const char *cache_stamp;
+  char *file_name;
+
+  file_name = _xdg_cache_home_file (SNAPSHOT_FILE);
+  if (file_name == NULL)
+    return NULL;
+
+  cache = _xdg_mime_cache_new_from_file (file_name, load_flags);
+  free (file_name);
+
+  if (cache == NULL)
+    return NULL;
+
+  cache_stamp = _xdg_mime_cache_get_stamp (cache);
+  if (cache_stamp == NULL || strcmp (cache_stamp, stamp) != 0)
+    {
+      _xdg_mime_cache_unref (cache);
+      return NULL;
+    }
+
+  return cache;
+}
+
+/* Creates the missing directories leading to file_name */
+static int
+make_parent_directories (char *file_name)
+{
+  char *p;
+
+  for (p = strchr (file_name + 1, '/'); p; p = strchr (p + 1, '/'))
+    {
+      *p = '\000';
+      if (mkdir (file_name, 0700) != 0 && errno != EEXIST)
+	{
+	  *p = '/';
+	  return FALSE;
+	}
+      *p = '/';
+    }
+
+  return TRUE;
+}
+
+int
+_xdg_mime_snapshot_save (XdgMimeCacheWriter *writer,
+			 const char         *stamp)
+{
+  char *file_name;
+  int res;
+
+  file_name = _xdg_cache_home_file (SNAPSHOT_FILE);
+  if (file_name == NULL)
+    return FALSE;
+
+  _xdg_mime_cache_writer_set_stamp (writer, stamp);
+
+  res = make_parent_directories (file_name) &&
+	_xdg_mime_cache_writer_write (writer, file_name);
+
+  free (file_name);
+  return res;
+}
@@ -0,0 +1,53 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimesnapshot.h: Shared snapshot of the text MIME databases.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef __XDG_MIME_SNAPSHOT_H__
+#define __XDG_MIME_SNAPSHOT_H__
+
+#include "xdgmimecache.h"
+#include "xdgmimecachewriter.h"
+
+#ifdef XDG_PREFIX
+#define _xdg_mime_snapshot_stamp  XDG_RESERVED_ENTRY(snapshot_stamp)
+#define _xdg_mime_snapshot_load   XDG_RESERVED_ENTRY(snapshot_load)
+#define _xdg_mime_snapshot_save   XDG_RESERVED_ENTRY(snapshot_save)
+#endif
+
+/* Returns the path, mtime, size and inode of every text file the
+ * snapshot would be built from, or NULL if a directory has a mime.cache
+ * of its own (those are shared already) or there is no cache directory.
+ */
+char         *_xdg_mime_snapshot_stamp (void);
+/* Maps the snapshot if it was built from the files described by stamp */
+XdgMimeCache *_xdg_mime_snapshot_load  (const char         *stamp,
+					int                 load_flags);
+/* Atomically replaces the snapshot, returns TRUE on success */
+int           _xdg_mime_snapshot_save  (XdgMimeCacheWriter *writer,
+					const char         *stamp);
+
+#endif /* __XDG_MIME_SNAPSHOT_H__ */
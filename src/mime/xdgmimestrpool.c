@@ -0,0 +1,300 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimestrpool.c: Private file.  Pool of interned strings.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <xdg/config.h>
+
+#include "xdgmimestrpool.h"
+#include "xdgmimeint.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_SIZE 4096
+
+typedef struct XdgStringPoolSlot XdgStringPoolSlot;
+typedef struct XdgStringIndexSlot XdgStringIndexSlot;
+typedef struct XdgStringPoolChunk XdgStringPoolChunk;
+
+struct XdgStringPoolSlot
+{
+  xdg_uint32_t hash;
+  const char *str;
+};
+
+struct XdgStringPoolChunk
+{
+  XdgStringPoolChunk *next;
+  int used;
+  int size;
+  char data[1];
+};
+
+struct XdgStringIndexSlot
+{
+  const char *key;
+  int value;
+};
+
+struct XdgStringIndex
+{
+  XdgStringIndexSlot *slots;
+  xdg_uint32_t mask;
+};
+
+struct XdgStringPool
+{
+  XdgStringPoolSlot *slots;
+  xdg_uint32_t mask;
+  int n_strings;
+
+  XdgStringPoolChunk *chunks;
+};
+
+XdgStringPool *
+_xdg_string_pool_new (void)
+{
+  XdgStringPool *pool;
+
+  pool = malloc (sizeof (XdgStringPool));
+  pool->mask = 255;
+  pool->slots = calloc (pool->mask + 1, sizeof (XdgStringPoolSlot));
+  pool->n_strings = 0;
+  pool->chunks = NULL;
+
+  return pool;
+}
+
+void
+_xdg_string_pool_free (XdgStringPool *pool)
+{
+  XdgStringPoolChunk *chunk, *next;
+
+  for (chunk = pool->chunks; chunk; chunk = next)
+    {
+      next = chunk->next;
+      free (chunk);
+    }
+
+  free (pool->slots);
+  free (pool);
+}
+
+static char *
+_xdg_string_pool_alloc (XdgStringPool *pool,
+			int            len)
+{
+  XdgStringPoolChunk *chunk = pool->chunks;
+  char *res;
+
+  if (chunk == NULL || chunk->used + len > chunk->size)
+    {
+      int size = len > CHUNK_SIZE ? len : CHUNK_SIZE;
+
+      chunk = malloc (sizeof (XdgStringPoolChunk) + size);
+      chunk->used = 0;
+      chunk->size = size;
+
+      /* Keep filling the current chunk if only an oversized string did not fit */
+      if (pool->chunks && len > CHUNK_SIZE)
+	{
+	  chunk->next = pool->chunks->next;
+	  pool->chunks->next = chunk;
+	}
+      else
+	{
+	  chunk->next = pool->chunks;
+	  pool->chunks = chunk;
+	}
+    }
+
+  res = chunk->data + chunk->used;
+  chunk->used += len;
+
+  return res;
+}
+
+static void
+_xdg_string_pool_grow (XdgStringPool *pool)
+{
+  XdgStringPoolSlot *slots = pool->slots;
+  xdg_uint32_t i, slot, size = pool->mask + 1;
+
+  pool->mask = size * 2 - 1;
+  pool->slots = calloc (size * 2, sizeof (XdgStringPoolSlot));
+
+  for (i = 0; i < size; i++)
+    if (slots[i].str)
+      {
+	for (slot = slots[i].hash & pool->mask;
+	     pool->slots[slot].str;
+	     slot = (slot + 1) & pool->mask) ;
+
+	pool->slots[slot] = slots[i];
+      }
+
+  free (slots);
+}
+
+static XdgStringPoolSlot *
+_xdg_string_pool_find (XdgStringPool *pool,
+		       const char    *str,
+		       int            len,
+		       xdg_uint32_t   hash)
+{
+  XdgStringPoolSlot *slot;
+  xdg_uint32_t i;
+
+  for (i = hash & pool->mask; ; i = (i + 1) & pool->mask)
+    {
+      slot = &pool->slots[i];
+
+      if (slot->str == NULL ||
+	  (slot->hash == hash && strncmp (slot->str, str, len) == 0 && slot->str[len] == 0))
+	return slot;
+    }
+}
+
+static xdg_uint32_t
+_xdg_string_pool_hash (const char *str,
+		       int         len)
+{
+  xdg_uint32_t hash = 2166136261U;
+  int i;
+
+  for (i = 0; i < len; i++)
+    {
+      hash ^= (unsigned char) str[i];
+      hash *= 16777619U;
+    }
+
+  return hash;
+}
+
+/* Returns the pooled copy of the first len bytes of str */
+const char *
+_xdg_string_pool_intern_len (XdgStringPool *pool,
+			     const char    *str,
+			     int            len)
+{
+  xdg_uint32_t hash = _xdg_string_pool_hash (str, len);
+  XdgStringPoolSlot *slot;
+  char *copy;
+
+  slot = _xdg_string_pool_find (pool, str, len, hash);
+
+  if (slot->str)
+    return slot->str;
+
+  copy = _xdg_string_pool_alloc (pool, len + 1);
+  memcpy (copy, str, len);
+  copy[len] = 0;
+
+  slot->hash = hash;
+  slot->str = copy;
+
+  if (++pool->n_strings * 2 > pool->mask)
+    _xdg_string_pool_grow (pool);
+
+  return copy;
+}
+
+const char *
+_xdg_string_pool_intern (XdgStringPool *pool,
+			 const char    *str)
+{
+  return _xdg_string_pool_intern_len (pool, str, strlen (str));
+}
+
+/* Returns the pooled copy of str, or NULL if str has never been interned */
+const char *
+_xdg_string_pool_lookup (XdgStringPool *pool,
+			 const char    *str)
+{
+  int len = strlen (str);
+
+  return _xdg_string_pool_find (pool, str, len, _xdg_string_pool_hash (str, len))->str;
+}
+
+
+/* XdgStringIndex
+ */
+XdgStringIndex *
+_xdg_string_index_new (int n_keys)
+{
+  XdgStringIndex *index;
+  xdg_uint32_t size;
+
+  for (size = 16; size < n_keys * 2; size <<= 1) ;
+
+  index = malloc (sizeof (XdgStringIndex));
+  index->mask = size - 1;
+  index->slots = calloc (size, sizeof (XdgStringIndexSlot));
+
+  return index;
+}
+
+void
+_xdg_string_index_free (XdgStringIndex *index)
+{
+  free (index->slots);
+  free (index);
+}
+
+/* Maps the interned string key to value, unless key is already mapped.
+ * At most n_keys keys given to _xdg_string_index_new() can be inserted. */
+int
+_xdg_string_index_insert (XdgStringIndex *index,
+			  const char     *key,
+			  int             value)
+{
+  xdg_uint32_t i;
+
+  for (i = XDG_POINTER_HASH (key) & index->mask;
+       index->slots[i].key;
+       i = (i + 1) & index->mask)
+    if (index->slots[i].key == key)
+      return FALSE;
+
+  index->slots[i].key = key;
+  index->slots[i].value = value;
+
+  return TRUE;
+}
+
+/* Returns the value of the interned string key, or -1 */
+int
+_xdg_string_index_lookup (XdgStringIndex *index,
+			  const char     *key)
+{
+  xdg_uint32_t i;
+
+  for (i = XDG_POINTER_HASH (key) & index->mask;
+       index->slots[i].key;
+       i = (i + 1) & index->mask)
+    if (index->slots[i].key == key)
+      return index->slots[i].value;
+
+  return -1;
+}
@@ -0,0 +1,71 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimestrpool.h: Private file.  Pool of interned strings.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __XDG_MIME_STRING_POOL_H__
+#define __XDG_MIME_STRING_POOL_H__
+
+#include "xdgmime.h"
+#include <stdint.h>
+
+typedef struct XdgStringPool XdgStringPool;
+typedef struct XdgStringIndex XdgStringIndex;
+
+#ifdef XDG_PREFIX
+#define _xdg_string_pool_new                  XDG_RESERVED_ENTRY(string_pool_new)
+#define _xdg_string_pool_free                 XDG_RESERVED_ENTRY(string_pool_free)
+#define _xdg_string_pool_intern               XDG_RESERVED_ENTRY(string_pool_intern)
+#define _xdg_string_pool_intern_len           XDG_RESERVED_ENTRY(string_pool_intern_len)
+#define _xdg_string_pool_lookup               XDG_RESERVED_ENTRY(string_pool_lookup)
+#define _xdg_string_index_new                 XDG_RESERVED_ENTRY(string_index_new)
+#define _xdg_string_index_free                XDG_RESERVED_ENTRY(string_index_free)
+#define _xdg_string_index_insert              XDG_RESERVED_ENTRY(string_index_insert)
+#define _xdg_string_index_lookup              XDG_RESERVED_ENTRY(string_index_lookup)
+#endif
+
+/* Interned strings are unique within a pool, so tables keyed by them
+ * can hash and compare the pointers instead of the contents. */
+#define XDG_POINTER_HASH(p) ((unsigned int)(((uintptr_t)(p) >> 3) * 2654435761U))
+
+XdgStringPool *_xdg_string_pool_new        (void);
+void           _xdg_string_pool_free       (XdgStringPool *pool);
+const char    *_xdg_string_pool_intern     (XdgStringPool *pool,
+					    const char    *str);
+const char    *_xdg_string_pool_intern_len (XdgStringPool *pool,
+					    const char    *str,
+					    int            len);
+const char    *_xdg_string_pool_lookup     (XdgStringPool *pool,
+					    const char    *str);
+
+/* Open addressing table from interned strings to integers */
+XdgStringIndex *_xdg_string_index_new      (int             n_keys);
+void            _xdg_string_index_free     (XdgStringIndex *index);
+int             _xdg_string_index_insert   (XdgStringIndex *index,
+					    const char     *key,
+					    int             value);
+int             _xdg_string_index_lookup   (XdgStringIndex *index,
+					    const char     *key);
+
+#endif /* __XDG_MIME_STRING_POOL_H__ */
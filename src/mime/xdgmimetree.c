@@ -0,0 +1,485 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimetree.c: Private file.  Datastructure for storing the treemagic rules.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <xdg/config.h>
+
+#include "xdgmimetree.h"
+#include "xdgmimeint.h"
+#include "xdgmimestrpool.h"
+#include "xdgmime_p.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+typedef struct XdgTreeMatch XdgTreeMatch;
+typedef struct XdgTreeMatchlet XdgTreeMatchlet;
+
+typedef enum
+{
+  XDG_TREE_TYPE_ANY,
+  XDG_TREE_TYPE_FILE,
+  XDG_TREE_TYPE_DIRECTORY,
+  XDG_TREE_TYPE_LINK
+} XdgTreeType;
+
+enum
+{
+  XDG_TREE_MATCH_CASE = 1 << 0,
+  XDG_TREE_EXECUTABLE = 1 << 1,
+  XDG_TREE_NON_EMPTY  = 1 << 2,
+  XDG_TREE_ON_DISC    = 1 << 3
+};
+
+/* Matchlets of a match are stored depth first in matchlets[first..end),
+ * next is the index of the following sibling (or end), so the children
+ * of a matchlet are matchlets[i + 1..next). */
+struct XdgTreeMatchlet
+{
+  const char *path;
+  const char *mime_type;
+  XdgTreeType type;
+  int flags;
+  int depth;
+  int next;
+};
+
+struct XdgTreeMatch
+{
+  int priority;
+  const char *mime_type;
+  int first;
+  int end;
+  int seq;
+};
+
+struct XdgTreeMagic
+{
+  XdgTreeMatch *matches;
+  int n_matches;
+  int n_matches_allocated;
+
+  XdgTreeMatchlet *matchlets;
+  int n_matchlets;
+  int n_matchlets_allocated;
+
+  XdgStringPool *strings;
+};
+
+XdgTreeMagic *
+_xdg_mime_tree_magic_new (void)
+{
+  XdgTreeMagic *tree_magic;
+
+  tree_magic = calloc (1, sizeof (XdgTreeMagic));
+  tree_magic->strings = _xdg_string_pool_new ();
+
+  return tree_magic;
+}
+
+void
+_xdg_mime_tree_magic_free (XdgTreeMagic *tree_magic)
+{
+  _xdg_string_pool_free (tree_magic->strings);
+  free (tree_magic->matches);
+  free (tree_magic->matchlets);
+  free (tree_magic);
+}
+
+static void
+tree_magic_finish_match (XdgTreeMagic *tree_magic,
+			 XdgTreeMatch *match)
+{
+  int i, j;
+
+  match->end = tree_magic->n_matchlets;
+
+  for (i = match->first; i < match->end; i++)
+    {
+      for (j = i + 1; j < match->end; j++)
+	if (tree_magic->matchlets[j].depth <= tree_magic->matchlets[i].depth)
+	  break;
+
+      tree_magic->matchlets[i].next = j;
+    }
+}
+
+/* Parses '[indent]>"path"=type[,option]...' */
+static int
+tree_magic_parse_matchlet (XdgTreeMagic *tree_magic,
+			   char         *line)
+{
+  XdgTreeMatchlet *matchlet;
+  char *p, *path, *option;
+  int depth = 0;
+
+  for (p = line; *p >= '0' && *p <= '9'; p++)
+    depth = depth * 10 + (*p - '0');
+
+  if (*p++ != '>' || *p++ != '"')
+    return FALSE;
+
+  path = p;
+  if ((p = strchr (p, '"')) == NULL)
+    return FALSE;
+  *p++ = '\000';
+
+  if (*p++ != '=')
+    return FALSE;
+
+  if (tree_magic->n_matchlets == tree_magic->n_matchlets_allocated)
+    {
+      tree_magic->n_matchlets_allocated = tree_magic->n_matchlets_allocated ? tree_magic->n_matchlets_allocated * 2 : 64;
+      tree_magic->matchlets = realloc (tree_magic->matchlets, tree_magic->n_matchlets_allocated * sizeof (XdgTreeMatchlet));
+    }
+
+  matchlet = &tree_magic->matchlets[tree_magic->n_matchlets];
+  matchlet->path = _xdg_string_pool_intern (tree_magic->strings, path);
+  matchlet->mime_type = NULL;
+  matchlet->type = XDG_TREE_TYPE_ANY;
+  matchlet->flags = 0;
+  matchlet->depth = depth;
+
+  p[strcspn (p, "\r\n")] = '\000';
+
+  for (option = strtok (p, ","); option; option = strtok (NULL, ","))
+    {
+      if (strcmp (option, "file") == 0)
+	matchlet->type = XDG_TREE_TYPE_FILE;
+      else if (strcmp (option, "directory") == 0)
+	matchlet->type = XDG_TREE_TYPE_DIRECTORY;
+      else if (strcmp (option, "link") == 0)
+	matchlet->type = XDG_TREE_TYPE_LINK;
+      else if (strcmp (option, "any") == 0)
+	matchlet->type = XDG_TREE_TYPE_ANY;
+      else if (strcmp (option, "match-case") == 0)
+	matchlet->flags |= XDG_TREE_MATCH_CASE;
+      else if (strcmp (option, "executable") == 0)
+	matchlet->flags |= XDG_TREE_EXECUTABLE;
+      else if (strcmp (option, "non-empty") == 0)
+	matchlet->flags |= XDG_TREE_NON_EMPTY;
+      else if (strcmp (option, "on-disc") == 0)
+	matchlet->flags |= XDG_TREE_ON_DISC;
+      else if (strchr (option, '/'))
+	matchlet->mime_type = _xdg_string_pool_intern (tree_magic->strings, option);
+    }
+
+  tree_magic->n_matchlets++;
+  return TRUE;
+}
+
+void
+_xdg_mime_tree_magic_read_from_file (XdgTreeMagic *tree_magic,
+				     const char   *file_name)
+{
+  XdgTreeMatch *match = NULL;
+  FILE *file;
+  char line[1024];
+  char *p;
+
+  file = fopen (file_name, "r");
+
+  if (file == NULL)
+    return;
+
+  if (fread (line, 1, 16, file) != 16 || memcmp (line, "MIME-TreeMagic\000\n", 16) != 0)
+    {
+      fclose (file);
+      return;
+    }
+
+  while (fgets (line, sizeof (line), file) != NULL)
+    {
+      if (line[0] == '[')
+	{
+	  if (match)
+	    tree_magic_finish_match (tree_magic, match);
+	  match = NULL;
+
+	  p = strchr (line, ':');
+	  if (p == NULL)
+	    continue;
+	  *p++ = '\000';
+	  p[strcspn (p, "]\r\n")] = '\000';
+
+	  if (tree_magic->n_matches == tree_magic->n_matches_allocated)
+	    {
+	      tree_magic->n_matches_allocated = tree_magic->n_matches_allocated ? tree_magic->n_matches_allocated * 2 : 32;
+	      tree_magic->matches = realloc (tree_magic->matches, tree_magic->n_matches_allocated * sizeof (XdgTreeMatch));
+	    }
+
+	  match = &tree_magic->matches[tree_magic->n_matches];
+	  match->priority = atoi (line + 1);
+	  match->mime_type = _xdg_string_pool_intern (tree_magic->strings, p);
+	  match->first = tree_magic->n_matchlets;
+	  match->end = match->first;
+	  match->seq = tree_magic->n_matches++;
+	}
+      else if (match)
+	{
+	  tree_magic_parse_matchlet (tree_magic, line);
+	}
+    }
+
+  if (match)
+    tree_magic_finish_match (tree_magic, match);
+
+  fclose (file);
+}
+
+static int
+compare_matches (const void *a, const void *b)
+{
+  const XdgTreeMatch *aa = (const XdgTreeMatch *)a;
+  const XdgTreeMatch *bb = (const XdgTreeMatch *)b;
+
+  if (aa->priority != bb->priority)
+    return bb->priority - aa->priority;
+
+  return aa->seq - bb->seq;
+}
+
+/* Orders the matches by priority, must be called once all files have been read */
+void
+_xdg_mime_tree_magic_compile (XdgTreeMagic *tree_magic)
+{
+  qsort (tree_magic->matches, tree_magic->n_matches, sizeof (XdgTreeMatch), compare_matches);
+}
+
+/* Finds path below dirfd ignoring the case of every component that does
+ * not exist as spelled, and stores the actual relative path in resolved.
+ * Only the directories named by path are listed. */
+static int
+tree_resolve_path (int         dirfd,
+		   const char *path,
+		   char       *resolved,
+		   size_t      size)
+{
+  struct stat st;
+  struct dirent *entry;
+  const char *component;
+  size_t len = 0, component_len;
+  DIR *dir;
+  int fd;
+
+  for (component = path; *component; component += component_len)
+    {
+      while (*component == '/')
+	component++;
+
+      component_len = strcspn (component, "/");
+      if (component_len == 0)
+	break;
+
+      if (len + component_len + 2 > size)
+	return FALSE;
+
+      if (len)
+	resolved[len++] = '/';
+      memcpy (resolved + len, component, component_len);
+      resolved[len + component_len] = '\000';
+
+      if (fstatat (dirfd, resolved, &st, AT_SYMLINK_NOFOLLOW) != 0)
+	{
+	  resolved[len] = '\000';
+	  fd = openat (dirfd, len ? resolved : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	  if (fd < 0 || (dir = fdopendir (fd)) == NULL)
+	    {
+	      if (fd >= 0)
+		close (fd);
+	      return FALSE;
+	    }
+
+	  while ((entry = readdir (dir)) != NULL)
+	    if (strlen (entry->d_name) == component_len &&
+		strncasecmp (entry->d_name, component, component_len) == 0)
+	      break;
+
+	  if (entry)
+	    memcpy (resolved + len, entry->d_name, component_len);
+	  closedir (dir);
+
+	  if (entry == NULL)
+	    return FALSE;
+	}
+
+      len += component_len;
+    }
+
+  resolved[len] = '\000';
+  return len > 0;
+}
+
+static int
+tree_directory_is_empty (int         dirfd,
+			 const char *path)
+{
+  struct dirent *entry;
+  DIR *dir;
+  int fd;
+
+  fd = openat (dirfd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0 || (dir = fdopendir (fd)) == NULL)
+    {
+      if (fd >= 0)
+	close (fd);
+      return TRUE;
+    }
+
+  while ((entry = readdir (dir)) != NULL)
+    if (strcmp (entry->d_name, ".") != 0 && strcmp (entry->d_name, "..") != 0)
+      break;
+
+  closedir (dir);
+  return entry == NULL;
+}
+
+static int tree_matchlets_compare (XdgTreeMagic *tree_magic,
+				   int           dirfd,
+				   const char   *root,
+				   int           first,
+				   int           end);
+
+static int
+tree_matchlet_compare (XdgTreeMagic *tree_magic,
+		       int           dirfd,
+		       const char   *root,
+		       int           index)
+{
+  XdgTreeMatchlet *matchlet = &tree_magic->matchlets[index];
+  char resolved[PATH_MAX];
+  struct stat st;
+
+  if (matchlet->flags & XDG_TREE_MATCH_CASE)
+    {
+      if (strlen (matchlet->path) >= sizeof (resolved))
+	return FALSE;
+      strcpy (resolved, matchlet->path);
+    }
+  else if (!tree_resolve_path (dirfd, matchlet->path, resolved, sizeof (resolved)))
+    return FALSE;
+
+  if (matchlet->type == XDG_TREE_TYPE_LINK)
+    {
+      if (fstatat (dirfd, resolved, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISLNK (st.st_mode))
+	return FALSE;
+    }
+  else
+    {
+      if (fstatat (dirfd, resolved, &st, 0) != 0)
+	return FALSE;
+
+      if ((matchlet->type == XDG_TREE_TYPE_FILE && !S_ISREG (st.st_mode)) ||
+	  (matchlet->type == XDG_TREE_TYPE_DIRECTORY && !S_ISDIR (st.st_mode)))
+	return FALSE;
+    }
+
+  if ((matchlet->flags & XDG_TREE_EXECUTABLE) &&
+      faccessat (dirfd, resolved, X_OK, 0) != 0)
+    return FALSE;
+
+  if (matchlet->flags & XDG_TREE_NON_EMPTY)
+    {
+      if (S_ISDIR (st.st_mode) ? tree_directory_is_empty (dirfd, resolved) : st.st_size == 0)
+	return FALSE;
+    }
+
+  if (matchlet->mime_type)
+    {
+      char file_name[PATH_MAX];
+
+      if (snprintf (file_name, sizeof (file_name), "%s/%s", root, resolved) >= sizeof (file_name) ||
+	  !_xdg_mime_mime_type_subclass (xdg_mime_get_mime_type_for_file (file_name, &st),
+					 matchlet->mime_type))
+	return FALSE;
+    }
+
+  /* "on-disc" would need to know the kind of the underlying device and
+   * is not checked. */
+
+  if (index + 1 < matchlet->next)
+    return tree_matchlets_compare (tree_magic, dirfd, root, index + 1, matchlet->next);
+
+  return TRUE;
+}
+
+static int
+tree_matchlets_compare (XdgTreeMagic *tree_magic,
+			int           dirfd,
+			const char   *root,
+			int           first,
+			int           end)
+{
+  int i;
+
+  for (i = first; i < end; i = tree_magic->matchlets[i].next)
+    if (tree_matchlet_compare (tree_magic, dirfd, root, i))
+      return TRUE;
+
+  return FALSE;
+}
+
+/* Returns the x-content type of the directory tree at root, NULL if no
+ * rule matches.  Matches are tried in order of priority and the first
+ * one that matches wins. */
+const char *
+_xdg_mime_tree_magic_lookup (XdgTreeMagic *tree_magic,
+			     const char   *root)
+{
+  const char *mime_type = NULL;
+  XdgTreeMatch *match;
+  int dirfd, i;
+
+  if (tree_magic->n_matches == 0)
+    return NULL;
+
+  dirfd = open (root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirfd < 0)
+    return NULL;
+
+  for (i = 0; i < tree_magic->n_matches; i++)
+    {
+      match = &tree_magic->matches[i];
+
+      if (tree_matchlets_compare (tree_magic, dirfd, root, match->first, match->end))
+	{
+	  mime_type = match->mime_type;
+	  break;
+	}
+    }
+
+  close (dirfd);
+  return mime_type;
+}
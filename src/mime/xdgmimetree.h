@@ -0,0 +1,50 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimetree.h: Private file.  Datastructure for storing the treemagic rules.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __XDG_MIME_TREE_H__
+#define __XDG_MIME_TREE_H__
+
+#include "xdgmime.h"
+
+typedef struct XdgTreeMagic XdgTreeMagic;
+
+#ifdef XDG_PREFIX
+#define _xdg_mime_tree_magic_read_from_file   XDG_RESERVED_ENTRY(tree_magic_read_from_file)
+#define _xdg_mime_tree_magic_new              XDG_RESERVED_ENTRY(tree_magic_new)
+#define _xdg_mime_tree_magic_free             XDG_RESERVED_ENTRY(tree_magic_free)
+#define _xdg_mime_tree_magic_compile          XDG_RESERVED_ENTRY(tree_magic_compile)
+#define _xdg_mime_tree_magic_lookup           XDG_RESERVED_ENTRY(tree_magic_lookup)
+#endif
+
+void          _xdg_mime_tree_magic_read_from_file (XdgTreeMagic *tree_magic,
+						   const char   *file_name);
+XdgTreeMagic *_xdg_mime_tree_magic_new            (void);
+void          _xdg_mime_tree_magic_free           (XdgTreeMagic *tree_magic);
+void          _xdg_mime_tree_magic_compile        (XdgTreeMagic *tree_magic);
+const char   *_xdg_mime_tree_magic_lookup         (XdgTreeMagic *tree_magic,
+						   const char   *root);
+
+#endif /* __XDG_MIME_TREE_H__ */
@@ -0,0 +1,444 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimexml.c: Private file.  Root element sniffing of XML documents.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <xdg/config.h>
+
+#include "xdgmimexml.h"
+#include "xdgmimeint.h"
+#include "xdgmimestrpool.h"
+#include "xdgmime_p.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Priority reported when the root element decides the type */
+#define XML_ROOT_PRIORITY 80
+
+typedef struct XdgXmlNamespace XdgXmlNamespace;
+
+struct XdgXmlNamespace
+{
+  const char *namespace_uri;
+  const char *local_name;
+  const char *mime_type;
+  xdg_uint32_t hash;
+};
+
+struct XdgXmlNamespaceList
+{
+  XdgXmlNamespace *entries;
+  int n_entries;
+  int n_allocated;
+
+  /* Open addressing table of entry index + 1, 0 marks an empty slot */
+  int *table;
+  xdg_uint32_t mask;
+
+  XdgStringPool *strings;
+};
+
+#define IS_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+
+static xdg_uint32_t
+xml_hash (const char *namespace_uri,
+	  int         namespace_len,
+	  const char *local_name,
+	  int         local_len)
+{
+  xdg_uint32_t hash = 2166136261U;
+  int i;
+
+  for (i = 0; i < namespace_len; i++)
+    hash = (hash ^ (unsigned char) namespace_uri[i]) * 16777619U;
+
+  hash *= 16777619U;
+
+  for (i = 0; i < local_len; i++)
+    hash = (hash ^ (unsigned char) local_name[i]) * 16777619U;
+
+  return hash;
+}
+
+XdgXmlNamespaceList *
+_xdg_mime_xml_namespace_list_new (void)
+{
+  XdgXmlNamespaceList *list;
+
+  list = calloc (1, sizeof (XdgXmlNamespaceList));
+  list->strings = _xdg_string_pool_new ();
+
+  return list;
+}
+
+void
+_xdg_mime_xml_namespace_list_free (XdgXmlNamespaceList *list)
+{
+  _xdg_string_pool_free (list->strings);
+  free (list->entries);
+  free (list->table);
+  free (list);
+}
+
+void
+_xdg_mime_xml_namespace_list_add (const char          *namespace_uri,
+				  const char          *local_name,
+				  const char          *mime_type,
+				  XdgXmlNamespaceList *list)
+{
+  XdgXmlNamespace *entry;
+
+  if (list->n_entries == list->n_allocated)
+    {
+      list->n_allocated = list->n_allocated ? list->n_allocated * 2 : 64;
+      list->entries = realloc (list->entries, list->n_allocated * sizeof (XdgXmlNamespace));
+    }
+
+  entry = &list->entries[list->n_entries++];
+  entry->namespace_uri = _xdg_string_pool_intern (list->strings, namespace_uri);
+  entry->local_name = _xdg_string_pool_intern (list->strings, local_name);
+  entry->mime_type = _xdg_string_pool_intern (list->strings, mime_type);
+  entry->hash = xml_hash (namespace_uri, strlen (namespace_uri), local_name, strlen (local_name));
+}
+
+/* Must be called once all rules have been added.  When a rule is defined
+ * more than once the first definition wins. */
+void
+_xdg_mime_xml_namespace_list_build_index (XdgXmlNamespaceList *list)
+{
+  XdgXmlNamespace *entry, *other;
+  xdg_uint32_t size, slot;
+  int i;
+
+  free (list->table);
+
+  for (size = 16; size < list->n_entries * 2; size <<= 1) ;
+
+  list->mask = size - 1;
+  list->table = calloc (size, sizeof (int));
+
+  for (i = 0; i < list->n_entries; i++)
+    {
+      entry = &list->entries[i];
+
+      for (slot = entry->hash & list->mask; list->table[slot]; slot = (slot + 1) & list->mask)
+	{
+	  other = &list->entries[list->table[slot] - 1];
+	  if (other->namespace_uri == entry->namespace_uri && other->local_name == entry->local_name)
+	    break;
+	}
+
+      if (list->table[slot] == 0)
+	list->table[slot] = i + 1;
+    }
+}
+
+void
+_xdg_mime_xml_namespace_read_from_file (XdgXmlNamespaceList *list,
+					const char          *file_name)
+{
+  FILE *file;
+  char line[255];
+  char *local_name, *mime_type;
+
+  file = fopen (file_name, "r");
+
+  if (file == NULL)
+    return;
+
+  /* FIXME: Not UTF-8 safe.  Doesn't work if lines are greater than 255 chars.
+   * Blah */
+  while (fgets (line, 255, file) != NULL)
+    {
+      if (line[0] == '#')
+	continue;
+
+      local_name = strchr (line, ' ');
+      if (local_name == NULL)
+	continue;
+      *(local_name++) = '\000';
+
+      mime_type = strchr (local_name, ' ');
+      if (mime_type == NULL)
+	continue;
+      *(mime_type++) = '\000';
+      mime_type[strcspn (mime_type, "\r\n")] = '\000';
+
+      _xdg_mime_xml_namespace_list_add (line, local_name, mime_type, list);
+    }
+
+  fclose (file);
+}
+
+void
+_xdg_mime_xml_namespace_list_serialize (XdgXmlNamespaceList *list,
+					XdgMimeCacheWriter  *writer)
+{
+  XdgXmlNamespace *entry, *other;
+  int i, j;
+
+  for (i = 0; i < list->n_entries; i++)
+    {
+      entry = &list->entries[i];
+
+      /* The strings are interned, so the first definition is found by
+       * comparing the pointers */
+      for (j = 0; j < i; j++)
+	{
+	  other = &list->entries[j];
+	  if (other->namespace_uri == entry->namespace_uri &&
+	      other->local_name == entry->local_name)
+	    break;
+	}
+
+      if (j == i)
+	_xdg_mime_cache_writer_add_namespace (writer,
+					      entry->namespace_uri,
+					      entry->local_name,
+					      entry->mime_type);
+    }
+}
+
+/* Skips to just past the first occurrence of str, or to end */
+static const char *
+xml_skip_past (const char *p,
+	       const char *end,
+	       const char *str)
+{
+  int len = strlen (str);
+
+  for (; p + len <= end; p++)
+    if (memcmp (p, str, len) == 0)
+      return p + len;
+
+  return end;
+}
+
+/* Scans the prolog of an XML document up to the start tag of the root
+ * element and returns its namespace and local name as spans of data.
+ * Nothing is allocated and nothing beyond data + len is read.  Returns
+ * FALSE if data does not look like XML or the start tag is truncated. */
+static int
+xml_find_root_element (const char  *data,
+		       size_t       len,
+		       const char **namespace_uri,
+		       int         *namespace_len,
+		       const char **local_name,
+		       int         *local_len)
+{
+  const char *p = data, *end = data + len;
+  const char *name, *prefix = NULL, *attr, *value;
+  int prefix_len = 0, attr_len, depth;
+  char quote;
+
+  /* UTF-8 byte order mark */
+  if (len >= 3 && memcmp (p, "\xef\xbb\xbf", 3) == 0)
+    p += 3;
+
+  for (;;)
+    {
+      while (p < end && IS_SPACE (*p))
+	p++;
+
+      if (p + 1 >= end || *p != '<')
+	return FALSE;
+
+      if (p[1] == '?')
+	p = xml_skip_past (p + 2, end, "?>");
+      else if (end - p >= 4 && memcmp (p, "<!--", 4) == 0)
+	p = xml_skip_past (p + 4, end, "-->");
+      else if (p[1] == '!')
+	{
+	  /* <!DOCTYPE ...> with an optional [internal subset] */
+	  for (p += 2, depth = 0, quote = 0; p < end; p++)
+	    {
+	      if (quote)
+		{
+		  if (*p == quote)
+		    quote = 0;
+		}
+	      else if (*p == '"' || *p == '\'')
+		quote = *p;
+	      else if (*p == '[')
+		depth++;
+	      else if (*p == ']')
+		depth--;
+	      else if (*p == '>' && depth <= 0)
+		break;
+	    }
+	  p++;
+	}
+      else
+	break;
+
+      if (p >= end)
+	return FALSE;
+    }
+
+  /* The root element: <prefix:name attr="value" ...> */
+  name = ++p;
+  while (p < end && !IS_SPACE (*p) && *p != '>' && *p != '/')
+    {
+      if (*p == ':' && prefix == NULL)
+	{
+	  prefix = name;
+	  prefix_len = p - name;
+	  name = p + 1;
+	}
+      p++;
+    }
+
+  if (p >= end || p == name)
+    return FALSE;
+
+  *local_name = name;
+  *local_len = p - name;
+  *namespace_uri = NULL;
+  *namespace_len = 0;
+
+  for (;;)
+    {
+      while (p < end && IS_SPACE (*p))
+	p++;
+
+      if (p >= end)
+	return FALSE;
+
+      if (*p == '>' || *p == '/')
+	return TRUE;
+
+      attr = p;
+      while (p < end && !IS_SPACE (*p) && *p != '=' && *p != '>')
+	p++;
+      attr_len = p - attr;
+
+      while (p < end && IS_SPACE (*p))
+	p++;
+      if (p >= end || *p != '=')
+	return FALSE;
+      p++;
+      while (p < end && IS_SPACE (*p))
+	p++;
+      if (p >= end || (*p != '"' && *p != '\''))
+	return FALSE;
+
+      quote = *p++;
+      value = p;
+      while (p < end && *p != quote)
+	p++;
+      if (p >= end)
+	return FALSE;
+
+      if (prefix == NULL)
+	{
+	  if (attr_len == 5 && memcmp (attr, "xmlns", 5) == 0)
+	    {
+	      *namespace_uri = value;
+	      *namespace_len = p - value;
+	    }
+	}
+      else if (attr_len == 6 + prefix_len &&
+	       memcmp (attr, "xmlns:", 6) == 0 &&
+	       memcmp (attr + 6, prefix, prefix_len) == 0)
+	{
+	  *namespace_uri = value;
+	  *namespace_len = p - value;
+	}
+
+      p++;
+    }
+}
+
+/* Returns the mime type registered for the root element of the XML
+ * document in data, NULL if there is none. */
+const char *
+_xdg_mime_xml_namespace_list_lookup_data (XdgXmlNamespaceList *list,
+					  const void          *data,
+					  size_t               len)
+{
+  const char *namespace_uri, *local_name;
+  int namespace_len, local_len;
+  XdgXmlNamespace *entry;
+  xdg_uint32_t hash, slot;
+
+  if (list->table == NULL || list->n_entries == 0)
+    return NULL;
+
+  if (!xml_find_root_element (data, len,
+			      &namespace_uri, &namespace_len,
+			      &local_name, &local_len) ||
+      namespace_uri == NULL)
+    return NULL;
+
+  hash = xml_hash (namespace_uri, namespace_len, local_name, local_len);
+
+  for (slot = hash & list->mask; list->table[slot]; slot = (slot + 1) & list->mask)
+    {
+      entry = &list->entries[list->table[slot] - 1];
+
+      if (entry->hash == hash &&
+	  strncmp (entry->namespace_uri, namespace_uri, namespace_len) == 0 &&
+	  entry->namespace_uri[namespace_len] == '\000' &&
+	  strncmp (entry->local_name, local_name, local_len) == 0 &&
+	  entry->local_name[local_len] == '\000')
+	return entry->mime_type;
+    }
+
+  return NULL;
+}
+
+/* Replaces mime_type, the result of magic sniffing, with the type of the
+ * root element if the data is XML and mime_type is either unknown or a
+ * generic XML type. */
+const char *
+_xdg_mime_xml_namespace_refine (const void *data,
+				size_t      len,
+				const char *mime_type,
+				int        *result_prio)
+{
+  const char *xml_type;
+  const char *unaliased;
+
+  if (_xml_namespaces == NULL)
+    return mime_type;
+
+  /* Subtypes of XML found by magic are kept */
+  if (mime_type)
+    {
+      unaliased = _xdg_mime_unalias_mime_type (mime_type);
+      if (strcmp (unaliased, "application/xml") != 0 &&
+	  strcmp (unaliased, "text/xml") != 0)
+	return mime_type;
+    }
+
+  xml_type = _xdg_mime_xml_namespace_list_lookup_data (_xml_namespaces, data, len);
+  if (xml_type == NULL)
+    return mime_type;
+
+  if (result_prio && *result_prio < XML_ROOT_PRIORITY)
+    *result_prio = XML_ROOT_PRIORITY;
+
+  return xml_type;
+}
@@ -0,0 +1,74 @@
+/* -*- mode: C; c-file-style: "gnu" -*- */
+/* xdgmimexml.h: Private file.  Root element sniffing of XML documents.
+ *
+ * More info can be found at http://www.freedesktop.org/standards/
+ *
+ * Copyright (C) 2012  Dmitriy Vilkov <dav.daemon@gmail.com>
+ *
+ * Licensed under the Academic Free License version 2.0
+ * Or under the following terms:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __XDG_MIME_XML_H__
+#define __XDG_MIME_XML_H__
+
+#include "xdgmime.h"
+#include "xdgmimecachewriter.h"
+
+typedef struct XdgXmlNamespaceList XdgXmlNamespaceList;
+
+#ifdef XDG_PREFIX
+#define _xdg_mime_xml_namespace_read_from_file   XDG_RESERVED_ENTRY(xml_namespace_read_from_file)
+#define _xdg_mime_xml_namespace_list_new         XDG_RESERVED_ENTRY(xml_namespace_list_new)
+#define _xdg_mime_xml_namespace_list_free        XDG_RESERVED_ENTRY(xml_namespace_list_free)
+#define _xdg_mime_xml_namespace_list_add         XDG_RESERVED_ENTRY(xml_namespace_list_add)
+#define _xdg_mime_xml_namespace_list_build_index XDG_RESERVED_ENTRY(xml_namespace_list_build_index)
+#define _xdg_mime_xml_namespace_list_lookup_data XDG_RESERVED_ENTRY(xml_namespace_list_lookup_data)
+#define _xdg_mime_xml_namespace_refine           XDG_RESERVED_ENTRY(xml_namespace_refine)
+#define _xdg_mime_xml_namespace_list_serialize   XDG_RESERVED_ENTRY(xml_namespace_list_serialize)
+#endif
+
+/* Called once for every (namespace, local name) -> mime type rule */
+typedef void (*XdgXmlNamespaceForeachFunc) (const char *namespace_uri,
+					    const char *local_name,
+					    const char *mime_type,
+					    void       *user_data);
+
+extern XdgXmlNamespaceList *_xml_namespaces;
+
+void                 _xdg_mime_xml_namespace_read_from_file   (XdgXmlNamespaceList *list,
+							       const char          *file_name);
+XdgXmlNamespaceList *_xdg_mime_xml_namespace_list_new         (void);
+void                 _xdg_mime_xml_namespace_list_free        (XdgXmlNamespaceList *list);
+void                 _xdg_mime_xml_namespace_list_add         (const char          *namespace_uri,
+							       const char          *local_name,
+							       const char          *mime_type,
+							       XdgXmlNamespaceList *list);
+void                 _xdg_mime_xml_namespace_list_build_index (XdgXmlNamespaceList *list);
+/* Adds the rules in effect to writer */
+void                 _xdg_mime_xml_namespace_list_serialize   (XdgXmlNamespaceList *list,
+							       XdgMimeCacheWriter  *writer);
+const char          *_xdg_mime_xml_namespace_list_lookup_data (XdgXmlNamespaceList *list,
+							       const void          *data,
+							       size_t               len);
+const char          *_xdg_mime_xml_namespace_refine           (const void          *data,
+							       size_t               len,
+							       const char          *mime_type,
+							       int                 *result_prio);
+
+#endif /* __XDG_MIME_XML_H__ */
@@ -24,6 +24,8 @@
 #include "xdgmimeglob.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 
 static void
@@ -150,6 +152,55 @@ test_matches (void)
   test_one_match ("file.lzo", "application/x-lzop");
 }
 
+static void
+test_candidates (void)
+{
+  char directory[] = "/tmp/test-mime-XXXXXX";
+  char file_name[sizeof (directory) + 6];
+  const char *expected[10];
+  const char *const *actual;
+  XdgMimeLookupCtx *ctx;
+  FILE *file;
+  int n_expected, n_actual, i;
+
+  if (mkdtemp (directory) == NULL)
+    return;
+
+  /* Several types share the suffix, the contents match none of them,
+   * so the magic stage rules them out. */
+  sprintf (file_name, "%s/x.mod", directory);
+  if ((file = fopen (file_name, "w")) != NULL)
+    {
+      fputs ("no magic here\n", file);
+      fclose (file);
+
+      ctx = xdg_mime_lookup_ctx_new ();
+      n_expected = xdg_mime_get_mime_types_from_file_name_ctx (ctx, "x.mod", expected, 10);
+      xdg_mime_get_mime_type_for_file_ctx (ctx, file_name, NULL, NULL);
+      actual = xdg_mime_lookup_ctx_get_candidates (ctx, &n_actual);
+
+      if (n_actual != n_expected)
+	{
+	  printf ("Test Failed: %d candidates for %s, expected %d\n",
+		  n_actual, file_name, n_expected);
+	  exit (1);
+	}
+
+      for (i = 0; i < n_actual && i < 10; i++)
+	if (actual[i] == NULL || strcmp (actual[i], expected[i]) != 0)
+	  {
+	    printf ("Test Failed: candidate %d of %s is %s, expected %s\n",
+		    i, file_name, actual[i] ? actual[i] : "NULL", expected[i]);
+	    exit (1);
+	  }
+
+      xdg_mime_lookup_ctx_free (ctx);
+      unlink (file_name);
+    }
+
+  rmdir (directory);
+}
+
 static void
 test_one_icon (const char *mimetype, const char *expected)
 {
@@ -184,6 +235,7 @@ main (int argc, char *argv[])
   test_aliasing ();
   test_subclassing ();
   test_matches ();
+  test_candidates ();
   test_icons ();
 
   for (i = 1; i < argc; i++)
@@ -28,6 +28,9 @@
 #include "../containers/avltree_p.h"
 #include "../containers/xdglist_p.h"
 #include "../basedirectory/xdgbasedirectory.h"
+#ifdef MIME_SPEC
+#	include "../mime/xdgmime.h"
+#endif
 #include <stdlib.h>
 #include <dirent.h>
 #include <stdio.h>
@@ -104,14 +107,31 @@ struct XdgIconSearchFuncArgs
 typedef struct XdgIconSearchFuncArgs XdgIconSearchFuncArgs;
 
 
+/**
+ * Resolved icon paths of a MIME type, one per theme and size
+ */
+struct XdgIconPathItem
+{
+	XdgListItem list;
+	XdgTheme *theme;
+	int size;
+	char *path;
+};
+typedef struct XdgIconPathItem XdgIconPathItem;
+
+
 struct XdgThemes
 {
 	AvlTree themes_files_map;
+	AvlTree icon_paths;
 };
 
 
 typedef struct XdgThemes XdgThemes;
 static XdgThemes *themes_list = NULL;
+#ifdef MIME_SPEC
+static int mime_callback_id = 0;
+#endif
 
 
 /**
@@ -206,6 +226,28 @@ static void _xdg_theme_map_item_free(XdgTheme *item)
 	free(item);
 }
 
+static XdgList *_xdg_icon_path_map_item_add(AvlTree *map, const char *mime)
+{
+	XdgList **res = (XdgList **)search_or_create_node(map, mime);
+
+	if ((*res) == NULL)
+		(*res) = calloc(1, sizeof(XdgList));
+
+	return (*res);
+}
+
+static void _xdg_icon_path_item_free(XdgIconPathItem *item)
+{
+	free(item->path);
+	free(item);
+}
+
+static void _xdg_icon_path_map_item_free(XdgList *item)
+{
+	_xdg_list_clear(item, (XdgListItemFree)_xdg_icon_path_item_free);
+	free(item);
+}
+
 
 /**
  * Main algorithms
@@ -360,26 +402,49 @@ static XdgThemes *_xdg_mime_themes_new(void)
 
 	res = malloc(sizeof(XdgThemes));
 	init_avl_tree(&res->themes_files_map, strdup, (DestroyKey)free, strcmp);
+	init_avl_tree(&res->icon_paths, strdup, (DestroyKey)free, strcmp);
 
 	return res;
 }
 
 static void _xdg_mime_themes_free(XdgThemes *themes)
 {
+	clear_avl_tree_and_values(&themes->icon_paths, (DestroyValue)_xdg_icon_path_map_item_free);
 	clear_avl_tree_and_values(&themes->themes_files_map, (DestroyValue)_xdg_theme_map_item_free);
 	free(themes);
 }
 
+#ifdef MIME_SPEC
+/* Icon names of MIME types may change with the MIME data */
+static void _xdg_mime_themes_clear_icon_paths(void *user_data)
+{
+	if (themes_list)
+		clear_avl_tree_and_values(&themes_list->icon_paths, (DestroyValue)_xdg_icon_path_map_item_free);
+}
+#endif
+
 void _xdg_themes_init()
 {
 	char buffer[READ_FROM_FILE_BUFFER_SIZE];
 
 	themes_list = _xdg_mime_themes_new();
 	_xdg_for_each_theme_dir((XdgDirectoryFunc)_xdg_mime_themes_read_from_directory, buffer);
+
+#ifdef MIME_SPEC
+	mime_callback_id = xdg_mime_register_reload_callback(_xdg_mime_themes_clear_icon_paths, NULL, NULL);
+#endif
 }
 
 void _xdg_themes_shutdown()
 {
+#ifdef MIME_SPEC
+	if (mime_callback_id)
+	{
+		xdg_mime_remove_callback(mime_callback_id);
+		mime_callback_id = 0;
+	}
+#endif
+
 	if (themes_list)
 	{
 		_xdg_mime_themes_free(themes_list);
@@ -720,3 +785,76 @@ char *xdg_icon_lookup(const char *icon, int size, Context context, const char *t
 
 	return NULL;
 }
+
+/**
+ * Resolves the icon of a MIME type in the order given by the "Shared MIME-info
+ * Database" specification: the icon of the MIME data, "media-subtype", the
+ * generic icon of the MIME data and finally "media-x-generic".
+ */
+static char *_xdg_mime_icon_path_resolve(const char *mime, int size, XdgTheme *theme, XdgTheme *hicolor)
+{
+	char icon[MIME_TYPE_NAME_BUFFER_SIZE];
+	const char *name;
+	char *res;
+	char *sep;
+
+#ifdef MIME_SPEC
+	if ((name = xdg_mime_get_icon(mime)) &&
+		(res = _xdg_mime_find_icon(name, size, XdgThemeMimeTypes, theme, hicolor)))
+		return res;
+#endif
+
+	strncpy(icon, mime, sizeof(icon) - sizeof("-x-generic"));
+	icon[sizeof(icon) - sizeof("-x-generic")] = 0;
+
+	if ((sep = strchr(icon, '/')) == NULL)
+		return NULL;
+
+	(*sep) = '-';
+
+	if (res = _xdg_mime_find_icon(icon, size, XdgThemeMimeTypes, theme, hicolor))
+		return res;
+
+#ifdef MIME_SPEC
+	if ((name = xdg_mime_get_generic_icon(mime)) &&
+		(res = _xdg_mime_find_icon(name, size, XdgThemeMimeTypes, theme, hicolor)))
+		return res;
+#endif
+
+	strcpy(sep, "-x-generic");
+	return _xdg_mime_find_icon(icon, size, XdgThemeMimeTypes, theme, hicolor);
+}
+
+const char *xdg_mime_icon_path(const char *mime, int size, const char *themeName)
+{
+	if (mime && themeName)
+	{
+		XdgTheme **hicolor = (XdgTheme **)search_node(&themes_list->themes_files_map, "hicolor");
+
+		if (hicolor)
+		{
+			XdgTheme **theme = (XdgTheme **)search_node(&themes_list->themes_files_map, themeName);
+
+			if (theme)
+			{
+				XdgList *paths = _xdg_icon_path_map_item_add(&themes_list->icon_paths, mime);
+				XdgIconPathItem *item;
+
+				for (item = (XdgIconPathItem *)paths->head; item; item = (XdgIconPathItem *)item->list.next)
+					if (item->theme == *theme && item->size == size)
+						return item->path;
+
+				/* Misses are remembered too, they cost the most stat()s */
+				item = malloc(sizeof(XdgIconPathItem));
+				item->theme = *theme;
+				item->size = size;
+				item->path = _xdg_mime_icon_path_resolve(mime, size, *theme, *hicolor);
+				_xdg_list_apped(paths, (XdgListItem *)item);
+
+				return item->path;
+			}
+		}
+	}
+
+	return NULL;
+}
@@ -57,6 +57,14 @@ typedef enum
 char *xdg_mime_type_icon_lookup(const char *mime, int size, const char *theme);
 char *xdg_icon_lookup(const char *icon, int size, Context context, const char *theme);
 
+/**
+ * Same as xdg_mime_type_icon_lookup(), but also tries the icon names given by
+ * the MIME data and remembers the result per MIME type, size and theme.
+ * The returned path belongs to the library and stays valid until the themes
+ * or the MIME data are reloaded.
+ */
+const char *xdg_mime_icon_path(const char *mime, int size, const char *theme);
+
 #ifdef __cplusplus
 }
 #endif